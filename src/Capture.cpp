@@ -0,0 +1,272 @@
+/*
+ * Capture.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	DepthCapture: captura de profundidad con NewFrameListener
+ *
+ */
+
+#include "Capture.h"
+#include "Latency.h"
+#include "WorkerPool.h"
+
+#include <ctime>
+#include <cerrno>
+
+namespace Capture {
+
+	// Constructor
+
+	DepthCapture::DepthCapture() {
+
+		this->myListening = false;
+		this->myReplay = false;
+		this->myStopped = false;
+		this->myReplayFrames = 0;
+		this->myFirstCpu = 0;
+		this->myNumCpus = 0;
+		this->myPinned = false;
+
+		sem_init(&this->myNewFrame, 0, 0);
+
+	}
+
+	// Destructor
+
+	DepthCapture::~DepthCapture() {
+
+		this->close();
+
+		sem_destroy(&this->myNewFrame);
+
+	}
+
+	openni::Status DepthCapture::open(const char* inUri, bool inReplay) {
+
+		openni::Status theStatus;
+
+		theStatus = this->myDevice.open(inUri);
+		if (theStatus != openni::STATUS_OK) {
+			return theStatus;
+		}
+
+		this->myReplay = inReplay;
+		this->myReplayFrames = 0;
+
+		if (inReplay) {
+
+			// Sin límite de velocidad y sin volver al principio al terminar
+
+			openni::PlaybackControl* thePlayback = this->myDevice.getPlaybackControl();
+
+			if (!this->myDevice.isFile() || (thePlayback == NULL)) {
+				this->myDevice.close();
+				return openni::STATUS_NOT_SUPPORTED;
+			}
+
+			thePlayback->setSpeed(-1);
+			thePlayback->setRepeatEnabled(false);
+		}
+
+		// Crea un stream de cuadros de profundidad a partir del dispositivo
+
+		theStatus = this->myStream.create(this->myDevice, openni::SENSOR_DEPTH);
+		if (theStatus != openni::STATUS_OK) {
+			this->myDevice.close();
+			return theStatus;
+		}
+
+		// El listener se registra antes de arrancar para no perder el primer cuadro.
+		// En reproducción se lee directamente del stream en waitFrame.
+
+		if (inReplay) {
+			theStatus = this->myStream.start();
+		} else {
+			theStatus = this->myStream.addNewFrameListener(this);
+			if (theStatus == openni::STATUS_OK) {
+				this->myListening = true;
+				theStatus = this->myStream.start();
+			}
+		}
+
+		if (theStatus != openni::STATUS_OK) {
+			this->close();
+		}
+
+		return theStatus;
+	}
+
+	void DepthCapture::close() {
+
+		if (this->myListening) {
+			this->myStream.removeNewFrameListener(this);
+			this->myListening = false;
+		}
+
+		if (this->myStream.isValid()) {
+			this->myStream.stop();
+			this->myStream.destroy();
+		}
+
+		// Ya no hay productor: podemos soltar los cuadros retenidos
+
+		this->myFrames.clear();
+
+		this->myDevice.close();
+
+	}
+
+	void DepthCapture::stop() {
+
+		this->myStopped = true;
+		sem_post(&this->myNewFrame);
+
+	}
+
+	openni::Status DepthCapture::setVideoMode(const openni::VideoMode& inMode) {
+
+		if (this->myReplay || !this->myStream.isValid()) {
+			return openni::STATUS_NOT_SUPPORTED;
+		}
+
+		// El listener sigue registrado: los cuadros del nuevo modo llegan por el mismo camino
+
+		this->myStream.stop();
+
+		openni::Status theStatus = this->myStream.setVideoMode(inMode);
+		openni::Status theStartStatus = this->myStream.start();
+
+		return (theStatus != openni::STATUS_OK) ? theStatus : theStartStatus;
+	}
+
+	void DepthCapture::setAffinity(int inFirstCpu, int inNumCpus) {
+		this->myFirstCpu = inFirstCpu;
+		this->myNumCpus = inNumCpus;
+		this->myPinned = false;
+	}
+
+	bool DepthCapture::isValid() {
+		return this->myStream.isValid();
+	}
+
+	void DepthCapture::onNewFrame(openni::VideoStream& inStream) {
+
+		// Hay un cuadro disponible: readFrame no bloquea.
+		// Se lee directamente en el buffer del productor, que solo usa este hilo.
+
+		Slot& theSlot = this->myFrames.getBack();
+
+		if ((this->myNumCpus > 0) && !this->myPinned) {
+			Threads::WorkerPool::setAffinity(pthread_self(), this->myFirstCpu, this->myNumCpus);
+			this->myPinned = true;
+		}
+
+		if (inStream.readFrame(&theSlot.myFrame) != openni::STATUS_OK) {
+			return;
+		}
+
+		theSlot.myReadNs = Timing::nowNs();
+
+		this->myFrames.publish();
+		sem_post(&this->myNewFrame);
+
+	}
+
+	bool DepthCapture::waitFrame(openni::VideoFrameRef* outFrame, int inTimeoutMs, int64_t* outReadNs) {
+
+		if (this->myStopped) {
+			return false;
+		}
+
+		if (this->myReplay) {
+
+			openni::VideoStream* theStream = &this->myStream;
+			int theReady;
+
+			if (this->isFinished() ||
+					(openni::OpenNI::waitForAnyStream(&theStream, 1, &theReady, inTimeoutMs) != openni::STATUS_OK) ||
+					(this->myStream.readFrame(outFrame) != openni::STATUS_OK)) {
+				return false;
+			}
+
+			if (outReadNs != NULL) {
+				*outReadNs = Timing::nowNs();
+			}
+
+			this->myReplayFrames++;
+			return true;
+		}
+
+		struct timespec theDeadline;
+
+		clock_gettime(CLOCK_REALTIME, &theDeadline);
+		theDeadline.tv_sec += inTimeoutMs / 1000;
+		theDeadline.tv_nsec += (long)(inTimeoutMs % 1000) * 1000000;
+		if (theDeadline.tv_nsec >= 1000000000) {
+			theDeadline.tv_sec++;
+			theDeadline.tv_nsec -= 1000000000;
+		}
+
+		// El semáforo puede acumular avisos de cuadros ya descartados:
+		// se sigue esperando hasta encontrar uno nuevo o agotar el tiempo
+
+		while (!this->myFrames.take()) {
+			if (this->myStopped) {
+				return false;
+			}
+			if ((sem_timedwait(&this->myNewFrame, &theDeadline) != 0) && (errno == ETIMEDOUT)) {
+				if (!this->myFrames.take()) {
+					return false;
+				}
+				break;
+			}
+		}
+
+		*outFrame = this->myFrames.getFront().myFrame;
+
+		if (outReadNs != NULL) {
+			*outReadNs = this->myFrames.getFront().myReadNs;
+		}
+
+		return true;
+	}
+
+	unsigned long DepthCapture::getNumFrames() {
+		return this->myReplay ? this->myReplayFrames : this->myFrames.getPublished();
+	}
+
+	unsigned long DepthCapture::getDroppedFrames() {
+		return this->myFrames.getDropped();
+	}
+
+	bool DepthCapture::isReplay() {
+		return this->myReplay;
+	}
+
+	int DepthCapture::getTotalFrames() {
+
+		openni::PlaybackControl* thePlayback = this->myDevice.getPlaybackControl();
+
+		return (thePlayback != NULL) ? thePlayback->getNumberOfFrames(this->myStream) : 0;
+	}
+
+	bool DepthCapture::isFinished() {
+
+		int theTotal = this->getTotalFrames();
+
+		return this->myReplay && (theTotal > 0) && (this->myReplayFrames >= (unsigned long)theTotal);
+	}
+
+	openni::Device& DepthCapture::getDevice() {
+		return this->myDevice;
+	}
+
+	openni::VideoStream& DepthCapture::getStream() {
+		return this->myStream;
+	}
+
+}
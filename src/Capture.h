@@ -0,0 +1,135 @@
+/*
+ * Capture.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Captura de cuadros de profundidad guiada por eventos.
+ *
+ *  En lugar de bloquear en VideoStream::readFrame, se registra un NewFrameListener:
+ *  OpenNI avisa desde su propio hilo cada vez que llega un cuadro, que se deja
+ *  disponible para la etapa de procesado. Los cuadros se entregan como
+ *  openni::VideoFrameRef (referencias con contador), sin copiar los pixeles.
+ *
+ *  El paso de cuadros entre el hilo de OpenNI y el de procesado se hace con un triple
+ *  buffer sin bloqueos: el procesado recibe siempre el cuadro más reciente y los que
+ *  no llegó a tomar se descartan (y se cuentan) en lugar de acumularse en una cola.
+ *  Una etapa lenta (por ejemplo una orden a la PTU) no genera retraso acumulado.
+ *
+ *  El origen puede ser un sensor o una grabación .oni (driver libOniFile.so de OpenNI2).
+ *
+ *  Cada dispositivo abierto tiene su propio hilo de OpenNI; con setAffinity ese hilo se fija
+ *  a unas CPU al recibir el primer cuadro (OpenNI no da acceso al hilo antes).
+ *
+ *  En modo reproducción (solo grabaciones) la lectura es síncrona: sin límite de velocidad
+ *  (PlaybackControl::setSpeed(-1)) el reproductor entrega el siguiente cuadro cuando se
+ *  lee el anterior, así que se procesan todos los cuadros, uno tras otro, tan rápido como
+ *  permita la CPU y sin descartar ninguno. La grabación se recorre una sola vez.
+ *
+ */
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <semaphore.h>
+#include <stdint.h>
+#include <OpenNI.h>
+#include "TripleBuffer.h"
+
+namespace Capture {
+
+	class DepthCapture : public openni::VideoStream::NewFrameListener {
+
+	private:
+
+		// Miembros privados
+
+		openni::Device myDevice;
+		openni::VideoStream myStream;
+		bool myListening;
+		bool myReplay;
+		volatile bool myStopped;
+		unsigned long myReplayFrames;
+
+		// CPU del hilo de OpenNI (myNumCpus 0: sin fijar)
+
+		int myFirstCpu;
+		int myNumCpus;
+		bool myPinned;
+
+		// Cuadro y momento (Timing::nowNs) en que readFrame lo entregó
+
+		struct Slot {
+			openni::VideoFrameRef myFrame;
+			int64_t myReadNs;
+		};
+
+		// Cuadros entre el hilo de OpenNI (productor) y el de procesado (consumidor).
+		// El semáforo solo sirve para que el consumidor duerma mientras no hay cuadros.
+
+		Threads::TripleBuffer<Slot> myFrames;
+		sem_t myNewFrame;
+
+	public:
+
+		// Miembros públicos
+
+		DepthCapture();
+
+		~DepthCapture();
+
+		// Abre el dispositivo (URI de un sensor o ruta de un fichero .oni),
+		// crea el stream de profundidad y empieza a recibir cuadros.
+		// inReplay solo es válido con grabaciones: lectura síncrona sin límite de velocidad.
+
+		openni::Status open(const char* inUri, bool inReplay = false);
+
+		// Cambia el modo de vídeo (resolución y cuadros/s): para el stream, cambia el modo y
+		// lo vuelve a arrancar. Un cuadro del modo anterior aún no tomado se entrega igualmente.
+		// No válido en reproducción.
+
+		openni::Status setVideoMode(const openni::VideoMode& inMode);
+
+		// CPU a las que se fija el hilo de OpenNI que entrega los cuadros. Antes de open.
+
+		void setAffinity(int inFirstCpu, int inNumCpus);
+
+		void close();
+
+		// Hace que waitFrame deje de esperar y devuelva false (desde cualquier hilo), para
+		// terminar el procesado antes de cerrar. El stream lo para y lo destruye close.
+
+		void stop();
+
+		bool isValid();
+
+		// Se llama desde el hilo de OpenNI con cada cuadro nuevo
+
+		void onNewFrame(openni::VideoStream& inStream);
+
+		// Espera hasta inTimeoutMs milisegundos por un cuadro nuevo.
+		// Si han llegado varios desde la última llamada se entrega el más reciente.
+		// outReadNs (opcional) recibe el momento (Timing::nowNs) en que readFrame lo entregó.
+		// Solo debe llamarla un hilo (el de procesado).
+
+		bool waitFrame(openni::VideoFrameRef* outFrame, int inTimeoutMs, int64_t* outReadNs = NULL);
+
+		// Modo reproducción: cuadros de la grabación y si ya se han leído todos
+
+		bool isReplay();
+		int getTotalFrames();
+		bool isFinished();
+
+		// Cuadros recibidos desde la apertura y cuadros descartados por llegar otro más reciente
+
+		unsigned long getNumFrames();
+		unsigned long getDroppedFrames();
+
+		openni::Device& getDevice();
+		openni::VideoStream& getStream();
+
+	};
+
+}
+
+#endif /* CAPTURE_H_ */
@@ -0,0 +1,154 @@
+/*
+ * ClosestPoint.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	ClosestPointFinder: búsqueda paralela del punto más cercano
+ *
+ */
+
+#include "ClosestPoint.h"
+#include "DepthMin.h"
+
+namespace Depth {
+
+	// Constructor
+
+	ClosestPointFinder::ClosestPointFinder(Threads::WorkerPool* inPool) {
+
+		this->myPool = inPool;
+		this->myNumBands = (inPool != NULL) ? inPool->getNumThreads() : 1;
+		this->myBands = new BandResult[this->myNumBands];
+		this->mySearchMode = SEARCH_FULL;
+		this->myNear = 1;
+		this->myFar = 0xfffe;
+		this->myLastBlob.Area = 0;
+		this->myDepth = NULL;
+		this->myWidth = 0;
+		this->myHeight = 0;
+
+		// Resolvemos aquí la versión de findMin para que los hilos no compitan al hacerlo
+
+		getKernel();
+
+	}
+
+	// Destructor
+
+	ClosestPointFinder::~ClosestPointFinder() {
+		delete[] this->myBands;
+	}
+
+	bool ClosestPointFinder::find(const uint16_t* inDepth, int inWidth, int inHeight, Pixel3D* outPoint) {
+
+		int theIndex = -1;
+		uint16_t theZ = 0xffff;
+
+		this->myDepth = inDepth;
+		this->myWidth = inWidth;
+		this->myHeight = inHeight;
+
+		if (this->mySearchMode == SEARCH_BLOB) {
+
+			outPoint->Z = 0xffff;
+
+			if (!this->myBlobExtractor.extract(inDepth, inWidth, inHeight, &this->myLastBlob)) {
+				return false;
+			}
+
+			outPoint->X = (int)(this->myLastBlob.CentroidX + 0.5f);
+			outPoint->Y = (int)(this->myLastBlob.CentroidY + 0.5f);
+			outPoint->Z = this->myLastBlob.Nearest.Z;
+
+			return true;
+		}
+
+		if (this->myPool != NULL) {
+			this->myPool->run(this);
+		} else {
+			this->run(0, 1);
+		}
+
+		// Combinamos las bandas en orden: solo un valor estrictamente menor sustituye al actual
+
+		for (int i = 0; i < this->myNumBands; i++) {
+			if ((this->myBands[i].myIndex >= 0) && (this->myBands[i].myZ < theZ)) {
+				theIndex = this->myBands[i].myIndex;
+				theZ = this->myBands[i].myZ;
+			}
+		}
+
+		outPoint->Z = theZ;
+
+		if (theIndex < 0) {
+			return false;
+		}
+
+		outPoint->X = theIndex % inWidth;
+		outPoint->Y = theIndex / inWidth;
+
+		return true;
+	}
+
+	void ClosestPointFinder::setSearchMode(SearchMode inMode) {
+		this->mySearchMode = inMode;
+	}
+
+	SearchMode ClosestPointFinder::getSearchMode() {
+		return this->mySearchMode;
+	}
+
+	bool ClosestPointFinder::setRange(uint16_t inNear, uint16_t inFar) {
+
+		if (inNear < 1) inNear = 1;
+		if (inFar > 0xfffe) inFar = 0xfffe;
+
+		if (inNear > inFar) {
+			return false;
+		}
+
+		this->myNear = inNear;
+		this->myFar = inFar;
+		this->myBlobExtractor.setRange(inNear, inFar);
+
+		return true;
+	}
+
+	uint16_t ClosestPointFinder::getNear() {
+		return this->myNear;
+	}
+
+	uint16_t ClosestPointFinder::getFar() {
+		return this->myFar;
+	}
+
+	BlobExtractor* ClosestPointFinder::getBlobExtractor() {
+		return &this->myBlobExtractor;
+	}
+
+	const Blob& ClosestPointFinder::getLastBlob() {
+		return this->myLastBlob;
+	}
+
+	// Búsqueda en la banda inPart (filas repartidas lo más equitativamente posible)
+
+	void ClosestPointFinder::run(int inPart, int inNumParts) {
+
+		int theFirstRow = (int)((long long)this->myHeight * inPart / inNumParts);
+		int theLastRow = (int)((long long)this->myHeight * (inPart + 1) / inNumParts);
+		int theOffset = theFirstRow * this->myWidth;
+		BandResult* theBand = &this->myBands[inPart];
+
+		theBand->myZ = 0xffff;
+		theBand->myIndex = findMinInRange(this->myDepth + theOffset, (theLastRow - theFirstRow) * this->myWidth, this->myNear, this->myFar, &theBand->myZ);
+
+		if (theBand->myIndex >= 0) {
+			theBand->myIndex += theOffset;
+		}
+
+	}
+
+}
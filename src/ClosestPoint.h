@@ -0,0 +1,103 @@
+/*
+ * ClosestPoint.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Búsqueda del punto más cercano de un cuadro de profundidad.
+ *
+ *  	ClosestPointFinder: búsqueda por bandas de filas repartidas en un WorkerPool
+ *
+ */
+
+#ifndef CLOSESTPOINT_H_
+#define CLOSESTPOINT_H_
+
+#include <stdint.h>
+#include "Pixel3D.h"
+#include "DepthBlob.h"
+#include "WorkerPool.h"
+
+namespace Depth {
+
+	enum SearchMode {
+		SEARCH_FULL = 0,		// recorrido completo del cuadro
+		SEARCH_BLOB = 1			// objeto más cercano con un área mínima (centroide y profundidad mínima)
+	};
+
+	//////////////////////////////////////////////////////////////////////
+	// Búsqueda del punto más cercano									//
+	//																	//
+	//  - El cuadro se divide en bandas de filas, una por hilo del grupo	//
+	//  - Cada hilo obtiene el mínimo de su banda con Depth::findMinInRange	//
+	//  - Las bandas se combinan en orden, de modo que en caso de empate	//
+	//    gana la primera aparición (igual que el recorrido secuencial)	//
+	//																	//
+	//  En modo SEARCH_BLOB el punto devuelto es el centroide del		//
+	//  objeto más cercano con la profundidad de su pixel más cercano	//
+	//  (la extracción se hace en el hilo llamante)						//
+	//																	//
+	//////////////////////////////////////////////////////////////////////
+
+	class ClosestPointFinder : public Threads::Job {
+
+	private:
+
+		// Resultado de cada banda, en su propia línea de caché
+
+		struct BandResult {
+			int myIndex;
+			uint16_t myZ;
+			char myPadding[64 - sizeof(int) - sizeof(uint16_t)];
+		};
+
+		Threads::WorkerPool* myPool;
+		BandResult* myBands;
+		int myNumBands;
+
+		SearchMode mySearchMode;
+		uint16_t myNear;
+		uint16_t myFar;
+		BlobExtractor myBlobExtractor;
+		Blob myLastBlob;
+
+		// Cuadro en proceso (válido solo durante find())
+
+		const uint16_t* myDepth;
+		int myWidth;
+		int myHeight;
+
+	public:
+
+		// inPool puede ser NULL (búsqueda en el hilo llamante). El grupo no pasa a ser propiedad del buscador.
+
+		ClosestPointFinder(Threads::WorkerPool* inPool);
+
+		~ClosestPointFinder();
+
+		// Devuelve false si el cuadro no tiene ningún pixel válido (outPoint->Z queda a 0xffff)
+
+		bool find(const uint16_t* inDepth, int inWidth, int inHeight, Pixel3D* outPoint);
+
+		void setSearchMode(SearchMode inMode);
+		SearchMode getSearchMode();
+
+		// Rango de profundidades aceptadas en todos los modos (por ejemplo, para ignorar el
+		// propio chasis del robot). Devuelve false y no cambia nada si inNear > inFar.
+
+		bool setRange(uint16_t inNear, uint16_t inFar);
+		uint16_t getNear();
+		uint16_t getFar();
+
+		// Extractor de objetos (para configurarlo) y último objeto encontrado en modo SEARCH_BLOB
+
+		BlobExtractor* getBlobExtractor();
+		const Blob& getLastBlob();
+
+		void run(int inPart, int inNumParts);
+
+	};
+
+}
+
+#endif /* CLOSESTPOINT_H_ */
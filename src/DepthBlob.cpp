@@ -0,0 +1,447 @@
+/*
+ * DepthBlob.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	BlobExtractor: componentes conexas por tramos en una sola pasada
+ *
+ *  Las versiones vectoriales de las máscaras de fila y del mínimo de un tramo están en
+ *  DepthBlob_sse41.cpp y DepthBlob_avx2.cpp.
+ *
+ */
+
+#include "DepthBlob.h"
+#include "DepthMin.h"
+
+namespace Depth {
+
+	typedef void (*rowMasksFunction)(const uint16_t*, const uint16_t*, int, uint16_t, uint16_t, int, uint64_t*, uint64_t*, uint64_t*);
+
+	typedef uint16_t (*runMinFunction)(const uint16_t*, int, int, int, int*);
+
+	// inNear <= inZ <= inNear + inSpan con una sola comparación sin signo
+
+	static inline bool isValid(uint16_t inZ, uint16_t inNear, uint16_t inSpan) {
+		return (uint16_t)(inZ - inNear) <= inSpan;
+	}
+
+	// |inA - inB| <= inMaxStep con una sola comparación sin signo
+
+	static inline bool isNear(uint16_t inA, uint16_t inB, int inMaxStep) {
+		return (unsigned int)((int)inA - (int)inB + inMaxStep) <= (unsigned int)(2 * inMaxStep);
+	}
+
+	// true si hay algún bit a 1 en [inFrom, inTo) (inFrom < inTo)
+
+	static inline bool anyBit(const uint64_t* inMask, int inFrom, int inTo) {
+
+		int theWord = inFrom >> 6;
+		int theLast = (inTo - 1) >> 6;
+		uint64_t theBits = inMask[theWord] & (~0ULL << (inFrom & 63));
+
+		for (; theWord < theLast; theBits = inMask[++theWord]) {
+			if (theBits != 0) {
+				return true;
+			}
+		}
+
+		return (theBits & (~0ULL >> (63 - ((inTo - 1) & 63)))) != 0;
+	}
+
+	void blobRowMasksScalar(const uint16_t* inRow, const uint16_t* inPrevRow, int inWidth, uint16_t inNear, uint16_t inSpan,
+			int inMaxStep, uint64_t* outValid, uint64_t* outLinks, uint64_t* outUp) {
+
+		int theNumWords = (inWidth + 63) >> 6;
+		uint64_t theCarry = 0;
+
+		// Cada palabra se monta en registros, sin saltos por pixel: los bits entran por arriba y se
+		// desplazan hacia abajo. Primero se marcan los pixeles válidos y los que están cerca de su
+		// vecino izquierdo (el primero se compara consigo mismo) y después se exige que los dos
+		// sean válidos.
+
+		for (int w = 0; w < theNumWords; w++) {
+
+			int theX0 = w << 6;
+			int theCount = (inWidth - theX0 < 64) ? inWidth - theX0 : 64;
+			uint64_t theValid = 0;
+			uint64_t theNear = 0;
+			uint64_t theUp = 0;
+
+			for (int x = theX0; x < theX0 + theCount; x++) {
+				theValid = (theValid >> 1) | ((uint64_t)isValid(inRow[x], inNear, inSpan) << 63);
+				theNear = (theNear >> 1) | ((uint64_t)isNear(inRow[x], inRow[x - (x > 0)], inMaxStep) << 63);
+			}
+
+			theValid >>= 64 - theCount;
+			theNear >>= 64 - theCount;
+
+			if (inPrevRow != NULL) {
+				for (int x = theX0; x < theX0 + theCount; x++) {
+					theUp = (theUp >> 1) | ((uint64_t)isNear(inRow[x], inPrevRow[x], inMaxStep) << 63);
+				}
+				outUp[w] = theUp >> (64 - theCount);
+			}
+
+			outValid[w] = theValid;
+			outLinks[w] = theValid & ((theValid << 1) | theCarry) & theNear;
+			theCarry = theValid >> 63;
+		}
+
+	}
+
+	uint16_t blobRunMinScalar(const uint16_t* inRow, int inWidth, int inX0, int inX1, int* outX) {
+
+		(void)inWidth;
+
+		uint16_t outZ = inRow[inX0];
+		int theX = inX0;
+
+		for (int x = inX0 + 1; x < inX1; x++) {
+			if (inRow[x] < outZ) {
+				outZ = inRow[x];
+				theX = x;
+			}
+		}
+
+		*outX = theX;
+
+		return outZ;
+	}
+
+	// Constructor
+
+	BlobExtractor::BlobExtractor() {
+
+		this->myRuns[0] = NULL;
+		this->myRuns[1] = NULL;
+		this->myMasks = NULL;
+		this->myNumWords = 0;
+		this->myLabels = NULL;
+		this->myNumLabels = 0;
+		this->myLabelCapacity = 0;
+		this->myWidth = 0;
+		this->myHeight = 0;
+		this->myDroppedRuns = 0;
+		this->setRange(1, 0xfffe);
+
+		// Por defecto: 50 pixeles y 5 cm entre vecinos (profundidad en mm)
+
+		this->configure(50, 50);
+
+	}
+
+	// Destructor
+
+	BlobExtractor::~BlobExtractor() {
+		delete[] this->myRuns[0];
+		delete[] this->myRuns[1];
+		delete[] this->myMasks;
+		delete[] this->myLabels;
+	}
+
+	void BlobExtractor::configure(int inMinArea, int inMaxStep) {
+
+		if (inMaxStep < 0) inMaxStep = 0;
+		if (inMaxStep > 0xffff) inMaxStep = 0xffff;
+
+		this->myMinArea = inMinArea;
+		this->myMaxStep = inMaxStep;
+	}
+
+	void BlobExtractor::setRange(uint16_t inNear, uint16_t inFar) {
+
+		if (inNear < 1) inNear = 1;
+		if (inFar > 0xfffe) inFar = 0xfffe;
+		if (inFar < inNear) inFar = inNear;
+
+		this->myNear = inNear;
+		this->mySpan = (uint16_t)(inFar - inNear);
+	}
+
+	void BlobExtractor::resize(int inWidth, int inHeight, int inMaxLabels) {
+
+		int theLabels = (inMaxLabels > 0) ? inMaxLabels : inWidth * inHeight / 4 + inWidth;
+
+		if (inWidth != this->myWidth) {
+			for (int i = 0; i < 2; i++) {
+				delete[] this->myRuns[i];
+				this->myRuns[i] = new Run[inWidth];
+			}
+
+			// Por fila: pixeles válidos (después inicios de tramo), unidos a su izquierda
+			// (después finales de tramo) y cerca del de arriba
+
+			delete[] this->myMasks;
+			this->myNumWords = (inWidth + 63) >> 6;
+			this->myMasks = new uint64_t[3 * this->myNumWords];
+		}
+
+		if (theLabels != this->myLabelCapacity) {
+			delete[] this->myLabels;
+			this->myLabels = new Label[theLabels];
+			this->myLabelCapacity = theLabels;
+		}
+
+		this->myWidth = inWidth;
+		this->myHeight = inHeight;
+
+	}
+
+	int BlobExtractor::findRoot(int inLabel) {
+
+		// Compresión de caminos a la mitad
+
+		while (this->myLabels[inLabel].myParent != inLabel) {
+			this->myLabels[inLabel].myParent = this->myLabels[this->myLabels[inLabel].myParent].myParent;
+			inLabel = this->myLabels[inLabel].myParent;
+		}
+
+		return inLabel;
+	}
+
+	int BlobExtractor::merge(int inA, int inB) {
+
+		int theA = this->findRoot(inA);
+		int theB = this->findRoot(inB);
+
+		if (theA == theB) {
+			return theA;
+		}
+
+		// La raíz es siempre la etiqueta más antigua
+
+		if (theB < theA) {
+			int theTmp = theA;
+			theA = theB;
+			theB = theTmp;
+		}
+
+		Label* theRoot = &this->myLabels[theA];
+		Label* theChild = &this->myLabels[theB];
+
+		theChild->myParent = theA;
+		theRoot->myArea += theChild->myArea;
+		theRoot->mySumX += theChild->mySumX;
+		theRoot->mySumY += theChild->mySumY;
+
+		if ((theChild->myMinZ < theRoot->myMinZ) ||
+				((theChild->myMinZ == theRoot->myMinZ) && (theChild->myMinIndex < theRoot->myMinIndex))) {
+			theRoot->myMinZ = theChild->myMinZ;
+			theRoot->myMinIndex = theChild->myMinIndex;
+		}
+
+		return theA;
+	}
+
+	// Acumula el tramo [inX0, inX1) de la fila inY en la raíz inRoot
+
+	void BlobExtractor::addRun(int inRoot, int inX0, int inX1, int inY, uint16_t inMinZ, int inMinIndex) {
+
+		Label* theRoot = &this->myLabels[inRoot];
+
+		theRoot->myArea += inX1 - inX0;
+		theRoot->mySumX += (long long)(inX0 + inX1 - 1) * (inX1 - inX0) / 2;
+		theRoot->mySumY += (long long)inY * (inX1 - inX0);
+
+		if (inMinZ < theRoot->myMinZ) {
+			theRoot->myMinZ = inMinZ;
+			theRoot->myMinIndex = inMinIndex;
+		}
+
+	}
+
+	bool BlobExtractor::extract(const uint16_t* inDepth, int inWidth, int inHeight, Blob* outBlob) {
+
+		if ((inWidth != this->myWidth) || (inHeight != this->myHeight) || (this->myLabels == NULL)) {
+			this->resize(inWidth, inHeight);
+		}
+
+		Run* thePrevRuns = this->myRuns[0];
+		Run* theCurRuns = this->myRuns[1];
+		int theNumPrev = 0;
+		int theNumWords = this->myNumWords;
+		uint64_t* theStarts = this->myMasks;
+		uint64_t* theEnds = theStarts + theNumWords;
+		uint64_t* theUp = theEnds + theNumWords;
+
+		rowMasksFunction theRowMasks = blobRowMasksScalar;
+		runMinFunction theRunMin = blobRunMinScalar;
+
+#ifdef PTU_XTION_X86_SIMD
+		switch (getKernel()) {
+			case KERNEL_AVX2:
+				theRowMasks = blobRowMasksAVX2;
+				theRunMin = blobRunMinAVX2;
+				break;
+			case KERNEL_SSE41:
+				theRowMasks = blobRowMasksSSE41;
+				theRunMin = blobRunMinSSE41;
+				break;
+			default:
+				break;
+		}
+#endif
+
+		this->myNumLabels = 0;
+
+		for (int y = 0; y < inHeight; y++) {
+
+			const uint16_t* theRow = inDepth + y * inWidth;
+			int theNumCur = 0;
+			int thePrev = 0;
+
+			// Las máscaras de pixeles válidos y unidos a su izquierda pasan a ser, en el mismo sitio,
+			// las de inicio de tramo (no unido a su izquierda) y final (el siguiente no se une a él).
+			// Los tramos se recorren por parejas: el i-ésimo inicio con el i-ésimo final.
+
+			theRowMasks(theRow, (y > 0) ? theRow - inWidth : NULL, inWidth, this->myNear, this->mySpan, this->myMaxStep,
+					theStarts, theEnds, theUp);
+
+			for (int w = 0; w < theNumWords; w++) {
+				uint64_t theLinks = theEnds[w];
+				uint64_t theNextLinks = (w + 1 < theNumWords) ? theEnds[w + 1] : 0;
+				theEnds[w] = theStarts[w] & ~((theLinks >> 1) | (theNextLinks << 63));
+				theStarts[w] &= ~theLinks;
+			}
+
+			int theStartWord = 0;
+			int theEndWord = 0;
+			uint64_t theStartBits = theStarts[0];
+			uint64_t theEndBits = theEnds[0];
+
+			for (;;) {
+
+				while ((theStartBits == 0) && (theStartWord + 1 < theNumWords)) {
+					theStartBits = theStarts[++theStartWord];
+				}
+
+				if (theStartBits == 0) {
+					break;
+				}
+
+				int theX0 = (theStartWord << 6) + __builtin_ctzll(theStartBits);
+				theStartBits &= theStartBits - 1;
+
+				while (theEndBits == 0) {
+					theEndBits = theEnds[++theEndWord];
+				}
+
+				int theX1 = (theEndWord << 6) + __builtin_ctzll(theEndBits) + 1;
+				theEndBits &= theEndBits - 1;
+
+				int theMinX;
+				uint16_t theMinZ = theRunMin(theRow, inWidth, theX0, theX1, &theMinX);
+
+				// Unión con los tramos solapados de la fila anterior.
+				// Los tramos de la fila anterior que terminan antes de este ya no solapan con ningún otro.
+				// El tramo se suma directamente al primer objeto con el que conecta: solo se crea
+				// una etiqueta nueva para los tramos que no conectan con nada.
+
+				while ((thePrev < theNumPrev) && (thePrevRuns[thePrev].myX1 <= theX0)) {
+					thePrev++;
+				}
+
+				int theLabel = -1;
+
+				for (int p = thePrev; (p < theNumPrev) && (thePrevRuns[p].myX0 < theX1); p++) {
+
+					int theFrom = (thePrevRuns[p].myX0 > theX0) ? thePrevRuns[p].myX0 : theX0;
+					int theTo = (thePrevRuns[p].myX1 < theX1) ? thePrevRuns[p].myX1 : theX1;
+
+					if (!anyBit(theUp, theFrom, theTo)) {
+						continue;
+					}
+
+					if (theLabel < 0) {
+						theLabel = this->findRoot(thePrevRuns[p].myLabel);
+						this->addRun(theLabel, theX0, theX1, y, theMinZ, y * inWidth + theMinX);
+					} else if (thePrevRuns[p].myLabel != theLabel) {
+						theLabel = this->merge(theLabel, thePrevRuns[p].myLabel);
+					}
+				}
+
+				if (theLabel < 0) {
+
+					if (this->myNumLabels == this->myLabelCapacity) {
+						this->myDroppedRuns++;
+						continue;
+					}
+
+					theLabel = this->myNumLabels++;
+					Label* theL = &this->myLabels[theLabel];
+					theL->myParent = theLabel;
+					theL->myArea = 0;
+					theL->mySumX = 0;
+					theL->mySumY = 0;
+					theL->myMinZ = 0xffff;
+					this->addRun(theLabel, theX0, theX1, y, theMinZ, y * inWidth + theMinX);
+				}
+
+				Run* theRun = &theCurRuns[theNumCur++];
+				theRun->myX0 = theX0;
+				theRun->myX1 = theX1;
+				theRun->myLabel = theLabel;
+			}
+
+			Run* theTmp = thePrevRuns;
+			thePrevRuns = theCurRuns;
+			theCurRuns = theTmp;
+			theNumPrev = theNumCur;
+		}
+
+		// El objeto más cercano entre los que superan el área mínima.
+		// En caso de empate gana el que tiene antes su pixel más cercano.
+
+		int theBest = -1;
+
+		for (int i = 0; i < this->myNumLabels; i++) {
+
+			Label* theL = &this->myLabels[i];
+
+			if ((theL->myParent != i) || (theL->myArea < this->myMinArea)) {
+				continue;
+			}
+
+			if ((theBest < 0) || (theL->myMinZ < this->myLabels[theBest].myMinZ) ||
+					((theL->myMinZ == this->myLabels[theBest].myMinZ) && (theL->myMinIndex < this->myLabels[theBest].myMinIndex))) {
+				theBest = i;
+			}
+		}
+
+		if (theBest < 0) {
+			return false;
+		}
+
+		Label* theL = &this->myLabels[theBest];
+
+		outBlob->Area = theL->myArea;
+		outBlob->CentroidX = (float)((double)theL->mySumX / theL->myArea);
+		outBlob->CentroidY = (float)((double)theL->mySumY / theL->myArea);
+		outBlob->Nearest.X = theL->myMinIndex % inWidth;
+		outBlob->Nearest.Y = theL->myMinIndex / inWidth;
+		outBlob->Nearest.Z = theL->myMinZ;
+
+		return true;
+	}
+
+	int BlobExtractor::getNumComponents() {
+
+		int outNum = 0;
+
+		for (int i = 0; i < this->myNumLabels; i++) {
+			if (this->myLabels[i].myParent == i) {
+				outNum++;
+			}
+		}
+
+		return outNum;
+	}
+
+	unsigned long BlobExtractor::getDroppedRuns() {
+		return this->myDroppedRuns;
+	}
+
+}
@@ -0,0 +1,161 @@
+/*
+ * DepthBlob.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Extracción del objeto (blob) más cercano de un cuadro de profundidad.
+ *
+ *  Un pixel aislado o una mota de ruido no deben ganar la búsqueda del punto más
+ *  cercano. Se agrupan los pixeles en componentes conexas y solo se consideran
+ *  las que superan un área mínima.
+ *
+ *  El cuadro se recorre una sola vez fila a fila:
+ *
+ *  	- cada fila se divide en tramos (runs) de pixeles válidos cuya profundidad
+ *  	  varía entre vecinos como mucho inMaxStep
+ *  	- cada tramo se une (union-find) con los tramos solapados de la fila anterior
+ *  	  si en alguna columna común la diferencia de profundidad tampoco supera inMaxStep
+ *  	- el área, la suma de coordenadas y el pixel más cercano se acumulan en la raíz
+ *
+ *  Las comparaciones por pixel (rango, salto con el vecino izquierdo y con el de la fila
+ *  anterior) se hacen con SSE4.1/AVX2 y dan máscaras de bits por fila. Los límites de los
+ *  tramos salen de __builtin_ctzll sobre esas máscaras y la conexión con un tramo de la fila
+ *  anterior es buscar un bit a 1 en la parte común. El mínimo de cada tramo también es
+ *  vectorial (_mm_minpos_epu16). La versión escalar es la referencia y hace las tres
+ *  comparaciones en todos los pixeles, así que es bastante más lenta.
+ *
+ *  El coste por cuadro es el de las máscaras más un tanto por tramo (mínimo y unión de
+ *  etiquetas). En el banco de pruebas, a 640x480 con AVX2: sin huecos (unos pocos tramos
+ *  por fila) 0,1 ms, frente a 0,3 ms del findMin escalar y 15 us del de AVX2; con un 10% de
+ *  huecos sueltos (unos 28000 tramos) 1-1,4 ms, casi todo por tramo. Con ruido de ese tipo
+ *  no se llega a la velocidad de findMin.
+ *
+ *  Toda la memoria se reserva al cambiar la resolución, nunca por cuadro.
+ *
+ */
+
+#ifndef DEPTHBLOB_H_
+#define DEPTHBLOB_H_
+
+#include <stdint.h>
+#include "Pixel3D.h"
+
+namespace Depth {
+
+	// Objeto encontrado
+
+	struct Blob {
+		float CentroidX;		// centroide en pixeles
+		float CentroidY;
+		Pixel3D Nearest;		// pixel más cercano del objeto
+		int Area;				// número de pixeles
+	};
+
+	class BlobExtractor {
+
+	private:
+
+		// Tramo [myX0, myX1) de una fila
+
+		struct Run {
+			int myX0;
+			int myX1;
+			int myLabel;
+		};
+
+		// Etiqueta (union-find). Los datos solo son válidos en la raíz
+
+		struct Label {
+			int myParent;
+			int myArea;
+			long long mySumX;
+			long long mySumY;
+			uint16_t myMinZ;
+			int myMinIndex;
+		};
+
+		Run* myRuns[2];
+		uint64_t* myMasks;
+		int myNumWords;
+		Label* myLabels;
+		int myNumLabels;
+		int myLabelCapacity;
+		int myWidth;
+		int myHeight;
+
+		int myMinArea;
+		int myMaxStep;
+		uint16_t myNear;
+		uint16_t mySpan;
+		unsigned long myDroppedRuns;
+
+		int findRoot(int inLabel);
+		int merge(int inA, int inB);
+		void addRun(int inRoot, int inX0, int inX1, int inY, uint16_t inMinZ, int inMinIndex);
+
+	public:
+
+		BlobExtractor();
+
+		~BlobExtractor();
+
+		// inMinArea: área mínima (en pixeles) de un objeto válido
+		// inMaxStep: salto máximo de profundidad entre pixeles vecinos del mismo objeto (se recorta a [0, 0xffff])
+
+		void configure(int inMinArea, int inMaxStep);
+
+		// Solo se agrupan pixeles con profundidad en [inNear, inFar] (por defecto todos los no nulos).
+		// Requiere inNear <= inFar.
+
+		void setRange(uint16_t inNear, uint16_t inFar);
+
+		// Reserva la memoria para cuadros de inWidth x inHeight.
+		// inMaxLabels <= 0 reserva una etiqueta por cada 4 pixeles.
+
+		void resize(int inWidth, int inHeight, int inMaxLabels = 0);
+
+		// Devuelve false si no hay ningún objeto con el área mínima
+
+		bool extract(const uint16_t* inDepth, int inWidth, int inHeight, Blob* outBlob);
+
+		// Número de componentes del último cuadro (incluidas las descartadas por área)
+
+		int getNumComponents();
+
+		// Tramos ignorados por falta de etiquetas desde la creación
+
+		unsigned long getDroppedRuns();
+
+	};
+
+	// Máscaras de bits de una fila (el pixel x es el bit x % 64 de la palabra x / 64,
+	// los bits a partir de inWidth quedan a 0):
+	//
+	//	outValid: pixel con profundidad en [inNear, inNear + inSpan]
+	//	outLinks: pixel válido unido al de su izquierda (válido y a no más de inMaxStep)
+	//	outUp: pixel a no más de inMaxStep del de la fila anterior (no se calcula si inPrevRow es NULL)
+	//
+	// Requieren 1 <= inNear, inNear + inSpan <= 0xfffe y 0 <= inMaxStep <= 0xffff
+
+	void blobRowMasksScalar(const uint16_t* inRow, const uint16_t* inPrevRow, int inWidth, uint16_t inNear, uint16_t inSpan,
+			int inMaxStep, uint64_t* outValid, uint64_t* outLinks, uint64_t* outUp);
+
+	// Profundidad mínima del tramo [inX0, inX1) de una fila de inWidth pixeles (inX0 < inX1)
+	// y la columna de su primera aparición en outX. Pueden leer pixeles de la fila fuera del tramo.
+
+	uint16_t blobRunMinScalar(const uint16_t* inRow, int inWidth, int inX0, int inX1, int* outX);
+
+#ifdef PTU_XTION_X86_SIMD
+	void blobRowMasksSSE41(const uint16_t* inRow, const uint16_t* inPrevRow, int inWidth, uint16_t inNear, uint16_t inSpan,
+			int inMaxStep, uint64_t* outValid, uint64_t* outLinks, uint64_t* outUp);
+	void blobRowMasksAVX2(const uint16_t* inRow, const uint16_t* inPrevRow, int inWidth, uint16_t inNear, uint16_t inSpan,
+			int inMaxStep, uint64_t* outValid, uint64_t* outLinks, uint64_t* outUp);
+
+	uint16_t blobRunMinSSE41(const uint16_t* inRow, int inWidth, int inX0, int inX1, int* outX);
+	uint16_t blobRunMinAVX2(const uint16_t* inRow, int inWidth, int inX0, int inX1, int* outX);
+#endif
+
+}
+
+#endif /* DEPTHBLOB_H_ */
@@ -0,0 +1,232 @@
+/*
+ * DepthBlob_avx2.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Máscaras de fila y mínimo de un tramo para la extracción de objetos con AVX2
+ *  (32 pixeles por iteración). Se compila con -mavx2.
+ *
+ *  Las mismas comparaciones que la versión SSE4.1. _mm256_packs_epi16 empaqueta por
+ *  mitades de 128 bits, así que hay que reordenar las palabras de 64 bits antes de
+ *  sacar la máscara.
+ *
+ */
+
+#include "DepthBlob.h"
+
+#ifdef PTU_XTION_X86_SIMD
+
+#include <immintrin.h>
+
+namespace Depth {
+
+	// 0xffff en los pixeles con inV - inNear <= inSpan
+
+	static inline __m256i validAVX2(__m256i inV, __m256i inNear, __m256i inSpan) {
+		__m256i theV = _mm256_sub_epi16(inV, inNear);
+		return _mm256_cmpeq_epi16(_mm256_min_epu16(theV, inSpan), theV);
+	}
+
+	// 0xffff en los pixeles con |inA - inB| <= inStep
+
+	static inline __m256i nearAVX2(__m256i inA, __m256i inB, __m256i inStep) {
+		__m256i theDiff = _mm256_or_si256(_mm256_subs_epu16(inA, inB), _mm256_subs_epu16(inB, inA));
+		return _mm256_cmpeq_epi16(_mm256_min_epu16(theDiff, inStep), theDiff);
+	}
+
+	// Un bit por pixel de dos vectores de comparación
+
+	static inline uint32_t maskAVX2(__m256i inA, __m256i inB) {
+		return (uint32_t)_mm256_movemask_epi8(_mm256_permute4x64_epi64(_mm256_packs_epi16(inA, inB), 0xd8));
+	}
+
+	// Máscaras de los 32 pixeles de inRow a partir de x. inLeft0 son los 16 primeros desplazados
+	// un pixel a la izquierda; inCarry es la validez del pixel x - 1 (0 si x es 0).
+	// Un pixel se une al de su izquierda si los dos son válidos y el salto no pasa de inStep.
+
+	static inline void chunkMasksAVX2(const uint16_t* inRow, const uint16_t* inPrevRow, int x, __m256i inLeft0, uint32_t inCarry,
+			__m256i inNear, __m256i inSpan, __m256i inStep, uint32_t* outValid, uint32_t* outLinks, uint32_t* outUp) {
+
+		__m256i theCur0 = _mm256_loadu_si256((const __m256i*)(inRow + x));
+		__m256i theCur1 = _mm256_loadu_si256((const __m256i*)(inRow + x + 16));
+		__m256i theLeft1 = _mm256_loadu_si256((const __m256i*)(inRow + x + 15));
+
+		uint32_t theValid = maskAVX2(validAVX2(theCur0, inNear, inSpan), validAVX2(theCur1, inNear, inSpan));
+		uint32_t theNear = maskAVX2(nearAVX2(theCur0, inLeft0, inStep), nearAVX2(theCur1, theLeft1, inStep));
+
+		*outValid = theValid;
+		*outLinks = theValid & ((theValid << 1) | inCarry) & theNear;
+
+		if (inPrevRow != NULL) {
+			__m256i thePrev0 = _mm256_loadu_si256((const __m256i*)(inPrevRow + x));
+			__m256i thePrev1 = _mm256_loadu_si256((const __m256i*)(inPrevRow + x + 16));
+			*outUp = maskAVX2(nearAVX2(theCur0, thePrev0, inStep), nearAVX2(theCur1, thePrev1, inStep));
+		}
+
+	}
+
+	// Los 16 primeros pixeles desplazados uno a la derecha con un cero al principio (el primer
+	// pixel de la fila no tiene vecino izquierdo). La mitad baja de cada carril toma la alta del
+	// carril anterior.
+
+	static inline __m256i shiftInZeroAVX2(__m256i inV) {
+		return _mm256_alignr_epi8(inV, _mm256_permute2x128_si256(inV, inV, 0x08), 14);
+	}
+
+	// Añade los 32 bits de inBits a partir del bit x (pueden pasar a la palabra siguiente)
+
+	static inline void orBits(uint64_t* ioMask, int x, uint32_t inBits) {
+
+		int theShift = x & 63;
+
+		ioMask[x >> 6] |= (uint64_t)inBits << theShift;
+
+		if (theShift > 32) {
+			ioMask[(x >> 6) + 1] |= (uint64_t)inBits >> (64 - theShift);
+		}
+
+	}
+
+	// Bloque de 32 pixeles en cualquier posición, para el final de la fila. Puede solaparse con
+	// bloques ya hechos: los pixeles repetidos dan los mismos bits.
+
+	static inline void orChunkAVX2(const uint16_t* inRow, const uint16_t* inPrevRow, int x, uint16_t inNear, uint16_t inSpan,
+			__m256i inNearV, __m256i inSpanV, __m256i inStepV, uint64_t* outValid, uint64_t* outLinks, uint64_t* outUp) {
+
+		__m256i theLeft;
+		uint32_t theCarry;
+		uint32_t theValid;
+		uint32_t theLinks;
+		uint32_t theUp;
+
+		if (x == 0) {
+			theLeft = shiftInZeroAVX2(_mm256_loadu_si256((const __m256i*)inRow));
+			theCarry = 0;
+		} else {
+			theLeft = _mm256_loadu_si256((const __m256i*)(inRow + x - 1));
+			theCarry = ((uint16_t)(inRow[x - 1] - inNear) <= inSpan) ? 1 : 0;
+		}
+
+		chunkMasksAVX2(inRow, inPrevRow, x, theLeft, theCarry, inNearV, inSpanV, inStepV, &theValid, &theLinks, &theUp);
+
+		orBits(outValid, x, theValid);
+		orBits(outLinks, x, theLinks);
+
+		if (inPrevRow != NULL) {
+			orBits(outUp, x, theUp);
+		}
+
+	}
+
+	void blobRowMasksAVX2(const uint16_t* inRow, const uint16_t* inPrevRow, int inWidth, uint16_t inNear, uint16_t inSpan,
+			int inMaxStep, uint64_t* outValid, uint64_t* outLinks, uint64_t* outUp) {
+
+		if (inWidth < 32) {
+			blobRowMasksScalar(inRow, inPrevRow, inWidth, inNear, inSpan, inMaxStep, outValid, outLinks, outUp);
+			return;
+		}
+
+		const __m256i theNear = _mm256_set1_epi16((short)inNear);
+		const __m256i theSpan = _mm256_set1_epi16((short)inSpan);
+		const __m256i theStep = _mm256_set1_epi16((short)inMaxStep);
+
+		int theNumFull = inWidth >> 6;
+		__m256i theLeft = shiftInZeroAVX2(_mm256_loadu_si256((const __m256i*)inRow));
+		uint32_t theCarry = 0;
+		uint32_t theValid[2];
+		uint32_t theLinks[2];
+		uint32_t theUp[2] = { 0, 0 };
+
+		// Palabras completas: dos bloques de 32 pixeles cada una
+
+		for (int w = 0; w < theNumFull; w++) {
+
+			int x = w << 6;
+
+			chunkMasksAVX2(inRow, inPrevRow, x, theLeft, theCarry, theNear, theSpan, theStep, &theValid[0], &theLinks[0], &theUp[0]);
+			chunkMasksAVX2(inRow, inPrevRow, x + 32, _mm256_loadu_si256((const __m256i*)(inRow + x + 31)), theValid[0] >> 31,
+					theNear, theSpan, theStep, &theValid[1], &theLinks[1], &theUp[1]);
+
+			outValid[w] = theValid[0] | ((uint64_t)theValid[1] << 32);
+			outLinks[w] = theLinks[0] | ((uint64_t)theLinks[1] << 32);
+
+			if (inPrevRow != NULL) {
+				outUp[w] = theUp[0] | ((uint64_t)theUp[1] << 32);
+			}
+
+			theCarry = theValid[1] >> 31;
+
+			if (x + 64 < inWidth) {
+				theLeft = _mm256_loadu_si256((const __m256i*)(inRow + x + 63));
+			}
+		}
+
+		// Última palabra incompleta: un bloque desde su principio si cabe y otro que acaba en el
+		// último pixel (puede empezar en la palabra anterior)
+
+		if (inWidth & 63) {
+
+			int x = theNumFull << 6;
+
+			outValid[theNumFull] = 0;
+			outLinks[theNumFull] = 0;
+
+			if (inPrevRow != NULL) {
+				outUp[theNumFull] = 0;
+			}
+
+			if (x + 32 < inWidth) {
+				orChunkAVX2(inRow, inPrevRow, x, inNear, inSpan, theNear, theSpan, theStep, outValid, outLinks, outUp);
+			}
+
+			orChunkAVX2(inRow, inPrevRow, inWidth - 32, inNear, inSpan, theNear, theSpan, theStep, outValid, outLinks, outUp);
+		}
+
+	}
+
+	// Los tramos de hasta 16 pixeles van a la versión SSE4.1 (_mm_minpos_epu16 ya da el mínimo
+	// y su posición). Los largos, por bloques de 16 (el último se solapa con el anterior),
+	// reducidos a 8 para _mm_minpos_epu16, y después el primer bloque que lo contiene.
+
+	uint16_t blobRunMinAVX2(const uint16_t* inRow, int inWidth, int inX0, int inX1, int* outX) {
+
+		if (inX1 - inX0 <= 16) {
+			return blobRunMinSSE41(inRow, inWidth, inX0, inX1, outX);
+		}
+
+		const uint16_t* theRun = inRow + inX0;
+		int theLength = inX1 - inX0;
+		__m256i theMin = _mm256_loadu_si256((const __m256i*)theRun);
+		int i;
+
+		for (i = 16; i + 16 <= theLength; i += 16) {
+			theMin = _mm256_min_epu16(theMin, _mm256_loadu_si256((const __m256i*)(theRun + i)));
+		}
+
+		theMin = _mm256_min_epu16(theMin, _mm256_loadu_si256((const __m256i*)(theRun + theLength - 16)));
+
+		__m128i theMin8 = _mm_min_epu16(_mm256_castsi256_si128(theMin), _mm256_extracti128_si256(theMin, 1));
+		uint16_t outZ = (uint16_t)_mm_cvtsi128_si32(_mm_minpos_epu16(theMin8));
+		__m256i theTarget = _mm256_set1_epi16((short)outZ);
+
+		for (i = 0; ; i += 16) {
+
+			if (i + 16 > theLength) {
+				i = theLength - 16;
+			}
+
+			int theMask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(theRun + i)), theTarget));
+
+			if (theMask != 0) {
+				*outX = inX0 + i + (__builtin_ctz(theMask) >> 1);
+				break;
+			}
+		}
+
+		return outZ;
+	}
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * DepthBlob_sse41.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Máscaras de fila y mínimo de un tramo para la extracción de objetos con SSE4.1
+ *  (16 pixeles por iteración). Se compila con -msse4.1.
+ *
+ *  Las comparaciones sin signo se hacen con min: a <= b si min(a, b) == a. El salto
+ *  |a - b| sale de dos restas con saturación. Los resultados de 16 bits se empaquetan
+ *  a bytes para sacar una máscara de 16 pixeles con _mm_movemask_epi8.
+ *
+ */
+
+#include "DepthBlob.h"
+
+#ifdef PTU_XTION_X86_SIMD
+
+#include <smmintrin.h>
+
+namespace Depth {
+
+	// 0xffff en los pixeles con inV - inNear <= inSpan
+
+	static inline __m128i validSSE41(__m128i inV, __m128i inNear, __m128i inSpan) {
+		__m128i theV = _mm_sub_epi16(inV, inNear);
+		return _mm_cmpeq_epi16(_mm_min_epu16(theV, inSpan), theV);
+	}
+
+	// 0xffff en los pixeles con |inA - inB| <= inStep
+
+	static inline __m128i nearSSE41(__m128i inA, __m128i inB, __m128i inStep) {
+		__m128i theDiff = _mm_or_si128(_mm_subs_epu16(inA, inB), _mm_subs_epu16(inB, inA));
+		return _mm_cmpeq_epi16(_mm_min_epu16(theDiff, inStep), theDiff);
+	}
+
+	// Un bit por pixel de dos vectores de comparación
+
+	static inline uint32_t maskSSE41(__m128i inA, __m128i inB) {
+		return (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(inA, inB));
+	}
+
+	// Máscaras de los 16 pixeles de inRow a partir de x. inLeft0 son los 8 primeros desplazados
+	// un pixel a la izquierda; inCarry es la validez del pixel x - 1 (0 si x es 0).
+	// Un pixel se une al de su izquierda si los dos son válidos y el salto no pasa de inStep.
+
+	static inline void chunkMasksSSE41(const uint16_t* inRow, const uint16_t* inPrevRow, int x, __m128i inLeft0, uint32_t inCarry,
+			__m128i inNear, __m128i inSpan, __m128i inStep, uint32_t* outValid, uint32_t* outLinks, uint32_t* outUp) {
+
+		__m128i theCur0 = _mm_loadu_si128((const __m128i*)(inRow + x));
+		__m128i theCur1 = _mm_loadu_si128((const __m128i*)(inRow + x + 8));
+		__m128i theLeft1 = _mm_loadu_si128((const __m128i*)(inRow + x + 7));
+
+		uint32_t theValid = maskSSE41(validSSE41(theCur0, inNear, inSpan), validSSE41(theCur1, inNear, inSpan));
+		uint32_t theNear = maskSSE41(nearSSE41(theCur0, inLeft0, inStep), nearSSE41(theCur1, theLeft1, inStep));
+
+		*outValid = theValid;
+		*outLinks = theValid & ((theValid << 1) | inCarry) & theNear;
+
+		if (inPrevRow != NULL) {
+			__m128i thePrev0 = _mm_loadu_si128((const __m128i*)(inPrevRow + x));
+			__m128i thePrev1 = _mm_loadu_si128((const __m128i*)(inPrevRow + x + 8));
+			*outUp = maskSSE41(nearSSE41(theCur0, thePrev0, inStep), nearSSE41(theCur1, thePrev1, inStep));
+		}
+
+	}
+
+	// Añade los 16 bits de inBits a partir del bit x (pueden pasar a la palabra siguiente)
+
+	static inline void orBits(uint64_t* ioMask, int x, uint32_t inBits) {
+
+		int theShift = x & 63;
+
+		ioMask[x >> 6] |= (uint64_t)inBits << theShift;
+
+		if (theShift > 48) {
+			ioMask[(x >> 6) + 1] |= (uint64_t)inBits >> (64 - theShift);
+		}
+
+	}
+
+	// Bloque de 16 pixeles en cualquier posición, para el final de la fila. Puede solaparse con
+	// bloques ya hechos: los pixeles repetidos dan los mismos bits.
+
+	static inline void orChunkSSE41(const uint16_t* inRow, const uint16_t* inPrevRow, int x, uint16_t inNear, uint16_t inSpan,
+			__m128i inNearV, __m128i inSpanV, __m128i inStepV, uint64_t* outValid, uint64_t* outLinks, uint64_t* outUp) {
+
+		__m128i theLeft;
+		uint32_t theCarry;
+		uint32_t theValid;
+		uint32_t theLinks;
+		uint32_t theUp;
+
+		if (x == 0) {
+			theLeft = _mm_slli_si128(_mm_loadu_si128((const __m128i*)inRow), 2);
+			theCarry = 0;
+		} else {
+			theLeft = _mm_loadu_si128((const __m128i*)(inRow + x - 1));
+			theCarry = ((uint16_t)(inRow[x - 1] - inNear) <= inSpan) ? 1 : 0;
+		}
+
+		chunkMasksSSE41(inRow, inPrevRow, x, theLeft, theCarry, inNearV, inSpanV, inStepV, &theValid, &theLinks, &theUp);
+
+		orBits(outValid, x, theValid);
+		orBits(outLinks, x, theLinks);
+
+		if (inPrevRow != NULL) {
+			orBits(outUp, x, theUp);
+		}
+
+	}
+
+	void blobRowMasksSSE41(const uint16_t* inRow, const uint16_t* inPrevRow, int inWidth, uint16_t inNear, uint16_t inSpan,
+			int inMaxStep, uint64_t* outValid, uint64_t* outLinks, uint64_t* outUp) {
+
+		if (inWidth < 16) {
+			blobRowMasksScalar(inRow, inPrevRow, inWidth, inNear, inSpan, inMaxStep, outValid, outLinks, outUp);
+			return;
+		}
+
+		const __m128i theNear = _mm_set1_epi16((short)inNear);
+		const __m128i theSpan = _mm_set1_epi16((short)inSpan);
+		const __m128i theStep = _mm_set1_epi16((short)inMaxStep);
+
+		int theNumFull = inWidth >> 6;
+
+		// El primer pixel no tiene vecino izquierdo: se desplaza el primer vector con un cero al principio
+
+		__m128i theLeft = _mm_slli_si128(_mm_loadu_si128((const __m128i*)inRow), 2);
+		uint32_t theCarry = 0;
+		uint32_t theValid;
+		uint32_t theLinks;
+		uint32_t theUp = 0;
+
+		// Palabras completas: cuatro bloques de 16 pixeles cada una
+
+		for (int w = 0; w < theNumFull; w++) {
+
+			uint64_t theValidWord = 0;
+			uint64_t theLinksWord = 0;
+			uint64_t theUpWord = 0;
+
+			for (int b = 0; b < 64; b += 16) {
+
+				int x = (w << 6) + b;
+
+				if (x > 0) {
+					theLeft = _mm_loadu_si128((const __m128i*)(inRow + x - 1));
+				}
+
+				chunkMasksSSE41(inRow, inPrevRow, x, theLeft, theCarry, theNear, theSpan, theStep, &theValid, &theLinks, &theUp);
+
+				theValidWord |= (uint64_t)theValid << b;
+				theLinksWord |= (uint64_t)theLinks << b;
+				theUpWord |= (uint64_t)theUp << b;
+				theCarry = theValid >> 15;
+			}
+
+			outValid[w] = theValidWord;
+			outLinks[w] = theLinksWord;
+
+			if (inPrevRow != NULL) {
+				outUp[w] = theUpWord;
+			}
+		}
+
+		// Última palabra incompleta: bloques desde su principio mientras quepan y otro que acaba
+		// en el último pixel (puede empezar en la palabra anterior)
+
+		if (inWidth & 63) {
+
+			int x = theNumFull << 6;
+
+			outValid[theNumFull] = 0;
+			outLinks[theNumFull] = 0;
+
+			if (inPrevRow != NULL) {
+				outUp[theNumFull] = 0;
+			}
+
+			for (; x + 16 < inWidth; x += 16) {
+				orChunkSSE41(inRow, inPrevRow, x, inNear, inSpan, theNear, theSpan, theStep, outValid, outLinks, outUp);
+			}
+
+			orChunkSSE41(inRow, inPrevRow, inWidth - 16, inNear, inSpan, theNear, theSpan, theStep, outValid, outLinks, outUp);
+		}
+
+	}
+
+	// Tramos de hasta 16 pixeles: se cargan 16 pixeles de la fila que los contienen (sin salir
+	// de la fila), los que no son del tramo pasan a 0xffff (ningún pixel válido lo vale) y
+	// _mm_minpos_epu16 da el mínimo de cada mitad con su primera aparición. Sin saltos.
+	// Tramos más largos: mínimo por bloques de 8 (el último se solapa con el anterior) y
+	// después el primer bloque que lo contiene.
+
+	uint16_t blobRunMinSSE41(const uint16_t* inRow, int inWidth, int inX0, int inX1, int* outX) {
+
+		if (inX1 - inX0 <= 16) {
+
+			if (inWidth < 16) {
+				return blobRunMinScalar(inRow, inWidth, inX0, inX1, outX);
+			}
+
+			int theStart = (inX0 + 16 <= inWidth) ? inX0 : inWidth - 16;
+			const __m128i theIota0 = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+			const __m128i theIota1 = _mm_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15);
+			const __m128i theFrom = _mm_set1_epi16((short)(inX0 - theStart));
+			const __m128i theLast = _mm_set1_epi16((short)(inX1 - 1 - theStart));
+
+			__m128i theOut0 = _mm_or_si128(_mm_cmpgt_epi16(theFrom, theIota0), _mm_cmpgt_epi16(theIota0, theLast));
+			__m128i theOut1 = _mm_or_si128(_mm_cmpgt_epi16(theFrom, theIota1), _mm_cmpgt_epi16(theIota1, theLast));
+
+			uint32_t theMin0 = (uint32_t)_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_or_si128(_mm_loadu_si128((const __m128i*)(inRow + theStart)), theOut0)));
+			uint32_t theMin1 = (uint32_t)_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_or_si128(_mm_loadu_si128((const __m128i*)(inRow + theStart + 8)), theOut1)));
+
+			// En caso de empate gana la primera mitad
+
+			bool theSecond = (theMin1 & 0xffff) < (theMin0 & 0xffff);
+			uint32_t theMin = theSecond ? theMin1 : theMin0;
+
+			*outX = theStart + (theSecond ? 8 : 0) + (int)((theMin >> 16) & 7);
+
+			return (uint16_t)theMin;
+		}
+
+		const uint16_t* theRun = inRow + inX0;
+		int theLength = inX1 - inX0;
+		__m128i theMin = _mm_loadu_si128((const __m128i*)theRun);
+		int i;
+
+		for (i = 8; i + 8 <= theLength; i += 8) {
+			theMin = _mm_min_epu16(theMin, _mm_loadu_si128((const __m128i*)(theRun + i)));
+		}
+
+		theMin = _mm_min_epu16(theMin, _mm_loadu_si128((const __m128i*)(theRun + theLength - 8)));
+
+		uint16_t outZ = (uint16_t)_mm_cvtsi128_si32(_mm_minpos_epu16(theMin));
+		__m128i theTarget = _mm_set1_epi16((short)outZ);
+
+		for (i = 0; ; i += 8) {
+
+			if (i + 8 > theLength) {
+				i = theLength - 8;
+			}
+
+			int theMask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(theRun + i)), theTarget));
+
+			if (theMask != 0) {
+				*outX = inX0 + i + (__builtin_ctz(theMask) >> 1);
+				break;
+			}
+		}
+
+		return outZ;
+	}
+
+}
+
+#endif
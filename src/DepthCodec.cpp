@@ -0,0 +1,318 @@
+/*
+ * DepthCodec.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Funciones:
+ *
+ *  	encodeFrame, decodeFrame: filas, series de bloques y elección de la implementación
+ *  	encodeBlockScalar, decodeBlockScalar: bloque pixel a pixel (referencia)
+ *
+ */
+
+#include "DepthCodec.h"
+#include "DepthMin.h"
+
+#include <cstring>
+
+namespace Depth {
+
+	typedef int (*EncodeBlockFunction)(const uint16_t*, uint16_t*, uint8_t*);
+	typedef const uint8_t* (*DecodeBlockFunction)(const uint8_t*, uint16_t*, uint16_t*);
+
+	enum RunKind {
+		RUN_NONE = 0,
+		RUN_ZERO = CODEC_ZERO_RUN,
+		RUN_FLAT = CODEC_FLAT_RUN
+	};
+
+	static const int PayloadBytes[4] = { 0, CODEC_BLOCK / 2, CODEC_BLOCK, 2 * CODEC_BLOCK };
+
+	int getBlockBytes(uint8_t inHeader) {
+
+		if ((inHeader & ~(CODEC_MASK | 3)) != 0) {
+			return 0;
+		}
+
+		return 1 + ((inHeader & CODEC_MASK) ? 2 : 0) + PayloadBytes[inHeader & 3];
+	}
+
+	size_t getEncodedBound(int inWidth, int inHeight) {
+		return (size_t)inHeight * ((inWidth + CODEC_BLOCK - 1) / CODEC_BLOCK) * CODEC_MAX_BLOCK_BYTES;
+	}
+
+	// Un bloque ya codificado que puede ir en una serie: sin ningún pixel con medida, o sin
+	// pixeles sin medida y todas las diferencias 0
+
+	static RunKind getRunKind(const uint8_t* inBlock) {
+
+		if (inBlock[0] == CODEC_WIDTH_0) {
+			return RUN_FLAT;
+		}
+
+		if ((inBlock[0] == (CODEC_MASK | CODEC_WIDTH_0)) && (inBlock[1] == 0xff) && (inBlock[2] == 0xff)) {
+			return RUN_ZERO;
+		}
+
+		return RUN_NONE;
+	}
+
+	// Una fila. ioCarry: a la entrada, la predicción del primer pixel; a la salida, la de la
+	// fila siguiente (su primer pixel, o la predicción si no tiene medida).
+	// Con una serie abierta el bloque se codifica un byte más adelante, donde irá si no
+	// continúa la serie; si la continúa, se descarta.
+
+	static uint8_t* encodeRow(EncodeBlockFunction inEncodeBlock, const uint16_t* inRow, int inWidth, uint16_t* ioCarry, uint8_t* outBytes) {
+
+		uint16_t thePrevious = *ioCarry;
+		uint16_t thePadded[CODEC_BLOCK];
+		RunKind theRunKind = RUN_NONE;
+		int theRunLength = 0;
+
+		if ((inWidth > 0) && (inRow[0] != 0)) {
+			*ioCarry = inRow[0];
+		}
+
+		for (int x = 0; x < inWidth; x += CODEC_BLOCK) {
+
+			const uint16_t* theBlock = inRow + x;
+
+			if (inWidth - x < CODEC_BLOCK) {
+				for (int i = 0; i < CODEC_BLOCK; i++) {
+					thePadded[i] = (x + i < inWidth) ? inRow[x + i] : inRow[inWidth - 1];
+				}
+				theBlock = thePadded;
+			}
+
+			uint8_t* theAt = outBytes + ((theRunLength > 0) ? 1 : 0);
+			int theLength = inEncodeBlock(theBlock, &thePrevious, theAt);
+			RunKind theKind = getRunKind(theAt);
+
+			if ((theKind != RUN_NONE) && (theKind == theRunKind) && (theRunLength < CODEC_MAX_RUN)) {
+				theRunLength++;
+				continue;
+			}
+
+			if (theRunLength > 0) {
+				*outBytes++ = (uint8_t)(theRunKind | theRunLength);
+				theRunLength = 0;
+			}
+
+			if (theKind != RUN_NONE) {
+				theRunKind = theKind;
+				theRunLength = 1;
+			} else {
+				theRunKind = RUN_NONE;
+				outBytes += theLength;
+			}
+		}
+
+		if (theRunLength > 0) {
+			*outBytes++ = (uint8_t)(theRunKind | theRunLength);
+		}
+
+		return outBytes;
+	}
+
+	static const uint8_t* decodeRow(DecodeBlockFunction inDecodeBlock, const uint8_t* inBytes, const uint8_t* inEnd, int inWidth,
+			uint16_t* ioCarry, uint16_t* outRow) {
+
+		uint16_t thePrevious = *ioCarry;
+		uint16_t thePadded[CODEC_BLOCK];
+		int x = 0;
+
+		while (x < inWidth) {
+
+			if (inBytes >= inEnd) {
+				return NULL;
+			}
+
+			uint8_t theHeader = *inBytes;
+
+			if (theHeader & (CODEC_ZERO_RUN | CODEC_FLAT_RUN)) {
+
+				int theLength = (theHeader & CODEC_MAX_RUN) * CODEC_BLOCK;
+				uint16_t theValue = (theHeader & CODEC_ZERO_RUN) ? 0 : thePrevious;
+
+				if ((theLength == 0) || ((theHeader & CODEC_ZERO_RUN) && (theHeader & CODEC_FLAT_RUN)) ||
+						(x + theLength >= inWidth + CODEC_BLOCK)) {
+					return NULL;
+				}
+
+				for (int i = x; (i < x + theLength) && (i < inWidth); i++) {
+					outRow[i] = theValue;
+				}
+
+				inBytes++;
+				x += theLength;
+				continue;
+			}
+
+			int theBlockBytes = getBlockBytes(theHeader);
+
+			if ((theBlockBytes == 0) || (inEnd - inBytes < theBlockBytes)) {
+				return NULL;
+			}
+
+			if (inWidth - x >= CODEC_BLOCK) {
+				inBytes = inDecodeBlock(inBytes, &thePrevious, outRow + x);
+			} else {
+				inBytes = inDecodeBlock(inBytes, &thePrevious, thePadded);
+				memcpy(outRow + x, thePadded, (inWidth - x) * sizeof(uint16_t));
+			}
+
+			x += CODEC_BLOCK;
+		}
+
+		if ((inWidth > 0) && (outRow[0] != 0)) {
+			*ioCarry = outRow[0];
+		}
+
+		return inBytes;
+	}
+
+	size_t encodeFrame(const uint16_t* inDepth, int inWidth, int inHeight, uint8_t* outBytes) {
+
+		EncodeBlockFunction theEncodeBlock = encodeBlockScalar;
+
+#ifdef PTU_XTION_X86_SIMD
+		if (getKernel() != KERNEL_SCALAR) {
+			theEncodeBlock = encodeBlockSSE41;
+		}
+#endif
+
+		uint8_t* theOut = outBytes;
+		uint16_t theCarry = 0;
+
+		for (int y = 0; y < inHeight; y++) {
+			theOut = encodeRow(theEncodeBlock, inDepth + (size_t)y * inWidth, inWidth, &theCarry, theOut);
+		}
+
+		return (size_t)(theOut - outBytes);
+	}
+
+	bool decodeFrame(const uint8_t* inBytes, size_t inNumBytes, int inWidth, int inHeight, uint16_t* outDepth) {
+
+		DecodeBlockFunction theDecodeBlock = decodeBlockScalar;
+
+#ifdef PTU_XTION_X86_SIMD
+		if (getKernel() != KERNEL_SCALAR) {
+			theDecodeBlock = decodeBlockSSE41;
+		}
+#endif
+
+		const uint8_t* theIn = inBytes;
+		const uint8_t* theEnd = inBytes + inNumBytes;
+		uint16_t theCarry = 0;
+
+		for (int y = 0; (y < inHeight) && (theIn != NULL); y++) {
+			theIn = decodeRow(theDecodeBlock, theIn, theEnd, inWidth, &theCarry, outDepth + (size_t)y * inWidth);
+		}
+
+		return theIn == theEnd;
+	}
+
+	int encodeBlockScalar(const uint16_t* inPixels, uint16_t* ioPrevious, uint8_t* outBytes) {
+
+		uint16_t thePrevious = *ioPrevious;
+		uint16_t theZigzag[CODEC_BLOCK];
+		unsigned int theMask = 0;
+		unsigned int theBits = 0;
+
+		for (int i = 0; i < CODEC_BLOCK; i++) {
+
+			uint16_t theValue = inPixels[i];
+
+			if (theValue == 0) {
+				theMask |= 1u << i;
+				theValue = thePrevious;
+			}
+
+			int16_t theDelta = (int16_t)(uint16_t)(theValue - thePrevious);
+			theZigzag[i] = (uint16_t)((theDelta << 1) ^ (theDelta >> 15));
+			theBits |= theZigzag[i];
+			thePrevious = theValue;
+		}
+
+		*ioPrevious = thePrevious;
+
+		int theWidth = (theBits == 0) ? CODEC_WIDTH_0 : (theBits < 16) ? CODEC_WIDTH_4 : (theBits < 256) ? CODEC_WIDTH_8 : CODEC_WIDTH_16;
+		uint8_t* theOut = outBytes;
+
+		*theOut++ = (uint8_t)(theWidth | (theMask ? CODEC_MASK : 0));
+
+		if (theMask) {
+			*theOut++ = (uint8_t)theMask;
+			*theOut++ = (uint8_t)(theMask >> 8);
+		}
+
+		switch (theWidth) {
+			case CODEC_WIDTH_4:
+				for (int i = 0; i < CODEC_BLOCK / 2; i++) {
+					*theOut++ = (uint8_t)(theZigzag[i] | (theZigzag[i + CODEC_BLOCK / 2] << 4));
+				}
+				break;
+			case CODEC_WIDTH_8:
+				for (int i = 0; i < CODEC_BLOCK; i++) {
+					*theOut++ = (uint8_t)theZigzag[i];
+				}
+				break;
+			case CODEC_WIDTH_16:
+				for (int i = 0; i < CODEC_BLOCK; i++) {
+					*theOut++ = (uint8_t)theZigzag[i];
+					*theOut++ = (uint8_t)(theZigzag[i] >> 8);
+				}
+				break;
+		}
+
+		return (int)(theOut - outBytes);
+	}
+
+	const uint8_t* decodeBlockScalar(const uint8_t* inBytes, uint16_t* ioPrevious, uint16_t* outPixels) {
+
+		uint8_t theHeader = *inBytes++;
+		uint16_t theZigzag[CODEC_BLOCK];
+		unsigned int theMask = 0;
+
+		if (theHeader & CODEC_MASK) {
+			theMask = inBytes[0] | (inBytes[1] << 8);
+			inBytes += 2;
+		}
+
+		switch (theHeader & 3) {
+			case CODEC_WIDTH_0:
+				memset(theZigzag, 0, sizeof(theZigzag));
+				break;
+			case CODEC_WIDTH_4:
+				for (int i = 0; i < CODEC_BLOCK / 2; i++) {
+					theZigzag[i] = inBytes[i] & 0x0f;
+					theZigzag[i + CODEC_BLOCK / 2] = inBytes[i] >> 4;
+				}
+				break;
+			case CODEC_WIDTH_8:
+				for (int i = 0; i < CODEC_BLOCK; i++) {
+					theZigzag[i] = inBytes[i];
+				}
+				break;
+			default:
+				for (int i = 0; i < CODEC_BLOCK; i++) {
+					theZigzag[i] = (uint16_t)(inBytes[2 * i] | (inBytes[2 * i + 1] << 8));
+				}
+				break;
+		}
+
+		uint16_t thePrevious = *ioPrevious;
+
+		for (int i = 0; i < CODEC_BLOCK; i++) {
+			uint16_t theDelta = (uint16_t)((theZigzag[i] >> 1) ^ (uint16_t)-(theZigzag[i] & 1));
+			thePrevious = (uint16_t)(thePrevious + theDelta);
+			outPixels[i] = (theMask & (1u << i)) ? 0 : thePrevious;
+		}
+
+		*ioPrevious = thePrevious;
+
+		return inBytes + PayloadBytes[theHeader & 3];
+	}
+
+}
@@ -0,0 +1,88 @@
+/*
+ * DepthCodec.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Compresión sin pérdidas de cuadros de profundidad de 16 bits (openni::DepthPixel),
+ *  para grabarlos o enviarlos.
+ *
+ *  	encodeFrame / decodeFrame: eligen la implementación de bloque según getKernel()
+ *  	encodeBlockScalar / decodeBlockScalar: bloque de CODEC_BLOCK pixeles (referencia)
+ *  	encodeBlockSSE41 / decodeBlockSSE41: versiones vectoriales (solo x86)
+ *
+ *  Cada fila se recorre en bloques de CODEC_BLOCK pixeles. Los pixeles sin medida (0) se
+ *  marcan en una máscara y, para predecir, toman el valor del anterior: así un hueco no
+ *  rompe la predicción. Cada pixel se predice con el de su izquierda; el primero de la
+ *  fila, con el primero de la fila anterior. Las diferencias (en zigzag: 0, -1, 1, -2...)
+ *  se empaquetan con el ancho que necesita la mayor del bloque: 0, 4, 8 o 16 bits.
+ *
+ *  Formato de cada fila, byte a byte:
+ *
+ *  	CODEC_ZERO_RUN | n: n bloques (1..63) sin ningún pixel con medida
+ *  	CODEC_FLAT_RUN | n: n bloques iguales al último pixel con medida
+ *  	cabecera de bloque: ancho (CODEC_WIDTH_*) y CODEC_MASK si hay pixeles sin medida;
+ *  	siguen la máscara (2 bytes, bit i: pixel i) y las diferencias empaquetadas
+ *  	(4 bits: byte i = d[i] | d[i+8] << 4; 8 bits: un byte por pixel; 16 bits: little endian)
+ *
+ *  El último bloque de una fila incompleto se rellena con su último pixel. El cuadro
+ *  comprimido no lleva cabecera: el ancho y el alto los guarda quien lo almacena. Las dos
+ *  implementaciones producen exactamente los mismos bytes.
+ *
+ */
+
+#ifndef DEPTHCODEC_H_
+#define DEPTHCODEC_H_
+
+#include <stdint.h>
+#include <cstddef>
+
+#define CODEC_BLOCK			16
+#define CODEC_MAX_RUN		63
+#define CODEC_ZERO_RUN		0x80
+#define CODEC_FLAT_RUN		0x40
+#define CODEC_MASK			0x10
+#define CODEC_WIDTH_0		0
+#define CODEC_WIDTH_4		1
+#define CODEC_WIDTH_8		2
+#define CODEC_WIDTH_16		3
+
+// Mayor tamaño de un bloque: cabecera, máscara y 16 bits por pixel
+
+#define CODEC_MAX_BLOCK_BYTES	(1 + 2 + 2 * CODEC_BLOCK)
+
+namespace Depth {
+
+	// Tamaño máximo del cuadro comprimido (algo mayor que sin comprimir)
+
+	size_t getEncodedBound(int inWidth, int inHeight);
+
+	// Comprime el cuadro en outBytes (al menos getEncodedBound bytes). Devuelve los bytes escritos.
+
+	size_t encodeFrame(const uint16_t* inDepth, int inWidth, int inHeight, uint8_t* outBytes);
+
+	// Descomprime inNumBytes bytes en outDepth. Devuelve false si no forman un cuadro de
+	// inWidth x inHeight (datos dañados o de otro tamaño).
+
+	bool decodeFrame(const uint8_t* inBytes, size_t inNumBytes, int inWidth, int inHeight, uint16_t* outDepth);
+
+	// Implementaciones de bloque. ioPrevious es el último pixel con medida (o el valor que
+	// lo sustituye) antes del bloque y a la salida el último del bloque. encodeBlock devuelve
+	// los bytes escritos (como mucho CODEC_MAX_BLOCK_BYTES); decodeBlock lee un bloque con
+	// cabecera válida y completa.
+
+	int encodeBlockScalar(const uint16_t* inPixels, uint16_t* ioPrevious, uint8_t* outBytes);
+	const uint8_t* decodeBlockScalar(const uint8_t* inBytes, uint16_t* ioPrevious, uint16_t* outPixels);
+
+#ifdef PTU_XTION_X86_SIMD
+	int encodeBlockSSE41(const uint16_t* inPixels, uint16_t* ioPrevious, uint8_t* outBytes);
+	const uint8_t* decodeBlockSSE41(const uint8_t* inBytes, uint16_t* ioPrevious, uint16_t* outPixels);
+#endif
+
+	// Bytes de un bloque según su cabecera (0 si no es una cabecera de bloque)
+
+	int getBlockBytes(uint8_t inHeader);
+
+}
+
+#endif /* DEPTHCODEC_H_ */
@@ -0,0 +1,175 @@
+/*
+ * DepthCodec_sse41.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Bloques del compresor de profundidad con SSE4.1: un bloque de 16 pixeles son dos
+ *  registros. Este fichero se compila con -msse4.1 y solo se usa si la CPU lo soporta.
+ *
+ *  Al comprimir, la predicción de cada pixel es el registro desplazado un pixel
+ *  (_mm_alignr_epi8 con el último del bloque anterior) y el ancho sale del OR de todas las
+ *  diferencias. Al descomprimir, la suma acumulada se hace en log2(8) desplazamientos.
+ *  Los huecos (pixeles a 0) se rellenan pixel a pixel, solo en los bloques que los tienen.
+ *
+ */
+
+#include "DepthCodec.h"
+
+#ifdef PTU_XTION_X86_SIMD
+
+#include <smmintrin.h>
+
+namespace Depth {
+
+	static inline __m128i toZigzag(__m128i inDelta) {
+		return _mm_xor_si128(_mm_slli_epi16(inDelta, 1), _mm_srai_epi16(inDelta, 15));
+	}
+
+	static inline __m128i fromZigzag(__m128i inZigzag) {
+		__m128i theSign = _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(inZigzag, _mm_set1_epi16(1)));
+		return _mm_xor_si128(_mm_srli_epi16(inZigzag, 1), theSign);
+	}
+
+	static inline __m128i prefixSum(__m128i inValues, uint16_t inCarry) {
+		inValues = _mm_add_epi16(inValues, _mm_slli_si128(inValues, 2));
+		inValues = _mm_add_epi16(inValues, _mm_slli_si128(inValues, 4));
+		inValues = _mm_add_epi16(inValues, _mm_slli_si128(inValues, 8));
+		return _mm_add_epi16(inValues, _mm_set1_epi16((short)inCarry));
+	}
+
+	// Pone a 0 los pixeles marcados (bit i de inMask: pixel i del registro)
+
+	static inline __m128i clearMasked(__m128i inPixels, unsigned int inMask) {
+		const __m128i theBits = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+		__m128i theSelected = _mm_and_si128(_mm_set1_epi16((short)inMask), theBits);
+		return _mm_andnot_si128(_mm_cmpeq_epi16(theSelected, theBits), inPixels);
+	}
+
+	int encodeBlockSSE41(const uint16_t* inPixels, uint16_t* ioPrevious, uint8_t* outBytes) {
+
+		const __m128i theZero = _mm_setzero_si128();
+
+		__m128i theLow = _mm_loadu_si128((const __m128i*)inPixels);
+		__m128i theHigh = _mm_loadu_si128((const __m128i*)(inPixels + 8));
+		unsigned int theMask = _mm_movemask_epi8(_mm_packs_epi16(_mm_cmpeq_epi16(theLow, theZero), _mm_cmpeq_epi16(theHigh, theZero)));
+		uint16_t thePrevious = *ioPrevious;
+
+		if (theMask) {
+
+			uint16_t theFilled[CODEC_BLOCK];
+			uint16_t theLast = thePrevious;
+
+			for (int i = 0; i < CODEC_BLOCK; i++) {
+				theLast = inPixels[i] ? inPixels[i] : theLast;
+				theFilled[i] = theLast;
+			}
+
+			theLow = _mm_loadu_si128((const __m128i*)theFilled);
+			theHigh = _mm_loadu_si128((const __m128i*)(theFilled + 8));
+		}
+
+		__m128i theLowDelta = _mm_sub_epi16(theLow, _mm_alignr_epi8(theLow, _mm_set1_epi16((short)thePrevious), 14));
+		__m128i theHighDelta = _mm_sub_epi16(theHigh, _mm_alignr_epi8(theHigh, theLow, 14));
+		__m128i theLowZigzag = toZigzag(theLowDelta);
+		__m128i theHighZigzag = toZigzag(theHighDelta);
+
+		*ioPrevious = (uint16_t)_mm_extract_epi16(theHigh, 7);
+
+		__m128i theOr = _mm_or_si128(theLowZigzag, theHighZigzag);
+		theOr = _mm_or_si128(theOr, _mm_srli_si128(theOr, 8));
+		theOr = _mm_or_si128(theOr, _mm_srli_si128(theOr, 4));
+		theOr = _mm_or_si128(theOr, _mm_srli_si128(theOr, 2));
+		unsigned int theBits = (unsigned int)_mm_extract_epi16(theOr, 0);
+
+		int theWidth = (theBits == 0) ? CODEC_WIDTH_0 : (theBits < 16) ? CODEC_WIDTH_4 : (theBits < 256) ? CODEC_WIDTH_8 : CODEC_WIDTH_16;
+		uint8_t* theOut = outBytes;
+
+		*theOut++ = (uint8_t)(theWidth | (theMask ? CODEC_MASK : 0));
+
+		if (theMask) {
+			*theOut++ = (uint8_t)theMask;
+			*theOut++ = (uint8_t)(theMask >> 8);
+		}
+
+		switch (theWidth) {
+			case CODEC_WIDTH_4: {
+				__m128i theBytes = _mm_packus_epi16(theLowZigzag, theHighZigzag);
+				theBytes = _mm_or_si128(theBytes, _mm_slli_epi16(_mm_srli_si128(theBytes, 8), 4));
+				_mm_storel_epi64((__m128i*)theOut, theBytes);
+				theOut += CODEC_BLOCK / 2;
+				break;
+			}
+			case CODEC_WIDTH_8:
+				_mm_storeu_si128((__m128i*)theOut, _mm_packus_epi16(theLowZigzag, theHighZigzag));
+				theOut += CODEC_BLOCK;
+				break;
+			case CODEC_WIDTH_16:
+				_mm_storeu_si128((__m128i*)theOut, theLowZigzag);
+				_mm_storeu_si128((__m128i*)(theOut + 16), theHighZigzag);
+				theOut += 2 * CODEC_BLOCK;
+				break;
+		}
+
+		return (int)(theOut - outBytes);
+	}
+
+	const uint8_t* decodeBlockSSE41(const uint8_t* inBytes, uint16_t* ioPrevious, uint16_t* outPixels) {
+
+		uint8_t theHeader = *inBytes++;
+		unsigned int theMask = 0;
+
+		if (theHeader & CODEC_MASK) {
+			theMask = inBytes[0] | (inBytes[1] << 8);
+			inBytes += 2;
+		}
+
+		__m128i theLowZigzag;
+		__m128i theHighZigzag;
+
+		switch (theHeader & 3) {
+			case CODEC_WIDTH_0:
+				theLowZigzag = _mm_setzero_si128();
+				theHighZigzag = _mm_setzero_si128();
+				break;
+			case CODEC_WIDTH_4: {
+				const __m128i theNibble = _mm_set1_epi8(0x0f);
+				__m128i theBytes = _mm_loadl_epi64((const __m128i*)inBytes);
+				theLowZigzag = _mm_cvtepu8_epi16(_mm_and_si128(theBytes, theNibble));
+				theHighZigzag = _mm_cvtepu8_epi16(_mm_and_si128(_mm_srli_epi16(theBytes, 4), theNibble));
+				inBytes += CODEC_BLOCK / 2;
+				break;
+			}
+			case CODEC_WIDTH_8: {
+				__m128i theBytes = _mm_loadu_si128((const __m128i*)inBytes);
+				theLowZigzag = _mm_cvtepu8_epi16(theBytes);
+				theHighZigzag = _mm_cvtepu8_epi16(_mm_srli_si128(theBytes, 8));
+				inBytes += CODEC_BLOCK;
+				break;
+			}
+			default:
+				theLowZigzag = _mm_loadu_si128((const __m128i*)inBytes);
+				theHighZigzag = _mm_loadu_si128((const __m128i*)(inBytes + 16));
+				inBytes += 2 * CODEC_BLOCK;
+				break;
+		}
+
+		__m128i theLow = prefixSum(fromZigzag(theLowZigzag), *ioPrevious);
+		__m128i theHigh = prefixSum(fromZigzag(theHighZigzag), (uint16_t)_mm_extract_epi16(theLow, 7));
+
+		*ioPrevious = (uint16_t)_mm_extract_epi16(theHigh, 7);
+
+		if (theMask) {
+			theLow = clearMasked(theLow, theMask & 0xff);
+			theHigh = clearMasked(theHigh, theMask >> 8);
+		}
+
+		_mm_storeu_si128((__m128i*)outPixels, theLow);
+		_mm_storeu_si128((__m128i*)(outPixels + 8), theHigh);
+
+		return inBytes;
+	}
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * DepthMin.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Búsqueda escalar del mínimo de profundidad y selección en tiempo de
+ *  ejecución de la versión vectorial (ver DepthMin_sse41.cpp y DepthMin_avx2.cpp)
+ *
+ */
+
+#include "DepthMin.h"
+
+namespace Depth {
+
+	typedef int (*findMinFunction)(const uint16_t*, int, uint16_t, uint16_t, uint16_t*);
+
+	static findMinFunction myFindMin = 0;
+	static Kernel myKernel = KERNEL_AUTO;
+
+	// Recorrido pixel a pixel. Es la referencia para las versiones vectoriales:
+	// un pixel sustituye al mínimo solo si es estrictamente menor (gana la primera aparición).
+	// Al restar inNear (con desbordamiento) los pixeles por debajo del rango pasan a ser
+	// valores muy grandes, así que basta una comparación sin signo por pixel.
+
+	int findMinScalar(const uint16_t* inDepth, int inNumPixels, uint16_t inNear, uint16_t inFar, uint16_t* outZ) {
+
+		uint16_t theBest = (uint16_t)(inFar - inNear + 1);
+		int outIndex = -1;
+
+		for (int i = 0; i < inNumPixels; i++) {
+			uint16_t theV = (uint16_t)(inDepth[i] - inNear);
+			if (theV < theBest) {
+				theBest = theV;
+				outIndex = i;
+			}
+		}
+
+		if (outIndex >= 0) {
+			*outZ = theBest + inNear;
+		}
+
+		return outIndex;
+	}
+
+	bool isKernelSupported(Kernel inKernel) {
+
+		switch (inKernel) {
+			case KERNEL_AUTO:
+			case KERNEL_SCALAR:
+				return true;
+#ifdef PTU_XTION_X86_SIMD
+			case KERNEL_SSE41:
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("sse4.1");
+			case KERNEL_AVX2:
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("avx2");
+#endif
+			default:
+				return false;
+		}
+
+	}
+
+	bool setKernel(Kernel inKernel) {
+
+		if (!isKernelSupported(inKernel)) {
+			return false;
+		}
+
+		if (inKernel == KERNEL_AUTO) {
+			if (isKernelSupported(KERNEL_AVX2)) {
+				inKernel = KERNEL_AVX2;
+			} else if (isKernelSupported(KERNEL_SSE41)) {
+				inKernel = KERNEL_SSE41;
+			} else {
+				inKernel = KERNEL_SCALAR;
+			}
+		}
+
+		switch (inKernel) {
+#ifdef PTU_XTION_X86_SIMD
+			case KERNEL_AVX2:
+				myFindMin = findMinAVX2;
+				break;
+			case KERNEL_SSE41:
+				myFindMin = findMinSSE41;
+				break;
+#endif
+			default:
+				myFindMin = findMinScalar;
+				break;
+		}
+
+		myKernel = inKernel;
+
+		return true;
+	}
+
+	Kernel getKernel() {
+		if (myFindMin == 0) {
+			setKernel(KERNEL_AUTO);
+		}
+		return myKernel;
+	}
+
+	const char* getKernelName(Kernel inKernel) {
+
+		switch (inKernel) {
+			case KERNEL_AUTO:	return "auto";
+			case KERNEL_SCALAR:	return "scalar";
+			case KERNEL_SSE41:	return "sse4.1";
+			case KERNEL_AVX2:	return "avx2";
+			default:			return "?";
+		}
+
+	}
+
+	int findMin(const uint16_t* inDepth, int inNumPixels, uint16_t* outZ) {
+
+		// La primera llamada resuelve la implementación a usar
+
+		if (myFindMin == 0) {
+			setKernel(KERNEL_AUTO);
+		}
+
+		return myFindMin(inDepth, inNumPixels, 1, 0xfffe, outZ);
+	}
+
+	int findMinInRange(const uint16_t* inDepth, int inNumPixels, uint16_t inNear, uint16_t inFar, uint16_t* outZ) {
+
+		if (inNear < 1) inNear = 1;
+		if (inFar > 0xfffe) inFar = 0xfffe;
+
+		if (inFar < inNear) {
+			return -1;
+		}
+
+		if (myFindMin == 0) {
+			setKernel(KERNEL_AUTO);
+		}
+
+		return myFindMin(inDepth, inNumPixels, inNear, inFar, outZ);
+	}
+
+}
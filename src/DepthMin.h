@@ -0,0 +1,64 @@
+/*
+ * DepthMin.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Búsqueda del pixel con menor profundidad en un cuadro de 16 bits.
+ *
+ *  	findMin: elige en tiempo de ejecución la mejor implementación disponible
+ *  	findMinScalar: recorrido pixel a pixel (referencia)
+ *  	findMinSSE41 / findMinAVX2: versiones vectoriales (solo x86)
+ *
+ *  Todas las versiones devuelven exactamente el mismo resultado: se ignoran los
+ *  ceros (y el valor 0xffff) y, en caso de empate, gana la primera aparición.
+ *  Opcionalmente se ignoran también los pixeles fuera de un rango [inNear, inFar].
+ *
+ */
+
+#ifndef DEPTHMIN_H_
+#define DEPTHMIN_H_
+
+#include <stdint.h>
+
+namespace Depth {
+
+	enum Kernel {
+		KERNEL_AUTO = 0,
+		KERNEL_SCALAR = 1,
+		KERNEL_SSE41 = 2,
+		KERNEL_AVX2 = 3
+	};
+
+	// Devuelve el índice del primer pixel con la menor profundidad válida
+	// y su profundidad en outZ. Si no hay ningún pixel válido devuelve -1
+	// y no modifica outZ.
+
+	int findMin(const uint16_t* inDepth, int inNumPixels, uint16_t* outZ);
+
+	// Igual que findMin pero solo considera válidos los pixeles con profundidad en [inNear, inFar].
+	// El rango se recorta a [1, 0xfffe].
+
+	int findMinInRange(const uint16_t* inDepth, int inNumPixels, uint16_t inNear, uint16_t inFar, uint16_t* outZ);
+
+	// Implementaciones. Requieren 1 <= inNear <= inFar <= 0xfffe
+
+	int findMinScalar(const uint16_t* inDepth, int inNumPixels, uint16_t inNear, uint16_t inFar, uint16_t* outZ);
+
+#ifdef PTU_XTION_X86_SIMD
+	int findMinSSE41(const uint16_t* inDepth, int inNumPixels, uint16_t inNear, uint16_t inFar, uint16_t* outZ);
+	int findMinAVX2(const uint16_t* inDepth, int inNumPixels, uint16_t inNear, uint16_t inFar, uint16_t* outZ);
+#endif
+
+	// Selección de la implementación usada por findMin.
+	// KERNEL_AUTO elige la más rápida que soporte la CPU.
+	// Devuelve false si la CPU no soporta la implementación pedida.
+
+	bool setKernel(Kernel inKernel);
+	Kernel getKernel();
+	bool isKernelSupported(Kernel inKernel);
+	const char* getKernelName(Kernel inKernel);
+
+}
+
+#endif /* DEPTHMIN_H_ */
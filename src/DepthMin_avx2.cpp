@@ -0,0 +1,81 @@
+/*
+ * DepthMin_avx2.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Búsqueda vectorial del mínimo de profundidad con AVX2 (16 pixeles por instrucción).
+ *  Este fichero se compila con -mavx2 y solo se usa si la CPU lo soporta.
+ *
+ *  Sigue el mismo esquema por bloques que DepthMin_sse41.cpp.
+ *
+ */
+
+#include "DepthMin.h"
+
+#ifdef PTU_XTION_X86_SIMD
+
+#include <immintrin.h>
+
+#define BLOCK_PIXELS 256
+
+namespace Depth {
+
+	int findMinAVX2(const uint16_t* inDepth, int inNumPixels, uint16_t inNear, uint16_t inFar, uint16_t* outZ) {
+
+		const __m256i theNear = _mm256_set1_epi16((short)inNear);
+
+		uint16_t theBest = (uint16_t)(inFar - inNear + 1);
+		int outIndex = -1;
+		int i = 0;
+
+		for (; i + BLOCK_PIXELS <= inNumPixels; i += BLOCK_PIXELS) {
+
+			const uint16_t* theBlock = inDepth + i;
+			__m256i theMin = _mm256_set1_epi16(-1);
+
+			for (int j = 0; j < BLOCK_PIXELS; j += 16) {
+				__m256i theV = _mm256_loadu_si256((const __m256i*)(theBlock + j));
+				theMin = _mm256_min_epu16(theMin, _mm256_sub_epi16(theV, theNear));
+			}
+
+			// Reducción horizontal: 16 -> 8 valores y _mm_minpos_epu16 para el resto
+
+			__m128i theHalf = _mm_min_epu16(_mm256_castsi256_si128(theMin), _mm256_extracti128_si256(theMin, 1));
+			uint16_t theBlockMin = (uint16_t)_mm_cvtsi128_si32(_mm_minpos_epu16(theHalf));
+
+			if (theBlockMin < theBest) {
+
+				__m256i theTarget = _mm256_set1_epi16((short)theBlockMin);
+
+				for (int j = 0; j < BLOCK_PIXELS; j += 16) {
+					__m256i theV = _mm256_loadu_si256((const __m256i*)(theBlock + j));
+					int theMask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_sub_epi16(theV, theNear), theTarget));
+					if (theMask != 0) {
+						outIndex = i + j + (__builtin_ctz(theMask) >> 1);
+						break;
+					}
+				}
+
+				theBest = theBlockMin;
+			}
+		}
+
+		for (; i < inNumPixels; i++) {
+			uint16_t theV = (uint16_t)(inDepth[i] - inNear);
+			if (theV < theBest) {
+				theBest = theV;
+				outIndex = i;
+			}
+		}
+
+		if (outIndex >= 0) {
+			*outZ = theBest + inNear;
+		}
+
+		return outIndex;
+	}
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * DepthMin_sse41.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Búsqueda vectorial del mínimo de profundidad con SSE4.1 (8 pixeles por instrucción).
+ *  Este fichero se compila con -msse4.1 y solo se usa si la CPU lo soporta.
+ *
+ *  A cada pixel se le resta el inicio del rango válido (con desbordamiento), de modo que
+ *  el 0 y los pixeles demasiado cercanos pasan a ser valores muy grandes y un mínimo sin
+ *  signo descarta los pixeles inválidos sin necesidad de saltos.
+ *  El cuadro se recorre por bloques: solo si el mínimo de un bloque mejora el actual
+ *  se vuelve a recorrer el bloque (ya en caché) para localizar su primera aparición.
+ *
+ */
+
+#include "DepthMin.h"
+
+#ifdef PTU_XTION_X86_SIMD
+
+#include <smmintrin.h>
+
+#define BLOCK_PIXELS 256
+
+namespace Depth {
+
+	int findMinSSE41(const uint16_t* inDepth, int inNumPixels, uint16_t inNear, uint16_t inFar, uint16_t* outZ) {
+
+		const __m128i theNear = _mm_set1_epi16((short)inNear);
+
+		// Valores desplazados (profundidad - inNear). Son válidos los menores o iguales
+		// que inFar - inNear, igual que en la versión escalar
+
+		uint16_t theBest = (uint16_t)(inFar - inNear + 1);
+		int outIndex = -1;
+		int i = 0;
+
+		for (; i + BLOCK_PIXELS <= inNumPixels; i += BLOCK_PIXELS) {
+
+			const uint16_t* theBlock = inDepth + i;
+			__m128i theMin = _mm_set1_epi16(-1);
+
+			for (int j = 0; j < BLOCK_PIXELS; j += 8) {
+				__m128i theV = _mm_loadu_si128((const __m128i*)(theBlock + j));
+				theMin = _mm_min_epu16(theMin, _mm_sub_epi16(theV, theNear));
+			}
+
+			uint16_t theBlockMin = (uint16_t)_mm_cvtsi128_si32(_mm_minpos_epu16(theMin));
+
+			if (theBlockMin < theBest) {
+
+				__m128i theTarget = _mm_set1_epi16((short)theBlockMin);
+
+				for (int j = 0; j < BLOCK_PIXELS; j += 8) {
+					__m128i theV = _mm_loadu_si128((const __m128i*)(theBlock + j));
+					int theMask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_sub_epi16(theV, theNear), theTarget));
+					if (theMask != 0) {
+						outIndex = i + j + (__builtin_ctz(theMask) >> 1);
+						break;
+					}
+				}
+
+				theBest = theBlockMin;
+			}
+		}
+
+		// Pixeles restantes
+
+		for (; i < inNumPixels; i++) {
+			uint16_t theV = (uint16_t)(inDepth[i] - inNear);
+			if (theV < theBest) {
+				theBest = theV;
+				outIndex = i;
+			}
+		}
+
+		if (outIndex >= 0) {
+			*outZ = theBest + inNear;
+		}
+
+		return outIndex;
+	}
+
+}
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * DepthStats.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	DepthStats: histograma y estadísticas del cuadro en una sola pasada
+ *
+ */
+
+#include "DepthStats.h"
+#include "DepthMin.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace Depth {
+
+	// Constructor
+
+	DepthStats::DepthStats(Threads::WorkerPool* inPool) {
+
+		this->myPool = inPool;
+		this->myNumParts = (inPool != NULL) ? inPool->getNumThreads() : 1;
+		this->myParts = new PartStats[this->myNumParts];
+
+		for (int i = 0; i < this->myNumParts; i++) {
+			this->myParts[i].myHistograms = new uint32_t[4 * DEPTH_STATS_BINS];
+			memset(this->myParts[i].myHistograms, 0, 4 * DEPTH_STATS_BINS * sizeof(uint32_t));
+		}
+
+		this->myHistogram = new uint32_t[DEPTH_STATS_BINS];
+		memset(this->myHistogram, 0, DEPTH_STATS_BINS * sizeof(uint32_t));
+
+		this->myFirstBin = 0;
+		this->myLastBin = -1;
+		this->myNumPixels = 0;
+		this->myValidPixels = 0;
+		this->myMin = 0xffff;
+		this->myMax = 0;
+		this->myDepth = NULL;
+
+		// La versión vectorial se elige una sola vez, antes de que la usen los hilos.
+		// La de AVX2 no mejoraría: el coste está en los incrementos del histograma.
+
+		this->myHistogramFunction = histogramScalar;
+
+#ifdef PTU_XTION_X86_SIMD
+		if (getKernel() != KERNEL_SCALAR) {
+			this->myHistogramFunction = histogramSSE41;
+		}
+#endif
+
+	}
+
+	// Destructor
+
+	DepthStats::~DepthStats() {
+
+		for (int i = 0; i < this->myNumParts; i++) {
+			delete[] this->myParts[i].myHistograms;
+		}
+
+		delete[] this->myParts;
+		delete[] this->myHistogram;
+
+	}
+
+	void DepthStats::compute(const uint16_t* inDepth, int inWidth, int inHeight) {
+
+		this->myDepth = inDepth;
+		this->myNumPixels = inWidth * inHeight;
+
+		if (this->myPool != NULL) {
+			this->myPool->run(this);
+		} else {
+			this->run(0, 1);
+		}
+
+		// Borramos solo la parte del histograma usada en el cuadro anterior
+
+		if (this->myLastBin >= this->myFirstBin) {
+			memset(this->myHistogram + this->myFirstBin, 0, (this->myLastBin - this->myFirstBin + 1) * sizeof(uint32_t));
+		}
+
+		this->myValidPixels = 0;
+		this->myMin = 0xffff;
+		this->myMax = 0;
+
+		for (int i = 0; i < this->myNumParts; i++) {
+
+			PartStats* thePart = &this->myParts[i];
+
+			if (thePart->myValid == 0) {
+				continue;
+			}
+
+			this->myValidPixels += thePart->myValid;
+			if (thePart->myMin < this->myMin) this->myMin = thePart->myMin;
+			if (thePart->myMax > this->myMax) this->myMax = thePart->myMax;
+
+			// Cada tramo ya ha combinado sus 4 histogramas en el primero
+
+			uint32_t* theHistogram = thePart->myHistograms;
+			for (int b = thePart->myMin >> DEPTH_STATS_SHIFT; b <= (thePart->myMax >> DEPTH_STATS_SHIFT); b++) {
+				this->myHistogram[b] += theHistogram[b];
+				theHistogram[b] = 0;
+			}
+		}
+
+		this->myFirstBin = this->myMin >> DEPTH_STATS_SHIFT;
+		this->myLastBin = (this->myValidPixels > 0) ? (this->myMax >> DEPTH_STATS_SHIFT) : -1;
+
+	}
+
+	// Pasada pixel a pixel sobre inNumPixels pixeles.
+	// Los pixeles inválidos también se acumulan (en el primer y el último bin) para no
+	// saltar dentro del bucle; se cuentan aparte y se descuentan al final.
+	// Mínimo y máximo se llevan desplazados para que los inválidos nunca ganen:
+	// (z - 1) convierte 0 en 0xffff y (z + 1) convierte 0xffff en 0.
+
+	void histogramScalar(const uint16_t* inDepth, int inNumPixels, uint32_t* ioHistograms,
+			uint16_t* ioMinShifted, uint16_t* ioMaxShifted, int* ioZeros, int* ioSaturated) {
+
+		uint32_t* theH0 = ioHistograms;
+		uint32_t* theH1 = theH0 + DEPTH_STATS_BINS;
+		uint32_t* theH2 = theH1 + DEPTH_STATS_BINS;
+		uint32_t* theH3 = theH2 + DEPTH_STATS_BINS;
+
+		uint16_t theMinShifted = *ioMinShifted;
+		uint16_t theMaxShifted = *ioMaxShifted;
+		int theZeros = 0;
+		int theSaturated = 0;
+		int i = 0;
+
+		for (; i + 4 <= inNumPixels; i += 4) {
+
+			uint16_t theZ0 = inDepth[i];
+			uint16_t theZ1 = inDepth[i+1];
+			uint16_t theZ2 = inDepth[i+2];
+			uint16_t theZ3 = inDepth[i+3];
+
+			theH0[theZ0 >> DEPTH_STATS_SHIFT]++;
+			theH1[theZ1 >> DEPTH_STATS_SHIFT]++;
+			theH2[theZ2 >> DEPTH_STATS_SHIFT]++;
+			theH3[theZ3 >> DEPTH_STATS_SHIFT]++;
+
+			theZeros += (theZ0 == 0) + (theZ1 == 0) + (theZ2 == 0) + (theZ3 == 0);
+			theSaturated += (theZ0 == 0xffff) + (theZ1 == 0xffff) + (theZ2 == 0xffff) + (theZ3 == 0xffff);
+
+			uint16_t theLow = (uint16_t)(theZ0 - 1);
+			if ((uint16_t)(theZ1 - 1) < theLow) theLow = (uint16_t)(theZ1 - 1);
+			if ((uint16_t)(theZ2 - 1) < theLow) theLow = (uint16_t)(theZ2 - 1);
+			if ((uint16_t)(theZ3 - 1) < theLow) theLow = (uint16_t)(theZ3 - 1);
+			if (theLow < theMinShifted) theMinShifted = theLow;
+
+			uint16_t theHigh = (uint16_t)(theZ0 + 1);
+			if ((uint16_t)(theZ1 + 1) > theHigh) theHigh = (uint16_t)(theZ1 + 1);
+			if ((uint16_t)(theZ2 + 1) > theHigh) theHigh = (uint16_t)(theZ2 + 1);
+			if ((uint16_t)(theZ3 + 1) > theHigh) theHigh = (uint16_t)(theZ3 + 1);
+			if (theHigh > theMaxShifted) theMaxShifted = theHigh;
+		}
+
+		for (; i < inNumPixels; i++) {
+
+			uint16_t theZ = inDepth[i];
+
+			theH0[theZ >> DEPTH_STATS_SHIFT]++;
+			theZeros += (theZ == 0);
+			theSaturated += (theZ == 0xffff);
+
+			if ((uint16_t)(theZ - 1) < theMinShifted) theMinShifted = (uint16_t)(theZ - 1);
+			if ((uint16_t)(theZ + 1) > theMaxShifted) theMaxShifted = (uint16_t)(theZ + 1);
+		}
+
+		*ioMinShifted = theMinShifted;
+		*ioMaxShifted = theMaxShifted;
+		*ioZeros += theZeros;
+		*ioSaturated += theSaturated;
+
+	}
+
+	// Pasada sobre el tramo inPart del cuadro
+
+	void DepthStats::run(int inPart, int inNumParts) {
+
+		int theFirst = (int)((long long)this->myNumPixels * inPart / inNumParts);
+		int theLast = (int)((long long)this->myNumPixels * (inPart + 1) / inNumParts);
+		const uint16_t* theDepth = this->myDepth;
+		PartStats* thePart = &this->myParts[inPart];
+
+		uint32_t* theH0 = thePart->myHistograms;
+		uint32_t* theH1 = theH0 + DEPTH_STATS_BINS;
+		uint32_t* theH2 = theH1 + DEPTH_STATS_BINS;
+		uint32_t* theH3 = theH2 + DEPTH_STATS_BINS;
+
+		uint16_t theMinShifted = 0xffff;
+		uint16_t theMaxShifted = 0;
+		int theZeros = 0;
+		int theSaturated = 0;
+
+		this->myHistogramFunction(theDepth + theFirst, theLast - theFirst, theH0, &theMinShifted, &theMaxShifted, &theZeros, &theSaturated);
+
+		// Descontamos los inválidos. Los 4 histogramas solo tienen sentido sumados,
+		// así que basta con restarlos del primero (con aritmética modular).
+
+		theH0[0] -= theZeros;
+		theH0[DEPTH_STATS_BINS - 1] -= theSaturated;
+
+		thePart->myValid = (theLast - theFirst) - theZeros - theSaturated;
+
+		// Combinamos los 4 histogramas en el primero y dejamos a cero el resto,
+		// también en los bins de los inválidos (cuya suma ya es la de los válidos)
+
+		int theFirstBin = DEPTH_STATS_BINS;
+		int theLastBin = -1;
+
+		if (thePart->myValid > 0) {
+			thePart->myMin = (uint16_t)(theMinShifted + 1);
+			thePart->myMax = (uint16_t)(theMaxShifted - 1);
+			theFirstBin = thePart->myMin >> DEPTH_STATS_SHIFT;
+			theLastBin = thePart->myMax >> DEPTH_STATS_SHIFT;
+		}
+
+		for (int b = theFirstBin; b <= theLastBin; b++) {
+			theH0[b] += theH1[b] + theH2[b] + theH3[b];
+			theH1[b] = theH2[b] = theH3[b] = 0;
+		}
+
+		int theEdges[2] = { 0, DEPTH_STATS_BINS - 1 };
+
+		for (int e = 0; e < 2; e++) {
+			int b = theEdges[e];
+			if ((b < theFirstBin) || (b > theLastBin)) {
+				theH0[b] = 0;
+				theH1[b] = theH2[b] = theH3[b] = 0;
+			}
+		}
+
+	}
+
+	const uint32_t* DepthStats::getHistogram() {
+		return this->myHistogram;
+	}
+
+	int DepthStats::getNumPixels() {
+		return this->myNumPixels;
+	}
+
+	int DepthStats::getValidPixels() {
+		return this->myValidPixels;
+	}
+
+	uint16_t DepthStats::getMin() {
+		return this->myMin;
+	}
+
+	uint16_t DepthStats::getMax() {
+		return this->myMax;
+	}
+
+	uint16_t DepthStats::getPercentile(float inFraction) {
+
+		if (this->myValidPixels == 0) {
+			return 0;
+		}
+
+		if (inFraction <= 0) {
+			return this->myMin;
+		}
+
+		// Primer bin en el que la cuenta acumulada alcanza la fracción pedida
+
+		long long theTarget = (long long)(inFraction * this->myValidPixels + 0.5f);
+		if (theTarget < 1) theTarget = 1;
+
+		long long theCount = 0;
+		int b;
+
+		for (b = this->myFirstBin; b < this->myLastBin; b++) {
+			theCount += this->myHistogram[b];
+			if (theCount >= theTarget) {
+				break;
+			}
+		}
+
+		// Extremo superior del bin, sin salir del rango observado
+
+		int theZ = (b << DEPTH_STATS_SHIFT) + DEPTH_STATS_BIN_WIDTH - 1;
+		if (theZ > this->myMax) theZ = this->myMax;
+		if (theZ < this->myMin) theZ = this->myMin;
+
+		return (uint16_t)theZ;
+	}
+
+	bool DepthStats::suggestGate(int inMaxNearMm, int inGapMm, float inMinFraction, RangeGate* outGate) {
+
+		if (this->myValidPixels == 0) {
+			return false;
+		}
+
+		// Un bin con menos del 0,01% de los pixeles válidos se considera vacío (ruido)
+
+		uint32_t theNoise = (uint32_t)(this->myValidPixels / 10000);
+		int theGapBins = (inGapMm + DEPTH_STATS_BIN_WIDTH - 1) >> DEPTH_STATS_SHIFT;
+		if (theGapBins < 1) theGapBins = 1;
+
+		long long theCount = 0;
+		int theEmpty = 0;
+		int b;
+
+		for (b = this->myFirstBin; b <= this->myLastBin; b++) {
+
+			if (this->myHistogram[b] > theNoise) {
+
+				// El grupo no puede llegar más allá de inMaxNearMm
+
+				if ((b << DEPTH_STATS_SHIFT) > inMaxNearMm) {
+					return false;
+				}
+
+				theCount += this->myHistogram[b];
+				theEmpty = 0;
+
+			} else if ((theCount > 0) && (++theEmpty >= theGapBins)) {
+				break;
+			}
+		}
+
+		// Sin hueco todo el cuadro es un único grupo
+
+		if (b > this->myLastBin) {
+			return false;
+		}
+
+		if (theCount < (long long)(inMinFraction * this->myValidPixels)) {
+			return false;
+		}
+
+		// El rango empieza en el primer bin del hueco
+
+		outGate->Near = (uint16_t)((b - theEmpty + 1) << DEPTH_STATS_SHIFT);
+		outGate->Far = 0xfffe;
+
+		return true;
+	}
+
+	void DepthStats::print() {
+
+		printf("Profundidad: %d/%d pixeles válidos, min %u, p10 %u, p50 %u, p90 %u, max %u\n",
+				this->myValidPixels, this->myNumPixels, this->myMin,
+				this->getPercentile(0.1f), this->getPercentile(0.5f), this->getPercentile(0.9f), this->myMax);
+
+	}
+
+}
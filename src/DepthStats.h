@@ -0,0 +1,139 @@
+/*
+ * DepthStats.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Estadísticas de un cuadro de profundidad calculadas en una sola pasada:
+ *
+ *  	- histograma de profundidades (bins de DEPTH_STATS_BIN_WIDTH unidades)
+ *  	- número de pixeles válidos (ni 0 ni 0xffff)
+ *  	- profundidad mínima y máxima exactas
+ *  	- percentiles (con la resolución de un bin)
+ *
+ *  Se calculan una vez por cuadro y las comparten todas las etapas que las necesiten,
+ *  por ejemplo para fijar automáticamente el rango de búsqueda e ignorar el propio
+ *  chasis del robot (un grupo de pixeles siempre a la misma distancia, muy cerca).
+ *
+ */
+
+#ifndef DEPTHSTATS_H_
+#define DEPTHSTATS_H_
+
+#include <stdint.h>
+#include "WorkerPool.h"
+
+#define DEPTH_STATS_SHIFT 3
+#define DEPTH_STATS_BIN_WIDTH (1 << DEPTH_STATS_SHIFT)
+#define DEPTH_STATS_BINS (0x10000 >> DEPTH_STATS_SHIFT)
+
+namespace Depth {
+
+	// Rango de profundidades aceptadas [Near, Far]
+
+	struct RangeGate {
+		uint16_t Near;
+		uint16_t Far;
+	};
+
+	//////////////////////////////////////////////////////////////////////
+	// Estadísticas del cuadro											//
+	//																	//
+	//  - El cuadro se divide en tramos contiguos, uno por hilo			//
+	//  - Cada hilo acumula su tramo en 4 histogramas intercalados		//
+	//    (pixel i en el histograma i % 4) para que pixeles iguales		//
+	//    consecutivos no esperen unos a otros al incrementar el bin	//
+	//  - Solo se combinan los bins entre el mínimo y el máximo, y se	//
+	//    dejan a cero para el siguiente cuadro							//
+	//																	//
+	//////////////////////////////////////////////////////////////////////
+
+	class DepthStats : public Threads::Job {
+
+	private:
+
+		// Resultado de cada tramo, en su propia línea de caché
+
+		struct PartStats {
+			uint32_t* myHistograms;		// 4 x DEPTH_STATS_BINS, a cero entre cuadros
+			int myValid;
+			uint16_t myMin;
+			uint16_t myMax;
+			char myPadding[64 - sizeof(uint32_t*) - sizeof(int) - 2 * sizeof(uint16_t)];
+		};
+
+		Threads::WorkerPool* myPool;
+		PartStats* myParts;
+		int myNumParts;
+
+		uint32_t* myHistogram;
+		int myFirstBin;
+		int myLastBin;
+
+		int myNumPixels;
+		int myValidPixels;
+		uint16_t myMin;
+		uint16_t myMax;
+
+		void (*myHistogramFunction)(const uint16_t*, int, uint32_t*, uint16_t*, uint16_t*, int*, int*);
+
+		// Cuadro en proceso (válido solo durante compute())
+
+		const uint16_t* myDepth;
+
+	public:
+
+		// inPool puede ser NULL (cálculo en el hilo llamante). El grupo no pasa a ser propiedad de las estadísticas.
+
+		DepthStats(Threads::WorkerPool* inPool);
+
+		~DepthStats();
+
+		void compute(const uint16_t* inDepth, int inWidth, int inHeight);
+
+		// Histograma del último cuadro: el bin b cuenta los pixeles válidos con profundidad
+		// en [b * DEPTH_STATS_BIN_WIDTH, (b+1) * DEPTH_STATS_BIN_WIDTH)
+
+		const uint32_t* getHistogram();
+
+		int getNumPixels();
+		int getValidPixels();
+
+		// Sin pixeles válidos getMin() devuelve 0xffff y getMax() 0
+
+		uint16_t getMin();
+		uint16_t getMax();
+
+		// Profundidad por debajo de la cual queda la fracción inFraction (0..1) de los pixeles válidos.
+		// Resolución de un bin, pero siempre dentro de [getMin(), getMax()]. Devuelve 0 sin pixeles válidos.
+
+		uint16_t getPercentile(float inFraction);
+
+		// Busca un grupo de pixeles cercano y separado del resto (por ejemplo, el chasis del robot):
+		// el primer grupo de bins ocupados, que termina en el primer hueco de al menos inGapMm
+		// (un bin con menos del 0,01% de los pixeles válidos cuenta como vacío). Solo lo acepta
+		// si no pasa de inMaxNearMm y contiene al menos la fracción inMinFraction de los pixeles
+		// válidos. En ese caso outGate empieza en el hueco y deja fuera el grupo.
+
+		bool suggestGate(int inMaxNearMm, int inGapMm, float inMinFraction, RangeGate* outGate);
+
+		void print();
+
+		void run(int inPart, int inNumParts);
+
+	};
+
+	// Acumulación de inNumPixels pixeles en los 4 histogramas intercalados de ioHistograms,
+	// con mínimo (z - 1) y máximo (z + 1) desplazados y cuentas de ceros y de 0xffff
+
+	void histogramScalar(const uint16_t* inDepth, int inNumPixels, uint32_t* ioHistograms,
+			uint16_t* ioMinShifted, uint16_t* ioMaxShifted, int* ioZeros, int* ioSaturated);
+
+#ifdef PTU_XTION_X86_SIMD
+	void histogramSSE41(const uint16_t* inDepth, int inNumPixels, uint32_t* ioHistograms,
+			uint16_t* ioMinShifted, uint16_t* ioMaxShifted, int* ioZeros, int* ioSaturated);
+#endif
+
+}
+
+#endif /* DEPTHSTATS_H_ */
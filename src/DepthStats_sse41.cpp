@@ -0,0 +1,105 @@
+/*
+ * DepthStats_sse41.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Histograma y estadísticas de un tramo del cuadro con SSE4.1. Se compila con -msse4.1.
+ *
+ *  Cada carga de 8 pixeles actualiza en registros el mínimo, el máximo y las cuentas
+ *  de inválidos, y sus índices de bin (ya desplazados) se extraen para incrementar
+ *  los histogramas. Así el cuadro se lee una sola vez.
+ *
+ */
+
+#include "DepthStats.h"
+
+#ifdef PTU_XTION_X86_SIMD
+
+#include <smmintrin.h>
+
+// Pixeles por bloque: las cuentas de 16 bits por carril no pueden desbordarse
+
+#define BLOCK_PIXELS 4096
+
+namespace Depth {
+
+	// Suma de los 8 carriles de 16 bits
+
+	static inline int sumLanes(__m128i inV) {
+		__m128i theSum = _mm_madd_epi16(inV, _mm_set1_epi16(1));
+		theSum = _mm_add_epi32(theSum, _mm_shuffle_epi32(theSum, _MM_SHUFFLE(1, 0, 3, 2)));
+		theSum = _mm_add_epi32(theSum, _mm_shuffle_epi32(theSum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(theSum);
+	}
+
+	void histogramSSE41(const uint16_t* inDepth, int inNumPixels, uint32_t* ioHistograms,
+			uint16_t* ioMinShifted, uint16_t* ioMaxShifted, int* ioZeros, int* ioSaturated) {
+
+		uint32_t* theH0 = ioHistograms;
+		uint32_t* theH1 = theH0 + DEPTH_STATS_BINS;
+		uint32_t* theH2 = theH1 + DEPTH_STATS_BINS;
+		uint32_t* theH3 = theH2 + DEPTH_STATS_BINS;
+
+		const __m128i theOne = _mm_set1_epi16(1);
+		const __m128i theZero = _mm_setzero_si128();
+		const __m128i theAllOnes = _mm_set1_epi16(-1);
+
+		__m128i theMin = _mm_set1_epi16((short)*ioMinShifted);
+		__m128i theMax = _mm_set1_epi16((short)*ioMaxShifted);
+		int theZeros = 0;
+		int theSaturated = 0;
+		int i = 0;
+
+		while (i + 8 <= inNumPixels) {
+
+			int theBlockEnd = (i + BLOCK_PIXELS < inNumPixels) ? i + BLOCK_PIXELS : inNumPixels;
+			__m128i theZeroCount = _mm_setzero_si128();
+			__m128i theSaturatedCount = _mm_setzero_si128();
+
+			for (; i + 8 <= theBlockEnd; i += 8) {
+
+				__m128i theV = _mm_loadu_si128((const __m128i*)(inDepth + i));
+
+				theMin = _mm_min_epu16(theMin, _mm_sub_epi16(theV, theOne));
+				theMax = _mm_max_epu16(theMax, _mm_add_epi16(theV, theOne));
+
+				// La comparación da -1 en los carriles iguales: restar cuenta uno
+
+				theZeroCount = _mm_sub_epi16(theZeroCount, _mm_cmpeq_epi16(theV, theZero));
+				theSaturatedCount = _mm_sub_epi16(theSaturatedCount, _mm_cmpeq_epi16(theV, theAllOnes));
+
+				__m128i theBins = _mm_srli_epi16(theV, DEPTH_STATS_SHIFT);
+
+				theH0[_mm_extract_epi16(theBins, 0)]++;
+				theH1[_mm_extract_epi16(theBins, 1)]++;
+				theH2[_mm_extract_epi16(theBins, 2)]++;
+				theH3[_mm_extract_epi16(theBins, 3)]++;
+				theH0[_mm_extract_epi16(theBins, 4)]++;
+				theH1[_mm_extract_epi16(theBins, 5)]++;
+				theH2[_mm_extract_epi16(theBins, 6)]++;
+				theH3[_mm_extract_epi16(theBins, 7)]++;
+			}
+
+			theZeros += sumLanes(theZeroCount);
+			theSaturated += sumLanes(theSaturatedCount);
+		}
+
+		// Mínimo y máximo de los 8 carriles (el máximo como mínimo de los complementos)
+
+		*ioMinShifted = (uint16_t)_mm_cvtsi128_si32(_mm_minpos_epu16(theMin));
+		*ioMaxShifted = (uint16_t)~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(theMax, theAllOnes)));
+		*ioZeros += theZeros;
+		*ioSaturated += theSaturated;
+
+		// Pixeles restantes
+
+		if (i < inNumPixels) {
+			histogramScalar(inDepth + i, inNumPixels - i, ioHistograms, ioMinShifted, ioMaxShifted, ioZeros, ioSaturated);
+		}
+
+	}
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * DepthTracker.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	ClosestPointTracker: búsqueda en ventana alrededor del punto anterior
+ *
+ */
+
+#include "DepthTracker.h"
+#include "DepthMin.h"
+
+#include <cstring>
+#include <cstdlib>
+
+namespace Depth {
+
+	// Constructor
+
+	ClosestPointTracker::ClosestPointTracker(ClosestPointFinder* inFinder) {
+
+		this->myFinder = inFinder;
+
+		// Valores por defecto pensados para VGA a 30 fps: un recorrido completo por segundo,
+		// 15 cm de margen y semianchura de ventana entre 24 y 64 pixeles (129x129 como mucho,
+		// un 5% del cuadro). Si el punto salta más, falla la ventana y se recorre el cuadro.
+
+		this->configure(30, 150, 24, 64);
+		this->reset();
+
+		memset(&this->myStats, 0, sizeof(this->myStats));
+
+	}
+
+	void ClosestPointTracker::configure(int inRefreshPeriod, int inConfidenceMm, int inMinHalfSize, int inMaxHalfSize) {
+
+		this->myRefreshPeriod = inRefreshPeriod;
+		this->myConfidenceMm = inConfidenceMm;
+		this->myMinHalfSize = inMinHalfSize;
+		this->myMaxHalfSize = (inMaxHalfSize > inMinHalfSize) ? inMaxHalfSize : inMinHalfSize;
+		this->myHalfSize = this->myMinHalfSize;
+
+	}
+
+	void ClosestPointTracker::reset() {
+
+		this->myHasPrevious = false;
+		this->myWidth = 0;
+		this->myHeight = 0;
+		this->myFramesSinceScan = 0;
+		this->myHalfSize = this->myMinHalfSize;
+
+	}
+
+	// Búsqueda en la ventana centrada en el punto anterior.
+	// Cada fila de la ventana es un tramo contiguo del cuadro, así que se usa findMinInRange por filas
+	// con el mismo rango que el buscador (combinando las filas en orden para conservar
+	// la regla de la primera aparición)
+
+	bool ClosestPointTracker::findInWindow(const uint16_t* inDepth, Pixel3D* outPoint) {
+
+		int theX0 = this->myPrevious.X - this->myHalfSize;
+		int theX1 = this->myPrevious.X + this->myHalfSize + 1;
+		int theY0 = this->myPrevious.Y - this->myHalfSize;
+		int theY1 = this->myPrevious.Y + this->myHalfSize + 1;
+
+		if (theX0 < 0) theX0 = 0;
+		if (theY0 < 0) theY0 = 0;
+		if (theX1 > this->myWidth) theX1 = this->myWidth;
+		if (theY1 > this->myHeight) theY1 = this->myHeight;
+
+		this->myStats.WindowPixels += (uint64_t)(theX1 - theX0) * (uint64_t)(theY1 - theY0);
+
+		int theBestIndex = -1;
+		uint16_t theBestZ = 0xffff;
+		uint16_t theNear = this->myFinder->getNear();
+		uint16_t theFar = this->myFinder->getFar();
+
+		for (int y = theY0; y < theY1; y++) {
+
+			uint16_t theZ;
+			int theIndex = findMinInRange(inDepth + y * this->myWidth + theX0, theX1 - theX0, theNear, theFar, &theZ);
+
+			if ((theIndex >= 0) && (theZ < theBestZ)) {
+				theBestZ = theZ;
+				theBestIndex = y * this->myWidth + theX0 + theIndex;
+			}
+		}
+
+		if (theBestIndex < 0) {
+			return false;
+		}
+
+		outPoint->X = theBestIndex % this->myWidth;
+		outPoint->Y = theBestIndex / this->myWidth;
+		outPoint->Z = theBestZ;
+
+		return true;
+	}
+
+	bool ClosestPointTracker::find(const uint16_t* inDepth, int inWidth, int inHeight, Pixel3D* outPoint) {
+
+		this->myStats.Frames++;
+
+		// Un cambio de resolución invalida el punto anterior
+
+		if ((inWidth != this->myWidth) || (inHeight != this->myHeight)) {
+			this->reset();
+			this->myWidth = inWidth;
+			this->myHeight = inHeight;
+		}
+
+		if (this->myHasPrevious && (this->myFramesSinceScan < this->myRefreshPeriod)) {
+
+			if (this->findInWindow(inDepth, outPoint) && (outPoint->Z <= this->myPrevious.Z + this->myConfidenceMm)) {
+
+				// La ventana se ajusta al doble del desplazamiento entre cuadros
+
+				int theMotion = abs(outPoint->X - this->myPrevious.X);
+				if (abs(outPoint->Y - this->myPrevious.Y) > theMotion) {
+					theMotion = abs(outPoint->Y - this->myPrevious.Y);
+				}
+
+				this->myHalfSize = this->myMinHalfSize + 2 * theMotion;
+				if (this->myHalfSize > this->myMaxHalfSize) {
+					this->myHalfSize = this->myMaxHalfSize;
+				}
+
+				this->myPrevious = *outPoint;
+				this->myFramesSinceScan++;
+				this->myStats.WindowHits++;
+
+				return true;
+			}
+
+			this->myStats.FallbackScans++;
+
+		} else {
+
+			this->myStats.RefreshScans++;
+
+		}
+
+		// Recorrido completo
+
+		this->myFramesSinceScan = 0;
+		this->myHasPrevious = this->myFinder->find(inDepth, inWidth, inHeight, outPoint);
+
+		if (this->myHasPrevious) {
+			this->myPrevious = *outPoint;
+		}
+
+		return this->myHasPrevious;
+	}
+
+	const TrackerStats& ClosestPointTracker::getStats() {
+		return this->myStats;
+	}
+
+	void ClosestPointTracker::printStats() {
+
+		unsigned long theScans = this->myStats.RefreshScans + this->myStats.FallbackScans;
+		unsigned long theWindows = this->myStats.WindowHits + this->myStats.FallbackScans;
+
+		printf("Seguimiento: %lu cuadros, %lu en ventana (%.1f%%), %lu recorridos completos (%lu refresco, %lu fallo de ventana), "
+				"ventana media %.0f pixeles\n",
+				this->myStats.Frames, this->myStats.WindowHits,
+				(this->myStats.Frames > 0) ? 100.0 * this->myStats.WindowHits / this->myStats.Frames : 0.0,
+				theScans, this->myStats.RefreshScans, this->myStats.FallbackScans,
+				(theWindows > 0) ? (double)this->myStats.WindowPixels / theWindows : 0.0);
+
+	}
+
+}
@@ -0,0 +1,96 @@
+/*
+ * DepthTracker.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Seguimiento temporal del punto más cercano.
+ *
+ *  El punto más cercano apenas se desplaza entre cuadros consecutivos, de modo que
+ *  se busca primero en una ventana alrededor del punto anterior y solo se recorre
+ *  el cuadro completo (con ClosestPointFinder):
+ *
+ *  	- cada cierto número de cuadros (refresco periódico)
+ *  	- si la ventana no contiene pixeles válidos
+ *  	- si el mínimo de la ventana se aleja más de lo permitido respecto al anterior
+ *
+ *  El tamaño de la ventana se adapta al desplazamiento observado entre cuadros: crece con
+ *  un salto y vuelve al mínimo en cuanto el punto se queda quieto.
+ *
+ */
+
+#ifndef DEPTHTRACKER_H_
+#define DEPTHTRACKER_H_
+
+#include <stdint.h>
+#include "Pixel3D.h"
+#include "ClosestPoint.h"
+
+namespace Depth {
+
+	// Contadores del seguimiento
+
+	struct TrackerStats {
+		unsigned long Frames;			// cuadros procesados
+		unsigned long WindowHits;		// cuadros resueltos solo con la ventana
+		unsigned long RefreshScans;		// recorridos completos por refresco periódico o sin punto anterior
+		unsigned long FallbackScans;	// recorridos completos porque la ventana no era fiable
+		uint64_t WindowPixels;			// pixeles de las ventanas buscadas (WindowHits + FallbackScans)
+	};
+
+	class ClosestPointTracker {
+
+	private:
+
+		// Miembros privados
+
+		ClosestPointFinder* myFinder;
+
+		Pixel3D myPrevious;
+		bool myHasPrevious;
+		int myWidth;
+		int myHeight;
+		int myFramesSinceScan;
+		int myHalfSize;
+
+		// Configuración
+
+		int myRefreshPeriod;
+		int myConfidenceMm;
+		int myMinHalfSize;
+		int myMaxHalfSize;
+
+		TrackerStats myStats;
+
+		bool findInWindow(const uint16_t* inDepth, Pixel3D* outPoint);
+
+	public:
+
+		// Miembros públicos
+
+		// inFinder se usa para los recorridos completos (no pasa a ser propiedad del seguidor)
+
+		ClosestPointTracker(ClosestPointFinder* inFinder);
+
+		// Devuelve false si no se ha encontrado ningún pixel válido (ni en la ventana ni en el cuadro)
+
+		bool find(const uint16_t* inDepth, int inWidth, int inHeight, Pixel3D* outPoint);
+
+		// inRefreshPeriod: cuadros entre recorridos completos
+		// inConfidenceMm: alejamiento máximo (en unidades de profundidad) aceptado en la ventana
+		// inMinHalfSize / inMaxHalfSize: límites de la semianchura de la ventana en pixeles
+
+		void configure(int inRefreshPeriod, int inConfidenceMm, int inMinHalfSize, int inMaxHalfSize);
+
+		// Olvida el punto anterior: el siguiente cuadro se recorre completo
+
+		void reset();
+
+		const TrackerStats& getStats();
+		void printStats();
+
+	};
+
+}
+
+#endif /* DEPTHTRACKER_H_ */
@@ -0,0 +1,241 @@
+/*
+ * DepthWorld.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	PointCloud: nube de puntos con un array por coordenada
+ *  	WorldConverter: conversión de profundidad a coordenadas del mundo con tablas por modo de vídeo
+ *
+ */
+
+#include "DepthWorld.h"
+#include "DepthMin.h"
+
+#include <cmath>
+
+namespace Depth {
+
+	// Constructor
+
+	PointCloud::PointCloud() {
+		this->X = NULL;
+		this->Y = NULL;
+		this->Z = NULL;
+		this->NumPoints = 0;
+		this->myCapacity = 0;
+	}
+
+	// Destructor
+
+	PointCloud::~PointCloud() {
+		delete[] this->X;
+		delete[] this->Y;
+		delete[] this->Z;
+	}
+
+	void PointCloud::resize(int inNumPoints) {
+
+		if (inNumPoints > this->myCapacity) {
+			delete[] this->X;
+			delete[] this->Y;
+			delete[] this->Z;
+			this->X = new float[inNumPoints];
+			this->Y = new float[inNumPoints];
+			this->Z = new float[inNumPoints];
+			this->myCapacity = inNumPoints;
+		}
+
+		this->NumPoints = inNumPoints;
+
+	}
+
+	void toWorldRowScalar(const uint16_t* inDepth, int inWidth, const float* inRayX, float inRayY, float inZScale, float* outX, float* outY, float* outZ) {
+
+		for (int x = 0; x < inWidth; x++) {
+			float theZ = (float)inDepth[x];
+			outX[x] = inRayX[x] * theZ;
+			outY[x] = inRayY * theZ;
+			outZ[x] = inZScale * theZ;
+		}
+
+	}
+
+	// Constructor
+
+	WorldConverter::WorldConverter() {
+		this->myNumTables = 0;
+		this->myNumUses = 0;
+		this->myNumBuilt = 0;
+		this->myRayX = NULL;
+		this->myRayY = NULL;
+		this->myZScale = 1.0f;
+		this->myWidth = 0;
+		this->myHeight = 0;
+		this->myPixelFormat = openni::PIXEL_FORMAT_DEPTH_1_MM;
+	}
+
+	// Destructor
+
+	WorldConverter::~WorldConverter() {
+		for (int t = 0; t < this->myNumTables; t++) {
+			delete[] this->myTables[t].myRayX;
+			delete[] this->myTables[t].myRayY;
+		}
+	}
+
+	void WorldConverter::configure(const openni::VideoStream& inStream) {
+
+		openni::VideoMode theMode = inStream.getVideoMode();
+
+		this->configure(theMode.getResolutionX(), theMode.getResolutionY(),
+				inStream.getHorizontalFieldOfView(), inStream.getVerticalFieldOfView(), theMode.getPixelFormat());
+
+	}
+
+	void WorldConverter::configure(const openni::VideoFrameRef& inFrame, const openni::VideoStream& inStream) {
+
+		this->configure(inFrame.getWidth(), inFrame.getHeight(), inStream.getHorizontalFieldOfView(), inStream.getVerticalFieldOfView(),
+				inFrame.getVideoMode().getPixelFormat());
+
+	}
+
+	void WorldConverter::configure(int inWidth, int inHeight, float inHorizontalFov, float inVerticalFov, openni::PixelFormat inPixelFormat) {
+
+		Tables* theTables = NULL;
+
+		// Tablas ya calculadas para este modo
+
+		for (int t = 0; t < this->myNumTables; t++) {
+			Tables* theCandidate = &this->myTables[t];
+			if ((theCandidate->myWidth == inWidth) && (theCandidate->myHeight == inHeight) && (theCandidate->myPixelFormat == inPixelFormat) &&
+					(theCandidate->myHorizontalFov == inHorizontalFov) && (theCandidate->myVerticalFov == inVerticalFov)) {
+				theTables = theCandidate;
+				break;
+			}
+		}
+
+		if (theTables == NULL) {
+
+			// Un hueco libre o, si no quedan, las tablas usadas hace más tiempo
+
+			if (this->myNumTables < WORLD_MAX_MODES) {
+				theTables = &this->myTables[this->myNumTables++];
+				theTables->myRayX = NULL;
+				theTables->myRayY = NULL;
+				theTables->myWidth = 0;
+				theTables->myHeight = 0;
+			} else {
+				theTables = &this->myTables[0];
+				for (int t = 1; t < WORLD_MAX_MODES; t++) {
+					if (this->myTables[t].myLastUse < theTables->myLastUse) {
+						theTables = &this->myTables[t];
+					}
+				}
+			}
+
+			// Mismos factores que OpenNI (VideoStream::refreshWorldConversionCache).
+			// La conversión a mm del formato de 100 um se incluye en las tablas.
+
+			float theXZFactor = tan(inHorizontalFov / 2) * 2;
+			float theYZFactor = tan(inVerticalFov / 2) * 2;
+			float theZScale = (inPixelFormat == openni::PIXEL_FORMAT_DEPTH_100_UM) ? 0.1f : 1.0f;
+
+			if (inWidth != theTables->myWidth) {
+				delete[] theTables->myRayX;
+				theTables->myRayX = new float[inWidth];
+			}
+
+			if (inHeight != theTables->myHeight) {
+				delete[] theTables->myRayY;
+				theTables->myRayY = new float[inHeight];
+			}
+
+			for (int x = 0; x < inWidth; x++) {
+				theTables->myRayX[x] = ((float)x / inWidth - .5f) * theXZFactor * theZScale;
+			}
+
+			for (int y = 0; y < inHeight; y++) {
+				theTables->myRayY[y] = (.5f - (float)y / inHeight) * theYZFactor * theZScale;
+			}
+
+			theTables->myZScale = theZScale;
+			theTables->myWidth = inWidth;
+			theTables->myHeight = inHeight;
+			theTables->myHorizontalFov = inHorizontalFov;
+			theTables->myVerticalFov = inVerticalFov;
+			theTables->myPixelFormat = inPixelFormat;
+
+			this->myNumBuilt++;
+		}
+
+		theTables->myLastUse = ++this->myNumUses;
+
+		this->myRayX = theTables->myRayX;
+		this->myRayY = theTables->myRayY;
+		this->myZScale = theTables->myZScale;
+		this->myWidth = theTables->myWidth;
+		this->myHeight = theTables->myHeight;
+		this->myPixelFormat = theTables->myPixelFormat;
+
+	}
+
+	bool WorldConverter::matches(const openni::VideoFrameRef& inFrame) {
+		return (inFrame.getWidth() == this->myWidth) && (inFrame.getHeight() == this->myHeight) &&
+				(inFrame.getVideoMode().getPixelFormat() == this->myPixelFormat);
+	}
+
+	bool WorldConverter::convertPoint(int inX, int inY, uint16_t inZ, float* outX, float* outY, float* outZ) {
+
+		if ((inX < 0) || (inX >= this->myWidth) || (inY < 0) || (inY >= this->myHeight)) {
+			return false;
+		}
+
+		float theZ = (float)inZ;
+
+		*outX = this->myRayX[inX] * theZ;
+		*outY = this->myRayY[inY] * theZ;
+		*outZ = this->myZScale * theZ;
+
+		return true;
+	}
+
+	void WorldConverter::convertFrame(const uint16_t* inDepth, PointCloud* outCloud) {
+
+		typedef void (*rowFunction)(const uint16_t*, int, const float*, float, float, float*, float*, float*);
+
+		rowFunction theRow = toWorldRowScalar;
+
+#ifdef PTU_XTION_X86_SIMD
+		switch (getKernel()) {
+			case KERNEL_AVX2:	theRow = toWorldRowAVX2; break;
+			case KERNEL_SSE41:	theRow = toWorldRowSSE41; break;
+			default: break;
+		}
+#endif
+
+		outCloud->resize(this->myWidth * this->myHeight);
+
+		for (int y = 0; y < this->myHeight; y++) {
+			int theOffset = y * this->myWidth;
+			theRow(inDepth + theOffset, this->myWidth, this->myRayX, this->myRayY[y], this->myZScale,
+					outCloud->X + theOffset, outCloud->Y + theOffset, outCloud->Z + theOffset);
+		}
+
+	}
+
+	int WorldConverter::getWidth() {
+		return this->myWidth;
+	}
+
+	int WorldConverter::getHeight() {
+		return this->myHeight;
+	}
+
+	unsigned long WorldConverter::getNumBuilt() {
+		return this->myNumBuilt;
+	}
+
+}
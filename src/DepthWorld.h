@@ -0,0 +1,148 @@
+/*
+ * DepthWorld.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Conversión de cuadros de profundidad a coordenadas del mundo (mm).
+ *
+ *  Equivale a openni::CoordinateConverter::convertDepthToWorld:
+ *
+ *  	X = (x / ancho - 0.5) * 2 tan(FOVh / 2) * Z
+ *  	Y = (0.5 - y / alto) * 2 tan(FOVv / 2) * Z
+ *
+ *  pero los factores de cada columna y de cada fila se calculan una sola vez por
+ *  modo de vídeo, y el cuadro completo se convierte con multiplicaciones vectoriales
+ *  en una nube de puntos con un array por coordenada.
+ *
+ *  Se conservan las tablas de los últimos WORLD_MAX_MODES modos: al alternar entre modos
+ *  (Capture::ModeScheduler) volver a uno ya usado solo cambia de tablas.
+ *
+ */
+
+#ifndef DEPTHWORLD_H_
+#define DEPTHWORLD_H_
+
+#include <stdint.h>
+#include <OpenNI.h>
+
+#define WORLD_MAX_MODES 4
+
+namespace Depth {
+
+	//////////////////////////////////////////////////
+	// Nube de puntos (un array por coordenada)		//
+	// El punto i corresponde al pixel i del cuadro	//
+	//////////////////////////////////////////////////
+
+	class PointCloud {
+
+	private:
+
+		int myCapacity;
+
+	public:
+
+		float* X;
+		float* Y;
+		float* Z;
+		int NumPoints;
+
+		PointCloud();
+
+		~PointCloud();
+
+		// Solo reserva memoria si inNumPoints supera lo ya reservado
+
+		void resize(int inNumPoints);
+
+	};
+
+	class WorldConverter {
+
+	private:
+
+		// Miembros privados
+
+		struct Tables {
+			float* myRayX;
+			float* myRayY;
+			float myZScale;
+			int myWidth;
+			int myHeight;
+			float myHorizontalFov;
+			float myVerticalFov;
+			openni::PixelFormat myPixelFormat;
+			unsigned long myLastUse;
+		};
+
+		Tables myTables[WORLD_MAX_MODES];
+		int myNumTables;
+		unsigned long myNumUses;
+		unsigned long myNumBuilt;
+
+		// Tablas en uso
+
+		float* myRayX;		// factor de X por columna
+		float* myRayY;		// factor de Y por fila
+		float myZScale;		// unidades de profundidad a mm
+		int myWidth;
+		int myHeight;
+		openni::PixelFormat myPixelFormat;
+
+	public:
+
+		// Miembros públicos
+
+		WorldConverter();
+
+		~WorldConverter();
+
+		// Calcula las tablas para el modo de vídeo actual del stream
+
+		void configure(const openni::VideoStream& inStream);
+
+		// Calcula las tablas para el modo del cuadro, con los campos de visión del stream
+		// (tras un cambio de modo pueden llegar aún cuadros del anterior)
+
+		void configure(const openni::VideoFrameRef& inFrame, const openni::VideoStream& inStream);
+
+		// Calcula las tablas a partir de la resolución y los campos de visión (en radianes),
+		// o recupera las ya calculadas para esos valores
+
+		void configure(int inWidth, int inHeight, float inHorizontalFov, float inVerticalFov, openni::PixelFormat inPixelFormat);
+
+		// Indica si las tablas sirven para el cuadro (misma resolución y formato)
+
+		bool matches(const openni::VideoFrameRef& inFrame);
+
+		// Convierte un pixel. Devuelve false si el pixel está fuera del cuadro configurado.
+
+		bool convertPoint(int inX, int inY, uint16_t inZ, float* outX, float* outY, float* outZ);
+
+		// Convierte el cuadro completo (de las dimensiones configuradas).
+		// Los pixeles sin profundidad dan el punto (0,0,0).
+
+		void convertFrame(const uint16_t* inDepth, PointCloud* outCloud);
+
+		int getWidth();
+		int getHeight();
+
+		// Tablas calculadas desde la construcción (las recuperadas no cuentan)
+
+		unsigned long getNumBuilt();
+
+	};
+
+	// Conversión de una fila (dispatch según Depth::getKernel)
+
+	void toWorldRowScalar(const uint16_t* inDepth, int inWidth, const float* inRayX, float inRayY, float inZScale, float* outX, float* outY, float* outZ);
+
+#ifdef PTU_XTION_X86_SIMD
+	void toWorldRowSSE41(const uint16_t* inDepth, int inWidth, const float* inRayX, float inRayY, float inZScale, float* outX, float* outY, float* outZ);
+	void toWorldRowAVX2(const uint16_t* inDepth, int inWidth, const float* inRayX, float inRayY, float inZScale, float* outX, float* outY, float* outZ);
+#endif
+
+}
+
+#endif /* DEPTHWORLD_H_ */
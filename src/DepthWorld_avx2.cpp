@@ -0,0 +1,41 @@
+/*
+ * DepthWorld_avx2.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Conversión de una fila de profundidad a coordenadas del mundo con AVX2
+ *  (8 pixeles por instrucción). Se compila con -mavx2.
+ *
+ */
+
+#include "DepthWorld.h"
+
+#ifdef PTU_XTION_X86_SIMD
+
+#include <immintrin.h>
+
+namespace Depth {
+
+	void toWorldRowAVX2(const uint16_t* inDepth, int inWidth, const float* inRayX, float inRayY, float inZScale, float* outX, float* outY, float* outZ) {
+
+		const __m256 theRayY = _mm256_set1_ps(inRayY);
+		const __m256 theZScale = _mm256_set1_ps(inZScale);
+		int x = 0;
+
+		for (; x + 8 <= inWidth; x += 8) {
+			__m256 theZ = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(inDepth + x))));
+			_mm256_storeu_ps(outX + x, _mm256_mul_ps(_mm256_loadu_ps(inRayX + x), theZ));
+			_mm256_storeu_ps(outY + x, _mm256_mul_ps(theRayY, theZ));
+			_mm256_storeu_ps(outZ + x, _mm256_mul_ps(theZScale, theZ));
+		}
+
+		if (x < inWidth) {
+			toWorldRowScalar(inDepth + x, inWidth - x, inRayX + x, inRayY, inZScale, outX + x, outY + x, outZ + x);
+		}
+
+	}
+
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * DepthWorld_sse41.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Conversión de una fila de profundidad a coordenadas del mundo con SSE4.1
+ *  (4 pixeles por instrucción). Se compila con -msse4.1.
+ *
+ */
+
+#include "DepthWorld.h"
+
+#ifdef PTU_XTION_X86_SIMD
+
+#include <smmintrin.h>
+
+namespace Depth {
+
+	void toWorldRowSSE41(const uint16_t* inDepth, int inWidth, const float* inRayX, float inRayY, float inZScale, float* outX, float* outY, float* outZ) {
+
+		const __m128 theRayY = _mm_set1_ps(inRayY);
+		const __m128 theZScale = _mm_set1_ps(inZScale);
+		int x = 0;
+
+		for (; x + 4 <= inWidth; x += 4) {
+			__m128 theZ = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(inDepth + x))));
+			_mm_storeu_ps(outX + x, _mm_mul_ps(_mm_loadu_ps(inRayX + x), theZ));
+			_mm_storeu_ps(outY + x, _mm_mul_ps(theRayY, theZ));
+			_mm_storeu_ps(outZ + x, _mm_mul_ps(theZScale, theZ));
+		}
+
+		if (x < inWidth) {
+			toWorldRowScalar(inDepth + x, inWidth - x, inRayX + x, inRayY, inZScale, outX + x, outY + x, outZ + x);
+		}
+
+	}
+
+}
+
+#endif
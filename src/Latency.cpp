@@ -0,0 +1,127 @@
+/*
+ * Latency.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	LatencyHistogram: histograma log-lineal de latencias
+ *
+ */
+
+#include "Latency.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace Timing {
+
+	// Constructor
+
+	LatencyHistogram::LatencyHistogram() {
+		this->reset();
+	}
+
+	void LatencyHistogram::reset() {
+
+		memset(this->myBuckets, 0, sizeof(this->myBuckets));
+		this->myCount = 0;
+		this->mySum = 0;
+		this->myMax = 0;
+
+	}
+
+	// Valores menores que LATENCY_SUB_BUCKETS: un bucket por valor.
+	// Resto: exponente (posición del bit más alto) y los LATENCY_SUB_BITS bits siguientes.
+
+	int LatencyHistogram::getBucket(int64_t inNs) {
+
+		uint64_t theValue = (uint64_t)inNs;
+
+		if (theValue < LATENCY_SUB_BUCKETS) {
+			return (int)theValue;
+		}
+
+		int theExponent = 63 - __builtin_clzll(theValue);
+
+		if (theExponent >= LATENCY_MAX_BITS) {
+			return LATENCY_BUCKETS - 1;
+		}
+
+		int theShift = theExponent - LATENCY_SUB_BITS;
+
+		return (theShift + 1) * LATENCY_SUB_BUCKETS + (int)((theValue >> theShift) & (LATENCY_SUB_BUCKETS - 1));
+	}
+
+	int64_t LatencyHistogram::getBucketTop(int inBucket) {
+
+		if (inBucket < LATENCY_SUB_BUCKETS) {
+			return inBucket;
+		}
+
+		int theShift = inBucket / LATENCY_SUB_BUCKETS - 1;
+		int64_t theMantissa = LATENCY_SUB_BUCKETS + (inBucket % LATENCY_SUB_BUCKETS);
+
+		return ((theMantissa + 1) << theShift) - 1;
+	}
+
+	void LatencyHistogram::record(int64_t inNs) {
+
+		if (inNs < 0) {
+			inNs = 0;
+		}
+
+		this->myBuckets[getBucket(inNs)]++;
+		this->myCount++;
+		this->mySum += inNs;
+		if (inNs > this->myMax) {
+			this->myMax = inNs;
+		}
+
+	}
+
+	uint64_t LatencyHistogram::getCount() {
+		return this->myCount;
+	}
+
+	int64_t LatencyHistogram::getMax() {
+		return this->myMax;
+	}
+
+	double LatencyHistogram::getMean() {
+		return (this->myCount > 0) ? (double)this->mySum / this->myCount : 0.0;
+	}
+
+	int64_t LatencyHistogram::getPercentile(float inFraction) {
+
+		if (this->myCount == 0) {
+			return 0;
+		}
+
+		uint64_t theTarget = (uint64_t)(inFraction * this->myCount + 0.5f);
+		if (theTarget < 1) theTarget = 1;
+
+		uint64_t theCount = 0;
+
+		for (int b = 0; b < LATENCY_BUCKETS; b++) {
+			theCount += this->myBuckets[b];
+			if (theCount >= theTarget) {
+				int64_t theTop = getBucketTop(b);
+				return (theTop < this->myMax) ? theTop : this->myMax;
+			}
+		}
+
+		return this->myMax;
+	}
+
+	void LatencyHistogram::printHeader() {
+		printf("%-22s %10s %10s %10s %10s %10s\n", "etapa", "muestras", "media us", "p50 us", "p99 us", "max us");
+	}
+
+	void LatencyHistogram::print(const char* inName) {
+		printf("%-22s %10llu %10.1f %10.1f %10.1f %10.1f\n", inName, (unsigned long long)this->myCount, this->getMean() * 1e-3,
+				this->getPercentile(0.5f) * 1e-3, this->getPercentile(0.99f) * 1e-3, this->myMax * 1e-3);
+	}
+
+}
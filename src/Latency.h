@@ -0,0 +1,84 @@
+/*
+ * Latency.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Medida de latencias con muy poco coste por muestra.
+ *
+ *  	LatencyHistogram: histograma log-lineal de tiempos en nanosegundos
+ *
+ *  Cada potencia de dos se divide en LATENCY_SUB_BUCKETS intervalos iguales, de modo que
+ *  el error relativo de los percentiles es menor de 1/LATENCY_SUB_BUCKETS (3%) desde
+ *  nanosegundos hasta minutos, con una tabla fija y sin reservas de memoria al registrar.
+ *  El máximo, la suma y el número de muestras son exactos.
+ *
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+#include <ctime>
+
+#define LATENCY_SUB_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BITS 44			// hasta 2^44 ns (unas 4,9 horas); los valores mayores se acumulan en el último bucket
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+namespace Timing {
+
+	// Tiempo monótono en nanosegundos
+
+	static inline int64_t nowNs() {
+		struct timespec theTime;
+		clock_gettime(CLOCK_MONOTONIC, &theTime);
+		return (int64_t)theTime.tv_sec * 1000000000LL + theTime.tv_nsec;
+	}
+
+	class LatencyHistogram {
+
+	private:
+
+		// Miembros privados
+
+		uint32_t myBuckets[LATENCY_BUCKETS];
+		uint64_t myCount;
+		int64_t mySum;
+		int64_t myMax;
+
+		static int getBucket(int64_t inNs);
+		static int64_t getBucketTop(int inBucket);
+
+	public:
+
+		// Miembros públicos
+
+		LatencyHistogram();
+
+		// Los valores negativos cuentan como 0
+
+		void record(int64_t inNs);
+
+		void reset();
+
+		uint64_t getCount();
+		int64_t getMax();
+		double getMean();
+
+		// Valor por debajo del cual queda la fracción inFraction (0..1) de las muestras
+		// (extremo superior de su bucket, nunca mayor que el máximo). 0 sin muestras.
+
+		int64_t getPercentile(float inFraction);
+
+		// Una línea con muestras, media, p50, p99 y máximo en microsegundos
+
+		void print(const char* inName);
+
+		static void printHeader();
+
+	};
+
+}
+
+#endif /* LATENCY_H_ */
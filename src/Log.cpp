@@ -0,0 +1,589 @@
+/*
+ * Log.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Funciones:
+ *
+ *  	write: registro binario en el anillo del hilo llamante
+ *  	start, stop: hilo que da formato a los registros, los escribe y rota el fichero
+ *
+ */
+
+#include "Log.h"
+#include "Latency.h"
+
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <unistd.h>
+
+#define RECORD_BYTES	64
+#define RING_MASK		(LOG_RING_SLOTS - 1)
+
+// Como mucho, un registro ocupa la cabecera y los textos de todos sus argumentos
+
+#define MAX_RECORD_SLOTS	(1 + (LOG_MAX_ARGS * LOG_MAX_STRING + RECORD_BYTES - 1) / RECORD_BYTES)
+
+#define MAX_LINE	1024
+
+namespace Log {
+
+	// Cabecera de un registro (un hueco del anillo). Los textos de los argumentos siguen en los
+	// huecos siguientes; su argumento guarda la posición dentro de ellos.
+
+	struct Record {
+		int64_t StampNs;
+		const char* Format;
+		uint8_t Level;
+		uint8_t NumSlots;
+		uint8_t Types[LOG_MAX_ARGS];
+		uint8_t Padding;
+		union {
+			int64_t Int;
+			uint64_t UInt;
+			double Double;
+		} Values[LOG_MAX_ARGS];
+	};
+
+	typedef char RecordFitsSlot[(sizeof(Record) == RECORD_BYTES) ? 1 : -1];
+
+	struct Slot {
+		unsigned char Bytes[RECORD_BYTES];
+	};
+
+	// Anillo de un hilo: escribe solo su hilo (myWrite), lee solo el del registro (myRead).
+	// Los índices avanzan sin límite y se separan para no compartir línea de caché.
+	// Cuando el hilo termina, el anillo queda libre (myReleased) y otro hilo lo puede
+	// tomar en cuanto el hilo del registro haya leído todos sus mensajes.
+
+	struct Ring {
+		Slot mySlots[LOG_RING_SLOTS];
+		volatile unsigned int myWrite;
+		char myPadding1[64 - sizeof(unsigned int)];
+		volatile unsigned int myRead;
+		char myPadding2[64 - sizeof(unsigned int)];
+		volatile unsigned long myDropped;
+		volatile int myReleased;
+	};
+
+	Config::Config() {
+
+		this->ConsoleLevel = LEVEL_INFO;
+		this->FileLevel = LEVEL_DEBUG;
+		this->FilePath = NULL;
+		this->MaxFileBytes = 16 * 1024 * 1024;
+		this->MaxFiles = 4;
+
+	}
+
+	// Anillos registrados (no se liberan: al terminar su hilo se reutilizan). La clave de
+	// hilo solo sirve para saber cuándo termina cada hilo con anillo.
+
+	static Ring* theRings[LOG_MAX_THREADS];
+	static volatile int theNumRings = 0;
+	static __thread Ring* theThreadRing = NULL;
+	static pthread_key_t theRingKey;
+	static pthread_once_t theRingKeyOnce = PTHREAD_ONCE_INIT;
+
+	// Nivel mínimo aceptado (LEVEL_OFF sin hilo del registro) y descartes sin anillo
+
+	static volatile int theThreshold = LEVEL_OFF;
+	static volatile unsigned long theUnattached = 0;
+
+	// Estado del hilo del registro
+
+	static Config theConfig;
+	static pthread_t theThread;
+	static volatile bool theRunning = false;
+	static int64_t theStartNs = 0;
+	static FILE* theFile = NULL;
+	static long theFileBytes = 0;
+	static unsigned long theReportedDrops = 0;
+
+	static const char LevelLetters[] = "DIWE";
+	static const char* LevelNames[LEVEL_OFF] = { "debug", "info", "warn", "error" };
+
+	bool isEnabled(Level inLevel) {
+		return inLevel >= theThreshold;
+	}
+
+	// Destructor de theRingKey: el hilo ha terminado y ya no escribirá en su anillo
+
+	static void releaseRing(void* inRing) {
+
+		Ring* theRing = (Ring*)inRing;
+
+		__sync_synchronize();
+		theRing->myReleased = 1;
+
+	}
+
+	static void createRingKey() {
+		pthread_key_create(&theRingKey, releaseRing);
+	}
+
+	// Un anillo libre ya leído entero, o NULL si no hay ninguno
+
+	static Ring* reuseRing() {
+
+		int theCount = (theNumRings < LOG_MAX_THREADS) ? theNumRings : LOG_MAX_THREADS;
+
+		for (int r = 0; r < theCount; r++) {
+			Ring* theRing = theRings[r];
+			if ((theRing != NULL) && theRing->myReleased && (theRing->myRead == theRing->myWrite) &&
+					__sync_bool_compare_and_swap(&theRing->myReleased, 1, 0)) {
+				return theRing;
+			}
+		}
+
+		return NULL;
+	}
+
+	bool attachThread() {
+
+		if (theThreadRing != NULL) {
+			return true;
+		}
+
+		pthread_once(&theRingKeyOnce, createRingKey);
+
+		Ring* theRing = reuseRing();
+
+		if (theRing == NULL) {
+
+			int theIndex = __sync_fetch_and_add(&theNumRings, 1);
+
+			if (theIndex >= LOG_MAX_THREADS) {
+				__sync_fetch_and_sub(&theNumRings, 1);
+				return false;
+			}
+
+			theRing = new Ring;
+			theRing->myWrite = 0;
+			theRing->myRead = 0;
+			theRing->myDropped = 0;
+			theRing->myReleased = 0;
+
+			__sync_synchronize();
+			theRings[theIndex] = theRing;
+		}
+
+		theThreadRing = theRing;
+		pthread_setspecific(theRingKey, theRing);
+
+		return true;
+	}
+
+	// Copia inLength bytes a partir del byte inOffset de los huecos que siguen a la cabecera inHead
+
+	static void copyToRing(Ring* inRing, unsigned int inHead, int inOffset, const char* inBytes, int inLength) {
+
+		for (int i = 0; i < inLength; i++) {
+			int theByte = RECORD_BYTES + inOffset + i;
+			inRing->mySlots[(inHead + theByte / RECORD_BYTES) & RING_MASK].Bytes[theByte % RECORD_BYTES] = inBytes[i];
+		}
+
+	}
+
+	void write(Level inLevel, const char* inFormat, const Arg& inArg0, const Arg& inArg1,
+			const Arg& inArg2, const Arg& inArg3, const Arg& inArg4) {
+
+		if (inLevel < theThreshold) {
+			return;
+		}
+
+		Ring* theRing = theThreadRing;
+
+		if ((theRing == NULL) && (!attachThread() || ((theRing = theThreadRing) == NULL))) {
+			__sync_fetch_and_add(&theUnattached, 1);
+			return;
+		}
+
+		const Arg* theArgs[LOG_MAX_ARGS] = { &inArg0, &inArg1, &inArg2, &inArg3, &inArg4 };
+		int theLengths[LOG_MAX_ARGS];
+		int theTextBytes = 0;
+
+		for (int a = 0; a < LOG_MAX_ARGS; a++) {
+			if (theArgs[a]->Type == ARG_STRING) {
+				const char* theString = (theArgs[a]->String != NULL) ? theArgs[a]->String : "(null)";
+				theLengths[a] = (int)strnlen(theString, LOG_MAX_STRING - 1);
+				theTextBytes += theLengths[a] + 1;
+			}
+		}
+
+		int theNumSlots = 1 + (theTextBytes + RECORD_BYTES - 1) / RECORD_BYTES;
+		unsigned int theHead = theRing->myWrite;
+
+		if (theHead - theRing->myRead + theNumSlots > LOG_RING_SLOTS) {
+			theRing->myDropped++;
+			return;
+		}
+
+		Record* theRecord = (Record*)theRing->mySlots[theHead & RING_MASK].Bytes;
+		int theOffset = 0;
+
+		theRecord->StampNs = Timing::nowNs();
+		theRecord->Format = inFormat;
+		theRecord->Level = (uint8_t)inLevel;
+		theRecord->NumSlots = (uint8_t)theNumSlots;
+
+		for (int a = 0; a < LOG_MAX_ARGS; a++) {
+
+			theRecord->Types[a] = (uint8_t)theArgs[a]->Type;
+
+			if (theArgs[a]->Type == ARG_STRING) {
+				const char* theString = (theArgs[a]->String != NULL) ? theArgs[a]->String : "(null)";
+				theRecord->Values[a].Int = theOffset;
+				copyToRing(theRing, theHead, theOffset, theString, theLengths[a]);
+				copyToRing(theRing, theHead, theOffset + theLengths[a], "", 1);
+				theOffset += theLengths[a] + 1;
+			} else {
+				theRecord->Values[a].Int = theArgs[a]->Int;
+			}
+		}
+
+		// El registro debe estar completo antes de publicarlo
+
+		__sync_synchronize();
+		theRing->myWrite = theHead + theNumSlots;
+
+	}
+
+	unsigned long getDropped() {
+
+		unsigned long theDropped = theUnattached;
+		int theCount = (theNumRings < LOG_MAX_THREADS) ? theNumRings : LOG_MAX_THREADS;
+
+		for (int r = 0; r < theCount; r++) {
+			if (theRings[r] != NULL) {
+				theDropped += theRings[r]->myDropped;
+			}
+		}
+
+		return theDropped;
+	}
+
+	bool parseLevel(const char* inName, Level* outLevel) {
+
+		for (int l = 0; l < LEVEL_OFF; l++) {
+			if (strcmp(inName, LevelNames[l]) == 0) {
+				*outLevel = (Level)l;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Da formato a un registro: cada especificación de inFormat se aplica a su argumento
+	// con el tamaño con el que se guardó (se sustituyen los modificadores h, l, z, ...)
+
+	static int formatRecord(const Record* inRecord, const char* inTexts, char* outLine, int inMaxLength) {
+
+		const char* theFormat = inRecord->Format;
+		int theLength = 0;
+		int theArg = 0;
+
+		while ((*theFormat != '\0') && (theLength < inMaxLength - 1)) {
+
+			if (*theFormat != '%') {
+				outLine[theLength++] = *theFormat++;
+				continue;
+			}
+
+			if (theFormat[1] == '%') {
+				outLine[theLength++] = '%';
+				theFormat += 2;
+				continue;
+			}
+
+			// Indicadores, anchura y precisión
+
+			char theSpec[32];
+			int theSpecLength = 0;
+
+			theSpec[theSpecLength++] = *theFormat++;
+
+			while ((*theFormat != '\0') && (strchr("-+ #0123456789.", *theFormat) != NULL) && (theSpecLength < 24)) {
+				theSpec[theSpecLength++] = *theFormat++;
+			}
+
+			while ((*theFormat != '\0') && (strchr("hlLqjzt", *theFormat) != NULL)) {
+				theFormat++;
+			}
+
+			char theConversion = *theFormat;
+
+			if (theConversion == '\0') {
+				break;
+			}
+
+			theFormat++;
+
+			int theType = (theArg < LOG_MAX_ARGS) ? inRecord->Types[theArg] : (int)ARG_NONE;
+			int theRoom = inMaxLength - theLength;
+			int theWritten = 0;
+
+			if (theType == ARG_NONE) {
+				theWritten = snprintf(outLine + theLength, theRoom, "?");
+			} else {
+
+				int64_t theInt = inRecord->Values[theArg].Int;
+				double theDouble = (theType == ARG_DOUBLE) ? inRecord->Values[theArg].Double :
+						((theType == ARG_UINT) ? (double)inRecord->Values[theArg].UInt : (double)theInt);
+
+				if (theType == ARG_DOUBLE) {
+					theInt = (int64_t)theDouble;
+				}
+
+				switch (theConversion) {
+
+					case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+						theSpec[theSpecLength++] = 'l';
+						theSpec[theSpecLength++] = 'l';
+						theSpec[theSpecLength++] = theConversion;
+						theSpec[theSpecLength] = '\0';
+						if ((theConversion == 'd') || (theConversion == 'i')) {
+							theWritten = snprintf(outLine + theLength, theRoom, theSpec, (long long)theInt);
+						} else {
+							theWritten = snprintf(outLine + theLength, theRoom, theSpec, (unsigned long long)theInt);
+						}
+						break;
+
+					case 'c':
+						theSpec[theSpecLength++] = 'c';
+						theSpec[theSpecLength] = '\0';
+						theWritten = snprintf(outLine + theLength, theRoom, theSpec, (int)theInt);
+						break;
+
+					case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+						theSpec[theSpecLength++] = theConversion;
+						theSpec[theSpecLength] = '\0';
+						theWritten = snprintf(outLine + theLength, theRoom, theSpec, theDouble);
+						break;
+
+					case 's':
+						theSpec[theSpecLength++] = 's';
+						theSpec[theSpecLength] = '\0';
+						theWritten = snprintf(outLine + theLength, theRoom, theSpec,
+								(theType == ARG_STRING) ? inTexts + inRecord->Values[theArg].Int : "?");
+						break;
+
+					default:
+						theWritten = snprintf(outLine + theLength, theRoom, "?");
+						break;
+				}
+			}
+
+			theArg++;
+
+			if (theWritten > 0) {
+				theLength += (theWritten < theRoom) ? theWritten : theRoom - 1;
+			}
+		}
+
+		outLine[theLength] = '\0';
+
+		return theLength;
+	}
+
+	// Fichero actual a FilePath.1, FilePath.1 a FilePath.2, ... (se pierde el más antiguo)
+
+	static void rotateFile() {
+
+		char theFrom[512];
+		char theTo[512];
+
+		fclose(theFile);
+		theFile = NULL;
+
+		for (int i = theConfig.MaxFiles - 1; i >= 1; i--) {
+			snprintf(theFrom, sizeof(theFrom), "%s.%d", theConfig.FilePath, i);
+			snprintf(theTo, sizeof(theTo), "%s.%d", theConfig.FilePath, i + 1);
+			rename(theFrom, theTo);
+		}
+
+		if (theConfig.MaxFiles > 0) {
+			snprintf(theTo, sizeof(theTo), "%s.1", theConfig.FilePath);
+			rename(theConfig.FilePath, theTo);
+		}
+
+		theFile = fopen(theConfig.FilePath, "w");
+		theFileBytes = 0;
+
+	}
+
+	static void output(Level inLevel, int64_t inStampNs, const char* inMessage) {
+
+		char theLine[MAX_LINE + 32];
+		int64_t theNs = inStampNs - theStartNs;
+
+		int theLength = snprintf(theLine, sizeof(theLine), "[%5lld.%06lld] %c %s\n", (long long)(theNs / 1000000000LL),
+				(long long)((theNs % 1000000000LL) / 1000), LevelLetters[inLevel], inMessage);
+
+		if (theLength >= (int)sizeof(theLine)) {
+			theLength = sizeof(theLine) - 1;
+		}
+
+		if (inLevel >= theConfig.ConsoleLevel) {
+			fwrite(theLine, 1, theLength, stdout);
+		}
+
+		if ((theFile != NULL) && (inLevel >= theConfig.FileLevel)) {
+			fwrite(theLine, 1, theLength, theFile);
+			theFileBytes += theLength;
+			if ((theConfig.MaxFileBytes > 0) && (theFileBytes >= theConfig.MaxFileBytes)) {
+				rotateFile();
+			}
+		}
+
+	}
+
+	// Escribe todos los registros publicados, del más antiguo al más reciente entre anillos
+
+	static void drain() {
+
+		char theTexts[MAX_RECORD_SLOTS * RECORD_BYTES];
+		char theMessage[MAX_LINE];
+		int theCount = (theNumRings < LOG_MAX_THREADS) ? theNumRings : LOG_MAX_THREADS;
+		unsigned int theEnds[LOG_MAX_THREADS];
+
+		// Solo los publicados hasta ahora: un hilo que escribe sin parar no retiene el bucle
+
+		for (int r = 0; r < theCount; r++) {
+			theEnds[r] = (theRings[r] != NULL) ? theRings[r]->myWrite : 0;
+		}
+
+		__sync_synchronize();
+
+		for (;;) {
+
+			Ring* theOldest = NULL;
+			int64_t theOldestNs = 0;
+
+			for (int r = 0; r < theCount; r++) {
+				Ring* theRing = theRings[r];
+				if ((theRing != NULL) && (theRing->myRead != theEnds[r])) {
+					const Record* theRecord = (const Record*)theRing->mySlots[theRing->myRead & RING_MASK].Bytes;
+					if ((theOldest == NULL) || (theRecord->StampNs < theOldestNs)) {
+						theOldest = theRing;
+						theOldestNs = theRecord->StampNs;
+					}
+				}
+			}
+
+			if (theOldest == NULL) {
+				break;
+			}
+
+			unsigned int theHead = theOldest->myRead;
+			const Record* theRecord = (const Record*)theOldest->mySlots[theHead & RING_MASK].Bytes;
+
+			for (int s = 1; s < theRecord->NumSlots; s++) {
+				memcpy(theTexts + (s - 1) * RECORD_BYTES, theOldest->mySlots[(theHead + s) & RING_MASK].Bytes, RECORD_BYTES);
+			}
+
+			formatRecord(theRecord, theTexts, theMessage, sizeof(theMessage));
+			output((Level)theRecord->Level, theRecord->StampNs, theMessage);
+
+			// El hueco no se puede reutilizar hasta haberlo leído
+
+			__sync_synchronize();
+			theOldest->myRead = theHead + theRecord->NumSlots;
+		}
+
+		// Aviso de mensajes perdidos
+
+		unsigned long theDropped = getDropped();
+
+		if (theDropped != theReportedDrops) {
+			snprintf(theMessage, sizeof(theMessage), "Registro: %lu mensajes descartados (anillo lleno)", theDropped - theReportedDrops);
+			output(LEVEL_WARN, Timing::nowNs(), theMessage);
+			theReportedDrops = theDropped;
+		}
+
+		fflush(stdout);
+		if (theFile != NULL) {
+			fflush(theFile);
+		}
+
+	}
+
+	static void* threadMain(void* inArg) {
+
+		(void)inArg;
+
+		while (theRunning) {
+			drain();
+			usleep(LOG_FLUSH_MS * 1000);
+		}
+
+		drain();
+
+		return NULL;
+	}
+
+	bool start(const Config& inConfig) {
+
+		if (theRunning) {
+			return false;
+		}
+
+		theConfig = inConfig;
+		theStartNs = Timing::nowNs();
+		theReportedDrops = getDropped();
+
+		if (theConfig.FilePath != NULL) {
+
+			theFile = fopen(theConfig.FilePath, "a");
+
+			if (theFile == NULL) {
+				return false;
+			}
+
+			fseek(theFile, 0, SEEK_END);
+			theFileBytes = ftell(theFile);
+		}
+
+		theRunning = true;
+
+		if (pthread_create(&theThread, NULL, threadMain, NULL) != 0) {
+			theRunning = false;
+			if (theFile != NULL) {
+				fclose(theFile);
+				theFile = NULL;
+			}
+			return false;
+		}
+
+		int theLevel = theConfig.ConsoleLevel;
+
+		if ((theFile != NULL) && (theConfig.FileLevel < theLevel)) {
+			theLevel = theConfig.FileLevel;
+		}
+
+		theThreshold = theLevel;
+
+		return true;
+	}
+
+	void stop() {
+
+		if (!theRunning) {
+			return;
+		}
+
+		theThreshold = LEVEL_OFF;
+		theRunning = false;
+		pthread_join(theThread, NULL);
+
+		if (theFile != NULL) {
+			fclose(theFile);
+			theFile = NULL;
+		}
+
+	}
+
+}
@@ -0,0 +1,142 @@
+/*
+ * Log.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Registro de mensajes asíncrono, para sacar printf y cout del bucle de control.
+ *
+ *  	Arg: argumento de un mensaje (entero, real o texto) guardado sin formatear
+ *  	Config: niveles de consola y fichero y rotación del fichero
+ *  	write, debug, info, warn, error: añaden un mensaje al anillo del hilo llamante
+ *
+ *  Cada hilo escribe registros binarios de 64 bytes (instante, formato, nivel y hasta
+ *  LOG_MAX_ARGS argumentos) en su propio anillo, sin cerrojos ni reservas de memoria: solo
+ *  él escribe y solo el hilo del registro lee. Ese hilo despierta cada LOG_FLUSH_MS, da
+ *  formato a los mensajes de todos los anillos por orden de instante, los escribe en la
+ *  consola y en el fichero según el nivel de cada uno y rota el fichero cuando crece.
+ *
+ *  Con el anillo lleno el mensaje se descarta (se cuenta y se avisa): quien registra nunca
+ *  espera. El anillo de un hilo que termina lo reutiliza otro hilo una vez leído. El
+ *  formato debe ser una cadena constante (se guarda el puntero); los textos se copian,
+ *  hasta LOG_MAX_STRING - 1 caracteres. No se admiten '*' en anchura o precisión.
+ *
+ */
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <stdint.h>
+
+#define LOG_RING_SLOTS	4096		// registros de 64 bytes por hilo (potencia de dos)
+#define LOG_MAX_THREADS	32			// hilos con anillo a la vez (se reutilizan los de hilos terminados)
+#define LOG_MAX_ARGS	5
+#define LOG_MAX_STRING	64
+#define LOG_FLUSH_MS	20
+
+namespace Log {
+
+	enum Level {
+		LEVEL_DEBUG = 0,
+		LEVEL_INFO = 1,
+		LEVEL_WARN = 2,
+		LEVEL_ERROR = 3,
+		LEVEL_OFF = 4
+	};
+
+	enum ArgType {
+		ARG_NONE = 0,
+		ARG_INT = 1,
+		ARG_UINT = 2,
+		ARG_DOUBLE = 3,
+		ARG_STRING = 4
+	};
+
+	// Conversión implícita desde los tipos habituales: Log::debug("pan %d", thePan)
+
+	struct Arg {
+
+		ArgType Type;
+
+		union {
+			int64_t Int;
+			uint64_t UInt;
+			double Double;
+			const char* String;
+		};
+
+		Arg() { this->Type = ARG_NONE; this->Int = 0; }
+		Arg(int inValue) { this->Type = ARG_INT; this->Int = inValue; }
+		Arg(long inValue) { this->Type = ARG_INT; this->Int = inValue; }
+		Arg(long long inValue) { this->Type = ARG_INT; this->Int = inValue; }
+		Arg(unsigned int inValue) { this->Type = ARG_UINT; this->UInt = inValue; }
+		Arg(unsigned long inValue) { this->Type = ARG_UINT; this->UInt = inValue; }
+		Arg(unsigned long long inValue) { this->Type = ARG_UINT; this->UInt = inValue; }
+		Arg(double inValue) { this->Type = ARG_DOUBLE; this->Double = inValue; }
+		Arg(const char* inValue) { this->Type = ARG_STRING; this->String = inValue; }
+
+	};
+
+	struct Config {
+
+		Level ConsoleLevel;		// salida estándar
+		Level FileLevel;		// sin efecto sin FilePath
+		const char* FilePath;	// NULL: sin fichero
+		long MaxFileBytes;		// al superarlo, FilePath pasa a FilePath.1, .1 a .2, ...
+		int MaxFiles;			// ficheros antiguos que se conservan
+
+		Config();
+	};
+
+	// Arranca el hilo del registro. Devuelve false si no se puede abrir el fichero.
+	// Antes de start() (y tras stop()) los mensajes se descartan.
+
+	bool start(const Config& inConfig);
+
+	// Escribe los mensajes pendientes y termina el hilo del registro
+
+	void stop();
+
+	// Nivel mínimo que llega a alguna salida
+
+	bool isEnabled(Level inLevel);
+
+	// Reserva el anillo del hilo llamante (si no, se reserva en su primer mensaje). Devuelve
+	// false si ya hay LOG_MAX_THREADS anillos y ninguno libre.
+
+	bool attachThread();
+
+	void write(Level inLevel, const char* inFormat, const Arg& inArg0 = Arg(), const Arg& inArg1 = Arg(),
+			const Arg& inArg2 = Arg(), const Arg& inArg3 = Arg(), const Arg& inArg4 = Arg());
+
+	static inline void debug(const char* inFormat, const Arg& inArg0 = Arg(), const Arg& inArg1 = Arg(),
+			const Arg& inArg2 = Arg(), const Arg& inArg3 = Arg(), const Arg& inArg4 = Arg()) {
+		write(LEVEL_DEBUG, inFormat, inArg0, inArg1, inArg2, inArg3, inArg4);
+	}
+
+	static inline void info(const char* inFormat, const Arg& inArg0 = Arg(), const Arg& inArg1 = Arg(),
+			const Arg& inArg2 = Arg(), const Arg& inArg3 = Arg(), const Arg& inArg4 = Arg()) {
+		write(LEVEL_INFO, inFormat, inArg0, inArg1, inArg2, inArg3, inArg4);
+	}
+
+	static inline void warn(const char* inFormat, const Arg& inArg0 = Arg(), const Arg& inArg1 = Arg(),
+			const Arg& inArg2 = Arg(), const Arg& inArg3 = Arg(), const Arg& inArg4 = Arg()) {
+		write(LEVEL_WARN, inFormat, inArg0, inArg1, inArg2, inArg3, inArg4);
+	}
+
+	static inline void error(const char* inFormat, const Arg& inArg0 = Arg(), const Arg& inArg1 = Arg(),
+			const Arg& inArg2 = Arg(), const Arg& inArg3 = Arg(), const Arg& inArg4 = Arg()) {
+		write(LEVEL_ERROR, inFormat, inArg0, inArg1, inArg2, inArg3, inArg4);
+	}
+
+	// Mensajes descartados por anillos llenos (o sin anillo libre) desde el arranque
+
+	unsigned long getDropped();
+
+	// "debug", "info", "warn" o "error". Devuelve false si inName no es ninguno.
+
+	bool parseLevel(const char* inName, Level* outLevel);
+
+}
+
+#endif /* LOG_H_ */
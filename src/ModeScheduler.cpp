@@ -0,0 +1,224 @@
+/*
+ * ModeScheduler.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	ModeScheduler: modo de adquisición (más cuadros/s) o de precisión (más resolución)
+ *  	               según si el objetivo está fijado
+ *
+ */
+
+#include "ModeScheduler.h"
+
+namespace Capture {
+
+	static const char* ModeKindNames[NUM_MODE_KINDS] = { "adquisicion", "precision" };
+
+	static int getPixels(const openni::VideoMode& inMode) {
+		return inMode.getResolutionX() * inMode.getResolutionY();
+	}
+
+	// Constructor
+
+	ModeScheduler::ModeScheduler() {
+
+		this->myValid = false;
+		this->myCurrent = MODE_ACQUIRE;
+		this->mySwitchNs = 0;
+		this->myNumSwitches = 0;
+		this->myStableFrames = 0;
+		this->myLostFrames = 0;
+		this->myHasLast = false;
+		this->myReason = "inicio";
+
+		for (int k = 0; k < NUM_MODE_KINDS; k++) {
+			this->myFrameNs[k] = 0;
+		}
+
+	}
+
+	bool ModeScheduler::configure(const openni::Array<openni::VideoMode>& inModes, openni::PixelFormat inPixelFormat) {
+
+		int theAcquire = -1;
+		int thePrecise = -1;
+
+		for (int m = 0; m < inModes.getSize(); m++) {
+
+			const openni::VideoMode& theMode = inModes[m];
+
+			if ((theMode.getPixelFormat() != inPixelFormat) || (theMode.getResolutionX() < MODE_MIN_WIDTH)) {
+				continue;
+			}
+
+			if ((theAcquire < 0) || (theMode.getFps() > inModes[theAcquire].getFps()) ||
+					((theMode.getFps() == inModes[theAcquire].getFps()) && (getPixels(theMode) < getPixels(inModes[theAcquire])))) {
+				theAcquire = m;
+			}
+
+			if ((thePrecise < 0) || (getPixels(theMode) > getPixels(inModes[thePrecise])) ||
+					((getPixels(theMode) == getPixels(inModes[thePrecise])) && (theMode.getFps() > inModes[thePrecise].getFps()))) {
+				thePrecise = m;
+			}
+		}
+
+		// Con un solo modo útil (o si el más rápido es también el de más resolución) no hay nada que alternar
+
+		this->myValid = (theAcquire >= 0) && (thePrecise >= 0) && (getPixels(inModes[theAcquire]) != getPixels(inModes[thePrecise]));
+
+		if (this->myValid) {
+			this->myModes[MODE_ACQUIRE] = inModes[theAcquire];
+			this->myModes[MODE_PRECISE] = inModes[thePrecise];
+		}
+
+		this->myCurrent = MODE_ACQUIRE;
+		this->myStableFrames = 0;
+		this->myLostFrames = 0;
+		this->myHasLast = false;
+
+		return this->myValid;
+	}
+
+	bool ModeScheduler::isValid() {
+		return this->myValid;
+	}
+
+	const openni::VideoMode& ModeScheduler::getMode(ModeKind inKind) {
+		return this->myModes[inKind];
+	}
+
+	ModeKind ModeScheduler::getCurrent() {
+		return this->myCurrent;
+	}
+
+	// Modo al que corresponde un cuadro (tras un cambio aún pueden llegar cuadros del anterior)
+
+	int ModeScheduler::getKindOf(int inWidth, int inHeight) {
+
+		for (int k = 0; k < NUM_MODE_KINDS; k++) {
+			if ((this->myModes[k].getResolutionX() == inWidth) && (this->myModes[k].getResolutionY() == inHeight)) {
+				return k;
+			}
+		}
+
+		return -1;
+	}
+
+	bool ModeScheduler::update(int inWidth, int inHeight, bool inFound, const float inPoint[3], int64_t inProcessNs, int64_t inNowNs) {
+
+		if (!this->myValid) {
+			return false;
+		}
+
+		int theKind = this->getKindOf(inWidth, inHeight);
+
+		if (theKind >= 0) {
+			double* theFrameNs = &this->myFrameNs[theKind];
+			*theFrameNs = (*theFrameNs == 0) ? (double)inProcessNs : *theFrameNs + MODE_TIME_SMOOTHING * (inProcessNs - *theFrameNs);
+		}
+
+		// Los cuadros del modo anterior no cuentan para decidir
+
+		if (theKind != (int)this->myCurrent) {
+			return false;
+		}
+
+		// Estabilidad del objetivo: un salto se trata como un objetivo nuevo
+
+		bool theJump = false;
+
+		if (inFound && this->myHasLast) {
+			float theDx = inPoint[0] - this->myLast[0];
+			float theDy = inPoint[1] - this->myLast[1];
+			float theDz = inPoint[2] - this->myLast[2];
+			theJump = (theDx * theDx + theDy * theDy + theDz * theDz > MODE_LOCK_JUMP_MM * MODE_LOCK_JUMP_MM);
+		}
+
+		if (inFound) {
+			this->myLast[0] = inPoint[0];
+			this->myLast[1] = inPoint[1];
+			this->myLast[2] = inPoint[2];
+			this->myHasLast = true;
+		}
+
+		if (inFound && !theJump) {
+			this->myStableFrames++;
+			this->myLostFrames = 0;
+		} else {
+			this->myStableFrames = 0;
+			this->myLostFrames++;
+		}
+
+		if (inNowNs - this->mySwitchNs < MODE_MIN_DWELL_MS * 1000000LL) {
+			return false;
+		}
+
+		ModeKind theWanted = this->myCurrent;
+
+		if ((this->myCurrent == MODE_ACQUIRE) && (this->myStableFrames >= MODE_LOCK_FRAMES)) {
+			theWanted = MODE_PRECISE;
+			this->myReason = "objetivo fijado";
+		} else if ((this->myCurrent == MODE_PRECISE) && (this->myLostFrames >= MODE_LOST_FRAMES)) {
+			theWanted = MODE_ACQUIRE;
+			this->myReason = "objetivo perdido";
+		}
+
+		if (theWanted == this->myCurrent) {
+			return false;
+		}
+
+		// En el modo nuevo se empieza a contar de nuevo
+
+		this->myCurrent = theWanted;
+		this->mySwitchNs = inNowNs;
+		this->myNumSwitches++;
+		this->myStableFrames = 0;
+		this->myLostFrames = 0;
+
+		return true;
+	}
+
+	void ModeScheduler::rejectSwitch(ModeKind inPrevious) {
+
+		if (inPrevious == this->myCurrent) {
+			this->myValid = false;
+			return;
+		}
+
+		// mySwitchNs se mantiene: el reintento espera como un cambio más
+
+		this->myCurrent = inPrevious;
+		this->myNumSwitches--;
+		this->myStableFrames = 0;
+		this->myLostFrames = 0;
+		this->myReason = "cambio rechazado";
+	}
+
+	double ModeScheduler::getFrameNs(ModeKind inKind) {
+
+		if (this->myFrameNs[inKind] > 0) {
+			return this->myFrameNs[inKind];
+		}
+
+		// Sin medidas de este modo: proporcional a los pixeles del otro
+
+		ModeKind theOther = (inKind == MODE_ACQUIRE) ? MODE_PRECISE : MODE_ACQUIRE;
+
+		return this->myFrameNs[theOther] * getPixels(this->myModes[inKind]) / getPixels(this->myModes[theOther]);
+	}
+
+	const char* ModeScheduler::getReason() {
+		return this->myReason;
+	}
+
+	unsigned long ModeScheduler::getNumSwitches() {
+		return this->myNumSwitches;
+	}
+
+	const char* ModeScheduler::getKindName(ModeKind inKind) {
+		return ModeKindNames[inKind];
+	}
+
+}
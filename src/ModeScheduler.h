@@ -0,0 +1,126 @@
+/*
+ * ModeScheduler.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Elección del modo de vídeo del sensor según el estado del seguimiento.
+ *
+ *  Entre los modos que anuncia el sensor (SensorInfo::getSupportedVideoModes) con el
+ *  formato de profundidad en uso se eligen dos:
+ *
+ *  	adquisición: el de más cuadros/s (de al menos QVGA), el más pequeño si hay varios.
+ *  	             Sin objetivo, o recién perdido, interesa reaccionar antes.
+ *  	precisión:   el de mayor resolución, el de más cuadros/s si hay varios. Con el
+ *  	             objetivo fijado, interesa situarlo con más detalle.
+ *
+ *  El objetivo se considera fijado tras MODE_LOCK_FRAMES cuadros seguidos con el punto
+ *  encontrado y sin saltos de más de MODE_LOCK_JUMP_MM, y perdido tras MODE_LOST_FRAMES
+ *  cuadros sin punto o con un salto. Cambiar de modo reinicia el stream, así que se
+ *  permanece al menos MODE_MIN_DWELL_MS en cada uno.
+ *
+ *  Se mide el tiempo de procesado por cuadro de cada modo (media móvil), para informar de
+ *  lo que ahorra o cuesta cada cambio; de un modo aún no medido se estima por número de
+ *  pixeles.
+ *
+ */
+
+#ifndef MODESCHEDULER_H_
+#define MODESCHEDULER_H_
+
+#include <stdint.h>
+#include <OpenNI.h>
+
+#define MODE_LOCK_FRAMES	10
+#define MODE_LOCK_JUMP_MM	150.0f
+#define MODE_LOST_FRAMES	5
+#define MODE_MIN_DWELL_MS	1000
+#define MODE_MIN_WIDTH		320
+#define MODE_TIME_SMOOTHING	0.1
+
+namespace Capture {
+
+	enum ModeKind {
+		MODE_ACQUIRE = 0,
+		MODE_PRECISE = 1,
+		NUM_MODE_KINDS = 2
+	};
+
+	class ModeScheduler {
+
+	private:
+
+		// Miembros privados
+
+		openni::VideoMode myModes[NUM_MODE_KINDS];
+		bool myValid;
+
+		ModeKind myCurrent;
+		int64_t mySwitchNs;
+		unsigned long myNumSwitches;
+
+		// Seguimiento: cuadros seguidos estables y sin objetivo, y último punto (mm)
+
+		int myStableFrames;
+		int myLostFrames;
+		float myLast[3];
+		bool myHasLast;
+
+		// Tiempo de procesado por cuadro de cada modo (ns, media móvil; 0: sin medir)
+
+		double myFrameNs[NUM_MODE_KINDS];
+
+		// Motivo del último cambio
+
+		const char* myReason;
+
+		int getKindOf(int inWidth, int inHeight);
+
+	public:
+
+		// Miembros públicos
+
+		ModeScheduler();
+
+		// Elige los modos entre inModes con el formato inPixelFormat. Devuelve false si no
+		// hay dos modos distintos entre los que alternar.
+
+		bool configure(const openni::Array<openni::VideoMode>& inModes, openni::PixelFormat inPixelFormat);
+
+		bool isValid();
+
+		const openni::VideoMode& getMode(ModeKind inKind);
+
+		// Modo que debe tener el sensor. Al empezar, el de adquisición.
+
+		ModeKind getCurrent();
+
+		// Un cuadro procesado de inWidth x inHeight: si se ha encontrado el punto, dónde
+		// (mm, coordenadas de la cámara) y cuánto ha tardado el procesado. Devuelve true si hay
+		// que cambiar de modo: getCurrent() ya es el nuevo.
+
+		bool update(int inWidth, int inHeight, bool inFound, const float inPoint[3], int64_t inProcessNs, int64_t inNowNs);
+
+		// El sensor no ha aceptado el modo de getCurrent(): se vuelve a inPrevious, el que
+		// sigue teniendo, y no se reintenta hasta pasado el tiempo mínimo en un modo. Si ya
+		// era inPrevious (el modo inicial), se deja de alternar.
+
+		void rejectSwitch(ModeKind inPrevious);
+
+		// Tiempo de procesado por cuadro del modo (medido o estimado; 0 si no hay ninguna medida)
+
+		double getFrameNs(ModeKind inKind);
+
+		// Motivo del último cambio ("objetivo fijado", "objetivo perdido")
+
+		const char* getReason();
+
+		unsigned long getNumSwitches();
+
+		static const char* getKindName(ModeKind inKind);
+
+	};
+
+}
+
+#endif /* MODESCHEDULER_H_ */
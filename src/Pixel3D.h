@@ -0,0 +1,30 @@
+/*
+ * Pixel3D.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Pixel de un cuadro de profundidad: posición (X,Y) en el cuadro y profundidad Z
+ *
+ */
+
+#ifndef PIXEL3D_H_
+#define PIXEL3D_H_
+
+#include <cstdio>
+
+class Pixel3D {
+
+public:
+
+  int X;
+  int Y;
+  unsigned short int Z;
+
+  void print() {
+	  printf("Pixel3D (%d,%d,%d)\n",X,Y,Z);
+  }
+
+};
+
+#endif /* PIXEL3D_H_ */
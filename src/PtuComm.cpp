@@ -0,0 +1,596 @@
+/*
+ * PtuComm.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Funciones:
+ *
+ *  	getPosCommand, processPtuComm, movePtu, ceroPtu: comunicación con la PTU-46
+ *  	queuePtuCommand, waitPtuCommands, sendPtuCommand: órdenes encadenadas, con
+ *  	respuestas asociadas por orden de envío y espera por eventos
+ *  	negotiatePtuBaud, benchPtuLink: velocidad del enlace serie
+ *
+ */
+
+#include "PtuComm.h"
+#include "SerialLoop.h"
+#include "Recorder.h"
+#include "Log.h"
+#include "ros/ros.h"
+
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+// Velocidades de la PTU-46, de mayor a menor
+
+static const int PtuBaudRates[] = { 38400, 19200, 9600, 0 };
+
+// Constructor
+
+PtuLink::PtuLink() {
+
+	this->Port = NULL;
+	this->Status = IDLE;
+	memset(&this->JointState, 0, sizeof(this->JointState));
+	this->Timeouts = 0;
+	this->BytesOut = 0;
+	this->BytesIn = 0;
+	this->LastCommandOk = false;
+	this->NumFailed = 0;
+	this->Loop = NULL;
+	this->LoopPort = NULL;
+	this->InFlightHead = 0;
+	this->NumInFlight = 0;
+	this->Recorder = NULL;
+
+}
+
+static void pushCommand(PtuLink* ioLink, const char* inCommand, estado inState, int64_t inSendNs, int64_t inFrameNs, int inTimeoutMs) {
+
+	InFlightCommand* theCommand = &ioLink->InFlight[(ioLink->InFlightHead + ioLink->NumInFlight) % PTU_MAX_IN_FLIGHT];
+	theCommand->myState = inState;
+	theCommand->mySendNs = inSendNs;
+	theCommand->myFrameNs = inFrameNs;
+	theCommand->myDeadlineNs = inSendNs + (int64_t)inTimeoutMs * 1000000;
+	theCommand->myTimeoutMs = inTimeoutMs;
+	ioLink->NumInFlight++;
+
+	if (inFrameNs != 0) {
+		ioLink->Latency.Send.record(inSendNs - inFrameNs);
+	}
+
+	ioLink->Status = ioLink->InFlight[ioLink->InFlightHead].myState;
+
+	if (ioLink->Recorder != NULL) {
+		ioLink->Recorder->recordCommand(inCommand, inFrameNs, inSendNs);
+	}
+
+}
+
+// Saca la orden más antigua de la cola
+
+static InFlightCommand* popCommand(PtuLink* ioLink, int64_t inNowNs) {
+
+	InFlightCommand* theCommand = &ioLink->InFlight[ioLink->InFlightHead];
+	ioLink->InFlightHead = (ioLink->InFlightHead + 1) % PTU_MAX_IN_FLIGHT;
+	ioLink->NumInFlight--;
+
+	// La siguiente no empieza a ejecutarse hasta ahora (por ejemplo, detrás de un "A "):
+	// su plazo cuenta como mínimo desde este momento
+
+	if (ioLink->NumInFlight > 0) {
+		InFlightCommand* theNext = &ioLink->InFlight[ioLink->InFlightHead];
+		int64_t theDeadline = inNowNs + (int64_t)theNext->myTimeoutMs * 1000000;
+		if (theDeadline > theNext->myDeadlineNs) {
+			theNext->myDeadlineNs = theDeadline;
+		}
+		ioLink->Status = theNext->myState;
+	} else {
+		ioLink->Status = IDLE;
+	}
+
+	return theCommand;
+}
+
+// Resultado de la orden más antigua. Solo las confirmaciones ('*') se miden. Una orden
+// abandonada (sin inConfirmed ni respuesta) se queda en la cola esperando su respuesta tardía.
+
+static void completeCommand(PtuLink* ioLink, int64_t inNowNs, bool inConfirmed, bool inAbandoned = false) {
+
+	ioLink->LastCommandOk = inConfirmed;
+	if (!inConfirmed) {
+		ioLink->NumFailed++;
+	}
+
+	if (ioLink->NumInFlight == 0) {
+		ioLink->Status = IDLE;
+		if (ioLink->Recorder != NULL) {
+			ioLink->Recorder->recordReply(inConfirmed, 0, inNowNs);
+		}
+		return;
+	}
+
+	InFlightCommand* theCommand = &ioLink->InFlight[ioLink->InFlightHead];
+
+	if (inConfirmed && (theCommand->myFrameNs != 0)) {
+		ioLink->Latency.Ack.record(inNowNs - theCommand->mySendNs);
+		ioLink->Latency.Total.record(inNowNs - theCommand->myFrameNs);
+	}
+
+	if (ioLink->Recorder != NULL) {
+		ioLink->Recorder->recordReply(inConfirmed, theCommand->mySendNs, inNowNs);
+	}
+
+	if (inAbandoned) {
+		theCommand->myState = WAIT_DISCARD;
+		theCommand->myFrameNs = 0;
+		theCommand->myDeadlineNs = inNowNs + (int64_t)PTU_LATE_REPLY_MS * 1000000;
+		ioLink->Status = WAIT_DISCARD;
+		return;
+	}
+
+	popCommand(ioLink, inNowNs);
+
+}
+
+bool getPosCommand(float inDeg, int inTargetJoint, int inMode, char* outCommand) {
+
+	int thePosVal;
+	char theParam = 'P';
+	char theMode = ABSOLUTE;
+	bool ok = true;
+
+	switch(inTargetJoint) {
+		case PAN:
+			thePosVal = (int) (inDeg * 3600 / PAN_RESOLUTION);
+			theParam = 'P';
+			break;
+		case TILT:
+			thePosVal = (int) (inDeg * 3600 / TILT_RESOLUTION);
+			theParam = 'T';
+			break;
+		default: 	// inesperado
+			ok = false;
+	}
+
+	switch (inMode) {
+		case ABSOLUTE:	// PP o TP
+			theMode = 'P';
+			break;
+		case RELATIVE:	// PO o TO
+			theMode = 'O';
+			break;
+		default: 	// inesperado
+			ok = false;
+	}
+
+	if (ok) {
+		sprintf(outCommand,"%c%c%d ",theParam,theMode,thePosVal);
+	}
+
+	Log::debug("Orden a la PTU-46: %s", outCommand);
+
+	return ok;
+
+}
+
+// Procesa una respuesta de la PTU
+
+static void handlePtuEvent(PtuLink* ioLink, const PtuEvent& inEvent) {
+
+	int64_t theNow = Timing::nowNs();
+
+	// Respuesta tardía de una orden ya abandonada
+
+	if (ioLink->Status == WAIT_DISCARD) {
+		popCommand(ioLink, theNow);
+		Log::debug("PTU-46: descartada la respuesta tardía de una orden abandonada");
+		return;
+	}
+
+	// Un signo de exclamación indica que se ha producido un error
+
+	if (inEvent.Type == PTU_EVENT_ERROR) {
+		completeCommand(ioLink, theNow, false);
+		Log::warn("PTU-46 ha devuelto un error: %s", inEvent.Text);
+		return;
+	}
+
+	switch (ioLink->Status) {
+
+		case IDLE:
+
+			// Recepción inesperada
+
+			if (inEvent.Type == PTU_EVENT_POSITION) {
+				ROS_ERROR("PTU-46 ha enviado un dato inesperado: * %d", inEvent.Value);
+			} else {
+				ROS_ERROR("PTU-46 ha enviado una confirmación inesperada");
+			}
+
+			break;
+
+		case WAIT_COMMAND_CONF:
+
+			completeCommand(ioLink, theNow, true);
+
+			Log::debug("PTU-46 ha confirmado la última orden");
+
+			break;
+
+		case WAIT_POS_PAN:
+		case WAIT_POS_TILT:
+
+			// Leemos el dato devuelto
+
+			if (inEvent.Type == PTU_EVENT_POSITION) {
+				int theJoint = (ioLink->Status == WAIT_POS_PAN) ? PAN : TILT;
+				ioLink->JointState.Position[theJoint] = (float)inEvent.Value * ((theJoint == PAN) ? PAN_RESOLUTION : TILT_RESOLUTION) / 3600;
+				ioLink->JointState.StampNs[theJoint] = theNow;
+				ioLink->JointState.NumUpdates[theJoint]++;
+
+				if (ioLink->Recorder != NULL) {
+					ioLink->Recorder->recordJoint(theJoint, ioLink->JointState.Position[theJoint], theNow);
+				}
+			}
+
+			completeCommand(ioLink, theNow, true);
+
+			break;
+
+		default:
+
+			ioLink->Status = IDLE;
+			break;
+
+	}
+
+}
+
+void processPtuComm(PtuLink* ioLink, bool inPartial) {
+
+	ioLink->Port->checkDataAndEnqueue();
+
+	Serial::Queue* theQueue = ioLink->Port->getQueue();
+	int64_t theNow = Timing::nowNs();
+
+	// Si ha vencido el plazo de la orden más antigua se procesa también una respuesta incompleta
+
+	bool theExpired = (ioLink->NumInFlight > 0) && (theNow >= ioLink->InFlight[ioLink->InFlightHead].myDeadlineNs);
+
+	// Los bytes se interpretan directamente en la cola, sin copiarlos
+
+	Serial::QueueView theView;
+	PtuEvent theEvent;
+
+	theQueue->getContent(&theView);
+
+	for (int i = 0; i < theView.Length1; i++) {
+		if (ioLink->Parser.feed(theView.Data1[i], &theEvent)) {
+			handlePtuEvent(ioLink, theEvent);
+		}
+	}
+
+	for (int i = 0; i < theView.Length2; i++) {
+		if (ioLink->Parser.feed(theView.Data2[i], &theEvent)) {
+			handlePtuEvent(ioLink, theEvent);
+		}
+	}
+
+	theQueue->consume(theView.Length1 + theView.Length2);
+	ioLink->BytesIn += theView.Length1 + theView.Length2;
+
+	if ((inPartial || theExpired) && ioLink->Parser.flush(&theEvent)) {
+		handlePtuEvent(ioLink, theEvent);
+	}
+
+	// Órdenes sin respuesta en su plazo: se abandonan, pero siguen ocupando su sitio en la
+	// cola para que la respuesta, si llega más tarde, no se atribuya a la siguiente. Si
+	// tampoco llega en PTU_LATE_REPLY_MS, la PTU no la ha recibido o la ha perdido.
+
+	while ((ioLink->NumInFlight > 0) && (theNow >= ioLink->InFlight[ioLink->InFlightHead].myDeadlineNs)) {
+		InFlightCommand* theCommand = &ioLink->InFlight[ioLink->InFlightHead];
+		if (theCommand->myState == WAIT_DISCARD) {
+			popCommand(ioLink, theNow);
+		} else {
+			ioLink->Timeouts++;
+			Log::warn("PTU-46 no ha respondido en %d ms", theCommand->myTimeoutMs);
+			completeCommand(ioLink, theNow, false, true);
+		}
+	}
+
+	ioLink->Status = (ioLink->NumInFlight > 0) ? ioLink->InFlight[ioLink->InFlightHead].myState : IDLE;
+
+}
+
+bool queuePtuCommand(PtuLink* ioLink, const char* inCommand, int inTimeoutMs, int64_t inFrameNs) {
+
+	// Con el máximo de órdenes en curso se espera a que responda la más antigua
+
+	if (ioLink->NumInFlight == PTU_MAX_IN_FLIGHT) {
+		waitPtuCommands(ioLink, PTU_MAX_IN_FLIGHT - 1);
+	}
+
+	int theBytesSent = ioLink->Port->send(inCommand);
+
+	if (theBytesSent <= 0) {
+		return false;
+	}
+
+	ioLink->BytesOut += theBytesSent;
+
+	pushCommand(ioLink, inCommand, WAIT_COMMAND_CONF, Timing::nowNs(), inFrameNs, inTimeoutMs);
+
+	return true;
+}
+
+bool queuePtuQuery(PtuLink* ioLink, int inJoint) {
+
+	if (ioLink->NumInFlight == PTU_MAX_IN_FLIGHT) {
+		waitPtuCommands(ioLink, PTU_MAX_IN_FLIGHT - 1);
+	}
+
+	const char* theQuery = (inJoint == PAN) ? "PP " : "TP ";
+	int theBytesSent = ioLink->Port->send(theQuery);
+
+	if (theBytesSent <= 0) {
+		return false;
+	}
+
+	ioLink->BytesOut += theBytesSent;
+
+	pushCommand(ioLink, theQuery, (inJoint == PAN) ? WAIT_POS_PAN : WAIT_POS_TILT, Timing::nowNs(), 0, PTU_COMMAND_TIMEOUT_MS);
+
+	return true;
+}
+
+int waitPtuCommands(PtuLink* ioLink, int inMaxInFlight) {
+
+	if (ioLink->LoopPort != ioLink->Port) {
+		delete ioLink->Loop;
+		ioLink->Loop = new Serial::EventLoop();
+		if (!ioLink->Loop->add(ioLink->Port)) {
+			ROS_ERROR("No se pueden esperar eventos del puerto de la PTU-46");
+		}
+		ioLink->LoopPort = ioLink->Port;
+	}
+
+	unsigned long theFailed = ioLink->NumFailed;
+
+	for (;;) {
+
+		processPtuComm(ioLink);
+
+		if (ioLink->NumInFlight <= inMaxInFlight) {
+			break;
+		}
+
+		// Se duerme hasta que llegan datos o vence el plazo de la orden más antigua.
+		// Una señal (EINTR) solo provoca una vuelta más.
+
+		if (ioLink->Loop->wait(ioLink->InFlight[ioLink->InFlightHead].myDeadlineNs) == Serial::LOOP_ERROR) {
+			usleep(1000);
+		}
+	}
+
+	return (int)(ioLink->NumFailed - theFailed);
+}
+
+int getPtuInFlight(PtuLink* inLink) {
+	return inLink->NumInFlight;
+}
+
+int64_t getPtuDeadlineNs(PtuLink* inLink) {
+	return (inLink->NumInFlight > 0) ? inLink->InFlight[inLink->InFlightHead].myDeadlineNs : 0;
+}
+
+void closePtu(PtuLink* ioLink) {
+
+	delete ioLink->Loop;
+	ioLink->Loop = NULL;
+	ioLink->LoopPort = NULL;
+
+	delete ioLink->Port;
+	ioLink->Port = NULL;
+	ioLink->Status = IDLE;
+
+	ioLink->InFlightHead = 0;
+	ioLink->NumInFlight = 0;
+
+	ioLink->Parser.reset();
+
+}
+
+bool sendPtuCommand(PtuLink* ioLink, const char* inCommand, int inTimeoutMs) {
+	return queuePtuCommand(ioLink, inCommand, inTimeoutMs) && (waitPtuCommands(ioLink, 0) == 0) && ioLink->LastCommandOk;
+}
+
+// Las órdenes de pan y tilt se envían seguidas y se espera a las dos confirmaciones
+
+void movePtu(PtuLink* ioLink, float inPanDeg, float inTiltDeg) {
+
+	char thePanCommand[16];
+	char theTiltCommand[16];
+	bool theBuildCommandOk = false;
+
+	theBuildCommandOk = getPosCommand(inPanDeg,PAN,RELATIVE,thePanCommand);
+
+
+	theBuildCommandOk = theBuildCommandOk && getPosCommand(inTiltDeg,TILT,RELATIVE,theTiltCommand);
+
+	if (theBuildCommandOk) {
+		queuePtuCommand(ioLink, thePanCommand, PTU_COMMAND_TIMEOUT_MS);
+		queuePtuCommand(ioLink, theTiltCommand, PTU_COMMAND_TIMEOUT_MS);
+		//ioLink->Port->send("A ");
+		waitPtuCommands(ioLink, 0);
+	} else {
+		// Error construyendo mensaje. no enviar nada
+		// ...
+	}
+
+}
+
+// Toda la secuencia se envía de una vez: la PTU ejecuta cada orden en cuanto termina
+// la anterior, así que solo se espera el tiempo real de los movimientos
+
+void ceroPtu(PtuLink* ioLink) {
+
+	queuePtuCommand(ioLink, "I ", PTU_COMMAND_TIMEOUT_MS);		// Modo inmediato
+	queuePtuCommand(ioLink, "FT ", PTU_COMMAND_TIMEOUT_MS);		// Respuestas escuetas
+	queuePtuCommand(ioLink, "PP0 ", PTU_COMMAND_TIMEOUT_MS);	// Posición PAN 0
+	queuePtuCommand(ioLink, "A ", PTU_AWAIT_TIMEOUT_MS);		// Espera alcanzar las posiciones indicadas
+	queuePtuCommand(ioLink, "TP-300 ", PTU_COMMAND_TIMEOUT_MS);	// Posición TILT max
+	queuePtuCommand(ioLink, "A ", PTU_AWAIT_TIMEOUT_MS);		// Espera alcanzar las posiciones indicadas
+	queuePtuCommand(ioLink, "TP600 ", PTU_COMMAND_TIMEOUT_MS);	// Posición TILT max (PTU_HOME_TILT_POS)
+	queuePtuCommand(ioLink, "A ", PTU_AWAIT_TIMEOUT_MS);		// Espera alcanzar las posiciones indicadas
+
+	if (waitPtuCommands(ioLink, 0) > 0) {
+		ROS_ERROR("PTU-46: la secuencia inicial no se ha completado");
+	}
+
+}
+
+// Comprueba el enlace leyendo la posición de pan inTries veces seguidas
+
+bool verifyPtuLink(PtuLink* ioLink, int inTries) {
+
+	for (int i = 0; i < inTries; i++) {
+
+		unsigned long theUpdates = ioLink->JointState.NumUpdates[PAN];
+
+		if (!queuePtuQuery(ioLink, PAN) || (waitPtuCommands(ioLink, 0) > 0) || (ioLink->JointState.NumUpdates[PAN] == theUpdates)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Cambia la velocidad de la PTU y la del puerto. La PTU confirma a la velocidad anterior.
+
+static bool switchPtuBaud(PtuLink* ioLink, int inBps) {
+
+	char theCommand[32];
+
+	snprintf(theCommand, sizeof(theCommand), PTU_BAUD_COMMAND, inBps);
+
+	if (!sendPtuCommand(ioLink, theCommand, PTU_COMMAND_TIMEOUT_MS)) {
+		return false;
+	}
+
+	usleep(PTU_BAUD_SWITCH_MS * 1000);
+
+	bool theOk = ioLink->Port->setBaudRate(Serial::Serial::getBaudConstant(inBps));
+	ioLink->Port->getQueue()->clear();
+	ioLink->Parser.reset();
+
+	return theOk;
+}
+
+int negotiatePtuBaud(PtuLink* ioLink, int inMaxBps) {
+
+	int theBps = Serial::Serial::getBps(ioLink->Port->getBaudRate());
+
+	if (!verifyPtuLink(ioLink, PTU_BAUD_VERIFY_TRIES)) {
+		ROS_ERROR("PTU-46 no responde a %d bps", theBps);
+		return 0;
+	}
+
+	for (int r = 0; PtuBaudRates[r] > theBps; r++) {
+
+		int theCandidate = PtuBaudRates[r];
+
+		if ((theCandidate > inMaxBps) || (Serial::Serial::getBaudConstant(theCandidate) == 0)) {
+			continue;
+		}
+
+		// Si la PTU rechaza la velocidad sigue en la actual
+
+		if (!switchPtuBaud(ioLink, theCandidate)) {
+			if (Serial::Serial::getBps(ioLink->Port->getBaudRate()) == theBps) {
+				continue;
+			}
+		} else if (verifyPtuLink(ioLink, PTU_BAUD_VERIFY_TRIES)) {
+			Log::info("Enlace con la PTU-46 a %d bps", theCandidate);
+			return theCandidate;
+		}
+
+		// No se sabe a qué velocidad ha quedado la PTU: se le pide volver a la de partida
+		// a la nueva velocidad, se vuelve también en el puerto y se prueba la siguiente
+
+		ROS_ERROR("PTU-46 no responde correctamente a %d bps; se vuelve a %d bps", theCandidate, theBps);
+
+		char theCommand[32];
+		snprintf(theCommand, sizeof(theCommand), PTU_BAUD_COMMAND, theBps);
+		sendPtuCommand(ioLink, theCommand, PTU_COMMAND_TIMEOUT_MS);
+		usleep(PTU_BAUD_SWITCH_MS * 1000);
+		ioLink->Port->setBaudRate(Serial::Serial::getBaudConstant(theBps));
+		ioLink->Port->getQueue()->clear();
+		ioLink->Parser.reset();
+
+		if (!verifyPtuLink(ioLink, PTU_BAUD_VERIFY_TRIES)) {
+			ROS_ERROR("PTU-46 no responde tras volver a %d bps", theBps);
+			return 0;
+		}
+	}
+
+	return theBps;
+}
+
+void benchPtuLink(PtuLink* ioLink, int inRounds, bool inPaced) {
+
+	Timing::LatencyHistogram theRoundTrip;
+	int theBps = Serial::Serial::getBps(ioLink->Port->getBaudRate());
+	int theFailed = 0;
+
+	// Ida y vuelta: una consulta de posición cada vez
+
+	for (int i = 0; i < inRounds; i++) {
+		int64_t theStart = Timing::nowNs();
+		if (queuePtuQuery(ioLink, PAN) && (waitPtuCommands(ioLink, 0) == 0)) {
+			theRoundTrip.record(Timing::nowNs() - theStart);
+		} else {
+			theFailed++;
+		}
+	}
+
+	// Rendimiento: consultas encadenadas manteniendo llena la cola de órdenes en curso
+
+	unsigned long theBytesIn = ioLink->BytesIn;
+	unsigned long theBytesOut = ioLink->BytesOut;
+	unsigned long theTimeouts = ioLink->Timeouts;
+	int64_t theStart = Timing::nowNs();
+
+	for (int i = 0; i < inRounds; i++) {
+		queuePtuQuery(ioLink, (i & 1) ? TILT : PAN);
+		waitPtuCommands(ioLink, PTU_MAX_IN_FLIGHT / 2);
+	}
+	theFailed += waitPtuCommands(ioLink, 0);
+
+	double theSeconds = (Timing::nowNs() - theStart) * 1e-9;
+	double theInRate = (ioLink->BytesIn - theBytesIn) / theSeconds;
+	double theOutRate = (ioLink->BytesOut - theBytesOut) / theSeconds;
+
+	printf("Enlace con la PTU-46 a %d bps (%d consultas, %d fallidas, %lu sin respuesta)\n", theBps, inRounds, theFailed, ioLink->Timeouts - theTimeouts);
+	Timing::LatencyHistogram::printHeader();
+	theRoundTrip.print("ida y vuelta");
+
+	// El puerto es full dúplex: cada sentido tiene bps / 10 bytes/s (8N1). Si se supera,
+	// el otro extremo no limita la velocidad (un pseudoterminal, como ptu_sim sin límite).
+
+	int theCapacity = theBps / 10;
+
+	bool thePaced = inPaced && (theOutRate <= theCapacity * 1.05) && (theInRate <= theCapacity * 1.05);
+
+	if (thePaced) {
+		printf("encadenadas: %.1f consultas/s, enviados %.0f bytes/s (%.0f%%), recibidos %.0f bytes/s (%.0f%%) de %d bytes/s por sentido\n",
+				inRounds / theSeconds, theOutRate, 100.0 * theOutRate / theCapacity, theInRate, 100.0 * theInRate / theCapacity, theCapacity);
+	} else {
+		printf("encadenadas: %.1f consultas/s, enviados %.0f bytes/s, recibidos %.0f bytes/s (sin límite de velocidad)\n",
+				inRounds / theSeconds, theOutRate, theInRate);
+	}
+
+}
@@ -0,0 +1,227 @@
+/*
+ * PtuComm.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Órdenes a la PTU-46 y procesado de sus respuestas.
+ *
+ *  Se usan desde ptu_xtion y desde el banco de pruebas (que conecta el puerto del enlace
+ *  a un pseudoterminal en lugar de al dispositivo serie).
+ *
+ *  Todo el estado de una PTU (puerto, órdenes en curso, respuesta a medias, posiciones,
+ *  latencias y contadores) está en un PtuLink, que se pasa a cada función. Varias PTU,
+ *  cada una con su enlace atendido por un solo hilo, no comparten nada ni necesitan
+ *  cerrojos.
+ *
+ */
+
+#ifndef PTUCOMM_H_
+#define PTUCOMM_H_
+
+#include <string>
+#include "Serial_Q.h"
+#include "PtuParser.h"
+#include "Latency.h"
+
+#define PAN_RESOLUTION 	185.1428
+#define TILT_RESOLUTION 185.1428
+
+#define PAN		0
+#define TILT 	1
+
+#define ABSOLUTE 0
+#define RELATIVE 1
+
+// Plazos de respuesta de la PTU: órdenes normales y espera de fin de movimiento ("A ")
+
+#define PTU_COMMAND_TIMEOUT_MS	500
+#define PTU_AWAIT_TIMEOUT_MS	10000
+
+// Tras abandonar una orden, tiempo que se espera aún su respuesta tardía para descartarla
+
+#define PTU_LATE_REPLY_MS	PTU_COMMAND_TIMEOUT_MS
+
+// Posición tras ceroPtu (en pasos de la PTU)
+
+#define PTU_HOME_PAN_POS	0
+#define PTU_HOME_TILT_POS	600
+
+// Límites aproximados de la PTU-46 en grados (las órdenes fuera de rango se responden con '!')
+
+#define PTU_PAN_MIN_DEG		-159.0f
+#define PTU_PAN_MAX_DEG		159.0f
+#define PTU_TILT_MIN_DEG	-47.0f
+#define PTU_TILT_MAX_DEG	31.0f
+
+// Velocidad del enlace: orden de la PTU-46 para cambiar la velocidad del puerto de host
+// (confirma a la velocidad anterior), pausa tras la confirmación y lecturas de comprobación
+
+#define PTU_DEFAULT_BPS		9600
+#define PTU_BAUD_COMMAND	"@(%d,0,T) "
+#define PTU_BAUD_SWITCH_MS	50
+#define PTU_BAUD_VERIFY_TRIES	3
+
+// Máximo de órdenes enviadas sin respuesta
+
+#define PTU_MAX_IN_FLIGHT	16
+
+enum estado {
+	IDLE = 0,
+	WAIT_COMMAND_CONF = 1,
+	WAIT_POS_PAN = 2,
+	WAIT_POS_TILT = 3,
+	WAIT_DISCARD = 4		// orden abandonada: su respuesta, si llega, se descarta
+};
+
+// Latencias de las órdenes originadas por un cuadro (queuePtuCommand con inFrameNs),
+// desde que Serial::send las escribe hasta que processPtuComm procesa su '*'
+
+struct PtuLatency {
+	Timing::LatencyHistogram Send;		// cuadro leído -> orden escrita
+	Timing::LatencyHistogram Ack;		// orden escrita -> '*' procesado
+	Timing::LatencyHistogram Total;		// cuadro leído -> '*' procesado
+};
+
+// Última posición leída de cada articulación (respuestas a queuePtuQuery), índice PAN o TILT
+
+struct PtuJointState {
+	float Position[2];			// grados
+	int64_t StampNs[2];			// Timing::nowNs al procesar la respuesta (0: nunca leída)
+	unsigned long NumUpdates[2];
+};
+
+namespace Serial {
+	class EventLoop;
+}
+
+namespace Record {
+	class Recorder;
+}
+
+// Orden enviada pendiente de respuesta
+
+struct InFlightCommand {
+	estado myState;			// respuesta esperada: confirmación o posición
+	int64_t mySendNs;
+	int64_t myFrameNs;		// cuadro que originó la orden (0: no se miden sus latencias)
+	int64_t myDeadlineNs;
+	int myTimeoutMs;
+};
+
+struct PtuLink {
+
+	Serial::Serial_Q* Port;
+
+	// Respuesta que se espera a la orden en curso más antigua (IDLE si no hay ninguna)
+
+	estado Status;
+
+	PtuLatency Latency;
+	PtuJointState JointState;
+
+	// Órdenes abandonadas por falta de respuesta y bytes enviados y recibidos
+
+	unsigned long Timeouts;
+	unsigned long BytesOut;
+	unsigned long BytesIn;
+
+	// Resultado de la última respuesta procesada ('*' o '!') y órdenes fallidas
+
+	bool LastCommandOk;
+	unsigned long NumFailed;
+
+	// Bucle de eventos del puerto (se crea al esperar la primera respuesta
+	// y se rehace si Port pasa a ser otro puerto)
+
+	Serial::EventLoop* Loop;
+	Serial::Serial_Q* LoopPort;
+
+	// Respuesta en curso (puede llegar repartida entre varias lecturas)
+
+	PtuParser Parser;
+
+	// Órdenes enviadas pendientes de respuesta, en orden de envío (cola circular).
+	// La PTU responde a las órdenes en el orden en que las recibe: cada '*' o '!'
+	// corresponde a la más antigua. Una orden abandonada sigue en la cola (WAIT_DISCARD)
+	// hasta que llega su respuesta o pasan PTU_LATE_REPLY_MS, para no atribuírsela a la siguiente.
+
+	InFlightCommand InFlight[PTU_MAX_IN_FLIGHT];
+	int InFlightHead;
+	int NumInFlight;
+
+	// Grabación de las órdenes, respuestas y posiciones (NULL: no se graban)
+
+	Record::Recorder* Recorder;
+
+	PtuLink();
+};
+
+// Construye en outCommand (al menos 16 bytes) la orden de posición de la articulación inTargetJoint
+
+bool getPosCommand(float inDeg, int inTargetJoint, int inMode, char* outCommand);
+
+// Lee los datos recibidos de la PTU, los interpreta byte a byte (PtuParser) y actualiza
+// el estado del enlace. Cada '*' o '!' responde a la orden en curso más antigua. Con inPartial (o si ha
+// vencido el plazo de la orden más antigua) se da por terminada la respuesta incompleta.
+// Las órdenes con el plazo vencido se abandonan (cuentan como fallidas) y su respuesta
+// tardía se descarta. No bloquea.
+
+void processPtuComm(PtuLink* ioLink, bool inPartial = false);
+
+// Envía una orden sin esperar respuesta. inTimeoutMs cuenta desde el envío o desde la
+// respuesta a la orden anterior, lo que ocurra más tarde. Con PTU_MAX_IN_FLIGHT órdenes
+// en curso, antes espera a que responda la más antigua. inFrameNs: momento (Timing::nowNs)
+// en que se leyó el cuadro que origina la orden, para medir sus latencias (0: no se miden).
+
+bool queuePtuCommand(PtuLink* ioLink, const char* inCommand, int inTimeoutMs, int64_t inFrameNs = 0);
+
+// Pide la posición actual de la articulación inJoint (PAN o TILT) sin esperar respuesta.
+// La respuesta actualiza JointState.
+
+bool queuePtuQuery(PtuLink* ioLink, int inJoint);
+
+// Espera (sin sondeos, con Serial::EventLoop) hasta que queden como mucho inMaxInFlight
+// órdenes en curso. Devuelve cuántas han fallado ('!' o sin respuesta) durante la espera.
+
+int waitPtuCommands(PtuLink* ioLink, int inMaxInFlight);
+
+int getPtuInFlight(PtuLink* inLink);
+
+// Plazo (Timing::nowNs) de la orden en curso más antigua, 0 si no hay ninguna. Para esperar
+// con un bucle de eventos propio y llamar a processPtuComm al vencer.
+
+int64_t getPtuDeadlineNs(PtuLink* inLink);
+
+// Envía una orden y espera su respuesta (y la de todas las anteriores en curso).
+// Devuelve true si todas se han confirmado ('*').
+
+bool sendPtuCommand(PtuLink* ioLink, const char* inCommand, int inTimeoutMs);
+
+// Cierra el puerto de la PTU y libera su bucle de eventos (Port pasa a ser NULL).
+// Los contadores y latencias del enlace se conservan.
+
+void closePtu(PtuLink* ioLink);
+
+// true si la PTU responde a inTries consultas de posición seguidas
+
+bool verifyPtuLink(PtuLink* ioLink, int inTries);
+
+// Sube la velocidad de la PTU y del puerto a la mayor (hasta inMaxBps) que se comprueba
+// correctamente. Si falla una velocidad se vuelve a la de partida. Devuelve la velocidad
+// final en bps, o 0 si la PTU no responde.
+
+int negotiatePtuBaud(PtuLink* ioLink, int inMaxBps);
+
+// Mide el enlace: inRounds consultas de ida y vuelta y otras tantas encadenadas. Con
+// inPaced los bytes de cada sentido se comparan con la velocidad del puerto; sin él (un
+// pseudoterminal, que no limita la velocidad), o si se supera esa velocidad, solo se dan
+// los bytes por segundo.
+
+void benchPtuLink(PtuLink* ioLink, int inRounds, bool inPaced = true);
+
+void movePtu(PtuLink* ioLink, float inPanDeg, float inTiltDeg);
+
+void ceroPtu(PtuLink* ioLink);
+
+#endif /* PTUCOMM_H_ */
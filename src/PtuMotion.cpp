@@ -0,0 +1,372 @@
+/*
+ * PtuMotion.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	MotionArbiter: movimientos de la PTU con objetivos absolutos, solo el más reciente
+ *  	TargetPredictor: predicción de la posición del objetivo (Kalman, velocidad constante)
+ *
+ */
+
+#include "PtuMotion.h"
+#include "PtuComm.h"
+
+#include "Latency.h"
+
+#include <cstdio>
+#include <cmath>
+
+#define DEG_TO_RAD (3.14159265359f / 180.0f)
+
+namespace Motion {
+
+	static float clampDeg(float inDeg, float inMin, float inMax) {
+		return (inDeg < inMin) ? inMin : ((inDeg > inMax) ? inMax : inDeg);
+	}
+
+	// Constructor
+
+	MotionArbiter::MotionArbiter(PtuLink* inLink) {
+
+		this->myLink = inLink;
+		this->myNumRequested = 0;
+		this->myNumSent = 0;
+		this->myNumReplaced = 0;
+		this->myNumPolls = 0;
+		this->myPollPeriodNs = 0;
+		this->myLastPollNs = 0;
+		this->myJointUpdates[PAN] = 0;
+		this->myJointUpdates[TILT] = 0;
+		this->setPosition(0.0f, 0.0f);
+
+	}
+
+	void MotionArbiter::setPosition(float inPanDeg, float inTiltDeg) {
+
+		this->myPanDeg = inPanDeg;
+		this->myTiltDeg = inTiltDeg;
+		this->myHasTarget = false;
+		this->mySendNs[PAN] = Timing::nowNs();
+		this->mySendNs[TILT] = this->mySendNs[PAN];
+
+		// La historia empieza de nuevo en la posición conocida
+
+		for (int j = 0; j < 2; j++) {
+			this->myPoseHead[j] = 0;
+			this->myNumPoses[j] = 0;
+			this->myJointUpdates[j] = this->myLink->JointState.NumUpdates[j];
+		}
+
+		this->addPose(PAN, this->mySendNs[PAN], inPanDeg);
+		this->addPose(TILT, this->mySendNs[TILT], inTiltDeg);
+
+	}
+
+	void MotionArbiter::addPose(int inJoint, int64_t inStampNs, float inDeg) {
+
+		if (this->myNumPoses[inJoint] == MOTION_POSE_HISTORY) {
+			this->myPoseHead[inJoint] = (this->myPoseHead[inJoint] + 1) % MOTION_POSE_HISTORY;
+			this->myNumPoses[inJoint]--;
+		}
+
+		Pose* thePose = &this->myPoses[inJoint][(this->myPoseHead[inJoint] + this->myNumPoses[inJoint]) % MOTION_POSE_HISTORY];
+		thePose->myStampNs = inStampNs;
+		thePose->myDeg = inDeg;
+		this->myNumPoses[inJoint]++;
+
+	}
+
+	// Las lecturas se piden solo sin órdenes en curso y se procesan antes de enviar otra:
+	// llegan ya en orden de tiempo respecto a las órdenes
+
+	void MotionArbiter::addJointReadings() {
+
+		const PtuJointState* theState = &this->myLink->JointState;
+
+		for (int j = 0; j < 2; j++) {
+			if (theState->NumUpdates[j] != this->myJointUpdates[j]) {
+				this->myJointUpdates[j] = theState->NumUpdates[j];
+				this->addPose(j, theState->StampNs[j], theState->Position[j]);
+			}
+		}
+
+	}
+
+	void MotionArbiter::getPoseAt(int64_t inStampNs, float* outPanDeg, float* outTiltDeg) {
+
+		float* theOut[2] = { outPanDeg, outTiltDeg };
+
+		this->addJointReadings();
+
+		for (int j = 0; j < 2; j++) {
+
+			int i = this->myNumPoses[j] - 1;
+
+			while ((i > 0) && (this->myPoses[j][(this->myPoseHead[j] + i) % MOTION_POSE_HISTORY].myStampNs > inStampNs)) {
+				i--;
+			}
+
+			*theOut[j] = this->myPoses[j][(this->myPoseHead[j] + i) % MOTION_POSE_HISTORY].myDeg;
+		}
+
+	}
+
+	float MotionArbiter::getPanDeg() {
+		return this->myPanDeg;
+	}
+
+	float MotionArbiter::getTiltDeg() {
+		return this->myTiltDeg;
+	}
+
+	float MotionArbiter::getBasePanDeg() {
+		return (this->myLink->JointState.StampNs[PAN] > this->mySendNs[PAN]) ? this->myLink->JointState.Position[PAN] : this->myPanDeg;
+	}
+
+	float MotionArbiter::getBaseTiltDeg() {
+		return (this->myLink->JointState.StampNs[TILT] > this->mySendNs[TILT]) ? this->myLink->JointState.Position[TILT] : this->myTiltDeg;
+	}
+
+	void MotionArbiter::setPollRate(float inHz) {
+		this->myPollPeriodNs = (inHz > 0) ? (int64_t)(1e9f / inHz) : 0;
+	}
+
+	int64_t MotionArbiter::getNextPollNs() {
+		return (this->myPollPeriodNs > 0) ? this->myLastPollNs + this->myPollPeriodNs : 0;
+	}
+
+	void MotionArbiter::moveRelative(float inPanDeg, float inTiltDeg, int64_t inFrameNs) {
+		this->moveAbsolute(this->getBasePanDeg() + inPanDeg, this->getBaseTiltDeg() + inTiltDeg, inFrameNs);
+	}
+
+	void MotionArbiter::moveAbsolute(float inPanDeg, float inTiltDeg, int64_t inFrameNs) {
+
+		this->myNumRequested++;
+
+		if (this->myHasTarget) {
+			this->myNumReplaced++;
+		}
+
+		this->myTargetPanDeg = clampDeg(inPanDeg, PTU_PAN_MIN_DEG, PTU_PAN_MAX_DEG);
+		this->myTargetTiltDeg = clampDeg(inTiltDeg, PTU_TILT_MIN_DEG, PTU_TILT_MAX_DEG);
+		this->myTargetFrameNs = inFrameNs;
+		this->myHasTarget = true;
+
+	}
+
+	bool MotionArbiter::hasPendingTarget() {
+		return this->myHasTarget;
+	}
+
+	bool MotionArbiter::service() {
+
+		if (getPtuInFlight(this->myLink) > 0) {
+			return false;
+		}
+
+		this->addJointReadings();
+
+		// Sin objetivo pendiente el puerto queda libre para leer las posiciones
+
+		if (!this->myHasTarget) {
+			if (this->myPollPeriodNs > 0) {
+				int64_t theNow = Timing::nowNs();
+				if (theNow - this->myLastPollNs >= this->myPollPeriodNs) {
+					this->myLastPollNs = theNow;
+					this->myNumPolls++;
+					queuePtuQuery(this->myLink, PAN);
+					queuePtuQuery(this->myLink, TILT);
+				}
+			}
+			return false;
+		}
+
+		this->myHasTarget = false;
+
+		char theCommand[16];
+		bool theSent = false;
+
+		// Solo se envían las articulaciones que cambian
+
+		if (fabs(this->myTargetPanDeg - this->myPanDeg) >= MOTION_MIN_STEP_DEG) {
+			if (getPosCommand(this->myTargetPanDeg, PAN, ABSOLUTE, theCommand) &&
+					queuePtuCommand(this->myLink, theCommand, PTU_COMMAND_TIMEOUT_MS, this->myTargetFrameNs)) {
+				this->myPanDeg = this->myTargetPanDeg;
+				this->mySendNs[PAN] = Timing::nowNs();
+				this->addPose(PAN, this->mySendNs[PAN], this->myPanDeg);
+				theSent = true;
+			}
+		}
+
+		if (fabs(this->myTargetTiltDeg - this->myTiltDeg) >= MOTION_MIN_STEP_DEG) {
+			if (getPosCommand(this->myTargetTiltDeg, TILT, ABSOLUTE, theCommand) &&
+					queuePtuCommand(this->myLink, theCommand, PTU_COMMAND_TIMEOUT_MS, this->myTargetFrameNs)) {
+				this->myTiltDeg = this->myTargetTiltDeg;
+				this->mySendNs[TILT] = Timing::nowNs();
+				this->addPose(TILT, this->mySendNs[TILT], this->myTiltDeg);
+				theSent = true;
+			}
+		}
+
+		if (theSent) {
+			this->myNumSent++;
+		}
+
+		return theSent;
+	}
+
+	void MotionArbiter::flush() {
+
+		waitPtuCommands(this->myLink, 0);
+
+		if (this->service()) {
+			waitPtuCommands(this->myLink, 0);
+		}
+
+	}
+
+	void MotionArbiter::printStats() {
+		printf("Movimientos: %lu pedidos, %lu enviados, %lu sustituidos por uno más reciente\n",
+				this->myNumRequested, this->myNumSent, this->myNumReplaced);
+		if (this->myNumPolls > 0) {
+			printf("Posición leída %lu veces: pan %.2f, tilt %.2f (ordenada %.2f, %.2f)\n", this->myNumPolls,
+					this->myLink->JointState.Position[PAN], this->myLink->JointState.Position[TILT], this->myPanDeg, this->myTiltDeg);
+		}
+	}
+
+	// Constructor
+
+	TargetPredictor::TargetPredictor() {
+		this->myNumResets = 0;
+		this->reset();
+	}
+
+	void TargetPredictor::reset() {
+		this->myValid = false;
+		this->myStampNs = 0;
+	}
+
+	void TargetPredictor::update(const float inPosition[3], int64_t inStampNs) {
+
+		const float theR = PREDICT_MEASURE_NOISE_MM * PREDICT_MEASURE_NOISE_MM;
+		const float theQ = PREDICT_ACCEL_NOISE_MM * PREDICT_ACCEL_NOISE_MM;
+
+		float thePredicted[3];
+
+		// Sin medidas recientes, o con un salto que no explica la velocidad, se trata como otro objetivo
+
+		if (this->myValid && ((inStampNs - this->myStampNs > PREDICT_RESET_NS) || (inStampNs < this->myStampNs))) {
+			this->reset();
+			this->myNumResets++;
+		}
+
+		if (this->myValid && this->predict(inStampNs, thePredicted)) {
+			float theDx = inPosition[0] - thePredicted[0];
+			float theDy = inPosition[1] - thePredicted[1];
+			float theDz = inPosition[2] - thePredicted[2];
+			if (theDx * theDx + theDy * theDy + theDz * theDz > PREDICT_RESET_JUMP_MM * PREDICT_RESET_JUMP_MM) {
+				this->reset();
+				this->myNumResets++;
+			}
+		}
+
+		if (!this->myValid) {
+			for (int a = 0; a < 3; a++) {
+				Axis* theAxis = &this->myAxes[a];
+				theAxis->myX = inPosition[a];
+				theAxis->myV = 0.0f;
+				theAxis->myP[0][0] = theR;
+				theAxis->myP[0][1] = theAxis->myP[1][0] = 0.0f;
+				theAxis->myP[1][1] = 1000.0f * 1000.0f;		// velocidad desconocida (del orden de 1 m/s)
+			}
+			this->myStampNs = inStampNs;
+			this->myValid = true;
+			return;
+		}
+
+		float theDt = (inStampNs - this->myStampNs) * 1e-9f;
+		float theDt2 = theDt * theDt;
+
+		for (int a = 0; a < 3; a++) {
+
+			Axis* theAxis = &this->myAxes[a];
+			float (*theP)[2] = theAxis->myP;
+
+			// Predicción: x += v dt, P = F P F' + Q
+
+			theAxis->myX += theAxis->myV * theDt;
+
+			float theP00 = theP[0][0] + theDt * (theP[1][0] + theP[0][1]) + theDt2 * theP[1][1] + theQ * theDt2 * theDt2 / 4;
+			float theP01 = theP[0][1] + theDt * theP[1][1] + theQ * theDt2 * theDt / 2;
+			float theP11 = theP[1][1] + theQ * theDt2;
+
+			// Corrección con la medida de posición
+
+			float theInnovation = inPosition[a] - theAxis->myX;
+			float theS = theP00 + theR;
+			float theK0 = theP00 / theS;
+			float theK1 = theP01 / theS;
+
+			theAxis->myX += theK0 * theInnovation;
+			theAxis->myV += theK1 * theInnovation;
+
+			theP[0][0] = (1 - theK0) * theP00;
+			theP[0][1] = theP[1][0] = (1 - theK0) * theP01;
+			theP[1][1] = theP11 - theK1 * theP01;
+		}
+
+		this->myStampNs = inStampNs;
+
+	}
+
+	bool TargetPredictor::predict(int64_t inStampNs, float outPosition[3]) {
+
+		if (!this->myValid) {
+			return false;
+		}
+
+		float theDt = (inStampNs - this->myStampNs) * 1e-9f;
+
+		for (int a = 0; a < 3; a++) {
+			outPosition[a] = this->myAxes[a].myX + this->myAxes[a].myV * theDt;
+		}
+
+		return true;
+	}
+
+	void TargetPredictor::getVelocity(float outVelocity[3]) {
+		for (int a = 0; a < 3; a++) {
+			outVelocity[a] = this->myValid ? this->myAxes[a].myV : 0.0f;
+		}
+	}
+
+	unsigned long TargetPredictor::getNumResets() {
+		return this->myNumResets;
+	}
+
+	// Primero el tilt (giro alrededor de X, positivo hacia arriba) y luego el pan
+	// (giro alrededor de Y, positivo hacia X), como en los ángulos de Vector
+
+	void cameraToBase(float inPanDeg, float inTiltDeg, const float inCamera[3], float outBase[3]) {
+
+		float theSinP = sin(inPanDeg * DEG_TO_RAD), theCosP = cos(inPanDeg * DEG_TO_RAD);
+		float theSinT = sin(inTiltDeg * DEG_TO_RAD), theCosT = cos(inTiltDeg * DEG_TO_RAD);
+
+		float theY = inCamera[1] * theCosT + inCamera[2] * theSinT;
+		float theZ = -inCamera[1] * theSinT + inCamera[2] * theCosT;
+
+		outBase[0] = inCamera[0] * theCosP + theZ * theSinP;
+		outBase[1] = theY;
+		outBase[2] = -inCamera[0] * theSinP + theZ * theCosP;
+
+	}
+
+	void baseToAngles(const float inBase[3], float* outPanDeg, float* outTiltDeg) {
+		*outPanDeg = atan2(inBase[0], inBase[2]) / DEG_TO_RAD;
+		*outTiltDeg = atan2(inBase[1], sqrt(inBase[0] * inBase[0] + inBase[2] * inBase[2])) / DEG_TO_RAD;
+	}
+
+}
@@ -0,0 +1,214 @@
+/*
+ * PtuMotion.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Arbitraje de los movimientos de la PTU: solo cuenta el objetivo más reciente.
+ *
+ *  	MotionArbiter: convierte cada movimiento relativo pedido en un objetivo absoluto
+ *  	               (PP/TP) a partir de la posición de la PTU y lo envía cuando la PTU
+ *  	               ha respondido a las órdenes anteriores. Cuando no hay nada que
+ *  	               enviar, lee la posición de las articulaciones a un ritmo limitado.
+ *  	TargetPredictor: filtro de Kalman de velocidad constante sobre la posición del
+ *  	                 objetivo en coordenadas de la base (fijas), para adelantar las
+ *  	                 órdenes la latencia medida del sistema
+ *
+ *  Los objetivos que llegan mientras hay órdenes en curso sustituyen al pendiente en lugar
+ *  de acumularse: con órdenes relativas (PO/TO) encoladas, la PTU ejecutaría todas las
+ *  correcciones, cada una calculada antes de que se aplicaran las anteriores, y se pasaría
+ *  del objetivo. Como mucho hay un par de órdenes pan/tilt en curso, así que los bytes por
+ *  segundo por el puerto serie están acotados por el tiempo de respuesta de la PTU.
+ *
+ */
+
+#ifndef PTUMOTION_H_
+#define PTUMOTION_H_
+
+#include <stdint.h>
+
+// Diferencia mínima (grados) para volver a enviar la posición de una articulación
+
+#define MOTION_MIN_STEP_DEG 0.1f
+
+// Cambios de posición que se recuerdan por articulación (órdenes y lecturas), para saber
+// dónde estaba la PTU al capturar un cuadro ya procesado
+
+#define MOTION_POSE_HISTORY	32
+
+// Predicción: ruido de aceleración del objetivo (mm/s²), ruido de medida (mm), tiempo sin
+// medidas y salto de posición (mm) a partir de los cuales se reinicia el filtro (otro objetivo)
+
+#define PREDICT_ACCEL_NOISE_MM	2000.0f
+#define PREDICT_MEASURE_NOISE_MM	20.0f
+#define PREDICT_RESET_NS		500000000LL
+#define PREDICT_RESET_JUMP_MM	300.0f
+
+struct PtuLink;
+
+namespace Motion {
+
+	class MotionArbiter {
+
+	private:
+
+		// Miembros privados
+
+		PtuLink* myLink;		// enlace por el que se envían las órdenes y se leen las posiciones
+
+		float myPanDeg;			// última posición ordenada
+		float myTiltDeg;
+
+		bool myHasTarget;		// objetivo pendiente de envío
+		float myTargetPanDeg;
+		float myTargetTiltDeg;
+		int64_t myTargetFrameNs;
+
+		int64_t mySendNs[2];		// envío de la última orden de cada articulación (PAN, TILT)
+
+		// Historia de posiciones de cada articulación (cola circular, en orden de tiempo):
+		// la ordenada desde su envío y la leída desde su lectura
+
+		struct Pose {
+			int64_t myStampNs;
+			float myDeg;
+		};
+
+		Pose myPoses[2][MOTION_POSE_HISTORY];
+		int myPoseHead[2];
+		int myNumPoses[2];
+		unsigned long myJointUpdates[2];		// lecturas del enlace ya pasadas a la historia
+
+		void addPose(int inJoint, int64_t inStampNs, float inDeg);
+		void addJointReadings();
+
+		int64_t myPollPeriodNs;		// 0: sin lectura de posiciones
+		int64_t myLastPollNs;
+
+		unsigned long myNumRequested;
+		unsigned long myNumSent;
+		unsigned long myNumReplaced;
+		unsigned long myNumPolls;
+
+	public:
+
+		// Miembros públicos
+
+		// Las órdenes van por inLink, que debe atender el mismo hilo que llama a service()
+
+		MotionArbiter(PtuLink* inLink);
+
+		// Posición conocida de la PTU (por ejemplo, tras ceroPtu). Descarta el objetivo pendiente.
+
+		void setPosition(float inPanDeg, float inTiltDeg);
+
+		// Última posición ordenada (la de destino si aún se está moviendo)
+
+		float getPanDeg();
+		float getTiltDeg();
+
+		// Posición de referencia para los movimientos relativos: la leída de la PTU si es
+		// posterior a la última orden a esa articulación (la cámara puede estar aún en
+		// camino) y si no, la ordenada
+
+		float getBasePanDeg();
+		float getBaseTiltDeg();
+
+		// Posición de la PTU en inStampNs según la historia: la última ordenada o leída antes
+		// de ese momento (la más antigua que se recuerda si es anterior a todas)
+
+		void getPoseAt(int64_t inStampNs, float* outPanDeg, float* outTiltDeg);
+
+		// Lecturas de posición (PP/TP) por segundo cuando no hay órdenes que enviar (0: ninguna)
+
+		void setPollRate(float inHz);
+
+		// Momento (Timing::nowNs) de la siguiente lectura de posiciones, 0 si no se leen
+
+		int64_t getNextPollNs();
+
+		// Nuevo objetivo, relativo a la posición de referencia o absoluto, limitado al rango
+		// de la PTU. Sustituye al pendiente si aún no se ha enviado. inFrameNs: momento en que
+		// se leyó el cuadro que lo origina (0 si no se miden latencias).
+
+		void moveRelative(float inPanDeg, float inTiltDeg, int64_t inFrameNs);
+		void moveAbsolute(float inPanDeg, float inTiltDeg, int64_t inFrameNs);
+
+		bool hasPendingTarget();
+
+		// Envía el objetivo pendiente si no quedan órdenes en curso o, si no hay objetivo,
+		// pide la posición de las articulaciones cuando toca. No bloquea.
+		// Devuelve true si ha enviado alguna orden de movimiento.
+
+		bool service();
+
+		// Envía el objetivo pendiente y espera a que la PTU responda
+
+		void flush();
+
+		void printStats();
+
+	};
+
+	//////////////////////////////////////////////////////////////////
+	// Predicción de la posición del objetivo						//
+	//																//
+	//  - Un filtro de Kalman de dos estados (posición, velocidad)	//
+	//    por eje, con aceleración como ruido blanco				//
+	//  - Coordenadas de la base en milímetros (cameraToBase)		//
+	//																//
+	//////////////////////////////////////////////////////////////////
+
+	class TargetPredictor {
+
+	private:
+
+		// Miembros privados
+
+		struct Axis {
+			float myX;			// posición (mm)
+			float myV;			// velocidad (mm/s)
+			float myP[2][2];	// covarianza
+		};
+
+		Axis myAxes[3];
+		int64_t myStampNs;
+		bool myValid;
+		unsigned long myNumResets;
+
+	public:
+
+		// Miembros públicos
+
+		TargetPredictor();
+
+		void reset();
+
+		// Nueva medida de la posición en inStampNs (Timing::nowNs)
+
+		void update(const float inPosition[3], int64_t inStampNs);
+
+		// Posición prevista en inStampNs. Devuelve false si aún no hay medidas.
+
+		bool predict(int64_t inStampNs, float outPosition[3]);
+
+		// Velocidad estimada (mm/s)
+
+		void getVelocity(float outVelocity[3]);
+
+		unsigned long getNumResets();
+
+	};
+
+	// Punto de la cámara (X derecha, Y arriba, Z al frente, mm) a coordenadas de la base
+	// con la PTU en inPanDeg, inTiltDeg
+
+	void cameraToBase(float inPanDeg, float inTiltDeg, const float inCamera[3], float outBase[3]);
+
+	// Ángulos absolutos de pan y tilt que apuntan la cámara a un punto de la base
+
+	void baseToAngles(const float inBase[3], float* outPanDeg, float* outTiltDeg);
+
+}
+
+#endif /* PTUMOTION_H_ */
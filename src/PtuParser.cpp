@@ -0,0 +1,171 @@
+/*
+ * PtuParser.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	PtuParser: respuestas de la PTU-46 byte a byte, sin reservas de memoria
+ *
+ */
+
+#include "PtuParser.h"
+
+#include <cstring>
+
+// Límite del valor absoluto del entero (las posiciones de la PTU-46 tienen 4 o 5 cifras)
+
+#define MAX_VALUE 100000000
+
+// Constructor
+
+PtuParser::PtuParser() {
+	this->myIgnoredBytes = 0;
+	this->reset();
+}
+
+void PtuParser::reset() {
+	this->myState = PARSE_IDLE;
+}
+
+void PtuParser::start(ParseState inState) {
+
+	this->myState = inState;
+	this->myHasValue = false;
+	this->myInNumber = false;
+	this->myNumberDone = false;
+	this->myNegative = false;
+	this->myMinus = false;
+	this->myValue = 0;
+	this->myTextLength = 0;
+
+}
+
+void PtuParser::finish(PtuEvent* outEvent) {
+
+	if (this->myState == PARSE_ERROR) {
+
+		// Sin espacios al final
+
+		while ((this->myTextLength > 0) && (this->myText[this->myTextLength - 1] == ' ')) {
+			this->myTextLength--;
+		}
+
+		outEvent->Type = PTU_EVENT_ERROR;
+		outEvent->Value = 0;
+		memcpy(outEvent->Text, this->myText, this->myTextLength);
+		outEvent->Text[this->myTextLength] = '\0';
+
+	} else if (this->myHasValue) {
+
+		outEvent->Type = PTU_EVENT_POSITION;
+		outEvent->Value = this->myNegative ? -this->myValue : this->myValue;
+		outEvent->Text[0] = '\0';
+
+	} else {
+
+		outEvent->Type = PTU_EVENT_ACK;
+		outEvent->Value = 0;
+		outEvent->Text[0] = '\0';
+	}
+
+	this->myState = PARSE_IDLE;
+
+}
+
+bool PtuParser::feed(unsigned char inByte, PtuEvent* outEvent) {
+
+	// Principio de respuesta: termina la que estuviera en curso
+
+	if ((inByte == '*') || (inByte == '!')) {
+
+		bool theFinished = (this->myState != PARSE_IDLE);
+
+		if (theFinished) {
+			this->finish(outEvent);
+		}
+
+		this->start((inByte == '*') ? PARSE_ACK : PARSE_ERROR);
+
+		return theFinished;
+	}
+
+	// Fin de línea
+
+	if ((inByte == '\r') || (inByte == '\n')) {
+
+		if (this->myState == PARSE_IDLE) {
+			return false;
+		}
+
+		this->finish(outEvent);
+		return true;
+	}
+
+	switch (this->myState) {
+
+		case PARSE_IDLE:
+
+			this->myIgnoredBytes++;
+			break;
+
+		case PARSE_ACK:
+
+			// Solo cuenta el primer entero de la respuesta
+
+			if ((inByte >= '0') && (inByte <= '9')) {
+
+				if (this->myNumberDone) {
+					break;
+				}
+
+				if (!this->myInNumber) {
+					this->myInNumber = true;
+					this->myHasValue = true;
+					this->myNegative = this->myMinus;
+					this->myValue = 0;
+				}
+
+				if (this->myValue < MAX_VALUE) {
+					this->myValue = this->myValue * 10 + (inByte - '0');
+				}
+
+			} else {
+
+				if (this->myInNumber) {
+					this->myInNumber = false;
+					this->myNumberDone = true;
+				}
+				this->myMinus = (inByte == '-');
+			}
+
+			break;
+
+		case PARSE_ERROR:
+
+			// Texto del error sin los espacios iniciales
+
+			if ((this->myTextLength < PTU_PARSER_MAX_TEXT - 1) && ((this->myTextLength > 0) || (inByte != ' '))) {
+				this->myText[this->myTextLength++] = (char)inByte;
+			}
+
+			break;
+	}
+
+	return false;
+}
+
+bool PtuParser::flush(PtuEvent* outEvent) {
+
+	if (this->myState == PARSE_IDLE) {
+		return false;
+	}
+
+	this->finish(outEvent);
+	return true;
+}
+
+unsigned long PtuParser::getIgnoredBytes() {
+	return this->myIgnoredBytes;
+}
@@ -0,0 +1,91 @@
+/*
+ * PtuParser.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Interpretación incremental de las respuestas de la PTU-46, byte a byte.
+ *
+ *  	PtuParser: máquina de estados que convierte los bytes recibidos en eventos
+ *
+ *  Las respuestas pueden llegar partidas entre varias lecturas o varias juntas en una.
+ *  El estado se conserva entre llamadas y no se reserva memoria.
+ *
+ *  	'*' ... fin de línea		confirmación; si contiene un entero, posición
+ *  	'!' texto fin de línea		error, con su texto
+ *
+ *  Un '*' o '!' en medio de una respuesta la termina y empieza otra (respuestas sin fin de
+ *  línea entre ellas). Los bytes fuera de una respuesta (eco, espacios) se ignoran.
+ *
+ */
+
+#ifndef PTUPARSER_H_
+#define PTUPARSER_H_
+
+#define PTU_PARSER_MAX_TEXT 64
+
+enum PtuEventType {
+	PTU_EVENT_ACK = 0,			// '*' sin valor
+	PTU_EVENT_POSITION = 1,		// '*' con un entero (respuesta a PP, TP, ...)
+	PTU_EVENT_ERROR = 2			// '!' con el texto del error
+};
+
+struct PtuEvent {
+	PtuEventType Type;
+	int Value;							// PTU_EVENT_POSITION
+	char Text[PTU_PARSER_MAX_TEXT];		// PTU_EVENT_ERROR (terminado en '\0', recortado si es largo)
+};
+
+class PtuParser {
+
+private:
+
+	enum ParseState {
+		PARSE_IDLE = 0,
+		PARSE_ACK = 1,
+		PARSE_ERROR = 2
+	};
+
+	// Miembros privados
+
+	ParseState myState;
+
+	bool myHasValue;		// se ha leído al menos un dígito
+	bool myInNumber;		// el último byte era un dígito del primer entero
+	bool myNumberDone;		// el primer entero ya ha terminado
+	bool myNegative;
+	bool myMinus;			// el último byte era '-'
+	int myValue;
+
+	char myText[PTU_PARSER_MAX_TEXT];
+	int myTextLength;
+
+	unsigned long myIgnoredBytes;
+
+	void start(ParseState inState);
+	void finish(PtuEvent* outEvent);
+
+public:
+
+	// Miembros públicos
+
+	PtuParser();
+
+	void reset();
+
+	// Procesa un byte. Devuelve true si completa una respuesta (en outEvent).
+
+	bool feed(unsigned char inByte, PtuEvent* outEvent);
+
+	// Termina la respuesta en curso aunque no haya llegado su fin de línea.
+	// Devuelve true si había alguna (en outEvent).
+
+	bool flush(PtuEvent* outEvent);
+
+	// Bytes recibidos fuera de cualquier respuesta
+
+	unsigned long getIgnoredBytes();
+
+};
+
+#endif /* PTUPARSER_H_ */
@@ -0,0 +1,616 @@
+/*
+ * PtuSim.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	PtuSimulator: PTU-46 simulada en un pseudoterminal
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "PtuSim.h"
+#include "PtuComm.h"
+#include "Latency.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Bits por byte en el enlace (inicio, 8 de datos, parada)
+
+#define BITS_PER_BYTE 10
+
+namespace Sim {
+
+	PtuSimConfig::PtuSimConfig() {
+
+		this->Bps = PTU_DEFAULT_BPS;
+		this->PanSpeed = PTU_SIM_DEFAULT_SPEED;
+		this->TiltSpeed = PTU_SIM_DEFAULT_SPEED;
+		this->ReplyDelayUs = 0;
+		this->DropRate = 0;
+		this->ErrorRate = 0;
+		this->CorruptRate = 0;
+		this->StallRate = 0;
+		this->StallMs = 0;
+		this->Seed = 1;
+
+	}
+
+	// Constructor
+
+	PtuSimulator::PtuSimulator(const PtuSimConfig& inConfig) {
+
+		this->myConfig = inConfig;
+		memset(&this->myStats, 0, sizeof(this->myStats));
+		this->mySeed = inConfig.Seed;
+
+		this->LastError = NULL;
+		this->myMaster = -1;
+		this->mySlave = -1;
+		this->myWakePipe[0] = -1;
+		this->myWakePipe[1] = -1;
+		this->mySlaveName[0] = '\0';
+		this->myRunning = false;
+
+		this->mySlaved = false;
+		this->myVerbose = false;
+		this->myBps = inConfig.Bps;
+		this->myNextBps = inConfig.Bps;
+
+		this->myInStart = 0;
+		this->myInEnd = 0;
+		this->myRxNs = 0;
+		this->myCommandLength = 0;
+		this->myAwaiting = false;
+
+		this->myOutStart = 0;
+		this->myOutEnd = 0;
+		this->myTxNs = 0;
+
+		// Articulaciones en 0, con los límites de PtuComm.h en pasos
+
+		int64_t theNow = Timing::nowNs();
+
+		for (int a = 0; a < 2; a++) {
+			this->myAxes[a].myStart = 0;
+			this->myAxes[a].myTarget = 0;
+			this->myAxes[a].myPending = 0;
+			this->myAxes[a].myStartNs = theNow;
+		}
+
+		this->myAxes[PAN].mySpeed = inConfig.PanSpeed;
+		this->myAxes[PAN].myMin = (int)ceil(PTU_PAN_MIN_DEG * 3600 / PAN_RESOLUTION);
+		this->myAxes[PAN].myMax = (int)floor(PTU_PAN_MAX_DEG * 3600 / PAN_RESOLUTION);
+		this->myAxes[TILT].mySpeed = inConfig.TiltSpeed;
+		this->myAxes[TILT].myMin = (int)ceil(PTU_TILT_MIN_DEG * 3600 / TILT_RESOLUTION);
+		this->myAxes[TILT].myMax = (int)floor(PTU_TILT_MAX_DEG * 3600 / TILT_RESOLUTION);
+
+		pthread_mutex_init(&this->myMutex, NULL);
+
+		// Pseudoterminal. El simulador mantiene abierto también el extremo esclavo para que
+		// el maestro no dé error (EIO) mientras el cliente no lo tenga abierto.
+
+		this->myMaster = posix_openpt(O_RDWR | O_NOCTTY);
+
+		if ((this->myMaster < 0) || (grantpt(this->myMaster) != 0) || (unlockpt(this->myMaster) != 0) ||
+				(ptsname_r(this->myMaster, this->mySlaveName, sizeof(this->mySlaveName)) != 0)) {
+			this->LastError = "no se puede crear el pseudoterminal";
+			return;
+		}
+
+		this->mySlave = open(this->mySlaveName, O_RDWR | O_NOCTTY);
+
+		struct termios theSettings;
+
+		if ((this->mySlave < 0) || (tcgetattr(this->myMaster, &theSettings) != 0)) {
+			this->LastError = "no se puede abrir el extremo esclavo del pseudoterminal";
+			return;
+		}
+
+		cfmakeraw(&theSettings);
+		tcsetattr(this->myMaster, TCSANOW, &theSettings);
+		fcntl(this->myMaster, F_SETFL, fcntl(this->myMaster, F_GETFL) | O_NONBLOCK);
+
+		if (pipe(this->myWakePipe) != 0) {
+			this->LastError = "no se puede crear la tubería de aviso";
+		}
+
+	}
+
+	// Destructor
+
+	PtuSimulator::~PtuSimulator() {
+
+		this->stop();
+
+		if (this->myMaster >= 0) close(this->myMaster);
+		if (this->mySlave >= 0) close(this->mySlave);
+		if (this->myWakePipe[0] >= 0) close(this->myWakePipe[0]);
+		if (this->myWakePipe[1] >= 0) close(this->myWakePipe[1]);
+
+		pthread_mutex_destroy(&this->myMutex);
+
+	}
+
+	const char* PtuSimulator::getDeviceName() {
+		return this->mySlaveName;
+	}
+
+	bool PtuSimulator::start() {
+
+		if ((this->LastError != NULL) || this->myRunning) {
+			return false;
+		}
+
+		// Las señales del proceso las atiende el hilo llamante, no el del simulador
+
+		sigset_t theAll;
+		sigset_t theOld;
+
+		sigfillset(&theAll);
+		pthread_sigmask(SIG_SETMASK, &theAll, &theOld);
+		this->myRunning = (pthread_create(&this->myThread, NULL, threadMain, this) == 0);
+		pthread_sigmask(SIG_SETMASK, &theOld, NULL);
+
+		return this->myRunning;
+	}
+
+	void PtuSimulator::stop() {
+
+		if (!this->myRunning) {
+			return;
+		}
+
+		char theByte = 0;
+
+		if (write(this->myWakePipe[1], &theByte, 1) == 1) {
+			pthread_join(this->myThread, NULL);
+		} else {
+			pthread_cancel(this->myThread);
+			pthread_join(this->myThread, NULL);
+		}
+
+		this->myRunning = false;
+
+	}
+
+	double PtuSimulator::getPosition(int inAxis) {
+
+		pthread_mutex_lock(&this->myMutex);
+		double thePosition = this->getPosition(inAxis, Timing::nowNs());
+		pthread_mutex_unlock(&this->myMutex);
+
+		return thePosition;
+	}
+
+	PtuSimStats PtuSimulator::getStats() {
+
+		pthread_mutex_lock(&this->myMutex);
+		PtuSimStats theStats = this->myStats;
+		pthread_mutex_unlock(&this->myMutex);
+
+		return theStats;
+	}
+
+	void PtuSimulator::printStats() {
+
+		PtuSimStats theStats = this->getStats();
+
+		printf("PTU simulada en %s: %lu órdenes, %lu respuestas, %lu errores\n", this->mySlaveName,
+				theStats.Commands, theStats.Replies, theStats.Errors);
+		printf("  fallos: %lu respuestas perdidas, %lu errores inyectados, %lu bytes alterados, %lu retrasos\n",
+				theStats.Dropped, theStats.InjectedErrors, theStats.CorruptedBytes, theStats.Stalls);
+		printf("  enlace: %lu bytes recibidos, %lu bytes enviados\n", theStats.BytesIn, theStats.BytesOut);
+
+	}
+
+	void* PtuSimulator::threadMain(void* inSimulator) {
+		((PtuSimulator*)inSimulator)->loop();
+		return NULL;
+	}
+
+	// Duración de un byte en el enlace (0 sin límite de velocidad)
+
+	int64_t PtuSimulator::getByteNs() {
+		return (this->myBps > 0) ? BITS_PER_BYTE * 1000000000LL / this->myBps : 0;
+	}
+
+	double PtuSimulator::getPosition(int inAxis, int64_t inNowNs) {
+
+		Axis* theAxis = &this->myAxes[inAxis];
+		double theDistance = theAxis->myTarget - theAxis->myStart;
+
+		if (theAxis->mySpeed <= 0) {
+			return theAxis->myTarget;
+		}
+
+		double theTravelled = theAxis->mySpeed * (inNowNs - theAxis->myStartNs) * 1e-9;
+
+		if (theTravelled >= fabs(theDistance)) {
+			return theAxis->myTarget;
+		}
+
+		return theAxis->myStart + ((theDistance > 0) ? theTravelled : -theTravelled);
+	}
+
+	int64_t PtuSimulator::getMotionEndNs() {
+
+		int64_t theEnd = 0;
+
+		for (int a = 0; a < 2; a++) {
+
+			Axis* theAxis = &this->myAxes[a];
+			int64_t theAxisEnd = theAxis->myStartNs;
+
+			if (theAxis->mySpeed > 0) {
+				theAxisEnd += (int64_t)(fabs(theAxis->myTarget - theAxis->myStart) / theAxis->mySpeed * 1e9);
+			}
+
+			if (theAxisEnd > theEnd) {
+				theEnd = theAxisEnd;
+			}
+		}
+
+		return theEnd;
+	}
+
+	// Nuevo destino desde la posición actual (también a mitad de un movimiento)
+
+	void PtuSimulator::moveTo(int inAxis, double inTarget, int64_t inNowNs) {
+
+		Axis* theAxis = &this->myAxes[inAxis];
+
+		theAxis->myStart = this->getPosition(inAxis, inNowNs);
+		theAxis->myStartNs = inNowNs;
+		theAxis->myTarget = inTarget;
+
+	}
+
+	bool PtuSimulator::chance(float inRate) {
+		return (inRate > 0) && (rand_r(&this->mySeed) < inRate * ((float)RAND_MAX + 1.0f));
+	}
+
+	void PtuSimulator::loop() {
+
+		for (;;) {
+
+			int64_t theNow = Timing::nowNs();
+			int64_t theWakeNs = -1;
+
+			pthread_mutex_lock(&this->myMutex);
+
+			this->receive(theNow);
+			this->transmit(theNow);
+
+			// Próximo instante en que hay algo que hacer sin esperar datos
+
+			if (this->myAwaiting) {
+				theWakeNs = this->getMotionEndNs();
+			} else if (this->myInStart < this->myInEnd) {
+				theWakeNs = this->myRxNs + this->getByteNs();
+			}
+
+			if ((this->myOutStart < this->myOutEnd) && ((theWakeNs < 0) || (this->myTxNs < theWakeNs))) {
+				theWakeNs = this->myTxNs;
+			}
+
+			bool theRoom = (this->myInEnd < PTU_SIM_BUFFER) || (this->myInStart > 0);
+
+			pthread_mutex_unlock(&this->myMutex);
+
+			// Espera a datos, al aviso de parada o al próximo instante
+
+			struct pollfd thePoll[2] = { { this->myWakePipe[0], POLLIN, 0 }, { this->myMaster, (short)(theRoom ? POLLIN : 0), 0 } };
+			struct timespec theTimeout;
+			struct timespec* theTimeoutPtr = NULL;
+
+			if (theWakeNs >= 0) {
+				int64_t theWait = theWakeNs - Timing::nowNs();
+				if (theWait < 0) theWait = 0;
+				theTimeout.tv_sec = theWait / 1000000000LL;
+				theTimeout.tv_nsec = theWait % 1000000000LL;
+				theTimeoutPtr = &theTimeout;
+			}
+
+			if (ppoll(thePoll, 2, theTimeoutPtr, NULL) < 0) {
+				if (errno == EINTR) continue;
+				break;
+			}
+
+			if (thePoll[0].revents != 0) {
+				break;
+			}
+
+			if ((thePoll[1].revents & POLLIN) != 0) {
+
+				pthread_mutex_lock(&this->myMutex);
+
+				if (this->myInStart == this->myInEnd) {
+
+					// Cola vacía: la línea estaba libre, el primer byte termina de llegar un byte después
+
+					this->myInStart = 0;
+					this->myInEnd = 0;
+					theNow = Timing::nowNs();
+					if (this->myRxNs < theNow) {
+						this->myRxNs = theNow;
+					}
+
+				} else if (this->myInEnd == PTU_SIM_BUFFER) {
+					memmove(this->myIn, this->myIn + this->myInStart, this->myInEnd - this->myInStart);
+					this->myInEnd -= this->myInStart;
+					this->myInStart = 0;
+				}
+
+				int theRead = read(this->myMaster, this->myIn + this->myInEnd, PTU_SIM_BUFFER - this->myInEnd);
+
+				if (theRead > 0) {
+					this->myInEnd += theRead;
+				}
+
+				pthread_mutex_unlock(&this->myMutex);
+
+			} else if ((thePoll[1].revents & (POLLERR | POLLHUP)) != 0) {
+
+				// No debería ocurrir mientras el simulador mantenga abierto el extremo esclavo
+				usleep(1000);
+			}
+		}
+
+	}
+
+	// Interpreta los bytes que ya habrían llegado por el enlace
+
+	void PtuSimulator::receive(int64_t inNowNs) {
+
+		int64_t theByteNs = this->getByteNs();
+
+		for (;;) {
+
+			// "A": nada más hasta que termina el movimiento
+
+			if (this->myAwaiting) {
+				int64_t theEnd = this->getMotionEndNs();
+				if (inNowNs < theEnd) {
+					break;
+				}
+				this->myAwaiting = false;
+				this->reply("*", inNowNs);
+			}
+
+			if ((this->myInStart == this->myInEnd) || (this->myRxNs + theByteNs > inNowNs)) {
+				break;
+			}
+
+			this->myRxNs += theByteNs;
+			this->myStats.BytesIn++;
+
+			unsigned char theByte = this->myIn[this->myInStart++];
+
+			if ((theByte == ' ') || (theByte == '\r') || (theByte == '\n')) {
+				if (this->myCommandLength > 0) {
+					this->myCommand[this->myCommandLength] = '\0';
+					this->myCommandLength = 0;
+					this->execute(inNowNs);
+				}
+			} else if (this->myCommandLength < PTU_SIM_MAX_COMMAND - 1) {
+				this->myCommand[this->myCommandLength++] = (char)theByte;
+			}
+		}
+
+	}
+
+	void PtuSimulator::execute(int64_t inNowNs) {
+
+		const char* theCommand = this->myCommand;
+		char theReply[64];
+
+		this->myStats.Commands++;
+
+		if (this->chance(this->myConfig.ErrorRate)) {
+			this->myStats.InjectedErrors++;
+			this->reply("! Injected error", inNowNs);
+			return;
+		}
+
+		strcpy(theReply, "*");
+
+		if (strcmp(theCommand, "I") == 0) {
+
+			this->mySlaved = false;
+
+		} else if (strcmp(theCommand, "S") == 0) {
+
+			// Los destinos pendientes parten de los actuales
+
+			this->mySlaved = true;
+			this->myAxes[PAN].myPending = this->myAxes[PAN].myTarget;
+			this->myAxes[TILT].myPending = this->myAxes[TILT].myTarget;
+
+		} else if ((strcmp(theCommand, "FT") == 0) || (strcmp(theCommand, "FV") == 0)) {
+
+			this->myVerbose = (theCommand[1] == 'V');
+
+		} else if (strcmp(theCommand, "A") == 0) {
+
+			if (this->mySlaved) {
+				this->moveTo(PAN, this->myAxes[PAN].myPending, inNowNs);
+				this->moveTo(TILT, this->myAxes[TILT].myPending, inNowNs);
+			}
+
+			// Se confirma en receive() al terminar el movimiento
+			this->myAwaiting = true;
+			return;
+
+		} else if (theCommand[0] == '@') {
+
+			int theBps;
+
+			if ((sscanf(theCommand, "@(%d,0,T)", &theBps) == 1) && ((theBps == 9600) || (theBps == 19200) ||
+					(theBps == 38400) || (theBps == 57600) || (theBps == 115200))) {
+				// La confirmación sale aún a la velocidad actual
+				if (this->myConfig.Bps > 0) {
+					this->myNextBps = theBps;
+				}
+			} else {
+				this->myStats.Errors++;
+				strcpy(theReply, "! Illegal baud rate");
+			}
+
+		} else if (((theCommand[0] == 'P') || (theCommand[0] == 'T')) && ((theCommand[1] == 'P') || (theCommand[1] == 'O'))) {
+
+			int theAxis = (theCommand[0] == 'P') ? PAN : TILT;
+			const char* theName = (theAxis == PAN) ? "Pan" : "Tilt";
+			Axis* theState = &this->myAxes[theAxis];
+
+			if ((theCommand[2] == '\0') && (theCommand[1] == 'P')) {
+
+				// Consulta de posición
+
+				int thePosition = (int)lround(this->getPosition(theAxis, inNowNs));
+
+				if (this->myVerbose) {
+					snprintf(theReply, sizeof(theReply), "* Current %s position is %d", theName, thePosition);
+				} else {
+					snprintf(theReply, sizeof(theReply), "* %d", thePosition);
+				}
+
+			} else {
+
+				char* theEnd;
+				long theValue = strtol(theCommand + 2, &theEnd, 10);
+
+				if ((theCommand[2] == '\0') || (*theEnd != '\0')) {
+
+					this->myStats.Errors++;
+					strcpy(theReply, "! Illegal argument");
+
+				} else {
+
+					double theBase = this->mySlaved ? theState->myPending : theState->myTarget;
+					double theTarget = (theCommand[1] == 'P') ? theValue : theBase + theValue;
+
+					if (theTarget > theState->myMax) {
+						this->myStats.Errors++;
+						snprintf(theReply, sizeof(theReply), "! Maximum allowable %s position is %d", theName, theState->myMax);
+					} else if (theTarget < theState->myMin) {
+						this->myStats.Errors++;
+						snprintf(theReply, sizeof(theReply), "! Minimum allowable %s position is %d", theName, theState->myMin);
+					} else if (this->mySlaved) {
+						theState->myPending = theTarget;
+					} else {
+						this->moveTo(theAxis, theTarget, inNowNs);
+					}
+				}
+			}
+
+		} else {
+
+			this->myStats.Errors++;
+			strcpy(theReply, "! Illegal command");
+		}
+
+		this->reply(theReply, inNowNs);
+
+	}
+
+	// Añade una respuesta a la cola de envío, con los fallos configurados
+
+	void PtuSimulator::reply(const char* inText, int64_t inNowNs) {
+
+		this->myStats.Replies++;
+
+		if (this->chance(this->myConfig.DropRate)) {
+			this->myStats.Dropped++;
+			return;
+		}
+
+		int64_t theReadyNs = inNowNs + this->myConfig.ReplyDelayUs * 1000LL + this->getByteNs();
+
+		if (this->chance(this->myConfig.StallRate)) {
+			this->myStats.Stalls++;
+			theReadyNs += this->myConfig.StallMs * 1000000LL;
+		}
+
+		if (this->myTxNs < theReadyNs) {
+			this->myTxNs = theReadyNs;
+		}
+
+		int theLength = (int)strlen(inText);
+
+		if (this->myOutEnd + theLength + 2 > PTU_SIM_BUFFER) {
+			memmove(this->myOut, this->myOut + this->myOutStart, this->myOutEnd - this->myOutStart);
+			this->myOutEnd -= this->myOutStart;
+			this->myOutStart = 0;
+			if (this->myOutEnd + theLength + 2 > PTU_SIM_BUFFER) {
+				this->myStats.Dropped++;
+				return;
+			}
+		}
+
+		memcpy(this->myOut + this->myOutEnd, inText, theLength);
+		this->myOut[this->myOutEnd + theLength] = '\r';
+		this->myOut[this->myOutEnd + theLength + 1] = '\n';
+
+		// Bytes alterados: se invierte uno de sus 7 bits bajos
+
+		if (this->myConfig.CorruptRate > 0) {
+			for (int i = 0; i < theLength + 2; i++) {
+				if (this->chance(this->myConfig.CorruptRate)) {
+					this->myOut[this->myOutEnd + i] ^= (unsigned char)(1 << (rand_r(&this->mySeed) % 7));
+					this->myStats.CorruptedBytes++;
+				}
+			}
+		}
+
+		this->myOutEnd += theLength + 2;
+
+	}
+
+	// Escribe los bytes de respuesta cuyo momento de salida ha pasado
+
+	void PtuSimulator::transmit(int64_t inNowNs) {
+
+		int64_t theByteNs = this->getByteNs();
+		int theCount = 0;
+
+		while ((this->myOutStart + theCount < this->myOutEnd) && (this->myTxNs <= inNowNs)) {
+			theCount++;
+			this->myTxNs += theByteNs;
+		}
+
+		if (theCount > 0) {
+
+			int theWritten = write(this->myMaster, this->myOut + this->myOutStart, theCount);
+
+			if (theWritten > 0) {
+				this->myOutStart += theWritten;
+				this->myStats.BytesOut += theWritten;
+			}
+		}
+
+		// Cambio de velocidad pendiente: cuando ha salido la confirmación
+
+		if (this->myOutStart == this->myOutEnd) {
+			this->myOutStart = 0;
+			this->myOutEnd = 0;
+			this->myBps = this->myNextBps;
+		}
+
+	}
+
+}
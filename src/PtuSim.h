@@ -0,0 +1,192 @@
+/*
+ * PtuSim.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Simulador de la PTU-46 en un pseudoterminal, para probar y medir Serial, Serial_Q y el
+ *  protocolo de la PTU sin el hardware.
+ *
+ *  	PtuSimConfig: velocidad del enlace, movimiento y fallos a simular
+ *  	PtuSimulator: extremo PTU del pseudoterminal, atendido por un hilo propio
+ *
+ *  Órdenes (terminadas en espacio o fin de línea):
+ *
+ *  	I, S			modo inmediato / esclavo (en modo esclavo las posiciones esperan a "A")
+ *  	FT, FV			respuestas escuetas / detalladas
+ *  	PP, TP			consulta de la posición actual ("* <pos>")
+ *  	PP<n>, TP<n>	posición absoluta (en pasos); fuera de los límites se responde '!'
+ *  	PO<n>, TO<n>	posición relativa a la de destino actual
+ *  	A				espera al final del movimiento; las órdenes siguientes esperan con ella
+ *  	@(bps,0,T)		velocidad del enlace (se confirma a la velocidad anterior)
+ *
+ *  Cualquier otra orden se responde con '!'.
+ *
+ *  El enlace se simula con un retardo de 10 bits por byte en los dos sentidos: las órdenes
+ *  se ejecutan cuando habría terminado de llegar su último byte y las respuestas se
+ *  escriben al ritmo de la velocidad actual. El movimiento es a velocidad constante (sin
+ *  rampas de aceleración) desde la posición actual hasta la de destino.
+ *
+ */
+
+#ifndef PTUSIM_H_
+#define PTUSIM_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define PTU_SIM_MAX_COMMAND	32
+#define PTU_SIM_BUFFER		4096
+
+// Velocidad por defecto de la PTU-46 (pasos por segundo, unos 51 grados por segundo)
+
+#define PTU_SIM_DEFAULT_SPEED	1000
+
+namespace Sim {
+
+	struct PtuSimConfig {
+
+		int Bps;				// velocidad inicial del enlace (0: sin límite, también tras "@")
+		float PanSpeed;			// pasos por segundo (0: movimiento instantáneo)
+		float TiltSpeed;
+		int ReplyDelayUs;		// tiempo de proceso de cada orden antes de responder
+
+		// Fallos (probabilidad por orden o por byte, 0..1)
+
+		float DropRate;			// orden ejecutada sin respuesta
+		float ErrorRate;		// orden no ejecutada y respondida con '!'
+		float CorruptRate;		// byte de respuesta cambiado por otro
+		float StallRate;		// respuesta retrasada StallMs
+		int StallMs;
+
+		unsigned int Seed;
+
+		PtuSimConfig();
+	};
+
+	// Contadores del simulador
+
+	struct PtuSimStats {
+		unsigned long Commands;
+		unsigned long Replies;
+		unsigned long Dropped;
+		unsigned long Errors;			// '!' por orden desconocida o fuera de límites
+		unsigned long InjectedErrors;
+		unsigned long CorruptedBytes;
+		unsigned long Stalls;
+		unsigned long BytesIn;
+		unsigned long BytesOut;
+	};
+
+	//////////////////////////////////////////////////////////////
+	// Simulador de la PTU-46									//
+	//															//
+	//  - El hilo duerme en ppoll hasta que llegan datos, hay	//
+	//    que escribir un byte de respuesta o termina una		//
+	//    espera de movimiento									//
+	//  - Los bytes recibidos se guardan y se interpretan al	//
+	//    ritmo del enlace										//
+	//  - Las respuestas se acumulan y se escriben cuando su	//
+	//    momento de salida ha pasado							//
+	//															//
+	//////////////////////////////////////////////////////////////
+
+	class PtuSimulator {
+
+	private:
+
+		// Miembros privados
+
+		struct Axis {
+			double myStart;			// posición al empezar el movimiento
+			double myTarget;
+			double myPending;		// destino en modo esclavo (hasta "A")
+			int64_t myStartNs;
+			float mySpeed;
+			int myMin;
+			int myMax;
+		};
+
+		PtuSimConfig myConfig;
+		PtuSimStats myStats;
+		unsigned int mySeed;
+
+		int myMaster;
+		int mySlave;
+		int myWakePipe[2];
+		char mySlaveName[64];
+
+		pthread_t myThread;
+		pthread_mutex_t myMutex;		// estado frente a getPosition y getStats
+		bool myRunning;
+
+		Axis myAxes[2];
+		bool mySlaved;
+		bool myVerbose;
+		int myBps;
+		int myNextBps;			// tras "@", cuando haya salido la confirmación
+
+		// Recepción: bytes leídos del pseudoterminal pendientes de "llegar"
+
+		unsigned char myIn[PTU_SIM_BUFFER];
+		int myInStart;
+		int myInEnd;
+		int64_t myRxNs;			// momento en que terminó de llegar el último byte interpretado
+
+		char myCommand[PTU_SIM_MAX_COMMAND];
+		int myCommandLength;
+		bool myAwaiting;		// "A" en curso: no se interpreta nada más
+
+		// Envío
+
+		unsigned char myOut[PTU_SIM_BUFFER];
+		int myOutStart;
+		int myOutEnd;
+		int64_t myTxNs;			// momento de salida del siguiente byte
+
+		static void* threadMain(void* inSimulator);
+		void loop();
+
+		int64_t getByteNs();
+		double getPosition(int inAxis, int64_t inNowNs);
+		int64_t getMotionEndNs();
+		void moveTo(int inAxis, double inTarget, int64_t inNowNs);
+		bool chance(float inRate);
+
+		void receive(int64_t inNowNs);
+		void execute(int64_t inNowNs);
+		void reply(const char* inText, int64_t inNowNs);
+		void transmit(int64_t inNowNs);
+
+	public:
+
+		// Miembros públicos
+
+		// Abre el pseudoterminal. LastError indica si ha fallado.
+
+		PtuSimulator(const PtuSimConfig& inConfig);
+
+		~PtuSimulator();
+
+		const char* LastError;
+
+		// Extremo del pseudoterminal que debe abrir el cliente (como si fuera /dev/ttyUSB0)
+
+		const char* getDeviceName();
+
+		bool start();
+		void stop();
+
+		// Posición actual en pasos
+
+		double getPosition(int inAxis);
+
+		PtuSimStats getStats();
+
+		void printStats();
+
+	};
+
+}
+
+#endif /* PTUSIM_H_ */
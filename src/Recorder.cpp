@@ -0,0 +1,881 @@
+/*
+ * Recorder.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	Recorder: registros en segmentos proyectados, con el hilo que los prepara y los cierra
+ *  	RecordingReader: proyección de una grabación, índice de cuadros y recorrido
+ *  	getDepth: pixeles de un cuadro grabado, en bruto o comprimido
+ *
+ */
+
+#include "Recorder.h"
+#include "DepthCodec.h"
+#include "Latency.h"
+#include "Log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define NO_SLOT		0xffffffffu
+
+// Donde la cabecera de sistema no lo define todavía (Linux 5.14)
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE	23
+#endif
+
+namespace Record {
+
+	static const char SegmentMagic[8] = { 'P', 'T', 'X', 'R', 'E', 'C', 0, 0 };
+
+	typedef char DepthRecordIsAligned[(sizeof(DepthRecord) == RECORD_ALIGN) ? 1 : -1];
+
+	static uint64_t alignUp(uint64_t inValue, uint64_t inAlign) {
+		return (inValue + inAlign - 1) / inAlign * inAlign;
+	}
+
+	static uint32_t getDataOffset() {
+		return (uint32_t)alignUp(RECORD_PAGE + RECORD_INDEX_SLOTS * sizeof(FrameIndexEntry), RECORD_PAGE);
+	}
+
+	static void getSegmentPath(const char* inPrefix, uint32_t inNumber, char* outPath, size_t inSize) {
+		snprintf(outPath, inSize, "%s.%04u.rec", inPrefix, inNumber);
+	}
+
+	// Constructor
+
+	Recorder::Recorder() {
+
+		this->myPrefix[0] = '\0';
+		this->mySegmentBytes = 0;
+
+		pthread_mutex_init(&this->myMutex, NULL);
+		this->myCurrent = NULL;
+		this->myNext = NULL;
+		this->myRetired = NULL;
+		this->myNextNumber = 0;
+		this->myNumSegments = 0;
+		this->myNumFrames = 0;
+
+		this->myCompress = true;
+
+		this->myRunning = false;
+		this->myFailed = false;
+
+		this->myNumRecords = 0;
+		this->myDropped = 0;
+		this->myBytesWritten = 0;
+
+	}
+
+	// Destructor
+
+	Recorder::~Recorder() {
+
+		this->close();
+
+		pthread_mutex_destroy(&this->myMutex);
+
+	}
+
+	bool Recorder::open(const char* inPrefix, uint64_t inSegmentBytes) {
+
+		if ((this->myCurrent != NULL) || (inSegmentBytes < getDataOffset() + RECORD_PAGE)) {
+			return false;
+		}
+
+		snprintf(this->myPrefix, sizeof(this->myPrefix), "%s", inPrefix);
+		this->mySegmentBytes = alignUp(inSegmentBytes, RECORD_PAGE);
+		this->myNextNumber = 0;
+		this->myNumSegments = 1;
+		this->myNumFrames = 0;
+		this->myFailed = false;
+		this->myNumRecords = 0;
+		this->myDropped = 0;
+		this->myBytesWritten = 0;
+
+		this->myCurrent = this->createSegment();
+
+		if (this->myCurrent == NULL) {
+			return false;
+		}
+
+		this->myRunning = true;
+
+		if (pthread_create(&this->myThread, NULL, threadMain, this) != 0) {
+			this->myRunning = false;
+			this->closeSegment(this->myCurrent, false);
+			this->myCurrent = NULL;
+			return false;
+		}
+
+		return true;
+	}
+
+	void Recorder::close() {
+
+		if (this->myCurrent == NULL) {
+			return;
+		}
+
+		this->myRunning = false;
+		pthread_join(this->myThread, NULL);
+
+		// Sin hilos grabando ya no quedan reservas sin confirmar
+
+		while (this->myRetired != NULL) {
+			Segment* theSegment = this->myRetired;
+			this->myRetired = theSegment->myNextRetired;
+			this->closeSegment(theSegment, true);
+		}
+
+		this->closeSegment(this->myCurrent, true);
+		this->myCurrent = NULL;
+
+		// El segmento preparado no se ha llegado a usar
+
+		if (this->myNext != NULL) {
+			this->closeSegment(this->myNext, false);
+			this->myNext = NULL;
+		}
+
+	}
+
+	bool Recorder::isOpen() {
+		return this->myCurrent != NULL;
+	}
+
+	void Recorder::setCompression(bool inCompress) {
+		this->myCompress = inCompress;
+	}
+
+	void Recorder::reserveFrames(int inWidth, int inHeight) {
+
+		size_t theBound = Depth::getEncodedBound(inWidth, inHeight);
+
+		if (this->myEncoded.size() < theBound) {
+			this->myEncoded.resize(theBound);
+		}
+
+	}
+
+	// Crea, reserva y proyecta el segmento siguiente y escribe su cabecera
+
+	Recorder::Segment* Recorder::createSegment() {
+
+		char thePath[300];
+		uint32_t theNumber = this->myNextNumber;
+
+		getSegmentPath(this->myPrefix, theNumber, thePath, sizeof(thePath));
+
+		int theFd = ::open(thePath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+		if (theFd < 0) {
+			return NULL;
+		}
+
+		// Bloques reservados de antemano: escribir no tendrá que buscar espacio en el disco.
+		// Si el sistema de ficheros no lo admite, el fichero queda disperso.
+
+		if ((posix_fallocate(theFd, 0, (off_t)this->mySegmentBytes) != 0) && (ftruncate(theFd, (off_t)this->mySegmentBytes) != 0)) {
+			::close(theFd);
+			unlink(thePath);
+			return NULL;
+		}
+
+		void* theBase = mmap(NULL, this->mySegmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, theFd, 0);
+
+		if (theBase == MAP_FAILED) {
+			::close(theFd);
+			unlink(thePath);
+			return NULL;
+		}
+
+		Segment* theSegment = new Segment;
+		theSegment->myFd = theFd;
+		theSegment->myBase = (uint8_t*)theBase;
+		theSegment->myBytes = this->mySegmentBytes;
+		theSegment->myNumber = theNumber;
+		theSegment->myHeader = (SegmentHeader*)theBase;
+		theSegment->myIndex = (FrameIndexEntry*)(theSegment->myBase + RECORD_PAGE);
+		theSegment->myCursor = getDataOffset();
+		theSegment->myNumFrames = 0;
+		theSegment->myPending = 0;
+		theSegment->myPrefaulted = theSegment->myCursor;
+		theSegment->myNextRetired = NULL;
+
+		struct timespec theRealTime;
+		clock_gettime(CLOCK_REALTIME, &theRealTime);
+
+		SegmentHeader* theHeader = theSegment->myHeader;
+		memcpy(theHeader->Magic, SegmentMagic, sizeof(theHeader->Magic));
+		theHeader->Version = RECORD_VERSION;
+		theHeader->Segment = theNumber;
+		theHeader->Bytes = this->mySegmentBytes;
+		theHeader->IndexSlots = RECORD_INDEX_SLOTS;
+		theHeader->DataOffset = getDataOffset();
+		theHeader->StartNs = Timing::nowNs();
+		theHeader->StartRealNs = (int64_t)theRealTime.tv_sec * 1000000000LL + theRealTime.tv_nsec;
+
+		this->myNextNumber++;
+
+		return theSegment;
+	}
+
+	// Con inKeep se anota el contenido en la cabecera, se escribe en el disco y se recorta
+	// el fichero a lo grabado; si no, se borra
+
+	void Recorder::closeSegment(Segment* inSegment, bool inKeep) {
+
+		if (inKeep) {
+
+			SegmentHeader* theHeader = inSegment->myHeader;
+			theHeader->NumFrames = inSegment->myNumFrames;
+			theHeader->DataEnd = inSegment->myCursor;
+			__sync_synchronize();
+			theHeader->Closed = 1;
+
+			msync(inSegment->myBase, inSegment->myBytes, MS_SYNC);
+			munmap(inSegment->myBase, inSegment->myBytes);
+
+			if (ftruncate(inSegment->myFd, (off_t)inSegment->myCursor) != 0) {
+				Log::warn("No se ha podido recortar el segmento %u de la grabación", inSegment->myNumber);
+			}
+
+		} else {
+
+			char thePath[300];
+			getSegmentPath(this->myPrefix, inSegment->myNumber, thePath, sizeof(thePath));
+
+			munmap(inSegment->myBase, inSegment->myBytes);
+			unlink(thePath);
+		}
+
+		::close(inSegment->myFd);
+		delete inSegment;
+
+	}
+
+	void* Recorder::threadMain(void* inRecorder) {
+		((Recorder*)inRecorder)->threadLoop();
+		return NULL;
+	}
+
+	// Hilo del grabador: todo lo que puede esperar al disco
+
+	void Recorder::threadLoop() {
+
+		int64_t theNextSyncNs = Timing::nowNs() + RECORD_SYNC_MS * 1000000LL;
+
+		while (this->myRunning) {
+
+			pthread_mutex_lock(&this->myMutex);
+			bool theNeedsNext = (this->myNext == NULL);
+			Segment* theCurrent = this->myCurrent;
+			Segment* theRetired = this->myRetired;
+			this->myRetired = NULL;
+			pthread_mutex_unlock(&this->myMutex);
+
+			// Segmento siguiente, listo antes de que se llene el actual
+
+			if (theNeedsNext) {
+
+				Segment* theNext = this->createSegment();
+
+				if (theNext != NULL) {
+					pthread_mutex_lock(&this->myMutex);
+					this->myNext = theNext;
+					pthread_mutex_unlock(&this->myMutex);
+					this->myFailed = false;
+				} else if (!this->myFailed) {
+					Log::error("No se puede crear el segmento %u de la grabación %s", this->myNextNumber, this->myPrefix);
+					this->myFailed = true;
+				}
+			}
+
+			// Los segmentos llenos se cierran cuando se han confirmado todas sus reservas
+
+			Segment* theWaiting = NULL;
+
+			while (theRetired != NULL) {
+
+				Segment* theSegment = theRetired;
+				theRetired = theSegment->myNextRetired;
+
+				if (theSegment->myPending == 0) {
+					__sync_synchronize();
+					this->closeSegment(theSegment, true);
+				} else {
+					theSegment->myNextRetired = theWaiting;
+					theWaiting = theSegment;
+				}
+			}
+
+			if (theWaiting != NULL) {
+				pthread_mutex_lock(&this->myMutex);
+				while (theWaiting != NULL) {
+					Segment* theSegment = theWaiting;
+					theWaiting = theSegment->myNextRetired;
+					theSegment->myNextRetired = this->myRetired;
+					this->myRetired = theSegment;
+				}
+				pthread_mutex_unlock(&this->myMutex);
+			}
+
+			this->serviceSegment(theCurrent, Timing::nowNs(), &theNextSyncNs);
+
+			usleep(RECORD_SERVICE_MS * 1000);
+		}
+
+	}
+
+	// Adelanta las páginas que se van a escribir (quien graba no se encuentra fallos de página
+	// que lean o reserven) y escribe en el disco lo grabado cada RECORD_SYNC_MS. El cursor se
+	// lee sin el cerrojo: solo sirve de referencia.
+
+	void Recorder::serviceSegment(Segment* inSegment, int64_t inNowNs, int64_t* ioNextSyncNs) {
+
+		uint64_t theCursor = *(volatile uint64_t*)&inSegment->myCursor;
+		uint64_t theTarget = theCursor + RECORD_PREFAULT_BYTES;
+
+		if (theTarget > inSegment->myBytes) {
+			theTarget = inSegment->myBytes;
+		}
+
+		if (theTarget > inSegment->myPrefaulted) {
+
+			uint8_t* theStart = inSegment->myBase + inSegment->myPrefaulted;
+			size_t theLength = (size_t)(theTarget - inSegment->myPrefaulted);
+
+			// Sin MADV_POPULATE_WRITE se leen: la página queda en memoria y escribirla solo
+			// cuesta un fallo menor. Escribir en ella podría pisar un registro ya reservado.
+
+			if (madvise(theStart, theLength, MADV_POPULATE_WRITE) != 0) {
+				for (size_t p = 0; p < theLength; p += RECORD_PAGE) {
+					(void)*(volatile uint8_t*)(theStart + p);
+				}
+			}
+
+			inSegment->myPrefaulted = theTarget;
+		}
+
+		if (inNowNs >= *ioNextSyncNs) {
+			msync(inSegment->myBase, (size_t)alignUp(theCursor, RECORD_PAGE), MS_SYNC);
+			*ioNextSyncNs = inNowNs + RECORD_SYNC_MS * 1000000LL;
+		}
+
+	}
+
+	// Reserva inBytes (cabecera incluida) en el segmento actual, o en el siguiente si no
+	// caben. Los cuadros ocupan además una entrada del índice (outSlot).
+
+	RecordHeader* Recorder::reserve(RecordType inType, uint32_t inBytes, int64_t inStampNs, Segment** outSegment, uint32_t* outSlot) {
+
+		uint32_t theSize = (uint32_t)alignUp(inBytes, RECORD_ALIGN);
+		bool theIsFrame = (inType == RECORD_DEPTH);
+
+		pthread_mutex_lock(&this->myMutex);
+
+		Segment* theSegment = this->myCurrent;
+
+		if ((theSegment == NULL) || (theSegment->myCursor + theSize > theSegment->myBytes) ||
+				(theIsFrame && (theSegment->myNumFrames == RECORD_INDEX_SLOTS))) {
+
+			Segment* theNext = this->myNext;
+
+			if ((theSegment == NULL) || (theNext == NULL) || (theNext->myCursor + theSize > theNext->myBytes)) {
+				pthread_mutex_unlock(&this->myMutex);
+				__sync_fetch_and_add(&this->myDropped, 1);
+				return NULL;
+			}
+
+			theSegment->myNextRetired = this->myRetired;
+			this->myRetired = theSegment;
+			this->myCurrent = theNext;
+			this->myNext = NULL;
+			this->myNumSegments++;
+			theSegment = theNext;
+		}
+
+		RecordHeader* theRecord = (RecordHeader*)(theSegment->myBase + theSegment->myCursor);
+		theRecord->Size = theSize;
+		theRecord->Type = (uint16_t)inType;
+		theRecord->State = RECORD_PENDING;
+		theRecord->StampNs = inStampNs;
+
+		*outSlot = NO_SLOT;
+
+		if (theIsFrame) {
+			*outSlot = theSegment->myNumFrames++;
+			((DepthRecord*)theRecord)->Frame = this->myNumFrames++;
+		}
+
+		theSegment->myCursor += theSize;
+		__sync_fetch_and_add(&theSegment->myPending, 1);
+
+		pthread_mutex_unlock(&this->myMutex);
+
+		*outSegment = theSegment;
+
+		return theRecord;
+	}
+
+	// Los datos deben estar escritos antes de confirmar el registro, y el registro
+	// confirmado antes de que su entrada del índice tenga desplazamiento
+
+	void Recorder::commit(Segment* inSegment, RecordHeader* inRecord, uint32_t inSlot) {
+
+		__sync_synchronize();
+		inRecord->State = RECORD_COMMITTED;
+
+		if (inSlot != NO_SLOT) {
+			FrameIndexEntry* theEntry = &inSegment->myIndex[inSlot];
+			theEntry->StampNs = inRecord->StampNs;
+			__sync_synchronize();
+			theEntry->Offset = (uint64_t)((uint8_t*)inRecord - inSegment->myBase);
+		}
+
+		__sync_fetch_and_add(&this->myNumRecords, 1);
+		__sync_fetch_and_add(&this->myBytesWritten, (uint64_t)inRecord->Size);
+
+		__sync_synchronize();
+		__sync_fetch_and_sub(&inSegment->myPending, 1);
+
+	}
+
+	// Comprimido, el cuadro se codifica fuera del cerrojo en un búfer propio (reservado con
+	// reserveFrames o, si no, con el primer cuadro de cada tamaño mayor) y se reserva
+	// exactamente lo que ocupa
+
+	bool Recorder::recordDepth(const uint16_t* inPixels, int inWidth, int inHeight, uint64_t inSensorTimestampUs, int64_t inStampNs) {
+
+		const void* theData = inPixels;
+		uint32_t theEncoding = DEPTH_RAW;
+		uint32_t theDataBytes = (uint32_t)inWidth * inHeight * sizeof(uint16_t);
+		Segment* theSegment;
+		uint32_t theSlot;
+
+		if (this->myCompress) {
+
+			this->reserveFrames(inWidth, inHeight);
+
+			size_t theEncodedBytes = Depth::encodeFrame(inPixels, inWidth, inHeight, &this->myEncoded[0]);
+
+			// Un cuadro de ruido puede ocupar más comprimido: se graba en bruto
+
+			if (theEncodedBytes < theDataBytes) {
+				theData = &this->myEncoded[0];
+				theEncoding = DEPTH_CODEC;
+				theDataBytes = (uint32_t)theEncodedBytes;
+			}
+		}
+
+		DepthRecord* theRecord = (DepthRecord*)this->reserve(RECORD_DEPTH, sizeof(DepthRecord) + theDataBytes, inStampNs, &theSegment, &theSlot);
+
+		if (theRecord == NULL) {
+			return false;
+		}
+
+		theRecord->Width = (uint16_t)inWidth;
+		theRecord->Height = (uint16_t)inHeight;
+		theRecord->SensorTimestampUs = inSensorTimestampUs;
+		theRecord->Encoding = theEncoding;
+		theRecord->EncodedBytes = theDataBytes;
+		memcpy((uint8_t*)(theRecord + 1), theData, theDataBytes);
+
+		this->commit(theSegment, &theRecord->Header, theSlot);
+
+		return true;
+	}
+
+	bool Recorder::recordCommand(const char* inCommand, int64_t inFrameNs, int64_t inStampNs) {
+
+		Segment* theSegment;
+		uint32_t theSlot;
+
+		CommandRecord* theRecord = (CommandRecord*)this->reserve(RECORD_COMMAND, sizeof(CommandRecord), inStampNs, &theSegment, &theSlot);
+
+		if (theRecord == NULL) {
+			return false;
+		}
+
+		theRecord->FrameNs = inFrameNs;
+		strncpy(theRecord->Command, inCommand, sizeof(theRecord->Command) - 1);
+		theRecord->Command[sizeof(theRecord->Command) - 1] = '\0';
+
+		this->commit(theSegment, &theRecord->Header, theSlot);
+
+		return true;
+	}
+
+	bool Recorder::recordReply(bool inOk, int64_t inSendNs, int64_t inStampNs) {
+
+		Segment* theSegment;
+		uint32_t theSlot;
+
+		ReplyRecord* theRecord = (ReplyRecord*)this->reserve(RECORD_REPLY, sizeof(ReplyRecord), inStampNs, &theSegment, &theSlot);
+
+		if (theRecord == NULL) {
+			return false;
+		}
+
+		theRecord->Ok = inOk ? 1 : 0;
+		theRecord->SendNs = inSendNs;
+
+		this->commit(theSegment, &theRecord->Header, theSlot);
+
+		return true;
+	}
+
+	bool Recorder::recordJoint(int inJoint, float inPositionDeg, int64_t inStampNs) {
+
+		Segment* theSegment;
+		uint32_t theSlot;
+
+		JointRecord* theRecord = (JointRecord*)this->reserve(RECORD_JOINT, sizeof(JointRecord), inStampNs, &theSegment, &theSlot);
+
+		if (theRecord == NULL) {
+			return false;
+		}
+
+		theRecord->Joint = (uint32_t)inJoint;
+		theRecord->PositionDeg = inPositionDeg;
+
+		this->commit(theSegment, &theRecord->Header, theSlot);
+
+		return true;
+	}
+
+	unsigned long Recorder::getNumRecords() {
+		return this->myNumRecords;
+	}
+
+	unsigned long Recorder::getDropped() {
+		return this->myDropped;
+	}
+
+	uint64_t Recorder::getBytesWritten() {
+		return this->myBytesWritten;
+	}
+
+	uint32_t Recorder::getNumSegments() {
+		return this->myNumSegments;
+	}
+
+	bool getDepth(const DepthRecord* inRecord, uint16_t* outPixels) {
+
+		size_t theRawBytes = (size_t)inRecord->Width * inRecord->Height * sizeof(uint16_t);
+
+		switch (inRecord->Encoding) {
+			case DEPTH_RAW:
+				if (sizeof(DepthRecord) + theRawBytes > inRecord->Header.Size) {
+					return false;
+				}
+				memcpy(outPixels, getPixels(inRecord), theRawBytes);
+				return true;
+			case DEPTH_CODEC:
+				if (sizeof(DepthRecord) + inRecord->EncodedBytes > inRecord->Header.Size) {
+					return false;
+				}
+				return Depth::decodeFrame((const uint8_t*)(inRecord + 1), inRecord->EncodedBytes, inRecord->Width, inRecord->Height, outPixels);
+			default:
+				return false;
+		}
+	}
+
+	// Constructor
+
+	RecordingReader::RecordingReader() {
+		this->myNumFrames = 0;
+	}
+
+	// Destructor
+
+	RecordingReader::~RecordingReader() {
+		this->close();
+	}
+
+	// Proyecta un segmento. Si no se cerró, se aceptan las entradas del índice hasta la
+	// primera vacía o que no apunte a un cuadro confirmado, y los registros hasta el primero
+	// sin tamaño.
+
+	bool RecordingReader::openSegment(const char* inPath, Segment* outSegment) {
+
+		int theFd = ::open(inPath, O_RDONLY);
+		struct stat theStat;
+
+		if (theFd < 0) {
+			return false;
+		}
+
+		if ((fstat(theFd, &theStat) != 0) || ((uint64_t)theStat.st_size < getDataOffset())) {
+			::close(theFd);
+			return false;
+		}
+
+		uint64_t theBytes = (uint64_t)theStat.st_size;
+		void* theBase = mmap(NULL, theBytes, PROT_READ, MAP_SHARED, theFd, 0);
+
+		if (theBase == MAP_FAILED) {
+			::close(theFd);
+			return false;
+		}
+
+		const SegmentHeader* theHeader = (const SegmentHeader*)theBase;
+
+		if ((memcmp(theHeader->Magic, SegmentMagic, sizeof(SegmentMagic)) != 0) || (theHeader->Version < 1) || (theHeader->Version > RECORD_VERSION) ||
+				(theHeader->IndexSlots != RECORD_INDEX_SLOTS) || (theHeader->DataOffset != getDataOffset())) {
+			munmap(theBase, theBytes);
+			::close(theFd);
+			return false;
+		}
+
+		outSegment->myFd = theFd;
+		outSegment->myBase = (const uint8_t*)theBase;
+		outSegment->myBytes = theBytes;
+		outSegment->myHeader = theHeader;
+		outSegment->myIndex = (const FrameIndexEntry*)(outSegment->myBase + RECORD_PAGE);
+		outSegment->myRecovered = (theHeader->Closed == 0);
+
+		if (!outSegment->myRecovered) {
+			outSegment->myNumFrames = theHeader->NumFrames;
+			outSegment->myDataEnd = (theHeader->DataEnd < theBytes) ? theHeader->DataEnd : theBytes;
+			return true;
+		}
+
+		uint32_t theNumFrames = 0;
+
+		while (theNumFrames < RECORD_INDEX_SLOTS) {
+
+			uint64_t theOffset = outSegment->myIndex[theNumFrames].Offset;
+
+			if ((theOffset < theHeader->DataOffset) || (theOffset + sizeof(DepthRecord) > theBytes)) {
+				break;
+			}
+
+			const RecordHeader* theRecord = (const RecordHeader*)(outSegment->myBase + theOffset);
+
+			if ((theRecord->Type != RECORD_DEPTH) || (theRecord->State != RECORD_COMMITTED) || (theOffset + theRecord->Size > theBytes)) {
+				break;
+			}
+
+			theNumFrames++;
+		}
+
+		uint64_t theDataEnd = theHeader->DataOffset;
+
+		while (theDataEnd + sizeof(RecordHeader) <= theBytes) {
+
+			uint32_t theSize = ((const RecordHeader*)(outSegment->myBase + theDataEnd))->Size;
+
+			if ((theSize == 0) || (theSize % RECORD_ALIGN != 0) || (theDataEnd + theSize > theBytes)) {
+				break;
+			}
+
+			theDataEnd += theSize;
+		}
+
+		outSegment->myNumFrames = theNumFrames;
+		outSegment->myDataEnd = theDataEnd;
+
+		return true;
+	}
+
+	bool RecordingReader::open(const char* inPrefix) {
+
+		this->close();
+
+		char thePath[300];
+		Segment theSegment;
+
+		for (uint32_t s = 0; ; s++) {
+
+			getSegmentPath(inPrefix, s, thePath, sizeof(thePath));
+
+			if (!this->openSegment(thePath, &theSegment)) {
+				break;
+			}
+
+			theSegment.myFirstFrame = this->myNumFrames;
+			this->myNumFrames += theSegment.myNumFrames;
+			this->mySegments.push_back(theSegment);
+		}
+
+		return !this->mySegments.empty();
+	}
+
+	void RecordingReader::close() {
+
+		for (size_t s = 0; s < this->mySegments.size(); s++) {
+			munmap((void*)this->mySegments[s].myBase, this->mySegments[s].myBytes);
+			::close(this->mySegments[s].myFd);
+		}
+
+		this->mySegments.clear();
+		this->myNumFrames = 0;
+
+	}
+
+	int RecordingReader::getNumSegments() {
+		return (int)this->mySegments.size();
+	}
+
+	int RecordingReader::getNumRecovered() {
+
+		int theNumRecovered = 0;
+
+		for (size_t s = 0; s < this->mySegments.size(); s++) {
+			if (this->mySegments[s].myRecovered) {
+				theNumRecovered++;
+			}
+		}
+
+		return theNumRecovered;
+	}
+
+	unsigned long RecordingReader::getNumFrames() {
+		return this->myNumFrames;
+	}
+
+	const DepthRecord* RecordingReader::getFrame(unsigned long inFrame) {
+
+		RecordCursor theCursor;
+
+		if (!this->seekFrame(inFrame, &theCursor)) {
+			return NULL;
+		}
+
+		return (const DepthRecord*)(this->mySegments[theCursor.Segment].myBase + theCursor.Offset);
+	}
+
+	long RecordingReader::findFrame(int64_t inStampNs) {
+
+		// Primero el segmento (el último que empieza antes de inStampNs) y después la entrada
+
+		int theLow = 0;
+		int theHigh = (int)this->mySegments.size() - 1;
+
+		while ((theHigh >= 0) && (this->mySegments[theHigh].myNumFrames == 0)) {
+			theHigh--;
+		}
+
+		if (theHigh < 0) {
+			return -1;
+		}
+
+		while (theLow < theHigh) {
+			int theMiddle = (theLow + theHigh + 1) / 2;
+			const Segment& theSegment = this->mySegments[theMiddle];
+			if ((theSegment.myNumFrames == 0) || (theSegment.myIndex[0].StampNs <= inStampNs)) {
+				theLow = theMiddle;
+			} else {
+				theHigh = theMiddle - 1;
+			}
+		}
+
+		// En el segmento elegido, la primera entrada con StampNs >= inStampNs; si no hay,
+		// el primer cuadro del siguiente
+
+		const Segment& theSegment = this->mySegments[theLow];
+		uint32_t theFirst = 0;
+		uint32_t theLast = theSegment.myNumFrames;
+
+		while (theFirst < theLast) {
+			uint32_t theMiddle = (theFirst + theLast) / 2;
+			if (theSegment.myIndex[theMiddle].StampNs < inStampNs) {
+				theFirst = theMiddle + 1;
+			} else {
+				theLast = theMiddle;
+			}
+		}
+
+		unsigned long theFrame = theSegment.myFirstFrame + theFirst;
+
+		return (theFrame < this->myNumFrames) ? (long)theFrame : -1;
+	}
+
+	bool RecordingReader::seekFrame(unsigned long inFrame, RecordCursor* outCursor) {
+
+		if (inFrame >= this->myNumFrames) {
+			return false;
+		}
+
+		int theLow = 0;
+		int theHigh = (int)this->mySegments.size() - 1;
+
+		while (theLow < theHigh) {
+			int theMiddle = (theLow + theHigh + 1) / 2;
+			if (this->mySegments[theMiddle].myFirstFrame <= inFrame) {
+				theLow = theMiddle;
+			} else {
+				theHigh = theMiddle - 1;
+			}
+		}
+
+		// Entre segmentos sin cuadros, el que los tiene
+
+		while (inFrame - this->mySegments[theLow].myFirstFrame >= this->mySegments[theLow].myNumFrames) {
+			theLow++;
+		}
+
+		const Segment& theSegment = this->mySegments[theLow];
+
+		outCursor->Segment = theLow;
+		outCursor->Offset = theSegment.myIndex[inFrame - theSegment.myFirstFrame].Offset;
+
+		return true;
+	}
+
+	const RecordHeader* RecordingReader::next(RecordCursor* ioCursor) {
+
+		while (ioCursor->Segment < (int)this->mySegments.size()) {
+
+			const Segment& theSegment = this->mySegments[ioCursor->Segment];
+
+			if (ioCursor->Offset < theSegment.myHeader->DataOffset) {
+				ioCursor->Offset = theSegment.myHeader->DataOffset;
+			}
+
+			while (ioCursor->Offset + sizeof(RecordHeader) <= theSegment.myDataEnd) {
+
+				const RecordHeader* theRecord = (const RecordHeader*)(theSegment.myBase + ioCursor->Offset);
+
+				if ((theRecord->Size == 0) || (ioCursor->Offset + theRecord->Size > theSegment.myDataEnd)) {
+					break;
+				}
+
+				ioCursor->Offset += theRecord->Size;
+
+				if (theRecord->State == RECORD_COMMITTED) {
+					return theRecord;
+				}
+			}
+
+			ioCursor->Segment++;
+			ioCursor->Offset = 0;
+		}
+
+		return NULL;
+	}
+
+	int64_t RecordingReader::toRealNs(int64_t inStampNs) {
+
+		if (this->mySegments.empty()) {
+			return 0;
+		}
+
+		const SegmentHeader* theHeader = this->mySegments[0].myHeader;
+
+		return inStampNs - theHeader->StartNs + theHeader->StartRealNs;
+	}
+
+}
@@ -0,0 +1,348 @@
+/*
+ * Recorder.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Grabación de una unidad en segmentos proyectados en memoria (mmap): cuadros de
+ *  profundidad (en bruto o comprimidos sin pérdidas con Depth::encodeFrame) y, en el
+ *  mismo orden temporal, las órdenes a la PTU, sus respuestas y las posiciones leídas
+ *  de las articulaciones, que una grabación .oni no puede guardar.
+ *
+ *  	Recorder: escribe los registros sin que el hilo que graba espere al disco
+ *  	RecordingReader: proyecta una grabación, busca cuadros por instante y recorre los
+ *  	                 registros sin copiarlos
+ *
+ *  Cada segmento (prefijo.NNNN.rec) es un fichero de tamaño fijo reservado de antemano:
+ *
+ *  	cabecera (SegmentHeader, una página)
+ *  	índice de cuadros (RECORD_INDEX_SLOTS entradas FrameIndexEntry)
+ *  	registros (RecordHeader y sus datos, alineados a RECORD_ALIGN), uno tras otro
+ *
+ *  Grabar un registro es reservar su espacio (bajo un cerrojo que solo avanza un
+ *  cursor), copiar los datos en la proyección y confirmarlo: su State pasa a
+ *  RECORD_COMMITTED y, si es un cuadro, se rellena su entrada del índice con el
+ *  desplazamiento en último lugar. Abrir, reservar y proyectar el segmento siguiente,
+ *  adelantar sus páginas, sincronizar con el disco y cerrar los segmentos llenos lo hace
+ *  el hilo del grabador, nunca quien graba. Si el segmento siguiente no está listo a
+ *  tiempo el registro se descarta (se cuenta): quien graba nunca espera.
+ *
+ *  Si el proceso termina sin cerrar la grabación, el sistema escribe las páginas ya
+ *  modificadas; ante un corte de corriente se pierde como mucho lo escrito en los
+ *  últimos RECORD_SYNC_MS. Al leer un segmento sin cerrar se aceptan las entradas del
+ *  índice hasta la primera vacía y se saltan los registros sin confirmar.
+ *
+ *  Los instantes son de Timing::nowNs; la cabecera guarda también el reloj de tiempo real
+ *  al crear el segmento para situarlos en el calendario.
+ *
+ */
+
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+
+#define RECORD_VERSION			2			// 2: cuadros comprimidos (DepthRecord::Encoding)
+#define RECORD_PAGE				4096
+#define RECORD_ALIGN			64
+#define RECORD_INDEX_SLOTS		16384		// cuadros por segmento
+#define RECORD_SERVICE_MS		10			// periodo del hilo del grabador
+#define RECORD_SYNC_MS			500			// escritura en disco de lo grabado
+#define RECORD_PREFAULT_BYTES	(16L * 1024 * 1024)	// páginas que se adelantan al cursor
+
+namespace Record {
+
+	enum RecordType {
+		RECORD_DEPTH = 1,		// cuadro de profundidad (DepthRecord y sus pixeles)
+		RECORD_COMMAND = 2,		// orden o consulta enviada a la PTU
+		RECORD_REPLY = 3,		// respuesta (o abandono) de la orden en curso más antigua
+		RECORD_JOINT = 4		// posición leída de una articulación
+	};
+
+	enum DepthEncoding {
+		DEPTH_RAW = 0,			// Width * Height pixeles de 16 bits
+		DEPTH_CODEC = 1			// EncodedBytes bytes de Depth::encodeFrame
+	};
+
+	enum RecordState {
+		RECORD_PENDING = 0,		// reservado: sus datos aún no son válidos
+		RECORD_COMMITTED = 1
+	};
+
+	struct SegmentHeader {
+		char Magic[8];				// "PTXREC\0\0"
+		uint32_t Version;
+		uint32_t Segment;			// número de segmento dentro de la grabación
+		uint64_t Bytes;				// tamaño reservado
+		uint32_t IndexSlots;
+		uint32_t DataOffset;		// primer registro
+		int64_t StartNs;			// Timing::nowNs al crearlo
+		int64_t StartRealNs;		// CLOCK_REALTIME en el mismo momento
+
+		// Al cerrarlo (Closed = 0 si no se cerró: se recupera del índice y los registros)
+
+		volatile uint32_t Closed;
+		uint32_t NumFrames;
+		uint64_t DataEnd;			// fin del último registro
+	};
+
+	struct FrameIndexEntry {
+		int64_t StampNs;
+		volatile uint64_t Offset;	// 0: vacía (se escribe la última)
+	};
+
+	struct RecordHeader {
+		uint32_t Size;				// registro completo, con relleno hasta RECORD_ALIGN
+		uint16_t Type;
+		volatile uint16_t State;
+		int64_t StampNs;
+	};
+
+	// Los pixeles (o el cuadro comprimido) siguen a la estructura, alineados a RECORD_ALIGN
+
+	struct DepthRecord {
+		RecordHeader Header;
+		uint32_t Frame;				// número de cuadro en la grabación
+		uint16_t Width;
+		uint16_t Height;
+		uint64_t SensorTimestampUs;	// reloj del sensor (VideoFrameRef::getTimestamp)
+		uint32_t Encoding;			// DepthEncoding
+		uint32_t EncodedBytes;		// bytes tras la estructura (con DEPTH_RAW, Width * Height * 2)
+		uint8_t Reserved[24];
+	};
+
+	struct CommandRecord {
+		RecordHeader Header;
+		int64_t FrameNs;			// lectura del cuadro que originó la orden (0: ninguno)
+		char Command[16];			// texto enviado, terminado en '\0'
+	};
+
+	struct ReplyRecord {
+		RecordHeader Header;
+		uint32_t Ok;				// 1: '*'; 0: '!' o sin respuesta en su plazo
+		uint32_t Reserved;
+		int64_t SendNs;				// envío de la orden a la que responde (0: ninguna en curso)
+	};
+
+	struct JointRecord {
+		RecordHeader Header;
+		uint32_t Joint;				// PAN o TILT
+		float PositionDeg;
+	};
+
+	// Pixeles de un cuadro en bruto, sin copiarlos (con DEPTH_CODEC, getDepth)
+
+	static inline const uint16_t* getPixels(const DepthRecord* inRecord) {
+		return (const uint16_t*)(inRecord + 1);
+	}
+
+	// Copia o descomprime los pixeles de un cuadro en outPixels (Width * Height). Devuelve
+	// false si el cuadro está dañado o su codificación es desconocida.
+
+	bool getDepth(const DepthRecord* inRecord, uint16_t* outPixels);
+
+	//////////////////////////////////////////////////////
+	// Grabador: varios hilos pueden grabar a la vez	//
+	//////////////////////////////////////////////////////
+
+	class Recorder {
+
+	private:
+
+		// Miembros privados
+
+		struct Segment {
+			int myFd;
+			uint8_t* myBase;
+			uint64_t myBytes;
+			uint32_t myNumber;
+			SegmentHeader* myHeader;
+			FrameIndexEntry* myIndex;
+
+			// Bajo el cerrojo
+
+			uint64_t myCursor;
+			uint32_t myNumFrames;
+
+			// Reservas sin confirmar: el segmento no se cierra hasta que sean 0
+
+			volatile int myPending;
+
+			// Solo el hilo del grabador
+
+			uint64_t myPrefaulted;
+			Segment* myNextRetired;
+		};
+
+		char myPrefix[256];
+		uint64_t mySegmentBytes;
+
+		pthread_mutex_t myMutex;
+		Segment* myCurrent;
+		Segment* myNext;			// preparado por el hilo del grabador (NULL: aún no)
+		Segment* myRetired;			// llenos, pendientes de cerrar
+		uint32_t myNextNumber;
+		uint32_t myNumSegments;		// usados (se conserva al cerrar)
+		uint32_t myNumFrames;
+
+		// Compresión de los cuadros (solo el hilo que graba cuadros)
+
+		bool myCompress;
+		std::vector<uint8_t> myEncoded;
+
+		pthread_t myThread;
+		volatile bool myRunning;
+		bool myFailed;
+
+		volatile unsigned long myNumRecords;
+		volatile unsigned long myDropped;
+		volatile uint64_t myBytesWritten;
+
+		static void* threadMain(void* inRecorder);
+		void threadLoop();
+
+		Segment* createSegment();
+		void closeSegment(Segment* inSegment, bool inKeep);
+		void serviceSegment(Segment* inSegment, int64_t inNowNs, int64_t* ioNextSyncNs);
+
+		RecordHeader* reserve(RecordType inType, uint32_t inBytes, int64_t inStampNs, Segment** outSegment, uint32_t* outSlot);
+		void commit(Segment* inSegment, RecordHeader* inRecord, uint32_t inSlot);
+
+	public:
+
+		// Miembros públicos
+
+		Recorder();
+
+		~Recorder();
+
+		// Crea el primer segmento (inPrefix.0000.rec, de inSegmentBytes) y arranca el hilo
+		// del grabador. Devuelve false si no se puede crear.
+
+		bool open(const char* inPrefix, uint64_t inSegmentBytes);
+
+		// Cierra los segmentos (recortados a lo grabado) y termina el hilo del grabador.
+		// Ningún hilo debe estar grabando.
+
+		void close();
+
+		bool isOpen();
+
+		// Comprime los cuadros siguientes (por omisión) o los graba en bruto
+
+		void setCompression(bool inCompress);
+
+		// Reserva el búfer de compresión para cuadros de hasta inWidth x inHeight, para que
+		// recordDepth no reserve memoria con el primer cuadro (ni al crecer la resolución)
+
+		void reserveFrames(int inWidth, int inHeight);
+
+		// Copia un cuadro (comprimido, si se ha pedido) en el segmento. Nunca espera al disco;
+		// devuelve false si se descarta.
+		// Los cuadros de una grabación deben llegar de un solo hilo (el índice va en orden).
+		// La compresión se hace en el hilo que graba: unos 280 us por cuadro de 640x480,
+		// frente a unos 140 us de la copia en bruto.
+
+		bool recordDepth(const uint16_t* inPixels, int inWidth, int inHeight, uint64_t inSensorTimestampUs, int64_t inStampNs);
+
+		bool recordCommand(const char* inCommand, int64_t inFrameNs, int64_t inStampNs);
+
+		bool recordReply(bool inOk, int64_t inSendNs, int64_t inStampNs);
+
+		bool recordJoint(int inJoint, float inPositionDeg, int64_t inStampNs);
+
+		unsigned long getNumRecords();
+
+		unsigned long getDropped();
+
+		uint64_t getBytesWritten();
+
+		uint32_t getNumSegments();
+
+	};
+
+	// Posición en el recorrido de los registros de una grabación
+
+	struct RecordCursor {
+		int Segment;
+		uint64_t Offset;
+
+		RecordCursor() { this->Segment = 0; this->Offset = 0; }
+	};
+
+	//////////////////////////////////////
+	// Lectura de una grabación			//
+	//////////////////////////////////////
+
+	class RecordingReader {
+
+	private:
+
+		// Miembros privados
+
+		struct Segment {
+			int myFd;
+			const uint8_t* myBase;
+			uint64_t myBytes;
+			const SegmentHeader* myHeader;
+			const FrameIndexEntry* myIndex;
+			uint32_t myNumFrames;
+			uint64_t myDataEnd;
+			unsigned long myFirstFrame;		// número del primer cuadro en la grabación
+			bool myRecovered;
+		};
+
+		std::vector<Segment> mySegments;
+		unsigned long myNumFrames;
+
+		bool openSegment(const char* inPath, Segment* outSegment);
+
+	public:
+
+		// Miembros públicos
+
+		RecordingReader();
+
+		~RecordingReader();
+
+		// Proyecta inPrefix.0000.rec y los segmentos siguientes que existan
+
+		bool open(const char* inPrefix);
+
+		void close();
+
+		int getNumSegments();
+
+		// Segmentos que no se cerraron (grabación interrumpida) y se han recuperado
+
+		int getNumRecovered();
+
+		unsigned long getNumFrames();
+
+		// Cuadro inFrame (0 .. getNumFrames()-1), dentro de la proyección: válido hasta close()
+
+		const DepthRecord* getFrame(unsigned long inFrame);
+
+		// Primer cuadro con StampNs >= inStampNs (búsqueda binaria en los índices), o -1
+
+		long findFrame(int64_t inStampNs);
+
+		// Sitúa el cursor en el cuadro inFrame: next() devuelve ese cuadro y lo grabado después
+
+		bool seekFrame(unsigned long inFrame, RecordCursor* outCursor);
+
+		// Siguiente registro confirmado (en orden de reserva), o NULL al final
+
+		const RecordHeader* next(RecordCursor* ioCursor);
+
+		// Instante de tiempo real (ns desde 1970) de un StampNs de la grabación
+
+		int64_t toRealNs(int64_t inStampNs);
+
+	};
+
+}
+
+#endif /* RECORDER_H_ */
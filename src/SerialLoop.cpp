@@ -0,0 +1,197 @@
+/*
+ * SerialLoop.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	EventLoop: espera de datos serie y plazos con epoll, timerfd y eventfd
+ *
+ */
+
+#include "SerialLoop.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Identificadores del timerfd y del eventfd en los eventos de epoll (los dispositivos usan su índice)
+
+#define TIMER_ID SERIAL_LOOP_MAX_DEVICES
+#define WAKE_ID (SERIAL_LOOP_MAX_DEVICES + 1)
+
+namespace Serial {
+
+	// Constructor
+
+	EventLoop::EventLoop() {
+
+		this->myNumDevices = 0;
+		this->myArmedDeadlineNs = 0;
+
+		this->myEpoll = epoll_create(SERIAL_LOOP_MAX_DEVICES + 2);
+		this->myTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+		this->myWake = eventfd(0, EFD_NONBLOCK);
+
+		if (this->isValid()) {
+			struct epoll_event theEvent;
+			theEvent.events = EPOLLIN;
+			theEvent.data.u32 = TIMER_ID;
+			epoll_ctl(this->myEpoll, EPOLL_CTL_ADD, this->myTimer, &theEvent);
+			theEvent.data.u32 = WAKE_ID;
+			epoll_ctl(this->myEpoll, EPOLL_CTL_ADD, this->myWake, &theEvent);
+		}
+
+	}
+
+	// Destructor
+
+	EventLoop::~EventLoop() {
+
+		if (this->myTimer >= 0) {
+			close(this->myTimer);
+		}
+		if (this->myWake >= 0) {
+			close(this->myWake);
+		}
+		if (this->myEpoll >= 0) {
+			close(this->myEpoll);
+		}
+
+	}
+
+	bool EventLoop::isValid() {
+		return (this->myEpoll >= 0) && (this->myTimer >= 0) && (this->myWake >= 0);
+	}
+
+	bool EventLoop::add(Serial* inDevice) {
+
+		if (!this->isValid() || (this->myNumDevices == SERIAL_LOOP_MAX_DEVICES) || (inDevice->getHandler() < 0)) {
+			return false;
+		}
+
+		struct epoll_event theEvent;
+		theEvent.events = EPOLLIN;
+		theEvent.data.u32 = this->myNumDevices;
+
+		if (epoll_ctl(this->myEpoll, EPOLL_CTL_ADD, inDevice->getHandler(), &theEvent) != 0) {
+			return false;
+		}
+
+		this->myDevices[this->myNumDevices++] = inDevice;
+
+		return true;
+	}
+
+	void EventLoop::remove(Serial* inDevice) {
+
+		for (int d = 0; d < this->myNumDevices; d++) {
+
+			if (this->myDevices[d] != inDevice) {
+				continue;
+			}
+
+			epoll_ctl(this->myEpoll, EPOLL_CTL_DEL, inDevice->getHandler(), NULL);
+
+			// El último ocupa su hueco: se actualiza su índice en epoll
+
+			this->myNumDevices--;
+			if (d < this->myNumDevices) {
+				this->myDevices[d] = this->myDevices[this->myNumDevices];
+				struct epoll_event theEvent;
+				theEvent.events = EPOLLIN;
+				theEvent.data.u32 = d;
+				epoll_ctl(this->myEpoll, EPOLL_CTL_MOD, this->myDevices[d]->getHandler(), &theEvent);
+			}
+			return;
+		}
+
+	}
+
+	LoopEvent EventLoop::wait(int64_t inDeadlineNs, Serial** outDevice) {
+
+		if (!this->isValid()) {
+			return LOOP_ERROR;
+		}
+
+		if (inDeadlineNs <= 0) {
+			inDeadlineNs = 0;
+		}
+
+		// Solo se reprograma el temporizador si cambia el plazo. Un plazo ya
+		// vencido se dispara en seguida (el valor 0 desarmaría el temporizador).
+
+		if (inDeadlineNs != this->myArmedDeadlineNs) {
+
+			struct itimerspec theSpec;
+			theSpec.it_interval.tv_sec = 0;
+			theSpec.it_interval.tv_nsec = 0;
+			theSpec.it_value.tv_sec = inDeadlineNs / 1000000000LL;
+			theSpec.it_value.tv_nsec = inDeadlineNs % 1000000000LL;
+
+			if ((inDeadlineNs > 0) && (theSpec.it_value.tv_sec == 0) && (theSpec.it_value.tv_nsec == 0)) {
+				theSpec.it_value.tv_nsec = 1;
+			}
+
+			if (timerfd_settime(this->myTimer, TFD_TIMER_ABSTIME, &theSpec, NULL) != 0) {
+				return LOOP_ERROR;
+			}
+
+			this->myArmedDeadlineNs = inDeadlineNs;
+		}
+
+		struct epoll_event theEvents[SERIAL_LOOP_MAX_DEVICES + 2];
+
+		int theNumEvents = epoll_wait(this->myEpoll, theEvents, SERIAL_LOOP_MAX_DEVICES + 2, -1);
+
+		if (theNumEvents < 0) {
+			return (errno == EINTR) ? LOOP_TIMEOUT : LOOP_ERROR;
+		}
+
+		// Los datos tienen prioridad sobre wake y el plazo si llegan a la vez
+
+		LoopEvent theResult = LOOP_TIMEOUT;
+
+		for (int e = 0; e < theNumEvents; e++) {
+
+			if (theEvents[e].data.u32 == TIMER_ID) {
+
+				// Se vacía el contador del timerfd; el temporizador queda desarmado
+
+				uint64_t theExpirations;
+				if (read(this->myTimer, &theExpirations, sizeof(theExpirations)) > 0) {
+					this->myArmedDeadlineNs = 0;
+				}
+
+			} else if (theEvents[e].data.u32 == WAKE_ID) {
+
+				uint64_t theWakes;
+				if ((read(this->myWake, &theWakes, sizeof(theWakes)) > 0) && (theResult == LOOP_TIMEOUT)) {
+					theResult = LOOP_WAKE;
+				}
+
+			} else if (theResult != LOOP_DATA) {
+
+				theResult = LOOP_DATA;
+				if (outDevice != NULL) {
+					*outDevice = this->myDevices[theEvents[e].data.u32];
+				}
+			}
+		}
+
+		return theResult;
+	}
+
+	void EventLoop::wake() {
+
+		uint64_t theOne = 1;
+
+		if (write(this->myWake, &theOne, sizeof(theOne)) < 0) {
+			// Contador al máximo: wait ya tiene un aviso pendiente
+		}
+
+	}
+
+}
@@ -0,0 +1,92 @@
+/*
+ * SerialLoop.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Espera de eventos de los dispositivos serie con epoll y timerfd.
+ *
+ *  	EventLoop: duerme hasta que llegan bytes a alguno de los dispositivos
+ *  	           registrados, vence un plazo u otro hilo lo despierta (wake),
+ *  	           sin sondeos ni esperas fijas
+ *
+ */
+
+#ifndef SERIALLOOP_H_
+#define SERIALLOOP_H_
+
+#include <stdint.h>
+#include "Serial_Q.h"
+
+#define SERIAL_LOOP_MAX_DEVICES 8
+
+namespace Serial {
+
+	// Resultado de EventLoop::wait
+
+	enum LoopEvent {
+		LOOP_ERROR = -1,
+		LOOP_TIMEOUT = 0,		// ha vencido el plazo sin datos
+		LOOP_DATA = 1,			// hay bytes disponibles en algún dispositivo
+		LOOP_WAKE = 2			// otro hilo ha llamado a wake
+	};
+
+	//////////////////////////////////////////////////////////////////////
+	// Bucle de eventos de E/S serie									//
+	//																	//
+	//  - Los descriptores de los dispositivos se registran en epoll	//
+	//    (disparo por nivel: mientras queden bytes sin leer, wait		//
+	//    vuelve en seguida)											//
+	//  - El plazo es un timerfd absoluto sobre CLOCK_MONOTONIC, así	//
+	//    que se respeta con resolución de nanosegundos aunque wait		//
+	//    se llame varias veces hasta completar una respuesta			//
+	//  - wake escribe en un eventfd, también registrado en epoll		//
+	//																	//
+	//////////////////////////////////////////////////////////////////////
+
+	class EventLoop {
+
+	private:
+
+		// Miembros privados
+
+		int myEpoll;
+		int myTimer;
+		int myWake;
+		int64_t myArmedDeadlineNs;
+		Serial* myDevices[SERIAL_LOOP_MAX_DEVICES];
+		int myNumDevices;
+
+	public:
+
+		// Miembros públicos
+
+		EventLoop();
+
+		~EventLoop();
+
+		bool isValid();
+
+		// Registra el dispositivo (que sigue siendo del llamante y debe seguir abierto mientras esté registrado)
+
+		bool add(Serial* inDevice);
+
+		void remove(Serial* inDevice);
+
+		// Espera hasta que haya datos en algún dispositivo registrado o hasta inDeadlineNs
+		// (Timing::nowNs; 0 o negativo: sin plazo). Si outDevice no es NULL recibe el
+		// dispositivo con datos (con LOOP_DATA). EINTR se trata como LOOP_TIMEOUT anticipado.
+		// Los datos tienen prioridad sobre wake y wake sobre el plazo.
+
+		LoopEvent wait(int64_t inDeadlineNs, Serial** outDevice = NULL);
+
+		// Hace volver a wait (la que está en curso o la siguiente) con LOOP_WAKE.
+		// Se puede llamar desde cualquier hilo; varias llamadas seguidas cuentan como una.
+
+		void wake();
+
+	};
+
+}
+
+#endif /* SERIALLOOP_H_ */
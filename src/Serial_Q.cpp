@@ -15,12 +15,13 @@
  *  Clases:
  *
  *  	Serial: implementación en C++ de comunicación serie con termios
- *  	Queue: cola
+ *  	Queue: cola circular de bytes
  *  	Serial_Q: clase para comunicación serie simplificada
  *
  */
 
 #include "Serial_Q.h"
+#include "Log.h"
 
 namespace Serial {
 
@@ -37,7 +38,9 @@ namespace Serial {
 		this->myStopBits = inStopBits;
 		this->myReadMode = inReadMode;
 
-		cout << "Iniciando conexión serie en " << this->myDevice << " a " << this->myBaudRate << " bps " << this->myDataBits << this->myParity << this->myStopBits << " en modo " << this->myReadMode << endl;
+		char theSettings[32];
+		snprintf(theSettings, sizeof(theSettings), "%d%d%d en modo %d", this->myDataBits, this->myParity, this->myStopBits, this->myReadMode);
+		Log::info("Iniciando conexión serie en %s a %d bps %s", this->myDevice, this->myBaudRate, theSettings);
 
 		this->mySignalHandler = inSignalHandler;
 		this->LastError = NULL;
@@ -208,7 +211,7 @@ namespace Serial {
 	int Serial::send(const char* inBytes,int inNumBytes) {
 		int theBytesSent;
 		theBytesSent = write(this->myHandler,inBytes, inNumBytes);
-		cout << "Serial::send. Enviados " << theBytesSent << " bytes" << endl;
+		Log::debug("Serial::send. Enviados %d bytes", theBytesSent);
 		return theBytesSent;
 	}
 
@@ -222,14 +225,109 @@ namespace Serial {
 		return theBytesReceived;
 	}
 
+	int Serial::getHandler() {
+		return this->myHandler;
+	}
+
+	bool Serial::setBaudRate(int inBaudRate) {
+
+		// Se espera a que salga lo ya escrito a la velocidad anterior
+
+		tcdrain(this->myHandler);
+
+		this->myNewTIO.c_cflag &= ~CBAUD;
+		this->myNewTIO.c_cflag |= inBaudRate;
+		cfsetispeed(&this->myNewTIO, inBaudRate);
+		cfsetospeed(&this->myNewTIO, inBaudRate);
+
+		if (tcsetattr(this->myHandler, TCSANOW, &this->myNewTIO) != 0) {
+			this->LastError = strerror(errno);
+			return false;
+		}
+
+		// Lo recibido durante el cambio no es fiable
+
+		tcflush(this->myHandler, TCIFLUSH);
+
+		this->myBaudRate = inBaudRate;
+
+		return true;
+	}
+
+	int Serial::getBaudRate() {
+		return this->myBaudRate;
+	}
+
+	// Velocidades habituales de termios
+
+	static const int BaudTable[][2] = {
+		{ 1200, B1200 }, { 2400, B2400 }, { 4800, B4800 }, { 9600, B9600 }, { 19200, B19200 },
+		{ 38400, B38400 }, { 57600, B57600 }, { 115200, B115200 }, { 230400, B230400 }
+	};
+
+	#define BAUD_TABLE_SIZE ((int)(sizeof(BaudTable) / sizeof(BaudTable[0])))
+
+	int Serial::getBaudConstant(int inBps) {
+		for (int i = 0; i < BAUD_TABLE_SIZE; i++) {
+			if (BaudTable[i][0] == inBps) {
+				return BaudTable[i][1];
+			}
+		}
+		return 0;
+	}
+
+	int Serial::getBps(int inBaudRate) {
+		for (int i = 0; i < BAUD_TABLE_SIZE; i++) {
+			if (BaudTable[i][1] == inBaudRate) {
+				return BaudTable[i][0];
+			}
+		}
+		return 0;
+	}
+
 	// Constructor
 
-	Queue::Queue(int inSize) {
+	Queue::Queue(int inSize, OverflowPolicy inPolicy) {
+
+		// Capacidad: potencia de dos >= inSize
+
+		this->mySize = 1;
+		while ((this->mySize < inSize) && (this->mySize < (1 << 30))) {
+			this->mySize <<= 1;
+		}
 
-		this->mySize = inSize;
+		this->myMask = (unsigned int)this->mySize - 1;
 		this->myBuff = (unsigned char *)malloc(this->mySize);
-		this->myNumBytes = 0;
-		this->myHead = 0;
+		this->myLinear = (unsigned char *)malloc(this->mySize + 1);
+		this->myRead = 0;
+		this->myWrite = 0;
+		this->myPolicy = inPolicy;
+		this->myDroppedBytes = 0;
+
+	}
+
+	// Destructor
+
+	Queue::~Queue() {
+		free(this->myBuff);
+		free(this->myLinear);
+	}
+
+	// Tramos de inNumBytes bytes a partir del índice inStart
+
+	void Queue::getView(unsigned int inStart, int inNumBytes, QueueView* outView) {
+
+		int theOffset = (int)(inStart & this->myMask);
+		int theFirst = this->mySize - theOffset;
+
+		if (theFirst > inNumBytes) {
+			theFirst = inNumBytes;
+		}
+
+		outView->Data1 = this->myBuff + theOffset;
+		outView->Length1 = theFirst;
+		outView->Data2 = this->myBuff;
+		outView->Length2 = inNumBytes - theFirst;
 
 	}
 
@@ -237,62 +335,167 @@ namespace Serial {
 
 	void Queue::enqueue(unsigned char inC) {
 
-		if (this->myNumBytes < this->mySize) {
-			this->myHead++;
-			if (this->myHead >= this->mySize) {
-				this->myHead = 0;
+		if (this->getFreeBytes() == 0) {
+			if (this->myPolicy == OVERFLOW_REJECT) {
+				this->myDroppedBytes++;
+				return;
 			}
-			this->myBuff[this->myHead] = inC;
-			this->myNumBytes++;
-		} else {
-			cout << "Overflow!" << endl;
+			this->myRead++;
+			this->myDroppedBytes++;
 		}
 
+		this->myBuff[this->myWrite & this->myMask] = inC;
+		this->myWrite++;
+
+	}
+
+	// Insertar un bloque de bytes en la cola
+
+	int Queue::enqueue(const unsigned char* inBytes, int inNumBytes) {
+
+		if (inNumBytes <= 0) {
+			return 0;
+		}
+
+		int theAccepted = inNumBytes;
+		int theFree = this->getFreeBytes();
+
+		if (inNumBytes > theFree) {
+
+			if (this->myPolicy == OVERFLOW_REJECT) {
+
+				theAccepted = theFree;
+
+			} else {
+
+				// Solo caben los últimos mySize bytes del bloque; se descarta lo más antiguo
+
+				if (inNumBytes > this->mySize) {
+					this->myDroppedBytes += inNumBytes - this->mySize;
+					inBytes += inNumBytes - this->mySize;
+					inNumBytes = this->mySize;
+				}
+				if (inNumBytes > theFree) {
+					this->consume(inNumBytes - theFree);
+					this->myDroppedBytes += inNumBytes - theFree;
+				}
+				theAccepted = inNumBytes;
+			}
+
+			if (theAccepted < inNumBytes) {
+				this->myDroppedBytes += inNumBytes - theAccepted;
+			}
+		}
+
+		QueueView theView;
+
+		this->getView(this->myWrite, theAccepted, &theView);
+		memcpy(theView.Data1, inBytes, theView.Length1);
+		memcpy(theView.Data2, inBytes + theView.Length1, theView.Length2);
+		this->myWrite += theAccepted;
+
+		return theAccepted;
 	}
 
 	// Extraer un byte de la cola
 
 	unsigned char Queue::dequeue() {
 
-		char outByte = 0;
-		int theTail;
+		unsigned char outByte = 0;
 
-		if (this->myNumBytes > 0) {
-			theTail = this->myHead - this->myNumBytes+1;
-			if (theTail < 0) theTail += this->mySize;
-			outByte = this->myBuff[theTail];
-			this->myNumBytes--;
+		if (this->myWrite != this->myRead) {
+			outByte = this->myBuff[this->myRead & this->myMask];
+			this->myRead++;
 		}
 
 		return outByte;
 
 	}
 
+	// Copiar bytes del principio de la cola sin consumirlos
+
+	int Queue::peek(unsigned char* outBytes, int inMaxBytes) {
+
+		int theNumBytes = this->getNumBytes();
+
+		if (inMaxBytes < theNumBytes) {
+			theNumBytes = (inMaxBytes > 0) ? inMaxBytes : 0;
+		}
+
+		QueueView theView;
+
+		this->getView(this->myRead, theNumBytes, &theView);
+		memcpy(outBytes, theView.Data1, theView.Length1);
+		memcpy(outBytes + theView.Length1, theView.Data2, theView.Length2);
+
+		return theNumBytes;
+	}
+
+	// Descartar los bytes más antiguos
+
+	void Queue::consume(int inNumBytes) {
+
+		int theNumBytes = this->getNumBytes();
+
+		if (inNumBytes > theNumBytes) {
+			inNumBytes = theNumBytes;
+		}
+
+		if (inNumBytes > 0) {
+			this->myRead += inNumBytes;
+		}
+
+	}
+
+	void Queue::getContent(QueueView* outView) {
+		this->getView(this->myRead, this->getNumBytes(), outView);
+	}
+
+	void Queue::getFreeSpace(QueueView* outView) {
+		this->getView(this->myWrite, this->getFreeBytes(), outView);
+	}
+
+	void Queue::commit(int inNumBytes) {
+
+		int theFree = this->getFreeBytes();
+
+		if (inNumBytes > theFree) {
+			inNumBytes = theFree;
+		}
+
+		if (inNumBytes > 0) {
+			this->myWrite += inNumBytes;
+		}
+
+	}
+
+	void Queue::clear() {
+		this->myRead = this->myWrite;
+	}
+
 	// Mostrar el contenido de la cola (opcionalmente consumiendo los bytes leidos)
 
 	unsigned char* Queue::getFullContent(bool inDequeueBytes) {
 
-		int i;
-		int theLength = this->myNumBytes;
-		unsigned char* outStr = (unsigned char*)malloc(theLength+1);
+		int theLength = this->peek(this->myLinear, this->mySize);
 
-		if(outStr == NULL) return NULL;
+		this->myLinear[theLength] = '\0';
 
-		for (i=0;i<theLength;i++) {
-			outStr[i] = this->dequeue();
-			if (!inDequeueBytes) {
-				this->enqueue(outStr[i]);
-			}
+		if (inDequeueBytes) {
+			this->consume(theLength);
 		}
-		outStr[theLength] = '\0';
 
-		return outStr;
+		return this->myLinear;
 	}
 
 	// Mostrar el número de bytes disponibles en la cola
 
 	int Queue::getNumBytes() {
-		return this->myNumBytes;
+		return (int)(this->myWrite - this->myRead);
+	}
+
+	int Queue::getFreeBytes() {
+		return this->mySize - (int)(this->myWrite - this->myRead);
 	}
 
 	// Muestrar el tamaño máximo de la cola
@@ -301,27 +504,68 @@ namespace Serial {
 		return this->mySize;
 	}
 
+	void Queue::setOverflowPolicy(OverflowPolicy inPolicy) {
+		this->myPolicy = inPolicy;
+	}
+
+	OverflowPolicy Queue::getOverflowPolicy() {
+		return this->myPolicy;
+	}
+
+	unsigned long Queue::getDroppedBytes() {
+		return this->myDroppedBytes;
+	}
+
 	// Constructor
 
-	Serial_Q::Serial_Q(const char* inDevice, int inBaudRate) :  Serial(inDevice, inBaudRate, DataBits_8, Parity_None, StopBits_1, ReadMode_SyncNonBlocking) {
-		this->myQ = new Queue(256);
+	Serial_Q::Serial_Q(const char* inDevice, int inBaudRate, int inQueueSize, OverflowPolicy inPolicy) :  Serial(inDevice, inBaudRate, DataBits_8, Parity_None, StopBits_1, ReadMode_SyncNonBlocking) {
+		this->myQ = new Queue(inQueueSize, inPolicy);
+	}
+
+	// Destructor
+
+	Serial_Q::~Serial_Q() {
+		delete this->myQ;
 	}
 
-	// Cada llamada a checkDataAndEnqueue() inserta en la cola todos los datos disponibles en el dispositivo
+	// Cada llamada a checkDataAndEnqueue() inserta en la cola todos los datos disponibles en el dispositivo.
+	// Se lee directamente en el espacio libre de la cola. Con la cola llena y OVERFLOW_REJECT los datos
+	// se quedan en el dispositivo; con OVERFLOW_OVERWRITE se leen igualmente descartando los más antiguos.
 
 	bool Serial_Q::checkDataAndEnqueue() {
 
-		int theBytesRead, i;
-		char* theBuff;
+		QueueView theFree;
+		unsigned char theScratch[64];
+		int theBytesRead;
+
+		for (;;) {
 
-		if (this->myQ->getNumBytes() < this->myQ->getSize()) {
-			theBuff = (char*)malloc(32);
-			theBytesRead = Serial::receive(theBuff,32);
-			while ((theBytesRead > 0)&&(this->myQ->getNumBytes() < this->myQ->getSize())) {
-				for (i = 0;i< theBytesRead; i++) {
-					this->myQ->enqueue((unsigned char)theBuff[i]);
+			this->myQ->getFreeSpace(&theFree);
+
+			if (theFree.Length1 > 0) {
+
+				theBytesRead = Serial::receive((char*)theFree.Data1, theFree.Length1);
+				if (theBytesRead <= 0) {
+					break;
 				}
-				theBytesRead = Serial::receive(theBuff,256);
+				this->myQ->commit(theBytesRead);
+
+				// Una lectura incompleta indica que no quedan datos: se ahorra la llamada que lo confirmaría
+
+				if (theBytesRead < theFree.Length1) {
+					break;
+				}
+
+			} else if (this->myQ->getOverflowPolicy() == OVERFLOW_OVERWRITE) {
+
+				theBytesRead = Serial::receive((char*)theScratch, sizeof(theScratch));
+				if (theBytesRead <= 0) {
+					break;
+				}
+				this->myQ->enqueue(theScratch, theBytesRead);
+
+			} else {
+				break;
 			}
 		}
 
@@ -344,6 +588,10 @@ namespace Serial {
 		return this->myQ->getNumBytes();
 	}
 
+	Queue* Serial_Q::getQueue() {
+		return this->myQ;
+	}
+
 }
 
 
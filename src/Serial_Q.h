@@ -40,6 +40,8 @@ extern "C" {
 #define ReadMode_SyncNonBlocking	1
 #define ReadMode_AsyncWithSignal	2
 
+#define SERIAL_Q_DEFAULT_SIZE	256		/* Capacidad por defecto de la cola de Serial_Q */
+
 typedef void (*signalHandler)(int);
 
 namespace Serial {
@@ -85,11 +87,51 @@ namespace Serial {
 		int send(const char* inBytes, int inNumBytes);
 		int receive(char* inBytes, int inMaxNumBytes);
 
+		// Descriptor del dispositivo (para esperar datos con epoll/poll/select)
+
+		int getHandler();
+
+		// Cambia la velocidad (constante Bxxxx) tras enviar lo pendiente y descarta lo recibido
+
+		bool setBaudRate(int inBaudRate);
+		int getBaudRate();
+
+		// Conversión entre bits por segundo y constantes Bxxxx de termios (0 si no existe)
+
+		static int getBaudConstant(int inBps);
+		static int getBps(int inBaudRate);
+
+	};
+
+	//////////////////////////////////////////////////////////////////////
+	// Cola circular de bytes											//
+	//																	//
+	//  - La capacidad se redondea a la siguiente potencia de dos:		//
+	//    los índices de lectura y escritura crecen sin límite y solo	//
+	//    se enmascaran al acceder al buffer (sin divisiones ni ramas)	//
+	//  - Operaciones en bloque (enqueue, peek, consume) y vistas de	//
+	//    dos tramos del contenido y del espacio libre, para leer y		//
+	//    escribir directamente en el buffer sin copias intermedias		//
+	//  - Ninguna operación reserva memoria después del constructor	//
+	//																	//
+	//////////////////////////////////////////////////////////////////////
+
+	// Qué hacer con los bytes que no caben
+
+	enum OverflowPolicy {
+		OVERFLOW_REJECT = 0,		// se descartan los bytes nuevos (se conserva lo más antiguo)
+		OVERFLOW_OVERWRITE = 1		// se descartan los bytes más antiguos (se conserva lo más reciente)
 	};
 
-	//////////
-	// Cola //
-	//////////
+	// Contenido (o espacio libre) de la cola: como máximo dos tramos contiguos.
+	// Length2 es 0 si el contenido no da la vuelta al final del buffer.
+
+	struct QueueView {
+		unsigned char* Data1;
+		int Length1;
+		unsigned char* Data2;
+		int Length2;
+	};
 
 	class Queue {
 
@@ -98,24 +140,70 @@ namespace Serial {
 		// Miembros privados
 
 		int mySize;
+		unsigned int myMask;
 		unsigned char* myBuff;
-		int myHead;
-		int myNumBytes;
+		unsigned char* myLinear;		// copia lineal para getFullContent (mySize + 1 bytes)
+		unsigned int myRead;			// índice (sin enmascarar) del byte más antiguo
+		unsigned int myWrite;			// índice (sin enmascarar) del siguiente byte a escribir
+		OverflowPolicy myPolicy;
+		unsigned long myDroppedBytes;
+
+		void getView(unsigned int inStart, int inNumBytes, QueueView* outView);
 
 	public:
 
 		// Miembros públicos
 
-		Queue(int inSize);
+		// inSize se redondea a la siguiente potencia de dos
+
+		Queue(int inSize, OverflowPolicy inPolicy = OVERFLOW_REJECT);
 
 		~Queue();
 
 		int getNumBytes();
+		int getFreeBytes();
 		int getSize();
+
+		void setOverflowPolicy(OverflowPolicy inPolicy);
+		OverflowPolicy getOverflowPolicy();
+
+		// Bytes descartados por desbordamiento desde la creación de la cola
+
+		unsigned long getDroppedBytes();
+
+		// Contenido de la cola como cadena terminada en '\0', opcionalmente consumiéndolo.
+		// El buffer devuelto pertenece a la cola y es válido hasta la siguiente llamada.
+
 		unsigned char* getFullContent(bool inDequeueBytes);
+
 		unsigned char dequeue();
 		void enqueue(const unsigned char c);
 
+		// Inserta inNumBytes bytes según la política de desbordamiento.
+		// Devuelve el número de bytes de inBytes que se han insertado.
+
+		int enqueue(const unsigned char* inBytes, int inNumBytes);
+
+		// Copia hasta inMaxBytes bytes del principio de la cola sin consumirlos. Devuelve los copiados.
+
+		int peek(unsigned char* outBytes, int inMaxBytes);
+
+		// Descarta los inNumBytes bytes más antiguos (o todos si hay menos)
+
+		void consume(int inNumBytes);
+
+		// Contenido actual, sin copiarlo. Válido hasta la siguiente operación que modifique la cola.
+
+		void getContent(QueueView* outView);
+
+		// Espacio libre a continuación del contenido. Tras escribir en él, commit() añade
+		// a la cola los primeros inNumBytes bytes escritos.
+
+		void getFreeSpace(QueueView* outView);
+		void commit(int inNumBytes);
+
+		void clear();
+
 	};
 
 	//////////////////////////////////////////////////////////////////////////////
@@ -137,13 +225,21 @@ namespace Serial {
 
 	public:
 
-		Serial_Q(const char* inDevice, int inBaudRate);
+		// inQueueSize: capacidad de la cola de recepción (se redondea a potencia de dos)
+
+		Serial_Q(const char* inDevice, int inBaudRate, int inQueueSize = SERIAL_Q_DEFAULT_SIZE, OverflowPolicy inPolicy = OVERFLOW_REJECT);
+
+		~Serial_Q();
 
 		bool checkDataAndEnqueue();
 		unsigned char dequeue();
 		unsigned char* getFullQueueContent(bool inDequeueBytes);
 		int getNumBytesInQ();
 
+		// Cola de recepción, para las operaciones en bloque y las vistas sin copia
+
+		Queue* getQueue();
+
 	};
 
 }
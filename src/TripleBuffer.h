@@ -0,0 +1,129 @@
+/*
+ * TripleBuffer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Triple buffer sin bloqueos para un productor y un consumidor.
+ *
+ *  El productor escribe siempre en su buffer (back) y lo publica intercambiándolo
+ *  atómicamente con el buffer intermedio. El consumidor toma el intermedio
+ *  intercambiándolo con el suyo (front). Así el consumidor siempre obtiene el dato
+ *  más reciente y los datos que no llegó a tomar se descartan (y se cuentan),
+ *  sin que ninguno de los dos hilos espere nunca al otro.
+ *
+ */
+
+#ifndef TRIPLEBUFFER_H_
+#define TRIPLEBUFFER_H_
+
+namespace Threads {
+
+	template <class T> class TripleBuffer {
+
+	private:
+
+		// Miembros privados
+
+		static const int FRESH = 4;		// el buffer intermedio tiene un dato no consumido
+
+		T mySlots[3];
+		volatile int myMiddle;			// índice del intermedio | FRESH
+		int myBack;						// solo lo usa el productor
+		int myFront;					// solo lo usa el consumidor
+		volatile unsigned long myPublished;
+		volatile unsigned long myDropped;
+
+		// Intercambio atómico (los __sync_* son barreras completas)
+
+		int exchangeMiddle(int inValue) {
+			int theOld;
+			do {
+				theOld = this->myMiddle;
+			} while (!__sync_bool_compare_and_swap(&this->myMiddle, theOld, inValue));
+			return theOld;
+		}
+
+	public:
+
+		// Miembros públicos
+
+		TripleBuffer() {
+			this->myFront = 0;
+			this->myMiddle = 1;
+			this->myBack = 2;
+			this->myPublished = 0;
+			this->myDropped = 0;
+		}
+
+		// Productor: buffer en el que escribir el siguiente dato
+
+		T& getBack() {
+			return this->mySlots[this->myBack];
+		}
+
+		// Productor: publica el buffer back
+
+		void publish() {
+
+			int theOld = this->exchangeMiddle(this->myBack | FRESH);
+
+			this->myBack = theOld & ~FRESH;
+			__sync_fetch_and_add(&this->myPublished, 1);
+
+			// El consumidor no llegó a tomar el dato anterior
+
+			if (theOld & FRESH) {
+				__sync_fetch_and_add(&this->myDropped, 1);
+			}
+		}
+
+		// Consumidor: indica si hay un dato nuevo sin tomar
+
+		bool hasFresh() {
+			return (this->myMiddle & FRESH) != 0;
+		}
+
+		// Consumidor: toma el dato más reciente (quedará en getFront()).
+		// Devuelve false si no hay nada nuevo desde la última vez.
+
+		bool take() {
+
+			if (!this->hasFresh()) {
+				return false;
+			}
+
+			// Solo el consumidor borra la marca FRESH: el intercambio siempre toma un dato nuevo
+
+			this->myFront = this->exchangeMiddle(this->myFront) & ~FRESH;
+			return true;
+		}
+
+		// Consumidor: último dato tomado
+
+		T& getFront() {
+			return this->mySlots[this->myFront];
+		}
+
+		unsigned long getPublished() {
+			return __sync_fetch_and_add(&this->myPublished, 0);
+		}
+
+		unsigned long getDropped() {
+			return __sync_fetch_and_add(&this->myDropped, 0);
+		}
+
+		// Vacía los tres buffers. Solo con el productor y el consumidor parados.
+
+		void clear() {
+			for (int i = 0; i < 3; i++) {
+				this->mySlots[i] = T();
+			}
+			this->myMiddle &= ~FRESH;
+		}
+
+	};
+
+}
+
+#endif /* TRIPLEBUFFER_H_ */
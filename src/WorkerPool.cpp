@@ -0,0 +1,182 @@
+/*
+ * WorkerPool.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Clases:
+ *
+ *  	WorkerPool: grupo fijo de hilos (pthreads) fijados a CPU
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "WorkerPool.h"
+
+#include <iostream>
+#include <cstring>
+#include <sched.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace Threads {
+
+	// Constructor
+
+	WorkerPool::WorkerPool(int inNumThreads, int inFirstCpu) {
+
+		int theNumCpus = getNumCpus();
+
+		this->myNumThreads = (inNumThreads > 0) ? inNumThreads : theNumCpus;
+		this->myJob = NULL;
+		this->myGeneration = 0;
+		this->myPending = 0;
+		this->myStop = false;
+
+		pthread_mutex_init(&this->myMutex, NULL);
+		pthread_cond_init(&this->myStartCond, NULL);
+		pthread_cond_init(&this->myDoneCond, NULL);
+
+		// La parte 0 la ejecuta el hilo llamante. Creamos el resto
+
+		this->myWorkers = new Worker[this->myNumThreads];
+
+		for (int i = 1; i < this->myNumThreads; i++) {
+
+			Worker* theWorker = &this->myWorkers[i];
+			theWorker->myPool = this;
+			theWorker->myIndex = i;
+
+			int theError = pthread_create(&theWorker->myThread, NULL, workerMain, theWorker);
+
+			if (theError != 0) {
+				// Sin más hilos: el grupo se queda con los creados hasta ahora
+				cout << "WorkerPool: no se pudo crear el hilo " << i << ": " << strerror(theError) << endl;
+				this->myNumThreads = i;
+				break;
+			}
+
+			// Fijamos el hilo a su CPU para no perder la caché entre cuadros
+
+			setAffinity(theWorker->myThread, inFirstCpu + i, 1);
+		}
+
+	}
+
+	// Destructor
+
+	WorkerPool::~WorkerPool() {
+
+		pthread_mutex_lock(&this->myMutex);
+		this->myStop = true;
+		pthread_cond_broadcast(&this->myStartCond);
+		pthread_mutex_unlock(&this->myMutex);
+
+		for (int i = 1; i < this->myNumThreads; i++) {
+			pthread_join(this->myWorkers[i].myThread, NULL);
+		}
+
+		delete[] this->myWorkers;
+
+		pthread_cond_destroy(&this->myDoneCond);
+		pthread_cond_destroy(&this->myStartCond);
+		pthread_mutex_destroy(&this->myMutex);
+
+	}
+
+	int WorkerPool::getNumThreads() {
+		return this->myNumThreads;
+	}
+
+	int WorkerPool::getNumCpus() {
+		long theNumCpus = sysconf(_SC_NPROCESSORS_ONLN);
+		return (theNumCpus > 0) ? (int)theNumCpus : 1;
+	}
+
+	bool WorkerPool::setAffinity(pthread_t inThread, int inFirstCpu, int inNumCpus) {
+
+		int theNumCpus = getNumCpus();
+
+		cpu_set_t theCpus;
+		CPU_ZERO(&theCpus);
+		for (int c = 0; (c < inNumCpus) && (c < theNumCpus); c++) {
+			CPU_SET((inFirstCpu + c) % theNumCpus, &theCpus);
+		}
+
+		return pthread_setaffinity_np(inThread, sizeof(theCpus), &theCpus) == 0;
+	}
+
+	void WorkerPool::run(Job* inJob) {
+
+		if (this->myNumThreads == 1) {
+			inJob->run(0, 1);
+			return;
+		}
+
+		// Despertamos a los hilos con una nueva generación de trabajo
+
+		pthread_mutex_lock(&this->myMutex);
+		this->myJob = inJob;
+		this->myPending = this->myNumThreads - 1;
+		this->myGeneration++;
+		pthread_cond_broadcast(&this->myStartCond);
+		pthread_mutex_unlock(&this->myMutex);
+
+		inJob->run(0, this->myNumThreads);
+
+		// Esperamos a que terminen todas las partes
+
+		pthread_mutex_lock(&this->myMutex);
+		while (this->myPending > 0) {
+			pthread_cond_wait(&this->myDoneCond, &this->myMutex);
+		}
+		this->myJob = NULL;
+		pthread_mutex_unlock(&this->myMutex);
+
+	}
+
+	void* WorkerPool::workerMain(void* inWorker) {
+		Worker* theWorker = (Worker*)inWorker;
+		theWorker->myPool->workerLoop(theWorker->myIndex);
+		return NULL;
+	}
+
+	void WorkerPool::workerLoop(int inIndex) {
+
+		unsigned int theSeenGeneration = 0;
+
+		pthread_mutex_lock(&this->myMutex);
+
+		while (true) {
+
+			while ((this->myGeneration == theSeenGeneration) && !this->myStop) {
+				pthread_cond_wait(&this->myStartCond, &this->myMutex);
+			}
+
+			if (this->myStop) {
+				break;
+			}
+
+			theSeenGeneration = this->myGeneration;
+			Job* theJob = this->myJob;
+			int theNumParts = this->myNumThreads;
+
+			pthread_mutex_unlock(&this->myMutex);
+			theJob->run(inIndex, theNumParts);
+			pthread_mutex_lock(&this->myMutex);
+
+			this->myPending--;
+			if (this->myPending == 0) {
+				pthread_cond_signal(&this->myDoneCond);
+			}
+		}
+
+		pthread_mutex_unlock(&this->myMutex);
+
+	}
+
+}
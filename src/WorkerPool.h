@@ -0,0 +1,97 @@
+/*
+ * WorkerPool.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Grupo fijo de hilos de trabajo, creados una sola vez y fijados cada uno a una CPU.
+ *
+ *  	Job: trabajo divisible en partes independientes
+ *  	WorkerPool: ejecuta en paralelo las partes de un Job y espera a que terminen
+ *
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <pthread.h>
+
+namespace Threads {
+
+	//////////////////////////////////////////////////////
+	// Trabajo a repartir entre los hilos del grupo		//
+	//////////////////////////////////////////////////////
+
+	class Job {
+
+	public:
+
+		virtual ~Job() {}
+
+		// Se llama una vez por cada parte (inPart = 0 .. inNumParts-1), cada una en un hilo distinto
+
+		virtual void run(int inPart, int inNumParts) = 0;
+
+	};
+
+	//////////////////////
+	// Grupo de hilos 	//
+	//////////////////////
+
+	class WorkerPool {
+
+	private:
+
+		// Miembros privados
+
+		struct Worker {
+			WorkerPool* myPool;
+			int myIndex;
+			pthread_t myThread;
+		};
+
+		int myNumThreads;
+		Worker* myWorkers;
+
+		pthread_mutex_t myMutex;
+		pthread_cond_t myStartCond;
+		pthread_cond_t myDoneCond;
+
+		Job* myJob;
+		unsigned int myGeneration;
+		int myPending;
+		bool myStop;
+
+		static void* workerMain(void* inWorker);
+		void workerLoop(int inIndex);
+
+	public:
+
+		// Miembros públicos
+
+		// inNumThreads <= 0 usa tantos hilos como CPUs en línea.
+		// El hilo que llama a run() ejecuta la parte 0, por lo que se crean inNumThreads-1 hilos.
+		// El hilo de la parte i se fija a la CPU (inFirstCpu + i) módulo el número de CPUs.
+
+		WorkerPool(int inNumThreads, int inFirstCpu = 0);
+
+		~WorkerPool();
+
+		int getNumThreads();
+
+		// Ejecuta todas las partes de inJob y vuelve cuando han terminado.
+		// No es reentrante: un único hilo debe usar cada grupo.
+
+		void run(Job* inJob);
+
+		static int getNumCpus();
+
+		// Fija inThread a las CPU inFirstCpu .. inFirstCpu + inNumCpus - 1 (módulo el número de CPUs)
+
+		static bool setAffinity(pthread_t inThread, int inFirstCpu, int inNumCpus);
+
+	};
+
+}
+
+#endif /* WORKERPOOL_H_ */
@@ -0,0 +1,144 @@
+/*
+ * ptu_sim.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  PTU-46 simulada en un pseudoterminal, para usar ptu_xtion sin el hardware:
+ *
+ *  	ptu_sim -b 9600 &
+ *  	ptu_xtion -d /dev/pts/N
+ *
+ *  Funciona hasta recibir SIGINT o SIGTERM; con SIGUSR1 muestra los contadores.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <getopt.h>
+#include <unistd.h>
+#include "PtuSim.h"
+
+// Terminación (SIGINT, SIGTERM) y volcado de contadores (SIGUSR1)
+
+volatile sig_atomic_t theStopRequested = 0;
+volatile sig_atomic_t theStatsRequested = 0;
+
+void onStopSignal(int inSignal) {
+	(void)inSignal;
+	theStopRequested = 1;
+}
+
+void onStatsSignal(int inSignal) {
+	(void)inSignal;
+	theStatsRequested = 1;
+}
+
+void printUsage(const char* inProgram) {
+
+	printf("Uso: %s [opciones]\n", inProgram);
+	printf("  -b, --baud bps              velocidad inicial del enlace (por defecto 9600, 0 sin límite)\n");
+	printf("  -p, --pan-speed pasos/s     velocidad de pan (por defecto %d, 0 movimiento instantáneo)\n", PTU_SIM_DEFAULT_SPEED);
+	printf("  -t, --tilt-speed pasos/s    velocidad de tilt (por defecto %d)\n", PTU_SIM_DEFAULT_SPEED);
+	printf("  -r, --reply-delay us        tiempo de proceso de cada orden\n");
+	printf("  -x, --drop p                probabilidad de no responder a una orden\n");
+	printf("  -e, --error p               probabilidad de responder '!' sin ejecutar la orden\n");
+	printf("  -c, --corrupt p             probabilidad de alterar cada byte de respuesta\n");
+	printf("  -z, --stall p:ms            probabilidad de retrasar una respuesta ms milisegundos\n");
+	printf("  -S, --seed n                semilla de los fallos\n");
+	printf("  -h, --help                  muestra esta ayuda\n");
+
+}
+
+int main(int argc, char ** argv) {
+
+	Sim::PtuSimConfig theConfig;
+
+	static struct option theOptions[] = {
+		{ "baud",	required_argument,	NULL, 'b' },
+		{ "pan-speed",	required_argument,	NULL, 'p' },
+		{ "tilt-speed",	required_argument,	NULL, 't' },
+		{ "reply-delay",	required_argument,	NULL, 'r' },
+		{ "drop",	required_argument,	NULL, 'x' },
+		{ "error",	required_argument,	NULL, 'e' },
+		{ "corrupt",	required_argument,	NULL, 'c' },
+		{ "stall",	required_argument,	NULL, 'z' },
+		{ "seed",	required_argument,	NULL, 'S' },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int theOption;
+
+	while ((theOption = getopt_long(argc, argv, "b:p:t:r:x:e:c:z:S:h", theOptions, NULL)) != -1) {
+		switch (theOption) {
+			case 'b':
+				theConfig.Bps = atoi(optarg);
+				break;
+			case 'p':
+				theConfig.PanSpeed = atof(optarg);
+				break;
+			case 't':
+				theConfig.TiltSpeed = atof(optarg);
+				break;
+			case 'r':
+				theConfig.ReplyDelayUs = atoi(optarg);
+				break;
+			case 'x':
+				theConfig.DropRate = atof(optarg);
+				break;
+			case 'e':
+				theConfig.ErrorRate = atof(optarg);
+				break;
+			case 'c':
+				theConfig.CorruptRate = atof(optarg);
+				break;
+			case 'z':
+				if (sscanf(optarg, "%f:%d", &theConfig.StallRate, &theConfig.StallMs) != 2) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'S':
+				theConfig.Seed = (unsigned int)atoi(optarg);
+				break;
+			case 'h':
+				printUsage(argv[0]);
+				return 0;
+			default:
+				printUsage(argv[0]);
+				return 1;
+		}
+	}
+
+	Sim::PtuSimulator theSimulator(theConfig);
+
+	if ((theSimulator.LastError != NULL) || !theSimulator.start()) {
+		printf("No se puede iniciar el simulador: %s\n", (theSimulator.LastError != NULL) ? theSimulator.LastError : "sin hilo");
+		return 1;
+	}
+
+	signal(SIGINT, onStopSignal);
+	signal(SIGTERM, onStopSignal);
+	signal(SIGUSR1, onStatsSignal);
+
+	printf("PTU-46 simulada en %s (%d bps)\n", theSimulator.getDeviceName(), theConfig.Bps);
+	fflush(stdout);
+
+	while (!theStopRequested) {
+
+		pause();
+
+		if (theStatsRequested) {
+			theStatsRequested = 0;
+			theSimulator.printStats();
+			fflush(stdout);
+		}
+	}
+
+	theSimulator.stop();
+	theSimulator.printStats();
+
+	return 0;
+}
@@ -1,55 +1,162 @@
 #include <iostream>
 #include <OpenNI.h>
 #include <cmath>
+#include <ctime>
+#include <getopt.h>
+#include <csignal>
+#include <vector>
+#include <unistd.h>
 #include "ros/ros.h"
 #include "Serial_Q.h"
+#include "SerialLoop.h"
+#include "PtuComm.h"
+#include "PtuMotion.h"
+#include "DepthMin.h"
+#include "ClosestPoint.h"
+#include "DepthTracker.h"
+#include "DepthStats.h"
+#include "DepthWorld.h"
+#include "Capture.h"
+#include "ModeScheduler.h"
+#include "Recorder.h"
+#include "WorkerPool.h"
+#include "Latency.h"
+#include "Log.h"
 
 #define PI 3.14159265359
-#define PAN_RESOLUTION 	185.1428
-#define TILT_RESOLUTION 185.1428
-#define SERIALDEVICE	"/dev/ttyUSB0"
+// Puerto de la PTU y velocidad máxima a negociar (--device, --baud)
 
-#define PAN		0
-#define TILT 	1
+#define DEFAULT_SERIAL_DEVICE	"/dev/ttyUSB0"
+#define DEFAULT_MAX_BPS			38400
 
-#define ABSOLUTE 0
-#define RELATIVE 1
+// Tamaño de cada fichero de registro (--log-file) antes de rotarlo
+
+#define LOG_FILE_MB				16
+
+// Tamaño de cada segmento de la grabación (--record)
+
+#define RECORD_SEGMENT_MB		256
 
 #define OFFSET_CAMARA_EJE_TILT_MM 70
 
-enum estado {
-	IDLE = 0,
-	WAIT_COMMAND_CONF = 1,
-	WAIT_POS_PAN = 2,
-	WAIT_POS_TILT = 3
+// Calibración del rango automático (--auto-gate): el grupo de pixeles más cercano
+// (el chasis) debe aparecer en la mayoría de los primeros cuadros
+
+#define AUTO_GATE_FRAMES	30
+#define AUTO_GATE_MIN_HITS	20
+#define AUTO_GATE_MAX_NEAR_MM	800
+#define AUTO_GATE_GAP_MM	40
+#define AUTO_GATE_MIN_FRACTION	0.005f
+
+// Lectura de la posición de las articulaciones (veces por segundo, cuando no hay movimientos que enviar)
+
+#define JOINT_POLL_HZ	5
+
+// Predicción (--predict): adelanto sobre la latencia medida. Antes de la primera confirmación
+// de la PTU se supone PREDICT_DEFAULT_ACK_NS; a la medida se suma el tiempo entre la captura
+// del cuadro y su lectura (no medible en valor absoluto: se supone un periodo de cuadro)
+
+#define PREDICT_SENSOR_LATENCY_NS	33000000LL
+#define PREDICT_DEFAULT_ACK_NS		20000000LL
+
+// Etapas del procesado de cada cuadro (tiempos medidos en el hilo de procesado de cada unidad)
+
+enum Stage {
+	STAGE_READ = 0,			// espera y lectura del cuadro
+	STAGE_STATS = 1,		// estadísticas y rango automático
+	STAGE_DETECT = 2,		// punto más cercano
+	STAGE_WORLD = 3,		// conversión a coordenadas del mundo
+	STAGE_COMMAND = 4,		// ángulos y órdenes a la PTU
+	STAGE_RECORD = 5,		// copia del cuadro a la grabación (ya con la medida en la PTU)
+	NUM_STAGES = 6
 };
 
-estado STATUS = IDLE;
+static const char* StageNames[NUM_STAGES] = { "lectura", "estadisticas", "deteccion", "conversion", "orden", "grabacion" };
 
-using namespace std;
+// Latencias de cada cuadro desde que readFrame lo entrega (Capture::DepthCapture::waitFrame).
+// LATENCY_SENSOR compara el instante de captura del sensor (reloj del dispositivo) con la
+// lectura: se mide el exceso sobre el menor desfase observado, no el valor absoluto.
 
-openni::Status theStatus;
-openni::Device theDevice;
-openni::VideoStream theDepth;
+enum FrameLatency {
+	LATENCY_SENSOR = 0,		// captura -> lectura (exceso sobre el mínimo)
+	LATENCY_QUEUE = 1,		// lectura -> inicio del procesado
+	LATENCY_DETECT = 2,		// lectura -> punto más cercano
+	LATENCY_WORLD = 3,		// lectura -> coordenadas del mundo
+	NUM_FRAME_LATENCIES = 4
+};
+
+static const char* FrameLatencyNames[NUM_FRAME_LATENCIES] = { "captura->lectura", "lectura->proceso", "lectura->punto", "lectura->mundo" };
+
+using namespace std;
 
 //ros::NodeHandle* myNodeHandle = 0;
 
-Serial::Serial_Q *Ptu;
+// Peticiones de volcado de las latencias (SIGUSR1). Cada hilo recuerda las que ha atendido.
+
+volatile sig_atomic_t theLatencyDumpRequests = 0;
+
+// Opciones comunes a todas las unidades
+
+struct UnitOptions {
+
+	Depth::SearchMode SearchMode;
+	bool Tracking;
+	bool Replay;				// grabaciones sin límite de velocidad y sin PTU
+	int SettleMs;
+	int Near;
+	int Far;
+	bool AutoGate;
+	bool Stats;
+	int LatencyPeriodS;
+	float JointPollHz;
+	bool Predict;
+	bool AdaptiveMode;			// alterna entre el modo de adquisición y el de precisión
+	bool RecordRaw;				// graba los cuadros sin comprimir
+
+	UnitOptions() {
+		this->SearchMode = Depth::SEARCH_FULL;
+		this->Tracking = false;
+		this->Replay = false;
+		this->SettleMs = 1500;
+		this->Near = 1;
+		this->Far = 0xfffe;
+		this->AutoGate = false;
+		this->Stats = false;
+		this->LatencyPeriodS = 0;
+		this->JointPollHz = JOINT_POLL_HZ;
+		this->Predict = false;
+		this->AdaptiveMode = false;
+		this->RecordRaw = false;
+	}
 
-class Pixel3D {
+};
 
-public:
+// Sensor y PTU de una unidad (--unit uri,dispositivo[,cpus])
 
-  int X;
-  int Y;
-  unsigned short int Z;
+struct UnitConfig {
 
-  void print() {
-	  printf("Pixel3D (%d,%d,%d)\n",X,Y,Z);
-  }
+	string Uri;			// URI o número de serie del sensor, o fichero .oni (vacío: el último sensor)
+	string Device;		// puerto serie de la PTU (vacío: sin PTU)
+	string Record;		// prefijo de los segmentos de la grabación (vacío: no se graba)
+	int FirstCpu;
+	int NumCpus;		// 0: hilos sin fijar y búsqueda con todas las CPU
+
+	UnitConfig() {
+		this->FirstCpu = 0;
+		this->NumCpus = 0;
+	}
 
 };
 
+// Del hilo de procesado al de la PTU: punto más cercano de un cuadro
+
+struct Measurement {
+	float Camera[3];	// coordenadas de la cámara (mm)
+	float PanDeg;		// movimiento relativo que centra el punto
+	float TiltDeg;
+	int64_t ReadNs;		// lectura del cuadro (Timing::nowNs)
+};
+
 class Point {
 
 public:
@@ -71,7 +178,7 @@ public:
 	}
 
 	void print() {
-		printf("Point (%g,%g,%g)\n",X,Y,Z);
+		Log::debug("Point (%g,%g,%g)",X,Y,Z);
 	}
 
 };
@@ -125,42 +232,49 @@ public:
 	}
 
 	void print() {
-		printf("Point (%g,%g,%g)\n",this->X,this->Y,this->Z);
+		Log::debug("Point (%g,%g,%g)",this->X,this->Y,this->Z);
 	}
 
+	// Los ángulos solo se calculan si el nivel debug llega a alguna salida
+
 	void printPanTilt() {
-		printf("MODULO: %g, PAN: %g, TILT: %g \n",this->getModulo(),this->getPan(),this->getTilt());
+		if (Log::isEnabled(Log::LEVEL_DEBUG)) {
+			Log::debug("MODULO: %g, PAN: %g, TILT: %g",this->getModulo(),this->getPan(),this->getTilt());
+		}
 	}
 
 	void printPanTiltDeg() {
-		printf("MODULO: %d, PAN: %d, TILT: %d \n",(int)this->getModulo(),(int)(this->getPan()*180/PI),(int)(this->getTilt()*180/PI));
+		if (Log::isEnabled(Log::LEVEL_DEBUG)) {
+			Log::debug("MODULO: %d, PAN: %d, TILT: %d",(int)this->getModulo(),(int)(this->getPan()*180/PI),(int)(this->getTilt()*180/PI));
+		}
 	}
 
 };
 
 
+
+
 // Obtiene las coordenadas del punto con menor profundidad
 // Las coordenadas X e Y identifican un número de pixel dentro del cuadro
 // La coordenada Z es la profundidad
-openni::Status calculaPuntoMasCercano(Pixel3D* closestPoint, openni::VideoFrameRef* rawFrame) {
+// Con inTracker (no NULL) se busca primero en la ventana alrededor del punto anterior
+openni::Status calculaPuntoMasCercano(Depth::ClosestPointFinder* inFinder, Depth::ClosestPointTracker* inTracker, Pixel3D* closestPoint, openni::VideoFrameRef* rawFrame) {
 
-	openni::DepthPixel* pDepth = (openni::DepthPixel*)rawFrame->getData();
-	bool found = false;
-	closestPoint->Z = 0xffff;
+	const openni::DepthPixel* pDepth = (const openni::DepthPixel*)rawFrame->getData();
 	int width = rawFrame->getWidth();
 	int height = rawFrame->getHeight();
 
-	for (int y = 0; y < height; ++y)
-		for (int x = 0; x < width; ++x, ++pDepth)
-		{
-			if (*pDepth < closestPoint->Z && *pDepth != 0)
-			{
-				closestPoint->X = x;
-				closestPoint->Y = y;
-				closestPoint->Z = *pDepth;
-				found = true;
-			}
-		}
+	// El cuadro se reparte por bandas entre los hilos del grupo de la unidad.
+	// Cada banda usa la versión vectorial de Depth::findMin si la CPU la soporta
+	// (mismo resultado que el recorrido pixel a pixel)
+
+	bool found;
+
+	if (inTracker != NULL) {
+		found = inTracker->find(pDepth, width, height, closestPoint);
+	} else {
+		found = inFinder->find(pDepth, width, height, closestPoint);
+	}
 
 	if (!found)
 	{
@@ -170,319 +284,1195 @@ openni::Status calculaPuntoMasCercano(Pixel3D* closestPoint, openni::VideoFrameR
 	return openni::STATUS_OK;
 }
 
-bool getPosCommand(float inDeg, int inTargetJoint, int inMode, char* outCommand) {
+void onLatencyDumpSignal(int inSignal) {
+	(void)inSignal;
+	theLatencyDumpRequests++;
+}
 
-	int thePosVal;
-	char theParam = 'P';
-	char theMode = ABSOLUTE;
-	bool ok = true;
+//////////////////////////////////////////////////////////////////////
+// Unidad: un sensor y la PTU que lo mueve							//
+//																	//
+//  - Hilo de captura: el de OpenNI del dispositivo					//
+//  - Hilo de procesado: punto más cercano de cada cuadro, con su	//
+//    propio grupo de hilos de búsqueda								//
+//  - Hilo de la PTU: su propio PtuLink, el arbitraje de			//
+//    movimientos y la predicción; duerme en un Serial::EventLoop	//
+//    hasta que responde la PTU, vence un plazo o llega una medida	//
+//  - El procesado pasa las medidas a la PTU por un triple buffer:	//
+//    solo cuenta la más reciente y ninguno espera al otro			//
+//  - Con CPU asignadas, los tres hilos y el grupo se quedan en		//
+//    ellas: las unidades no se disputan CPU, cachés ni cerrojos	//
+//																	//
+//////////////////////////////////////////////////////////////////////
 
-	switch(inTargetJoint) {
-		case PAN:
-			thePosVal = (int) (inDeg * 3600 / PAN_RESOLUTION);
-			theParam = 'P';
-			break;
-		case TILT:
-			thePosVal = (int) (inDeg * 3600 / TILT_RESOLUTION);
-			theParam = 'T';
-			break;
-		default: 	// inesperado
-			ok = false;
-	}
+class TrackingUnit {
 
-	switch (inMode) {
-		case ABSOLUTE:	// PP o TP
-			theMode = 'P';
-			break;
-		case RELATIVE:	// PO o TO
-			theMode = 'O';
-			break;
-		default: 	// inesperado
-			ok = false;
-	}
+private:
 
-	if (ok) {
-		sprintf(outCommand,"%c%c%d ",theParam,theMode,thePosVal);
-	}
+	// Miembros privados
+
+	int myIndex;
+	UnitConfig myConfig;
+	const UnitOptions* myOptions;
+
+	// Captura y procesado (solo los usa el hilo de procesado)
+
+	Capture::DepthCapture myCapture;
+	Threads::WorkerPool* myWorkerPool;
+	Depth::ClosestPointFinder* myClosestPointFinder;
+	Depth::ClosestPointTracker* myClosestPointTracker;		// NULL sin --track
+	Depth::DepthStats* myDepthStats;						// NULL si no se calculan
+	Depth::WorldConverter myWorldConverter;
+	Capture::ModeScheduler myModeScheduler;		// solo con --adaptive-mode y un sensor
+
+	// Grabación de los cuadros (hilo de procesado) y de la PTU (hilo de la PTU, por su enlace)
+
+	Record::Recorder myRecorder;
+
+	Timing::LatencyHistogram myStageLatency[NUM_STAGES];
+	Timing::LatencyHistogram myFrameLatency[NUM_FRAME_LATENCIES];
+
+	unsigned long myNumFrames;
+	unsigned long myNumCommands;
+	int64_t myStartNs;
+
+	// PTU (solo la usa el hilo de la PTU, salvo al abrirla y cerrarla)
+
+	PtuLink myLink;
+	bool myHasPtu;
+	Serial::EventLoop* myLoop;
+	Motion::MotionArbiter myMotion;
+	Motion::TargetPredictor myPredictor;
+	int64_t myLastMoveNs;
+	unsigned long myNumMeasurements;
+
+	Threads::TripleBuffer<Measurement> myMeasurements;
+
+	pthread_t myProcessThread;
+	pthread_t myPtuThread;
+	bool myProcessRunning;
+	bool myPtuRunning;
+	volatile bool myStopping;
+
+	static void* processMain(void* inUnit);
+	static void* ptuMain(void* inUnit);
+
+	void processLoop();
+	void ptuLoop();
+	void handleMeasurement(const Measurement& inMeasurement);
+	void switchVideoMode(Capture::ModeKind inPrevious);
+
+	void printLatencies(int64_t inElapsedNs);
+	void printPtuLatencies();
+
+public:
 
-	printf("%s\n",outCommand);
+	// Miembros públicos
 
-	return ok;
+	TrackingUnit(int inIndex, const UnitConfig& inConfig, const UnitOptions* inOptions);
+
+	~TrackingUnit();
+
+	bool hasPtu();
+
+	// Abre el puerto de la PTU y sube la velocidad del enlace hasta inMaxBps
+
+	bool openPtu(int inMaxBps);
+
+	// Mide el enlace con la PTU (benchPtuLink)
+
+	void benchPtu(int inRounds);
+
+	// Abre el sensor o la grabación (inUri: URI ya resuelta) y crea el grupo de hilos y las
+	// etapas de procesado
+
+	bool openCapture(const char* inUri);
+
+	// Arranca la grabación (con --record) y los hilos de procesado y de la PTU
+
+	bool start();
+
+	// Pide a los hilos que terminen: despierta a la PTU y deja de esperar cuadros.
+	// Después hay que llamar a join.
+
+	void stop();
+
+	// Espera a que termine el procesado (solo termina en reproducción o tras stop), para la PTU y
+	// cierra la grabación
+
+	void join();
+
+	unsigned long getNumFrames();
+
+};
+
+// Constructor
+
+TrackingUnit::TrackingUnit(int inIndex, const UnitConfig& inConfig, const UnitOptions* inOptions) : myMotion(&this->myLink) {
+
+	this->myIndex = inIndex;
+	this->myConfig = inConfig;
+	this->myOptions = inOptions;
+
+	this->myWorkerPool = NULL;
+	this->myClosestPointFinder = NULL;
+	this->myClosestPointTracker = NULL;
+	this->myDepthStats = NULL;
+
+	this->myNumFrames = 0;
+	this->myNumCommands = 0;
+	this->myStartNs = 0;
+
+	this->myHasPtu = false;
+	this->myLoop = NULL;
+	this->myLastMoveNs = 0;
+	this->myNumMeasurements = 0;
+
+	this->myProcessRunning = false;
+	this->myPtuRunning = false;
+	this->myStopping = false;
 
 }
 
-bool extractInt(const string inStr, int* outNum) {
+// Destructor
 
-	stringstream ss(inStr);
-	string tmp;
-	ss >> tmp >> *outNum;
-	return true;
+TrackingUnit::~TrackingUnit() {
+
+	this->join();
+
+	this->myCapture.close();
+
+	delete this->myClosestPointTracker;
+	delete this->myDepthStats;
+	delete this->myClosestPointFinder;
+	delete this->myWorkerPool;
+
+	closePtu(&this->myLink);
+
+	delete this->myLoop;
 
 }
 
-void processPtuComm() {
+bool TrackingUnit::hasPtu() {
+	return this->myHasPtu;
+}
 
-	string theResp;
-	std::size_t theFound;
+bool TrackingUnit::openPtu(int inMaxBps) {
 
-	if (Ptu->checkDataAndEnqueue()) {
+	const char* theDevice = this->myConfig.Device.c_str();
 
-		theResp.assign((char *)Ptu->getFullQueueContent(true));
+	this->myLink.Port = new Serial::Serial_Q(theDevice, Serial::Serial::getBaudConstant(PTU_DEFAULT_BPS));
 
-		// Un signo de exclamación indica que se ha producido un error
+	if (this->myLink.Port->LastError != NULL) {
+		printf("No se puede abrir %s: %s\n", theDevice, this->myLink.Port->LastError);
+		closePtu(&this->myLink);
+		return false;
+	}
+
+	// Velocidad del enlace: se sube desde la de arranque de la PTU
 
-		theFound = theResp.find("!");
-		if (theFound != string::npos) {
-			STATUS = IDLE;
-			printf("PTU-46 ha devuelto un error: %s",theResp.c_str());
-			return;
+	if (inMaxBps > PTU_DEFAULT_BPS) {
+		if (negotiatePtuBaud(&this->myLink, inMaxBps) == 0) {
+			printf("La PTU-46 no responde en %s\n", theDevice);
 		}
+	}
 
-		switch (STATUS) {
+	this->myHasPtu = true;
 
-			case IDLE:
+	return true;
+}
 
-				// Recepción inesperada
-				// Mostramos datos recibidos
+void TrackingUnit::benchPtu(int inRounds) {
 
-				ROS_ERROR("PTU-46 ha enviado un dato inesperado: %s",theResp.c_str());
+	printf("Unidad %d (%s)\n", this->myIndex, this->myConfig.Device.c_str());
+	benchPtuLink(&this->myLink, inRounds);
 
-				break;
+}
 
-			case WAIT_COMMAND_CONF:
+bool TrackingUnit::openCapture(const char* inUri) {
 
-				theFound = theResp.find("*");
-				if (theFound != string::npos) {
-					printf("PTU-46 ha confirmado la última orden: %s",theResp.c_str());
-					STATUS = IDLE;
-				}
+	// Grupo de hilos de la unidad: uno por CPU asignada (el hilo de procesado es el primero)
 
-				break;
+	this->myWorkerPool = new Threads::WorkerPool(this->myConfig.NumCpus, this->myConfig.FirstCpu);
+	this->myClosestPointFinder = new Depth::ClosestPointFinder(this->myWorkerPool);
+	this->myClosestPointFinder->setSearchMode(this->myOptions->SearchMode);
+	this->myClosestPointFinder->setRange((uint16_t)this->myOptions->Near, (uint16_t)this->myOptions->Far);
 
-			case WAIT_POS_PAN:
+	if (this->myOptions->Stats || this->myOptions->AutoGate) {
+		this->myDepthStats = new Depth::DepthStats(this->myWorkerPool);
+	}
 
-				break;
+	if (this->myOptions->Tracking) {
+		this->myClosestPointTracker = new Depth::ClosestPointTracker(this->myClosestPointFinder);
+	}
 
-			case WAIT_POS_TILT:
+	printf("Unidad %d: búsqueda del punto más cercano: %s con %d hilos\n", this->myIndex,
+			Depth::getKernelName(Depth::getKernel()), this->myWorkerPool->getNumThreads());
 
-				// Comprobamos que el comando se ha admitido
-				// Y eliminamos el asterisco de confirmación
+	// Abre el dispositivo y crea un stream de cuadros de profundidad.
+	// Los cuadros llegan por eventos (NewFrameListener) desde el hilo de OpenNI
 
-				int thePos;
+	if (this->myConfig.NumCpus > 0) {
+		this->myCapture.setAffinity(this->myConfig.FirstCpu, this->myConfig.NumCpus);
+	}
 
-				theFound = theResp.find("*");
-				if (theFound != string::npos) {
-					theResp.erase(0,theFound+1);
-					STATUS = IDLE;
-				}
+	if (this->myCapture.open(inUri, this->myOptions->Replay) != openni::STATUS_OK) {
+		printf("Couldn't start depth stream:\n%s\n", openni::OpenNI::getExtendedError());
+		return false;
+	}
 
-				// Leemos el dato devuelto
+	if (this->myOptions->Replay) {
+		printf("Unidad %d: reproduciendo %s (%d cuadros)\n", this->myIndex, inUri, this->myCapture.getTotalFrames());
+	}
 
-				if (extractInt(theResp,&thePos)) {
+	// Modos de vídeo: se empieza en el de adquisición
 
-					float theDeg;
+	if (this->myOptions->AdaptiveMode && !this->myOptions->Replay) {
 
-					if (STATUS == WAIT_POS_PAN) {
-						theDeg = (float)thePos * PAN_RESOLUTION / 3600;
-						//thePtuJointState.position[0] = theDeg;
-					} else if (STATUS == WAIT_POS_TILT) {
-						theDeg = (float)thePos * TILT_RESOLUTION / 3600;
-						//thePtuJointState.position[1] = theDeg;
-					}
+		const openni::SensorInfo* theInfo = this->myCapture.getDevice().getSensorInfo(openni::SENSOR_DEPTH);
 
-				}
+		if ((theInfo != NULL) && this->myModeScheduler.configure(theInfo->getSupportedVideoModes(), this->myCapture.getStream().getVideoMode().getPixelFormat())) {
+			this->switchVideoMode(Capture::MODE_ACQUIRE);
+		} else {
+			printf("Unidad %d: el sensor no tiene modos de vídeo entre los que alternar\n", this->myIndex);
+		}
+	}
 
-				STATUS = IDLE;
-				break;
+	return true;
+}
 
-			default:
+// Pone el sensor en el modo que pide el planificador e informa de lo que se ahorra por cuadro
+// respecto a inPrevious (negativo si el modo nuevo es más caro)
 
-				STATUS = IDLE;
-				break;
+void TrackingUnit::switchVideoMode(Capture::ModeKind inPrevious) {
 
-		}
+	Capture::ModeKind theKind = this->myModeScheduler.getCurrent();
+	const openni::VideoMode& theMode = this->myModeScheduler.getMode(theKind);
+
+	if (this->myCapture.setVideoMode(theMode) != openni::STATUS_OK) {
+		Log::error("Unidad %d: no se puede cambiar al modo %dx%d@%d", this->myIndex, theMode.getResolutionX(), theMode.getResolutionY(), theMode.getFps());
+		this->myModeScheduler.rejectSwitch(inPrevious);
+		return;
+	}
 
+	char theModeText[32];
+	char theTimesText[80];
+	double theFromUs = this->myModeScheduler.getFrameNs(inPrevious) * 1e-3;
+	double theToUs = this->myModeScheduler.getFrameNs(theKind) * 1e-3;
+
+	snprintf(theModeText, sizeof(theModeText), "%dx%d@%d (%s)", theMode.getResolutionX(), theMode.getResolutionY(), theMode.getFps(),
+			Capture::ModeScheduler::getKindName(theKind));
+
+	if (theKind == inPrevious) {
+		Log::info("Unidad %d: modo %s al inicio", this->myIndex, theModeText);
+		return;
 	}
 
-	return;
+	snprintf(theTimesText, sizeof(theTimesText), "%.0f -> %.0f us/cuadro: %s %.0f us por cuadro", theFromUs, theToUs,
+			(theFromUs >= theToUs) ? "ahorra" : "cuesta", fabs(theFromUs - theToUs));
+
+	Log::info("Unidad %d: modo %s por %s (%s)", this->myIndex, theModeText, this->myModeScheduler.getReason(), theTimesText);
 
 }
 
-void movePtu(float inPanDeg, float inTiltDeg) {
+bool TrackingUnit::start() {
 
-	char thePanCommand[16];
-	char theTiltCommand[16];
-	bool theBuildCommandOk = false;
+	// La grabación existe antes que los hilos que graban
 
-	theBuildCommandOk = getPosCommand(inPanDeg,PAN,RELATIVE,thePanCommand);
+	if (!this->myConfig.Record.empty()) {
 
+		if (!this->myRecorder.open(this->myConfig.Record.c_str(), RECORD_SEGMENT_MB * 1024ULL * 1024ULL)) {
+			printf("Unidad %d: no se puede crear la grabación %s.0000.rec\n", this->myIndex, this->myConfig.Record.c_str());
+			return false;
+		}
 
-	theBuildCommandOk = theBuildCommandOk && getPosCommand(inTiltDeg,TILT,RELATIVE,theTiltCommand);
+		this->myRecorder.setCompression(!this->myOptions->RecordRaw);
+		this->myLink.Recorder = &this->myRecorder;
 
-	if (theBuildCommandOk) {
-		if (Ptu->send(thePanCommand) > 0) {
-			STATUS = WAIT_COMMAND_CONF;
-			processPtuComm();
-			//Ptu->send("A ");
+		// El búfer de compresión, para el mayor de los modos de vídeo que se van a usar
+
+		openni::VideoMode theMode = this->myCapture.getStream().getVideoMode();
+
+		if (this->myModeScheduler.isValid()) {
+			theMode = this->myModeScheduler.getMode(Capture::MODE_PRECISE);
 		}
-		if (Ptu->send(theTiltCommand) > 0) {
-			STATUS = WAIT_COMMAND_CONF;
-			processPtuComm();
-			//Ptu->send("A ");
+
+		this->myRecorder.reserveFrames(theMode.getResolutionX(), theMode.getResolutionY());
+
+		printf("Unidad %d: grabando en %s.NNNN.rec (segmentos de %d MB, cuadros %s)\n", this->myIndex, this->myConfig.Record.c_str(),
+				RECORD_SEGMENT_MB, this->myOptions->RecordRaw ? "en bruto" : "comprimidos");
+	}
+
+	// El bucle de eventos existe antes que los hilos: el procesado lo despierta con cada medida
+
+	if (this->myHasPtu) {
+
+		this->myLoop = new Serial::EventLoop();
+
+		if (!this->myLoop->add(this->myLink.Port)) {
+			printf("Unidad %d: no se pueden esperar eventos del puerto de la PTU-46\n", this->myIndex);
+			return false;
+		}
+
+		if (pthread_create(&this->myPtuThread, NULL, ptuMain, this) != 0) {
+			return false;
+		}
+		this->myPtuRunning = true;
+
+		if (this->myConfig.NumCpus > 0) {
+			Threads::WorkerPool::setAffinity(this->myPtuThread, this->myConfig.FirstCpu, this->myConfig.NumCpus);
 		}
-	} else {
-		// Error construyendo mensaje. no enviar nada
-		// ...
 	}
 
-}
+	if (pthread_create(&this->myProcessThread, NULL, processMain, this) != 0) {
+
+		// La PTU ya estaba en marcha: se para antes de devolver el fallo
 
-void ceroPtu() {
-
-	Ptu->send("I ");	// Modo inmediato
-	usleep(200000);
-	processPtuComm();
-	Ptu->send("FT ");	// Respuestas escuetas
-	usleep(200000);
-	processPtuComm();
-	Ptu->send("PP0 ");	// Posición PAN 0
-	usleep(200000);
-	processPtuComm();
-	Ptu->send("A ");	// Espera alcanzar las posiciones indicadas
-	usleep(200000);
-	processPtuComm();
-	Ptu->send("TP-300 ");	// Posición TILT max
-	usleep(200000);
-	processPtuComm();
-	Ptu->send("A ");	// Espera alcanzar las posiciones indicadas
-	usleep(200000);
-	processPtuComm();
-	Ptu->send("TP600 ");	// Posición TILT max
-	usleep(200000);
-	processPtuComm();
-	Ptu->send("A ");	// Espera alcanzar las posiciones indicadas
-	usleep(200000);
-	processPtuComm();
+		this->stop();
+		this->join();
+		return false;
+	}
+	this->myProcessRunning = true;
+
+	// El procesado ejecuta la parte 0 de las búsquedas: va en la primera CPU, como el grupo la espera
+
+	if (this->myConfig.NumCpus > 0) {
+		Threads::WorkerPool::setAffinity(this->myProcessThread, this->myConfig.FirstCpu, 1);
+	}
 
+	return true;
 }
 
-int main(int argc, char ** argv) {
+void TrackingUnit::stop() {
 
-	cout << "Inicializando PTU ..." << endl;
+	this->myStopping = true;
 
-	// Init PTU-46
+	if (this->myLoop != NULL) {
+		this->myLoop->wake();
+	}
 
-	Ptu = new Serial::Serial_Q(SERIALDEVICE, B9600);
+	this->myCapture.stop();
 
-	ceroPtu();
+}
 
-	usleep(500000);
+void TrackingUnit::join() {
 
-	movePtu(0,-20);
+	if (this->myProcessRunning) {
+		pthread_join(this->myProcessThread, NULL);
+		this->myProcessRunning = false;
+	}
 
-	cout << "Inicializando OpenNI ..." << endl;
-	theStatus = openni::OpenNI::initialize();
+	if (this->myPtuRunning) {
+		this->myStopping = true;
+		this->myLoop->wake();
+		pthread_join(this->myPtuThread, NULL);
+		this->myPtuRunning = false;
+	}
 
-	if (theStatus != openni::STATUS_OK) {
-		printf("Device open failed:\n%s\n", openni::OpenNI::getExtendedError());
-		openni::OpenNI::shutdown();
-		return 1;
+	if (this->myRecorder.isOpen()) {
+
+		this->myLink.Recorder = NULL;
+		this->myRecorder.close();
+
+		printf("Unidad %d: grabados %lu registros (%.1f MB) en %u segmentos, %lu descartados\n", this->myIndex,
+				this->myRecorder.getNumRecords(), this->myRecorder.getBytesWritten() / 1048576.0,
+				this->myRecorder.getNumSegments(), this->myRecorder.getDropped());
 	}
 
-	cout << "Iniciando sensor de profundidad ...";
+}
 
-	openni::Array<openni::DeviceInfo> theDevices;
-	openni::OpenNI::enumerateDevices(&theDevices);
+unsigned long TrackingUnit::getNumFrames() {
+	return this->myNumFrames;
+}
 
-	// Busca dispositivos compatibles
-	// Inicializa la variable theDevice con cada uno
-	// E imprime por pantalla su numero de serie
+void* TrackingUnit::processMain(void* inUnit) {
+	((TrackingUnit*)inUnit)->processLoop();
+	return NULL;
+}
+
+void* TrackingUnit::ptuMain(void* inUnit) {
+	((TrackingUnit*)inUnit)->ptuLoop();
+	return NULL;
+}
 
-	for (int i = 0; i != theDevices.getSize(); ++i) {
-		const openni::DeviceInfo& theDeviceInfo = theDevices[i];
-		string uri = theDeviceInfo.getUri();
-		theDevice.open(uri.c_str());
-		char theSerialNumber[1024];
-		theDevice.getProperty(ONI_DEVICE_PROPERTY_SERIAL_NUMBER, &theSerialNumber);
-		cout << "Device " << i << ". Serial Number: " << theSerialNumber << endl;
+// Volcado de los histogramas del procesado: duración de cada etapa y latencias del cuadro
+
+void TrackingUnit::printLatencies(int64_t inElapsedNs) {
+
+	if (this->myNumFrames == 0) {
+		printf("Unidad %d: no se ha procesado ningún cuadro\n", this->myIndex);
+		return;
 	}
 
-	// Crea un stream de cuadros a partir del dispositivo inicializado anteriormente
-	// Se indica que el dispositivo es de tipo profundidad
+	printf("Unidad %d: %lu cuadros en %.3f s: %.1f cuadros/s\n", this->myIndex, this->myNumFrames, inElapsedNs * 1e-9, this->myNumFrames * 1e9 / inElapsedNs);
 
-	theStatus = theDepth.create(theDevice, openni::SENSOR_DEPTH);
+	Timing::LatencyHistogram::printHeader();
 
-	if (theStatus == openni::STATUS_OK) {
-		theStatus = theDepth.start();
-		if (theStatus != openni::STATUS_OK) {
-			printf("Couldn't start depth stream:\n%s\n", openni::OpenNI::getExtendedError());
-			theDepth.destroy();
+	for (int s = 0; s < NUM_STAGES; s++) {
+		this->myStageLatency[s].print(StageNames[s]);
+	}
+
+	for (int l = 0; l < NUM_FRAME_LATENCIES; l++) {
+		if (this->myFrameLatency[l].getCount() > 0) {
+			this->myFrameLatency[l].print(FrameLatencyNames[l]);
 		}
-	} else {
-		printf("Couldn't find depth stream:\n%s\n", openni::OpenNI::getExtendedError());
 	}
 
-	if (!theDepth.isValid()) {
-		printf("No valid streams. Exiting\n");
-		openni::OpenNI::shutdown();
-		return 2;
+}
+
+// Latencias de las órdenes a la PTU (desde el hilo de la PTU)
+
+void TrackingUnit::printPtuLatencies() {
+
+	if (this->myLink.Latency.Send.getCount() == 0) {
+		return;
 	}
 
+	printf("Unidad %d: órdenes a la PTU\n", this->myIndex);
+	Timing::LatencyHistogram::printHeader();
+	this->myLink.Latency.Send.print("lectura->orden");
+	this->myLink.Latency.Ack.print("orden->confirmacion");
+	this->myLink.Latency.Total.print("lectura->confirmacion");
+
+}
+
+// Por cada cuadro recibido se obtiene el punto más cercano y se muestra por pantalla.
+// Se procesan todos los cuadros que entrega el sensor; el punto se pasa al hilo de la PTU,
+// que es quien decide cuándo mover la cámara.
+// theTimes[s] marca el inicio de la etapa s; una etapa que no se ejecuta dura 0.
+
+void TrackingUnit::processLoop() {
+
+	const UnitOptions* theOptions = this->myOptions;
+
 	openni::VideoFrameRef theRawFrame;
 	Pixel3D theClosestPoint;
 	Point theRealPoint;
 	Point theOrigin;
 
 	float thePanDeg, theTiltDeg, theDist;
+	int theGateHits = 0;
+	Depth::RangeGate theGate;
+	uint16_t theGateNear = 0;
 
-	// Por cada cuadro recibido se obtiene el punto más cercano y se muestra por pantalla
-	while(theDepth.isValid()){
+	int64_t theNextDumpNs;
+	int64_t theTimes[NUM_STAGES + 1];
+	int64_t theReadNs;
+	int64_t theMinSensorOffsetNs = 0;
+	bool theSensorOffsetKnown = false;
+	sig_atomic_t theDumpsSeen = theLatencyDumpRequests;
+
+	this->myStartNs = Timing::nowNs();
+	theNextDumpNs = this->myStartNs + theOptions->LatencyPeriodS * 1000000000LL;
+
+	while(this->myCapture.isValid() && !this->myStopping){
+
+		theTimes[STAGE_READ] = Timing::nowNs();
+
+		if (!this->myCapture.waitFrame(&theRawFrame, 2000, &theReadNs)) {
+
+			// En reproducción se termina al acabar la grabación; en cualquier caso, con stop
+
+			if (this->myCapture.isReplay() || this->myStopping) {
+				break;
+			}
+
+			printf("Unidad %d: no se reciben cuadros del sensor\n", this->myIndex);
+			continue;
+		}
+
+		theTimes[STAGE_STATS] = Timing::nowNs();
+
+		// El instante de captura está en microsegundos del reloj del sensor.
+		// En reproducción no tiene relación con el momento de la lectura.
+
+		if (!theOptions->Replay) {
+			int64_t theOffsetNs = theReadNs - (int64_t)theRawFrame.getTimestamp() * 1000;
+			if (!theSensorOffsetKnown || (theOffsetNs < theMinSensorOffsetNs)) {
+				theMinSensorOffsetNs = theOffsetNs;
+				theSensorOffsetKnown = true;
+			}
+			this->myFrameLatency[LATENCY_SENSOR].record(theOffsetNs - theMinSensorOffsetNs);
+		}
+
+		this->myFrameLatency[LATENCY_QUEUE].record(theTimes[STAGE_STATS] - theReadNs);
+
+		// Estadísticas del cuadro (una pasada compartida por todas las etapas que las usan)
+
+		bool theCalibrating = theOptions->AutoGate && (this->myNumFrames < AUTO_GATE_FRAMES);
+
+		if (theOptions->Stats || theCalibrating) {
+			this->myDepthStats->compute((const uint16_t*)theRawFrame.getData(), theRawFrame.getWidth(), theRawFrame.getHeight());
+		}
+
+		// Calibración del rango: nos quedamos con el mayor near propuesto en los primeros cuadros
+		// y solo lo aplicamos si el grupo cercano ha aparecido en la mayoría de ellos
+
+		if (theCalibrating) {
+
+			if (this->myDepthStats->suggestGate(AUTO_GATE_MAX_NEAR_MM, AUTO_GATE_GAP_MM, AUTO_GATE_MIN_FRACTION, &theGate)) {
+				theGateHits++;
+				if (theGate.Near > theGateNear) {
+					theGateNear = theGate.Near;
+				}
+			}
+
+			if (this->myNumFrames + 1 == AUTO_GATE_FRAMES) {
+				if ((theGateHits >= AUTO_GATE_MIN_HITS) && (theGateNear > theOptions->Near) && (theGateNear <= theOptions->Far)) {
+					this->myClosestPointFinder->setRange(theGateNear, (uint16_t)theOptions->Far);
+					if (this->myClosestPointTracker != NULL) {
+						this->myClosestPointTracker->reset();
+					}
+					printf("Unidad %d: rango automático: se ignoran profundidades menores de %u (%d de %d cuadros)\n", this->myIndex, theGateNear, theGateHits, AUTO_GATE_FRAMES);
+				} else {
+					printf("Unidad %d: rango automático: no se ha encontrado ningún grupo cercano estable\n", this->myIndex);
+				}
+			}
+		}
+
+		theTimes[STAGE_DETECT] = Timing::nowNs();
+
+		openni::Status rc = calculaPuntoMasCercano(this->myClosestPointFinder, this->myClosestPointTracker, &theClosestPoint, &theRawFrame);
+
+		theTimes[STAGE_WORLD] = theTimes[STAGE_COMMAND] = theTimes[STAGE_RECORD] = Timing::nowNs();
+
+		this->myFrameLatency[LATENCY_DETECT].record(theTimes[STAGE_WORLD] - theReadNs);
+
+		// Las tablas se calculan para el modo del cuadro, que tras un cambio de modo puede ser
+		// aún el anterior. Un punto que no se puede convertir no se publica: theRealPoint
+		// sería el de otro cuadro.
+
+		if ((rc == openni::STATUS_OK) && !this->myWorldConverter.matches(theRawFrame)) {
+			this->myWorldConverter.configure(theRawFrame, this->myCapture.getStream());
+		}
+
+		if ((rc == openni::STATUS_OK) &&
+				!this->myWorldConverter.convertPoint(theClosestPoint.X,theClosestPoint.Y,theClosestPoint.Z,&theRealPoint.X, &theRealPoint.Y, &theRealPoint.Z)) {
+			Log::warn("Unidad %d: punto (%d, %d) fuera del cuadro de %dx%d", this->myIndex, theClosestPoint.X, theClosestPoint.Y,
+					theRawFrame.getWidth(), theRawFrame.getHeight());
+			rc = openni::STATUS_ERROR;
+		}
+
+		// Sin ningún pixel válido no hay punto que convertir ni seguir
+
+		if (rc == openni::STATUS_OK) {
 
-		openni::Status rc = theDepth.readFrame(&theRawFrame);
-		if (rc != openni::STATUS_OK) {
-			printf("readFrame failed\n%s\n", openni::OpenNI::getExtendedError());
-		} else {
-			calculaPuntoMasCercano(&theClosestPoint,&theRawFrame);
 			//theClosestPoint.print();
-			openni::CoordinateConverter::convertDepthToWorld(theDepth,theClosestPoint.X,theClosestPoint.Y,theClosestPoint.Z,&theRealPoint.X, &theRealPoint.Y, &theRealPoint.Z);
 
 			// Adaptamos las coordenadas para considerar el desajuste
 			// entre las coordenadas de la cámara y las de la base pan-tilt
 
 			theRealPoint.Y += OFFSET_CAMARA_EJE_TILT_MM / 1000;
 
+			theTimes[STAGE_COMMAND] = Timing::nowNs();
+
+			this->myFrameLatency[LATENCY_WORLD].record(theTimes[STAGE_COMMAND] - theReadNs);
+
 			theRealPoint.print();
 			Vector theV(theOrigin, theRealPoint);
 
 			thePanDeg = theV.getPan()*180/PI;
 			//theTiltDeg = theV.getTiltConsideringOffsetY(OFFSET_CAMARA_EJE_TILT_MM / 1000)*180/PI - 90;
 			theTiltDeg = theV.getTiltConsideringOffsetY(OFFSET_CAMARA_EJE_TILT_MM / 1000)*180/PI;
-			theDist = theV.getModulo();
 
 			//if (theDist > 600) {
-			if ((abs(thePanDeg) > 2)||(abs(theTiltDeg) > 2)) {
-				movePtu(thePanDeg, theTiltDeg);
+			if (theOptions->Replay) {
+
+				// Se construyen las órdenes de cada cuadro (sin esperar a que se estabilice
+				// una cámara que no se mueve) pero no se envían
+
+				if ((abs(thePanDeg) > 2)||(abs(theTiltDeg) > 2)) {
+					char theCommand[16];
+					getPosCommand(thePanDeg,PAN,RELATIVE,theCommand);
+					getPosCommand(theTiltDeg,TILT,RELATIVE,theCommand);
+					this->myNumCommands++;
+				}
+
+			} else if (this->myHasPtu) {
+
+				// La medida más reciente sustituye a la que el hilo de la PTU no haya tomado aún
+
+				Measurement& theMeasurement = this->myMeasurements.getBack();
+				theMeasurement.Camera[0] = theRealPoint.X;
+				theMeasurement.Camera[1] = theRealPoint.Y;
+				theMeasurement.Camera[2] = theRealPoint.Z;
+				theMeasurement.PanDeg = thePanDeg;
+				theMeasurement.TiltDeg = theTiltDeg;
+				theMeasurement.ReadNs = theReadNs;
+				this->myMeasurements.publish();
+				this->myLoop->wake();
 			}
 			//}
 
-			theV.printPanTiltDeg();
+			// Con los ángulos ya calculados; la distancia solo hace falta para el registro
+
+			if (Log::isEnabled(Log::LEVEL_DEBUG)) {
+				theDist = theV.getModulo();
+				Log::debug("MODULO: %d, PAN: %d, TILT: %d", (int)theDist, (int)thePanDeg, (int)theTiltDeg);
+			}
+
+			theTimes[STAGE_RECORD] = Timing::nowNs();
+		}
+
+		// El cuadro se graba cuando la PTU ya tiene la medida: la copia no la retrasa
+
+		if (this->myRecorder.isOpen()) {
+			this->myRecorder.recordDepth((const uint16_t*)theRawFrame.getData(), theRawFrame.getWidth(), theRawFrame.getHeight(),
+					theRawFrame.getTimestamp(), theReadNs);
+		}
+
+		theTimes[NUM_STAGES] = Timing::nowNs();
+
+		for (int s = 0; s < NUM_STAGES; s++) {
+			this->myStageLatency[s].record(theTimes[s+1] - theTimes[s]);
+		}
+
+		// Modo de vídeo según si el objetivo está fijado, con el tiempo de procesado del cuadro
+
+		if (this->myModeScheduler.isValid()) {
+			float thePoint[3] = { theRealPoint.X, theRealPoint.Y, theRealPoint.Z };
+			Capture::ModeKind thePrevious = this->myModeScheduler.getCurrent();
+			if (this->myModeScheduler.update(theRawFrame.getWidth(), theRawFrame.getHeight(), rc == openni::STATUS_OK, thePoint,
+					theTimes[NUM_STAGES] - theTimes[STAGE_STATS], theTimes[NUM_STAGES])) {
+				this->switchVideoMode(thePrevious);
+			}
+		}
+
+		if (++this->myNumFrames % 300 == 0) {
+			printf("Unidad %d. Cuadros: %lu recibidos, %lu procesados, %lu descartados\n", this->myIndex, this->myCapture.getNumFrames(), this->myNumFrames, this->myCapture.getDroppedFrames());
+			if (this->myClosestPointTracker != NULL) {
+				this->myClosestPointTracker->printStats();
+			}
+			if (theOptions->Stats) {
+				this->myDepthStats->print();
+			}
+		}
 
-			usleep(1500000);
+		if ((theDumpsSeen != theLatencyDumpRequests) || ((theOptions->LatencyPeriodS > 0) && (theTimes[NUM_STAGES] >= theNextDumpNs))) {
+			theDumpsSeen = theLatencyDumpRequests;
+			theNextDumpNs = theTimes[NUM_STAGES] + theOptions->LatencyPeriodS * 1000000000LL;
+			this->printLatencies(theTimes[NUM_STAGES] - this->myStartNs);
 		}
 
 	}
 
-	theDepth.stop();
-	theDepth.destroy();
+	if (theOptions->Replay) {
+		this->printLatencies(Timing::nowNs() - this->myStartNs);
+		printf("Unidad %d: %lu cuadros con movimiento de la PTU\n", this->myIndex, this->myNumCommands);
+	}
 
-	cout << "Terminando" << endl;
-	openni::OpenNI::shutdown();
+}
+
+// Hilo de la PTU: pone la PTU en su posición inicial y después atiende sus respuestas y
+// las medidas del procesado. Solo duerme en el bucle de eventos de la unidad.
+
+void TrackingUnit::ptuLoop() {
+
+	const UnitOptions* theOptions = this->myOptions;
+
+	// ceroPtu termina cuando la PTU ha alcanzado la última posición
+
+	ceroPtu(&this->myLink);
+
+	this->myMotion.setPosition(PTU_HOME_PAN_POS * PAN_RESOLUTION / 3600, PTU_HOME_TILT_POS * TILT_RESOLUTION / 3600);
+	this->myMotion.moveRelative(0, -20, 0);
+	this->myMotion.flush();
+	this->myMotion.setPollRate(theOptions->JointPollHz);
+
+	// Las medidas tomadas mientras la PTU se colocaba ya no sirven
+
+	this->myMeasurements.take();
+
+	int64_t theNextDumpNs = Timing::nowNs() + theOptions->LatencyPeriodS * 1000000000LL;
+	sig_atomic_t theDumpsSeen = theLatencyDumpRequests;
+
+	while (!this->myStopping) {
+
+		// Respuestas de la PTU (sin esperar), medida más reciente y, cuando la PTU ha
+		// respondido, envío del objetivo más reciente
+
+		processPtuComm(&this->myLink);
+
+		if (this->myMeasurements.take()) {
+			this->handleMeasurement(this->myMeasurements.getFront());
+		}
+
+		this->myMotion.service();
+
+		int64_t theNow = Timing::nowNs();
+
+		if ((theDumpsSeen != theLatencyDumpRequests) || ((theOptions->LatencyPeriodS > 0) && (theNow >= theNextDumpNs))) {
+			theDumpsSeen = theLatencyDumpRequests;
+			theNextDumpNs = theNow + theOptions->LatencyPeriodS * 1000000000LL;
+			this->printPtuLatencies();
+		}
+
+		// Se duerme hasta que responde la PTU, llega una medida o vence el primer plazo:
+		// el de la orden en curso más antigua o, sin órdenes, la siguiente lectura de posiciones
+
+		int64_t theDeadlineNs = getPtuDeadlineNs(&this->myLink);
+
+		if (theDeadlineNs == 0) {
+			theDeadlineNs = this->myMotion.getNextPollNs();
+		}
 
-	return 0;
+		if ((theOptions->LatencyPeriodS > 0) && ((theDeadlineNs == 0) || (theNextDumpNs < theDeadlineNs))) {
+			theDeadlineNs = theNextDumpNs;
+		}
+
+		if (this->myLoop->wait(theDeadlineNs) == Serial::LOOP_ERROR) {
+			usleep(1000);
+		}
+	}
+
+	this->myMotion.printStats();
+
+}
+
+// Decide el movimiento para una medida. Los movimientos se espacian al menos SettleMs
+// para que la cámara (montada en la PTU) se estabilice.
+
+void TrackingUnit::handleMeasurement(const Measurement& inMeasurement) {
+
+	const UnitOptions* theOptions = this->myOptions;
+
+	// Posición de la PTU al capturar el cuadro (un periodo de cuadro antes de leerlo), no
+	// la de ahora: si desde entonces se ha enviado otra orden, el cuadro es de la anterior
+
+	float theFramePanDeg, theFrameTiltDeg;
+
+	this->myMotion.getPoseAt(inMeasurement.ReadNs - PREDICT_SENSOR_LATENCY_NS, &theFramePanDeg, &theFrameTiltDeg);
+
+	// Posición del objetivo en coordenadas de la base
+
+	if (theOptions->Predict) {
+		float theBase[3];
+		Motion::cameraToBase(theFramePanDeg, theFrameTiltDeg, inMeasurement.Camera, theBase);
+		this->myPredictor.update(theBase, inMeasurement.ReadNs);
+	}
+
+	int64_t theNow = Timing::nowNs();
+
+	if (((abs(inMeasurement.PanDeg) > 2)||(abs(inMeasurement.TiltDeg) > 2)) && (theNow - this->myLastMoveNs >= theOptions->SettleMs * 1000000LL)) {
+
+		// Con predicción se apunta a donde estará el objetivo cuando la PTU reciba la orden.
+		// Las medidas llevan la hora de lectura, posterior a la captura: por eso se suma
+		// también la latencia del sensor. El adelanto usa el tiempo de confirmación de las
+		// órdenes (envío -> '*'), que solo dice cuándo la PTU ha aceptado la orden, no cuánto
+		// tarda en llegar: el tiempo del movimiento no se adelanta.
+
+		float thePredicted[3];
+
+		if (theOptions->Predict) {
+			int64_t theAckNs = (this->myLink.Latency.Ack.getCount() > 0) ? this->myLink.Latency.Ack.getPercentile(0.5f) : PREDICT_DEFAULT_ACK_NS;
+			int64_t theTargetNs = theNow + theAckNs + PREDICT_SENSOR_LATENCY_NS;
+			float theTargetPanDeg, theTargetTiltDeg;
+
+			this->myPredictor.predict(theTargetNs, thePredicted);
+			Motion::baseToAngles(thePredicted, &theTargetPanDeg, &theTargetTiltDeg);
+			this->myMotion.moveAbsolute(theTargetPanDeg, theTargetTiltDeg, inMeasurement.ReadNs);
+		} else {
+			this->myMotion.moveAbsolute(theFramePanDeg + inMeasurement.PanDeg, theFrameTiltDeg + inMeasurement.TiltDeg, inMeasurement.ReadNs);
+		}
+		this->myMotion.service();
+		this->myLastMoveNs = theNow;
+	}
+
+	if (++this->myNumMeasurements % 300 == 0) {
+		this->myMotion.printStats();
+	}
+
+}
+
+void printUsage(const char* inProgram) {
+
+	printf("Uso: %s [opciones]\n", inProgram);
+	printf("  -s, --search full|blob\n");
+	printf("                              modo de búsqueda del punto más cercano (por defecto full)\n");
+	printf("                              blob: objeto más cercano de al menos 50 pixeles (ignora pixeles sueltos)\n");
+	printf("  -t, --track                 busca primero en una ventana alrededor del punto anterior\n");
+	printf("  -g, --gate near:far         solo acepta profundidades en [near, far]\n");
+	printf("  -a, --auto-gate             calcula near en los primeros cuadros para ignorar el chasis del robot\n");
+	printf("  -e, --stats                 calcula y muestra estadísticas de profundidad de los cuadros\n");
+	printf("  -o, --oni fichero.oni       usa una grabación en lugar del sensor (driver libOniFile.so)\n");
+	printf("  -r, --replay fichero.oni    reproduce la grabación sin límite de velocidad, sin PTU,\n");
+	printf("                              y muestra cuadros/s y tiempos por etapa\n");
+	printf("  -w, --settle ms             tiempo mínimo entre movimientos de la PTU (por defecto 1500)\n");
+	printf("  -d, --device ruta           puerto serie de la PTU (por defecto %s)\n", DEFAULT_SERIAL_DEVICE);
+	printf("  -u, --unit sensor,ruta[,cpus]\n");
+	printf("                              una unidad: sensor (URI, número de serie o .oni) y puerto de su PTU\n");
+	printf("                              ('-' sin PTU), con sus hilos fijados a cpus (n o n-m). Se repite por\n");
+	printf("                              cada unidad; sustituye a --device y --oni\n");
+	printf("  -b, --baud bps              velocidad máxima del enlace con la PTU; se arranca a %d bps y se\n", PTU_DEFAULT_BPS);
+	printf("                              sube a la mayor que funcione (por defecto %d)\n", DEFAULT_MAX_BPS);
+	printf("  -L, --link-bench n          mide el enlace con la PTU (n consultas) y termina\n");
+	printf("  -j, --joints hz             lecturas por segundo de la posición de la PTU (por defecto %d, 0 ninguna)\n", JOINT_POLL_HZ);
+	printf("  -k, --predict               apunta a la posición prevista del objetivo tras la latencia medida\n");
+	printf("  -A, --adaptive-mode         sin objetivo, el modo del sensor con más cuadros/s (QVGA); con el\n");
+	printf("                              objetivo fijado, el de más resolución (VGA)\n");
+	printf("  -R, --record prefijo        graba los cuadros (comprimidos sin pérdidas) y las órdenes, respuestas y\n");
+	printf("                              posiciones de la PTU en prefijo.NNNN.rec (con varias unidades,\n");
+	printf("                              prefijo-u.NNNN.rec)\n");
+	printf("  -Z, --record-raw            con --record, graba los cuadros sin comprimir\n");
+	printf("  -l, --latency s             muestra las latencias cada s segundos (también con SIGUSR1)\n");
+	printf("  -v, --log-level nivel       mensajes en consola: debug|info|warn|error (por defecto info;\n");
+	printf("                              debug muestra el punto y las órdenes de cada cuadro)\n");
+	printf("  -F, --log-file ruta         guarda también todos los mensajes (debug) en ruta, rotando cada %d MB\n", LOG_FILE_MB);
+	printf("  -h, --help                  muestra esta ayuda\n");
+
+}
+
+// "sensor,ruta[,cpus]" (cpus: "n" o "n-m")
+
+bool parseUnit(const char* inSpec, UnitConfig* outConfig) {
+
+	const char* theComma = strchr(inSpec, ',');
+
+	if ((theComma == NULL) || (theComma == inSpec)) {
+		return false;
+	}
+
+	outConfig->Uri.assign(inSpec, theComma - inSpec);
+
+	const char* theDevice = theComma + 1;
+	const char* theCpus = strchr(theDevice, ',');
+
+	outConfig->Device = (theCpus != NULL) ? string(theDevice, theCpus - theDevice) : string(theDevice);
+
+	if (outConfig->Device.empty()) {
+		return false;
+	}
+
+	if (outConfig->Device == "-") {
+		outConfig->Device.clear();
+	}
+
+	outConfig->FirstCpu = 0;
+	outConfig->NumCpus = 0;
+
+	if (theCpus != NULL) {
+
+		int theFirst, theLast;
+		int theNumFields = sscanf(theCpus + 1, "%d-%d", &theFirst, &theLast);
+
+		if (theNumFields == 1) {
+			theLast = theFirst;
+		}
+
+		if ((theNumFields < 1) || (theFirst < 0) || (theLast < theFirst)) {
+			return false;
+		}
+
+		outConfig->FirstCpu = theFirst;
+		outConfig->NumCpus = theLast - theFirst + 1;
+	}
 
+	return true;
 }
 
+int main(int argc, char ** argv) {
+
+	// Opciones de línea de comandos
+
+	UnitOptions theUnitOptions;
+	vector<UnitConfig> theUnitConfigs;
+	const char* theOniFile = NULL;
+	const char* theRecordPrefix = NULL;
+	const char* theDevice = DEFAULT_SERIAL_DEVICE;
+	int theMaxBps = DEFAULT_MAX_BPS;
+	int theLinkBenchRounds = 0;
+	Log::Config theLogConfig;
+	UnitConfig theUnitConfig;
+
+	static struct option theOptions[] = {
+		{ "search",	required_argument,	NULL, 's' },
+		{ "track",	no_argument,		NULL, 't' },
+		{ "gate",	required_argument,	NULL, 'g' },
+		{ "auto-gate",	no_argument,	NULL, 'a' },
+		{ "stats",	no_argument,		NULL, 'e' },
+		{ "oni",	required_argument,	NULL, 'o' },
+		{ "replay",	required_argument,	NULL, 'r' },
+		{ "settle",	required_argument,	NULL, 'w' },
+		{ "latency",	required_argument,	NULL, 'l' },
+		{ "device",	required_argument,	NULL, 'd' },
+		{ "unit",	required_argument,	NULL, 'u' },
+		{ "baud",	required_argument,	NULL, 'b' },
+		{ "link-bench",	required_argument,	NULL, 'L' },
+		{ "joints",	required_argument,	NULL, 'j' },
+		{ "predict",	no_argument,		NULL, 'k' },
+		{ "adaptive-mode",	no_argument,	NULL, 'A' },
+		{ "record",	required_argument,	NULL, 'R' },
+		{ "record-raw",	no_argument,	NULL, 'Z' },
+		{ "log-level",	required_argument,	NULL, 'v' },
+		{ "log-file",	required_argument,	NULL, 'F' },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int theOption;
+
+	while ((theOption = getopt_long(argc, argv, "s:tg:aeo:r:w:l:d:u:b:L:j:kAR:Zv:F:h", theOptions, NULL)) != -1) {
+		switch (theOption) {
+			case 's':
+				if (strcmp(optarg, "full") == 0) {
+					theUnitOptions.SearchMode = Depth::SEARCH_FULL;
+				} else if (strcmp(optarg, "blob") == 0) {
+					theUnitOptions.SearchMode = Depth::SEARCH_BLOB;
+				} else {
+					printUsage(argv[0]);
+					return 1;
+				}
+				break;
+			case 't':
+				theUnitOptions.Tracking = true;
+				break;
+			case 'g':
+				if ((sscanf(optarg, "%d:%d", &theUnitOptions.Near, &theUnitOptions.Far) != 2) || (theUnitOptions.Near < 1) ||
+						(theUnitOptions.Far > 0xfffe) || (theUnitOptions.Near > theUnitOptions.Far)) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'a':
+				theUnitOptions.AutoGate = true;
+				break;
+			case 'e':
+				theUnitOptions.Stats = true;
+				break;
+			case 'o':
+				theOniFile = optarg;
+				break;
+			case 'r':
+				theOniFile = optarg;
+				theUnitOptions.Replay = true;
+				break;
+			case 'w':
+				theUnitOptions.SettleMs = atoi(optarg);
+				break;
+			case 'l':
+				theUnitOptions.LatencyPeriodS = atoi(optarg);
+				break;
+			case 'd':
+				theDevice = optarg;
+				break;
+			case 'u':
+				if (!parseUnit(optarg, &theUnitConfig)) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				theUnitConfigs.push_back(theUnitConfig);
+				break;
+			case 'b':
+				theMaxBps = atoi(optarg);
+				if (Serial::Serial::getBaudConstant(theMaxBps) == 0) {
+					printf("Velocidad no soportada: %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'L':
+				theLinkBenchRounds = atoi(optarg);
+				break;
+			case 'j':
+				theUnitOptions.JointPollHz = atof(optarg);
+				break;
+			case 'k':
+				theUnitOptions.Predict = true;
+				break;
+			case 'A':
+				theUnitOptions.AdaptiveMode = true;
+				break;
+			case 'R':
+				theRecordPrefix = optarg;
+				break;
+			case 'Z':
+				theUnitOptions.RecordRaw = true;
+				break;
+			case 'v':
+				if (!Log::parseLevel(optarg, &theLogConfig.ConsoleLevel)) {
+					printUsage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'F':
+				theLogConfig.FilePath = optarg;
+				break;
+			case 'h':
+				printUsage(argv[0]);
+				return 0;
+			default:
+				printUsage(argv[0]);
+				return 1;
+		}
+	}
+
+	// La ventana de seguimiento busca mínimos de pixeles sueltos, no objetos
+
+	if (theUnitOptions.Tracking && (theUnitOptions.SearchMode == Depth::SEARCH_BLOB)) {
+		printf("--track no es compatible con --search blob\n");
+		return 1;
+	}
+
+	// Sin --unit, una sola unidad con --oni (o el último sensor encontrado) y --device
 
+	if (theUnitConfigs.empty()) {
+		theUnitConfig = UnitConfig();
+		theUnitConfig.Uri = (theOniFile != NULL) ? theOniFile : "";
+		theUnitConfig.Device = theDevice;
+		theUnitConfigs.push_back(theUnitConfig);
+	} else if (theOniFile != NULL) {
+		printf("--oni y --replay no son compatibles con --unit (indique la grabación en cada unidad)\n");
+		return 1;
+	}
 
+	// En reproducción no se usa la PTU: las órdenes se construyen pero no se envían
+
+	if (theUnitOptions.Replay) {
+		for (size_t u = 0; u < theUnitConfigs.size(); u++) {
+			theUnitConfigs[u].Device.clear();
+		}
+	}
+
+	// Cada unidad graba en sus propios segmentos
+
+	if (theRecordPrefix != NULL) {
+		for (size_t u = 0; u < theUnitConfigs.size(); u++) {
+			char theSuffix[16];
+			snprintf(theSuffix, sizeof(theSuffix), "-%d", (int)u);
+			theUnitConfigs[u].Record = string(theRecordPrefix) + ((theUnitConfigs.size() > 1) ? theSuffix : "");
+		}
+	}
+
+	// Mensajes: los de cada cuadro y cada orden se registran sin formatear y los escribe
+	// el hilo del registro
+
+	theLogConfig.MaxFileBytes = LOG_FILE_MB * 1024L * 1024L;
+
+	if (!Log::start(theLogConfig)) {
+		printf("No se puede abrir el fichero de registro %s\n", theLogConfig.FilePath);
+		return 1;
+	}
+
+	atexit(Log::stop);
+
+	vector<TrackingUnit*> theUnits;
+
+	for (size_t u = 0; u < theUnitConfigs.size(); u++) {
+		theUnits.push_back(new TrackingUnit((int)u, theUnitConfigs[u], &theUnitOptions));
+	}
 
+	// Init PTU-46: cada unidad con su propio enlace
 
+	int theExitCode = 0;
+
+	for (size_t u = 0; (u < theUnits.size()) && (theExitCode == 0); u++) {
+		if (!theUnitConfigs[u].Device.empty()) {
+			cout << "Inicializando PTU " << theUnitConfigs[u].Device << " ..." << endl;
+			if (!theUnits[u]->openPtu(theMaxBps)) {
+				theExitCode = 1;
+			}
+		}
+	}
+
+	if ((theExitCode == 0) && (theLinkBenchRounds > 0)) {
+		for (size_t u = 0; u < theUnits.size(); u++) {
+			if (theUnits[u]->hasPtu()) {
+				theUnits[u]->benchPtu(theLinkBenchRounds);
+			}
+		}
+	}
+
+	if ((theExitCode != 0) || (theLinkBenchRounds > 0)) {
+		for (size_t u = 0; u < theUnits.size(); u++) {
+			delete theUnits[u];
+		}
+		return theExitCode;
+	}
+
+	// Volcado de latencias bajo demanda: kill -USR1 <pid>
+
+	signal(SIGUSR1, onLatencyDumpSignal);
+
+	cout << "Inicializando OpenNI ..." << endl;
+	openni::Status theStatus = openni::OpenNI::initialize();
+
+	if (theStatus != openni::STATUS_OK) {
+		printf("Device open failed:\n%s\n", openni::OpenNI::getExtendedError());
+		openni::OpenNI::shutdown();
+		return 1;
+	}
+
+	cout << "Iniciando sensor de profundidad ..." << endl;
+
+	// Busca dispositivos compatibles
+	// E imprime por pantalla su numero de serie
+	// Las unidades sin sensor indicado usan el último encontrado; las que indican un
+	// número de serie, el dispositivo que lo tiene
+
+	if (theOniFile == NULL) {
+
+		openni::Array<openni::DeviceInfo> theDevices;
+		openni::OpenNI::enumerateDevices(&theDevices);
+
+		for (int i = 0; i != theDevices.getSize(); ++i) {
+			const openni::DeviceInfo& theDeviceInfo = theDevices[i];
+			openni::Device theDevice;
+			string theUri = theDeviceInfo.getUri();
+			theDevice.open(theUri.c_str());
+			char theSerialNumber[1024];
+			theDevice.getProperty(ONI_DEVICE_PROPERTY_SERIAL_NUMBER, &theSerialNumber);
+			cout << "Device " << i << ". Serial Number: " << theSerialNumber << endl;
+			theDevice.close();
+
+			for (size_t u = 0; u < theUnitConfigs.size(); u++) {
+				if (theUnitConfigs[u].Uri == theSerialNumber) {
+					theUnitConfigs[u].Uri = theUri;
+				}
+			}
+			if ((i + 1 == theDevices.getSize()) && (theUnitConfigs.size() == 1) && theUnitConfigs[0].Uri.empty()) {
+				theUnitConfigs[0].Uri = theUri;
+			}
+		}
+	}
+
+	for (size_t u = 0; (u < theUnits.size()) && (theExitCode == 0); u++) {
+		if (!theUnits[u]->openCapture(theUnitConfigs[u].Uri.c_str())) {
+			printf("No valid streams. Exiting\n");
+			theExitCode = 2;
+		}
+	}
+
+	// Todas las unidades funcionan a la vez, cada una con sus hilos
+
+	for (size_t u = 0; (u < theUnits.size()) && (theExitCode == 0); u++) {
+		if (!theUnits[u]->start()) {
+
+			printf("Unidad %d: no se pueden crear sus hilos\n", (int)u);
+			theExitCode = 1;
+
+			// Las unidades ya arrancadas se paran; las espera y las destruye el final de main
+
+			for (size_t s = 0; s < u; s++) {
+				theUnits[s]->stop();
+			}
+		}
+	}
+
+	// Una reproducción sin ningún cuadro procesado se considera un fallo (pruebas sin sensor)
+
+	for (size_t u = 0; u < theUnits.size(); u++) {
+		theUnits[u]->join();
+		if ((theExitCode == 0) && theUnitOptions.Replay && (theUnits[u]->getNumFrames() == 0)) {
+			theExitCode = 3;
+		}
+	}
+
+	for (size_t u = 0; u < theUnits.size(); u++) {
+		delete theUnits[u];
+	}
+
+	cout << "Terminando" << endl;
+	openni::OpenNI::shutdown();
+
+	return theExitCode;
+
+}
@@ -0,0 +1,1856 @@
+/*
+ * ptu_xtion_bench.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: youbot
+ *
+ *  Banco de pruebas de rendimiento de las partes críticas de ptu_xtion.
+ *
+ *  Uso: ptu_xtion_bench [iteraciones] [grabacion.oni]
+ *
+ *  Además de las comparaciones entre implementaciones, mide por operación (ns/op,
+ *  bytes reservados/op y reservas/op) la búsqueda del punto más cercano a varias
+ *  resoluciones, la cola de Serial, la construcción de órdenes, el procesado de
+ *  respuestas de la PTU y, contra la PTU simulada (PtuSim), la ida y vuelta de una orden,
+ *  el enlace a su velocidad real, la recuperación de errores y varias PTU a la vez, y la
+ *  grabación en segmentos proyectados (escritura, lectura por instante y recuperación)
+ *  y la compresión de cuadros (razón y MB/s). Con una grabación se mide también sobre sus
+ *  cuadros.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cmath>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "DepthMin.h"
+#include "ClosestPoint.h"
+#include "DepthTracker.h"
+#include "DepthWorld.h"
+#include "DepthStats.h"
+#include "WorkerPool.h"
+#include "Capture.h"
+#include "ModeScheduler.h"
+#include "Recorder.h"
+#include "DepthCodec.h"
+#include "Serial_Q.h"
+#include "PtuComm.h"
+#include "PtuParser.h"
+#include "PtuSim.h"
+#include "Latency.h"
+#include "Log.h"
+
+using namespace std;
+
+#define FRAME_WIDTH		640
+#define FRAME_HEIGHT	480
+
+// Contadores de reservas de memoria. Se sustituyen malloc, calloc y realloc de glibc
+// (operator new también pasa por malloc) para contar llamadas y bytes.
+
+static volatile unsigned long theNumAllocs = 0;
+static volatile unsigned long theAllocBytes = 0;
+
+extern "C" {
+
+	void* __libc_malloc(size_t inSize);
+	void* __libc_calloc(size_t inCount, size_t inSize);
+	void* __libc_realloc(void* inPtr, size_t inSize);
+
+	void* malloc(size_t inSize) throw() {
+		__sync_fetch_and_add(&theNumAllocs, 1);
+		__sync_fetch_and_add(&theAllocBytes, inSize);
+		return __libc_malloc(inSize);
+	}
+
+	void* calloc(size_t inCount, size_t inSize) throw() {
+		__sync_fetch_and_add(&theNumAllocs, 1);
+		__sync_fetch_and_add(&theAllocBytes, inCount * inSize);
+		return __libc_calloc(inCount, inSize);
+	}
+
+	void* realloc(void* inPtr, size_t inSize) throw() {
+		__sync_fetch_and_add(&theNumAllocs, 1);
+		__sync_fetch_and_add(&theAllocBytes, inSize);
+		return __libc_realloc(inPtr, inSize);
+	}
+
+}
+
+// Medida de una serie de operaciones: tiempo y reservas entre start() y stop()
+
+class OpMeter {
+
+private:
+
+	struct timespec myStart;
+	unsigned long myAllocs;
+	unsigned long myBytes;
+	double myNs;
+
+public:
+
+	OpMeter() {
+		this->myAllocs = 0;
+		this->myBytes = 0;
+		this->myNs = 0;
+	}
+
+	void start() {
+		this->myAllocs -= theNumAllocs;
+		this->myBytes -= theAllocBytes;
+		clock_gettime(CLOCK_MONOTONIC, &this->myStart);
+	}
+
+	void stop() {
+		struct timespec theEnd;
+		clock_gettime(CLOCK_MONOTONIC, &theEnd);
+		this->myNs += (theEnd.tv_sec - this->myStart.tv_sec) * 1e9 + (theEnd.tv_nsec - this->myStart.tv_nsec);
+		this->myAllocs += theNumAllocs;
+		this->myBytes += theAllocBytes;
+	}
+
+	void print(const char* inName, long inOps) {
+		printf("%-36s %12.1f ns/op %10.1f B/op %8.2f allocs/op\n", inName, this->myNs / inOps,
+				(double)this->myBytes / inOps, (double)this->myAllocs / inOps);
+	}
+
+};
+
+// Tiempo monótono en nanosegundos
+
+static double nowNs() {
+	struct timespec theTime;
+	clock_gettime(CLOCK_MONOTONIC, &theTime);
+	return theTime.tv_sec * 1e9 + theTime.tv_nsec;
+}
+
+// Cuadros sintéticos
+
+enum Pattern {
+	PATTERN_NOISE = 0,		// profundidad aleatoria con un 20% de ceros
+	PATTERN_RAMP = 1,		// profundidad decreciente: el mínimo mejora en cada bloque (peor caso)
+	PATTERN_TIES = 2,		// valores repetidos: prueba la regla de la primera aparición
+	PATTERN_EMPTY = 3,		// todo ceros: no hay punto válido
+	NUM_PATTERNS = 4
+};
+
+static const char* PatternNames[NUM_PATTERNS] = { "noise", "ramp", "ties", "empty" };
+
+static void fillFrame(vector<uint16_t>& outFrame, Pattern inPattern) {
+
+	srand(1234);
+
+	for (size_t i = 0; i < outFrame.size(); i++) {
+		switch (inPattern) {
+			case PATTERN_NOISE:
+				outFrame[i] = (rand() % 5 == 0) ? 0 : (uint16_t)(500 + rand() % 7500);
+				break;
+			case PATTERN_RAMP:
+				outFrame[i] = (uint16_t)(60000 - i / 8);
+				break;
+			case PATTERN_TIES:
+				outFrame[i] = (uint16_t)(rand() % 4);
+				break;
+			default:
+				outFrame[i] = 0;
+				break;
+		}
+	}
+}
+
+// Mide el tiempo medio por cuadro de una implementación concreta
+
+static double benchKernel(Depth::Kernel inKernel, const vector<uint16_t>& inFrame, int inIterations, int* outIndex, uint16_t* outZ) {
+
+	Depth::setKernel(inKernel);
+
+	*outZ = 0;
+	*outIndex = Depth::findMin(&inFrame[0], (int)inFrame.size(), outZ);
+
+	double theStart = nowNs();
+	volatile int theSink = 0;
+	for (int i = 0; i < inIterations; i++) {
+		uint16_t theZ;
+		theSink += Depth::findMin(&inFrame[0], (int)inFrame.size(), &theZ);
+	}
+
+	return (nowNs() - theStart) / inIterations;
+}
+
+static bool benchFindMin(int inIterations) {
+
+	const Depth::Kernel theKernels[] = { Depth::KERNEL_SCALAR, Depth::KERNEL_SSE41, Depth::KERNEL_AVX2 };
+	const int theNumKernels = sizeof(theKernels) / sizeof(theKernels[0]);
+
+	vector<uint16_t> theFrame(FRAME_WIDTH * FRAME_HEIGHT);
+	bool outOk = true;
+
+	printf("Depth::findMin %dx%d (%d iteraciones)\n", FRAME_WIDTH, FRAME_HEIGHT, inIterations);
+	printf("%-8s %-8s %12s %10s %10s %8s\n", "patron", "kernel", "ns/cuadro", "MB/s", "indice", "Z");
+
+	for (int p = 0; p < NUM_PATTERNS; p++) {
+
+		fillFrame(theFrame, (Pattern)p);
+
+		int theRefIndex = -1;
+		uint16_t theRefZ = 0;
+		double theRefNs = 0;
+
+		for (int k = 0; k < theNumKernels; k++) {
+
+			if (!Depth::isKernelSupported(theKernels[k])) {
+				continue;
+			}
+
+			int theIndex;
+			uint16_t theZ;
+			double theNs = benchKernel(theKernels[k], theFrame, inIterations, &theIndex, &theZ);
+
+			const char* theCheck = "";
+			if (theKernels[k] == Depth::KERNEL_SCALAR) {
+				theRefIndex = theIndex;
+				theRefZ = theZ;
+				theRefNs = theNs;
+			} else if ((theIndex != theRefIndex) || (theZ != theRefZ)) {
+				theCheck = " DISTINTO!";
+				outOk = false;
+			}
+
+			printf("%-8s %-8s %12.0f %10.1f %10d %8u x%.2f%s\n", PatternNames[p], Depth::getKernelName(theKernels[k]),
+					theNs, theFrame.size() * sizeof(uint16_t) * 1e3 / theNs, theIndex, (unsigned)theZ, theRefNs / theNs, theCheck);
+		}
+	}
+
+	Depth::setKernel(Depth::KERNEL_AUTO);
+
+	return outOk;
+}
+
+// Escalado de la búsqueda por bandas según el número de hilos del grupo
+
+static bool benchClosestPoint(int inIterations) {
+
+	vector<uint16_t> theFrame(FRAME_WIDTH * FRAME_HEIGHT);
+	int theMaxThreads = Threads::WorkerPool::getNumCpus();
+	bool outOk = true;
+
+	fillFrame(theFrame, PATTERN_NOISE);
+
+	uint16_t theRefZ = 0;
+	int theRefIndex = Depth::findMinScalar(&theFrame[0], (int)theFrame.size(), 1, 0xfffe, &theRefZ);
+	double theOneThreadNs = 0;
+
+	printf("\nDepth::ClosestPointFinder %dx%d (%s)\n", FRAME_WIDTH, FRAME_HEIGHT, Depth::getKernelName(Depth::getKernel()));
+	printf("%-8s %12s %10s\n", "hilos", "ns/cuadro", "escalado");
+
+	for (int t = 1; t <= theMaxThreads; t++) {
+
+		Threads::WorkerPool thePool(t);
+		Depth::ClosestPointFinder theFinder(&thePool);
+		Pixel3D thePoint;
+
+		theFinder.find(&theFrame[0], FRAME_WIDTH, FRAME_HEIGHT, &thePoint);
+		const char* theCheck = "";
+		if ((thePoint.Y * FRAME_WIDTH + thePoint.X != theRefIndex) || (thePoint.Z != theRefZ)) {
+			theCheck = " DISTINTO!";
+			outOk = false;
+		}
+
+		double theStart = nowNs();
+		for (int i = 0; i < inIterations; i++) {
+			theFinder.find(&theFrame[0], FRAME_WIDTH, FRAME_HEIGHT, &thePoint);
+		}
+		double theNs = (nowNs() - theStart) / inIterations;
+
+		// El escalado se da respecto a un hilo
+
+		if (t == 1) {
+			theOneThreadNs = theNs;
+		}
+
+		printf("%-8d %12.0f %9.2fx%s\n", t, theNs, theOneThreadNs / theNs, theCheck);
+	}
+
+	return outOk;
+}
+
+// Secuencia sintética: pared inclinada con ruido y un disco cercano que se mueve en círculo.
+// Con inHoles, un 10% de los pixeles son huecos sueltos (sin profundidad).
+
+static void fillMovingTarget(vector<uint16_t>& outFrame, int inFrameIndex, bool inHoles = true) {
+
+	const int theRadius = 15;
+	int theCx = FRAME_WIDTH / 2 + (int)(150 * cos(inFrameIndex * 0.02));
+	int theCy = FRAME_HEIGHT / 2 + (int)(150 * sin(inFrameIndex * 0.02));
+
+	srand(inFrameIndex);
+
+	for (int y = 0; y < FRAME_HEIGHT; y++) {
+		for (int x = 0; x < FRAME_WIDTH; x++) {
+			uint16_t theZ = (inHoles && (rand() % 10 == 0)) ? 0 : (uint16_t)(2000 + 4 * y + rand() % 10);
+			if ((x - theCx) * (x - theCx) + (y - theCy) * (y - theCy) < theRadius * theRadius) {
+				theZ = (uint16_t)(800 + rand() % 20);
+			}
+			outFrame[y * FRAME_WIDTH + x] = theZ;
+		}
+	}
+}
+
+// Seguimiento en ventana frente a recorrido completo sobre una secuencia con movimiento,
+// con el objetivo lento (3 pixeles por cuadro) y rápido (30). Junto a la mejora se da el
+// área media de la ventana, que es lo que se recorre en régimen estable.
+
+static bool benchTracker(int inIterations) {
+
+	const int theNumFrames = 32;
+	const int theSpeeds[] = { 1, 10 };
+	const char* theSpeedNames[] = { "lento", "rapido" };
+
+	printf("\nDepth::ClosestPointTracker %dx%d, %d cuadros\n", FRAME_WIDTH, FRAME_HEIGHT, inIterations * theNumFrames / 4);
+	printf("%-8s %12s %12s %8s %14s %10s\n", "objetivo", "completo ns", "ventana ns", "mejora", "area ventana", "distintos");
+
+	for (int v = 0; v < 2; v++) {
+
+		vector< vector<uint16_t> > theFrames(theNumFrames, vector<uint16_t>(FRAME_WIDTH * FRAME_HEIGHT));
+
+		for (int f = 0; f < theNumFrames; f++) {
+			fillMovingTarget(theFrames[f], f * theSpeeds[v]);
+		}
+
+		Depth::ClosestPointFinder theFinder(NULL);
+		Depth::ClosestPointTracker theTracker(&theFinder);
+		Pixel3D thePoint, theFullPoint;
+		int theSteps = inIterations * theNumFrames / 4;
+		unsigned long theMismatches = 0;
+
+		double theStart = nowNs();
+		for (int i = 0; i < theSteps; i++) {
+			theFinder.find(&theFrames[i % theNumFrames][0], FRAME_WIDTH, FRAME_HEIGHT, &theFullPoint);
+		}
+		double theFullNs = (nowNs() - theStart) / theSteps;
+
+		theStart = nowNs();
+		for (int i = 0; i < theSteps; i++) {
+			theTracker.find(&theFrames[i % theNumFrames][0], FRAME_WIDTH, FRAME_HEIGHT, &thePoint);
+		}
+		double theTrackNs = (nowNs() - theStart) / theSteps;
+
+		const Depth::TrackerStats& theStats = theTracker.getStats();
+		unsigned long theWindows = theStats.WindowHits + theStats.FallbackScans;
+		double theArea = (theWindows > 0) ? (double)theStats.WindowPixels / theWindows : 0.0;
+
+		// Diferencias de profundidad respecto al recorrido completo (fuera del tiempo medido)
+
+		theTracker.reset();
+		for (int i = 0; i < theSteps; i++) {
+			theTracker.find(&theFrames[i % theNumFrames][0], FRAME_WIDTH, FRAME_HEIGHT, &thePoint);
+			theFinder.find(&theFrames[i % theNumFrames][0], FRAME_WIDTH, FRAME_HEIGHT, &theFullPoint);
+			if (thePoint.Z != theFullPoint.Z) {
+				theMismatches++;
+			}
+		}
+
+		printf("%-8s %12.0f %12.0f %7.2fx %8.0f %4.1f%% %10lu\n", theSpeedNames[v], theFullNs, theTrackNs, theFullNs / theTrackNs,
+				theArea, 100.0 * theArea / (FRAME_WIDTH * FRAME_HEIGHT), theMismatches);
+		theTracker.printStats();
+	}
+
+	return true;
+}
+
+// Objeto más cercano frente al mínimo de pixeles sueltos, con motas de ruido más cercanas que el objeto,
+// con cada implementación. La escena con huecos sueltos da muchos tramos por fila (manda la unión de
+// etiquetas); sin huecos hay pocos y se ve el coste de las máscaras de fila.
+
+static bool benchBlob(int inIterations) {
+
+	const Depth::Kernel theKernels[] = { Depth::KERNEL_SCALAR, Depth::KERNEL_SSE41, Depth::KERNEL_AVX2 };
+	const int theNumKernels = sizeof(theKernels) / sizeof(theKernels[0]);
+	const char* theSceneNames[] = { "huecos", "liso" };
+
+	vector<uint16_t> theFrame(FRAME_WIDTH * FRAME_HEIGHT);
+	bool outOk = true;
+
+	printf("\nDepth::BlobExtractor %dx%d con 20 motas de ruido\n", FRAME_WIDTH, FRAME_HEIGHT);
+	printf("%-8s %-8s %12s %12s %8s\n", "escena", "kernel", "full ns", "blob ns", "blob/full");
+
+	for (int e = 0; e < 2; e++) {
+
+		fillMovingTarget(theFrame, 0, e == 0);
+
+		for (int i = 0; i < 20; i++) {
+			theFrame[rand() % theFrame.size()] = (uint16_t)(400 + rand() % 100);
+		}
+
+		Depth::Blob theRefBlob;
+
+		for (int k = 0; k < theNumKernels; k++) {
+
+			if (!Depth::isKernelSupported(theKernels[k])) {
+				continue;
+			}
+
+			Depth::setKernel(theKernels[k]);
+
+			Depth::ClosestPointFinder theFinder(NULL);
+			Pixel3D thePoint;
+			double theNs[2];
+
+			for (int m = 0; m < 2; m++) {
+
+				theFinder.setSearchMode((m == 0) ? Depth::SEARCH_FULL : Depth::SEARCH_BLOB);
+				theFinder.find(&theFrame[0], FRAME_WIDTH, FRAME_HEIGHT, &thePoint);
+
+				double theStart = nowNs();
+				for (int i = 0; i < inIterations; i++) {
+					theFinder.find(&theFrame[0], FRAME_WIDTH, FRAME_HEIGHT, &thePoint);
+				}
+				theNs[m] = (nowNs() - theStart) / inIterations;
+			}
+
+			const Depth::Blob& theBlob = theFinder.getLastBlob();
+			const char* theCheck = "";
+
+			if (theKernels[k] == Depth::KERNEL_SCALAR) {
+				theRefBlob = theBlob;
+			} else if ((theBlob.Area != theRefBlob.Area) || (theBlob.CentroidX != theRefBlob.CentroidX) ||
+					(theBlob.CentroidY != theRefBlob.CentroidY) || (theBlob.Nearest.X != theRefBlob.Nearest.X) ||
+					(theBlob.Nearest.Y != theRefBlob.Nearest.Y) || (theBlob.Nearest.Z != theRefBlob.Nearest.Z)) {
+				theCheck = " DISTINTO!";
+				outOk = false;
+			}
+
+			printf("%-8s %-8s %12.0f %12.0f %8.1fx  punto (%d,%d,%u) area %d, %d componentes%s\n", theSceneNames[e],
+					Depth::getKernelName(theKernels[k]), theNs[0], theNs[1], theNs[1] / theNs[0], thePoint.X, thePoint.Y,
+					(unsigned)thePoint.Z, theBlob.Area, theFinder.getBlobExtractor()->getNumComponents(), theCheck);
+		}
+	}
+
+	Depth::setKernel(Depth::KERNEL_AUTO);
+
+	return outOk;
+}
+
+// Estadísticas del cuadro frente a un histograma calculado pixel a pixel, y rango automático
+// sobre un cuadro en el que las últimas filas son el chasis del robot (más cerca que el objeto)
+
+static bool benchStats(int inIterations) {
+
+	const int theChassisRows = 40;
+
+	vector<uint16_t> theFrame(FRAME_WIDTH * FRAME_HEIGHT);
+	vector<uint32_t> theRefHistogram(DEPTH_STATS_BINS, 0);
+	int theMaxThreads = Threads::WorkerPool::getNumCpus();
+	bool outOk = true;
+
+	fillMovingTarget(theFrame, 0);
+
+	for (int y = FRAME_HEIGHT - theChassisRows; y < FRAME_HEIGHT; y++) {
+		for (int x = 0; x < FRAME_WIDTH; x++) {
+			theFrame[y * FRAME_WIDTH + x] = (rand() % 10 == 0) ? 0 : (uint16_t)(350 + rand() % 30);
+		}
+	}
+
+	theFrame[7] = 0xffff;
+
+	int theRefValid = 0;
+	uint16_t theRefMin = 0xffff, theRefMax = 0;
+
+	for (size_t i = 0; i < theFrame.size(); i++) {
+		uint16_t theZ = theFrame[i];
+		if ((theZ != 0) && (theZ != 0xffff)) {
+			theRefHistogram[theZ >> DEPTH_STATS_SHIFT]++;
+			theRefValid++;
+			if (theZ < theRefMin) theRefMin = theZ;
+			if (theZ > theRefMax) theRefMax = theZ;
+		}
+	}
+
+	printf("\nDepth::DepthStats %dx%d (bins de %d)\n", FRAME_WIDTH, FRAME_HEIGHT, DEPTH_STATS_BIN_WIDTH);
+	printf("%-8s %12s %10s\n", "hilos", "ns/cuadro", "MB/s");
+
+	for (int t = 1; t <= theMaxThreads; t++) {
+
+		Threads::WorkerPool thePool(t);
+		Depth::DepthStats theStats(&thePool);
+
+		// Dos pasadas seguidas: la segunda comprueba que no quedan restos del cuadro anterior
+
+		theStats.compute(&theFrame[0], FRAME_WIDTH, FRAME_HEIGHT);
+		theStats.compute(&theFrame[0], FRAME_WIDTH, FRAME_HEIGHT);
+
+		bool theSame = (theStats.getValidPixels() == theRefValid) && (theStats.getMin() == theRefMin) && (theStats.getMax() == theRefMax);
+		for (int b = 0; b < DEPTH_STATS_BINS; b++) {
+			theSame = theSame && (theStats.getHistogram()[b] == theRefHistogram[b]);
+		}
+		outOk = outOk && theSame;
+
+		double theStart = nowNs();
+		for (int i = 0; i < inIterations; i++) {
+			theStats.compute(&theFrame[0], FRAME_WIDTH, FRAME_HEIGHT);
+		}
+		double theNs = (nowNs() - theStart) / inIterations;
+
+		printf("%-8d %12.0f %10.1f%s\n", t, theNs, theFrame.size() * sizeof(uint16_t) * 1e3 / theNs, theSame ? "" : " DISTINTO!");
+
+		if (t == theMaxThreads) {
+			theStats.print();
+		}
+	}
+
+	// Rango propuesto y búsqueda con ese rango
+
+	Depth::DepthStats theStats(NULL);
+	Depth::RangeGate theGate;
+
+	theStats.compute(&theFrame[0], FRAME_WIDTH, FRAME_HEIGHT);
+
+	if (!theStats.suggestGate(800, 40, 0.005f, &theGate)) {
+		printf("no se ha encontrado el chasis DISTINTO!\n");
+		return false;
+	}
+
+	uint16_t theRefZ = 0;
+	int theRefIndex = Depth::findMinScalar(&theFrame[0], (int)theFrame.size(), theGate.Near, theGate.Far, &theRefZ);
+
+	Depth::ClosestPointFinder theFinder(NULL);
+	Pixel3D thePoint;
+
+	theFinder.setRange(theGate.Near, theGate.Far);
+	printf("rango propuesto [%u, %u]\n", theGate.Near, theGate.Far);
+
+	bool theFound = theFinder.find(&theFrame[0], FRAME_WIDTH, FRAME_HEIGHT, &thePoint);
+	bool theSame = theFound && (thePoint.Y * FRAME_WIDTH + thePoint.X == theRefIndex) && (thePoint.Z == theRefZ);
+	outOk = outOk && theSame;
+
+	printf("punto (%d,%d,%u)%s\n", thePoint.X, thePoint.Y, (unsigned)thePoint.Z, theSame ? "" : " DISTINTO!");
+
+	return outOk;
+}
+
+// Conversión del cuadro completo a coordenadas del mundo, comparada con la conversión
+// punto a punto con la fórmula de openni::CoordinateConverter::convertDepthToWorld
+
+static bool benchWorld(int inIterations) {
+
+	const float theHFov = 1.0225999f;	// campos de visión de la Xtion
+	const float theVFov = 0.79661566f;
+
+	vector<uint16_t> theFrame(FRAME_WIDTH * FRAME_HEIGHT);
+	vector<float> theRefX(theFrame.size()), theRefY(theFrame.size()), theRefZ(theFrame.size());
+	Depth::WorldConverter theConverter;
+	Depth::PointCloud theCloud;
+	bool outOk = true;
+
+	fillFrame(theFrame, PATTERN_NOISE);
+	theConverter.configure(FRAME_WIDTH, FRAME_HEIGHT, theHFov, theVFov, openni::PIXEL_FORMAT_DEPTH_1_MM);
+
+	double theStart = nowNs();
+	for (int i = 0; i < inIterations; i++) {
+		float theXZFactor = tan(theHFov / 2) * 2;
+		float theYZFactor = tan(theVFov / 2) * 2;
+		for (int p = 0; p < (int)theFrame.size(); p++) {
+			float theZ = theFrame[p];
+			theRefX[p] = ((float)(p % FRAME_WIDTH) / FRAME_WIDTH - .5f) * theZ * theXZFactor;
+			theRefY[p] = (.5f - (float)(p / FRAME_WIDTH) / FRAME_HEIGHT) * theZ * theYZFactor;
+			theRefZ[p] = theZ;
+		}
+	}
+	double theRefNs = (nowNs() - theStart) / inIterations;
+
+	printf("\nDepth::WorldConverter %dx%d\n", FRAME_WIDTH, FRAME_HEIGHT);
+	printf("%-8s %12s %10s %14s\n", "kernel", "ns/cuadro", "Mpuntos/s", "error relativo");
+	printf("%-8s %12.0f %10.1f\n", "punto", theRefNs, theFrame.size() * 1e3 / theRefNs);
+
+	const Depth::Kernel theKernels[] = { Depth::KERNEL_SCALAR, Depth::KERNEL_SSE41, Depth::KERNEL_AVX2 };
+
+	for (int k = 0; k < 3; k++) {
+
+		if (!Depth::isKernelSupported(theKernels[k])) {
+			continue;
+		}
+
+		Depth::setKernel(theKernels[k]);
+
+		theStart = nowNs();
+		for (int i = 0; i < inIterations; i++) {
+			theConverter.convertFrame(&theFrame[0], &theCloud);
+		}
+		double theNs = (nowNs() - theStart) / inIterations;
+
+		double theMaxError = 0;
+		for (int p = 0; p < (int)theFrame.size(); p++) {
+			double theError = fabs(theCloud.X[p] - theRefX[p]) / (fabs(theRefX[p]) + 1) +
+					fabs(theCloud.Y[p] - theRefY[p]) / (fabs(theRefY[p]) + 1) +
+					fabs(theCloud.Z[p] - theRefZ[p]) / (fabs(theRefZ[p]) + 1);
+			if (theError > theMaxError) {
+				theMaxError = theError;
+			}
+		}
+
+		const char* theCheck = (theMaxError < 1e-5) ? "" : " DISTINTO!";
+		outOk = outOk && (theMaxError < 1e-5);
+
+		printf("%-8s %12.0f %10.1f %14.2g x%.2f%s\n", Depth::getKernelName(theKernels[k]), theNs, theFrame.size() * 1e3 / theNs,
+				theMaxError, theRefNs / theNs, theCheck);
+	}
+
+	Depth::setKernel(Depth::KERNEL_AUTO);
+
+	return outOk;
+}
+
+// Escena sintética de inWidth x inHeight: pared inclinada con un 10% de ceros y un objeto cercano
+
+// Cambio de modo de vídeo: tablas del mundo recuperadas frente a recalculadas, y decisiones
+// del planificador con una lista de modos como la de la Xtion
+
+static bool benchModeSwitch(int inIterations) {
+
+	const float theHFov = 1.0225999f;
+	const float theVFov = 0.79661566f;
+
+	Depth::WorldConverter theConverter;
+	bool outOk = true;
+
+	theConverter.configure(640, 480, theHFov, theVFov, openni::PIXEL_FORMAT_DEPTH_1_MM);
+	theConverter.configure(320, 240, theHFov, theVFov, openni::PIXEL_FORMAT_DEPTH_1_MM);
+
+	OpMeter theMeter;
+
+	theMeter.start();
+	for (int i = 0; i < inIterations; i++) {
+		theConverter.configure((i & 1) ? 320 : 640, (i & 1) ? 240 : 480, theHFov, theVFov, openni::PIXEL_FORMAT_DEPTH_1_MM);
+	}
+	theMeter.stop();
+	theMeter.print("WorldConverter::configure (recuperada)", inIterations);
+
+	theMeter.start();
+	for (int i = 0; i < inIterations; i++) {
+		Depth::WorldConverter theFresh;
+		theFresh.configure(640, 480, theHFov, theVFov, openni::PIXEL_FORMAT_DEPTH_1_MM);
+	}
+	theMeter.stop();
+	theMeter.print("WorldConverter::configure (calculada)", inIterations);
+
+	// Las tablas recuperadas dan lo mismo que unas recién calculadas
+
+	Depth::WorldConverter theFresh;
+	theFresh.configure(640, 480, theHFov, theVFov, openni::PIXEL_FORMAT_DEPTH_1_MM);
+	theConverter.configure(640, 480, theHFov, theVFov, openni::PIXEL_FORMAT_DEPTH_1_MM);
+
+	float theX1, theY1, theZ1, theX2, theY2, theZ2;
+	theConverter.convertPoint(17, 401, 1234, &theX1, &theY1, &theZ1);
+	theFresh.convertPoint(17, 401, 1234, &theX2, &theY2, &theZ2);
+
+	if ((theConverter.getNumBuilt() != 2) || (theX1 != theX2) || (theY1 != theY2) || (theZ1 != theZ2)) {
+		printf("Tablas del mundo recuperadas: %lu calculadas DISTINTO!\n", theConverter.getNumBuilt());
+		outOk = false;
+	}
+
+	// Modos: se deben elegir QVGA a 60 (adquisición) y VGA a 30 (precisión)
+
+	openni::VideoMode theModeList[5];
+	const int theSizes[5][3] = { { 640, 480, 30 }, { 320, 240, 30 }, { 320, 240, 60 }, { 160, 120, 60 }, { 640, 480, 30 } };
+
+	for (int m = 0; m < 5; m++) {
+		theModeList[m].setResolution(theSizes[m][0], theSizes[m][1]);
+		theModeList[m].setFps(theSizes[m][2]);
+		theModeList[m].setPixelFormat((m == 4) ? openni::PIXEL_FORMAT_DEPTH_100_UM : openni::PIXEL_FORMAT_DEPTH_1_MM);
+	}
+
+	openni::Array<openni::VideoMode> theModes(theModeList, 5);
+	Capture::ModeScheduler theScheduler;
+
+	outOk = theScheduler.configure(theModes, openni::PIXEL_FORMAT_DEPTH_1_MM) && outOk;
+	outOk = outOk && (theScheduler.getMode(Capture::MODE_ACQUIRE).getResolutionX() == 320) && (theScheduler.getMode(Capture::MODE_ACQUIRE).getFps() == 60);
+	outOk = outOk && (theScheduler.getMode(Capture::MODE_PRECISE).getResolutionX() == 640);
+
+	// Objetivo quieto: a precisión tras MODE_LOCK_FRAMES cuadros. Sin objetivo: vuelta a
+	// adquisición tras MODE_LOST_FRAMES, una vez cumplido el tiempo mínimo en el modo.
+
+	float thePoint[3] = { 100, 50, 1500 };
+	int64_t theNow = 10000000000LL;
+	int theLockFrame = -1;
+	int theLostFrame = -1;
+
+	for (int f = 0; outOk && (f < 200); f++) {
+
+		theNow += 16666667;
+
+		bool theLock = (f < 100);
+		int theWidth = (theScheduler.getCurrent() == Capture::MODE_ACQUIRE) ? 320 : 640;
+
+		if (theScheduler.update(theWidth, theWidth * 3 / 4, theLock, thePoint, (theWidth == 320) ? 1000000 : 4000000, theNow)) {
+			if (theScheduler.getCurrent() == Capture::MODE_PRECISE) {
+				theLockFrame = f;
+			} else {
+				theLostFrame = f;
+			}
+		}
+	}
+
+	printf("Planificador de modos: precisión en el cuadro %d, adquisición en el %d, %.0f us/cuadro ahorrados al volver\n",
+			theLockFrame, theLostFrame, (theScheduler.getFrameNs(Capture::MODE_PRECISE) - theScheduler.getFrameNs(Capture::MODE_ACQUIRE)) * 1e-3);
+
+	if (!outOk || (theLockFrame != MODE_LOCK_FRAMES - 1) || (theLostFrame < 100 + MODE_LOST_FRAMES - 1) || (theScheduler.getNumSwitches() != 2)) {
+		printf("Planificador de modos: decisiones inesperadas DISTINTO!\n");
+		outOk = false;
+	}
+
+	return outOk;
+}
+
+static void fillScene(vector<uint16_t>& outFrame, int inWidth, int inHeight) {
+
+	srand(inWidth);
+	outFrame.resize(inWidth * inHeight);
+
+	for (int y = 0; y < inHeight; y++) {
+		for (int x = 0; x < inWidth; x++) {
+			uint16_t theZ = (rand() % 10 == 0) ? 0 : (uint16_t)(2000 + 4 * y + rand() % 10);
+			if ((abs(x - inWidth / 3) < inWidth / 20) && (abs(y - inHeight / 2) < inHeight / 20)) {
+				theZ = (uint16_t)(800 + rand() % 20);
+			}
+			outFrame[y * inWidth + x] = theZ;
+		}
+	}
+}
+
+// Lee (en modo reproducción) hasta inMaxFrames cuadros de una grabación
+
+static int loadRecording(const char* inPath, int inMaxFrames, vector< vector<uint16_t> >& outFrames, int* outWidth, int* outHeight) {
+
+	if (openni::OpenNI::initialize() != openni::STATUS_OK) {
+		return 0;
+	}
+
+	{
+		Capture::DepthCapture theCapture;
+		openni::VideoFrameRef theFrame;
+
+		if (theCapture.open(inPath, true) == openni::STATUS_OK) {
+			while (((int)outFrames.size() < inMaxFrames) && theCapture.waitFrame(&theFrame, 1000)) {
+				const uint16_t* theData = (const uint16_t*)theFrame.getData();
+				*outWidth = theFrame.getWidth();
+				*outHeight = theFrame.getHeight();
+				outFrames.push_back(vector<uint16_t>(theData, theData + *outWidth * *outHeight));
+			}
+			theCapture.close();
+		}
+	}
+
+	openni::OpenNI::shutdown();
+
+	return (int)outFrames.size();
+}
+
+// Lo que hace calculaPuntoMasCercano con cada cuadro: ClosestPointFinder con un hilo por CPU
+
+static void benchFrames(const char* inName, const vector< vector<uint16_t> >& inFrames, int inWidth, int inHeight, int inIterations) {
+
+	const Depth::SearchMode theModes[] = { Depth::SEARCH_FULL, Depth::SEARCH_BLOB };
+	const char* theModeNames[] = { "full", "blob" };
+
+	Threads::WorkerPool thePool(0);
+	Depth::ClosestPointFinder theFinder(&thePool);
+	Pixel3D thePoint;
+	char theName[64];
+
+	for (int m = 0; m < 2; m++) {
+
+		OpMeter theMeter;
+		long theOps = (long)inIterations * (long)inFrames.size();
+
+		// Primera pasada fuera de la medida: reserva de etiquetas
+
+		theFinder.setSearchMode(theModes[m]);
+		theFinder.find(&inFrames[0][0], inWidth, inHeight, &thePoint);
+
+		theMeter.start();
+		for (long i = 0; i < theOps; i++) {
+			theFinder.find(&inFrames[i % inFrames.size()][0], inWidth, inHeight, &thePoint);
+		}
+		theMeter.stop();
+
+		snprintf(theName, sizeof(theName), "punto %s %dx%d %s", inName, inWidth, inHeight, theModeNames[m]);
+		theMeter.print(theName, theOps);
+	}
+}
+
+static void benchClosestPointOps(int inIterations, const char* inRecording) {
+
+	const int theSizes[][2] = { { 320, 240 }, { 640, 480 }, { 1280, 1024 } };
+
+	printf("\nOperaciones (%d hilos)\n", Threads::WorkerPool::getNumCpus());
+
+	for (int s = 0; s < 3; s++) {
+		vector< vector<uint16_t> > theFrames(1);
+		fillScene(theFrames[0], theSizes[s][0], theSizes[s][1]);
+		benchFrames("sint", theFrames, theSizes[s][0], theSizes[s][1], inIterations);
+	}
+
+	if (inRecording != NULL) {
+
+		vector< vector<uint16_t> > theFrames;
+		int theWidth = 0, theHeight = 0;
+
+		if (loadRecording(inRecording, 300, theFrames, &theWidth, &theHeight) > 0) {
+			benchFrames("oni", theFrames, theWidth, theHeight, (inIterations + 9) / 10);
+		} else {
+			printf("No se ha podido leer %s\n", inRecording);
+		}
+	}
+}
+
+// Serial::Queue: byte a byte, en bloque y volcado completo
+
+static void benchQueue(int inIterations) {
+
+	Serial::Queue theQueue(256);
+	const char* theResponse = "* Current Pan position is 1234\r\n";
+	int theLength = (int)strlen(theResponse);
+	long theOps = (long)inIterations * 1000;
+	volatile unsigned char theSink = 0;
+	unsigned char theBuff[64];
+	char theName[64];
+	OpMeter theMeter;
+
+	theMeter.start();
+	for (long i = 0; i < theOps; i++) {
+		theQueue.enqueue((unsigned char)i);
+		theSink += theQueue.dequeue();
+	}
+	theMeter.stop();
+	theMeter.print("Queue enqueue+dequeue (1 B)", theOps);
+
+	// El índice de escritura avanza 33 bytes por vuelta: se cruza el final del buffer a menudo
+
+	theMeter.start();
+	for (long i = 0; i < theOps; i++) {
+		theQueue.enqueue((const unsigned char*)theResponse, theLength);
+		theQueue.peek(theBuff, theLength);
+		theQueue.consume(theLength);
+		theSink += theBuff[0];
+	}
+	theMeter.stop();
+	snprintf(theName, sizeof(theName), "Queue enqueue+peek+consume (%d B)", theLength);
+	theMeter.print(theName, theOps);
+
+	theMeter.start();
+	for (long i = 0; i < theOps; i++) {
+		theQueue.enqueue((const unsigned char*)theResponse, theLength);
+		unsigned char* theContent = theQueue.getFullContent(true);
+		theSink += theContent[0];
+	}
+	theMeter.stop();
+	snprintf(theName, sizeof(theName), "Queue enqueue+getFullContent (%d B)", theLength);
+	theMeter.print(theName, theOps);
+}
+
+static void benchPosCommand(int inIterations) {
+
+	char theCommand[16];
+	long theOps = (long)inIterations * 1000;
+	OpMeter theMeter;
+
+	theMeter.start();
+	for (long i = 0; i < theOps; i++) {
+		getPosCommand((float)(i % 90) - 45.0f, (i & 1) ? TILT : PAN, RELATIVE, theCommand);
+	}
+	theMeter.stop();
+	theMeter.print("getPosCommand", theOps);
+}
+
+// Coste de registrar una muestra en un histograma de latencias (una por etapa y cuadro)
+
+static void benchLatency(int inIterations) {
+
+	Timing::LatencyHistogram theHistogram;
+	long theOps = (long)inIterations * 1000;
+	OpMeter theMeter;
+	int64_t theNs = 1000;
+
+	theMeter.start();
+	for (long i = 0; i < theOps; i++) {
+		theHistogram.record(theNs);
+		theNs = (theNs * 7 + 13) & 0xffffff;
+	}
+	theMeter.stop();
+	theMeter.print("LatencyHistogram::record", theOps);
+
+	// Una consulta recorre los contadores: se repite como las demás medidas, con otro
+	// percentil cada vez para que no se pueda reutilizar el resultado
+
+	long thePercentileOps = (long)inIterations * 100;
+	volatile int64_t theSink = 0;
+
+	theMeter.start();
+	for (long i = 0; i < thePercentileOps; i++) {
+		theSink += theHistogram.getPercentile(0.5f + (float)(i % 50) * 0.01f);
+	}
+	theMeter.stop();
+	theMeter.print("LatencyHistogram::getPercentile", thePercentileOps);
+}
+
+// Hilo de vida corta que registra un mensaje (los anillos de los hilos terminados se reutilizan)
+
+static void* logThreadMain(void* inArg) {
+	Log::info("hilo %d", (int)(long)inArg);
+	return NULL;
+}
+
+// Coste de un mensaje del bucle de control: descartado por nivel y registrado (el hilo del
+// registro lo escribe en un fichero temporal). Se comprueba también el texto escrito.
+
+static bool benchLog(int inIterations) {
+
+	char thePath[] = "/tmp/ptu_xtion_bench_log_XXXXXX";
+	int theFd = mkstemp(thePath);
+
+	if (theFd < 0) {
+		printf("No se ha podido crear el fichero de registro\n");
+		return false;
+	}
+
+	close(theFd);
+
+	Log::Config theConfig;
+	theConfig.ConsoleLevel = Log::LEVEL_OFF;
+	theConfig.FileLevel = Log::LEVEL_INFO;
+	theConfig.FilePath = thePath;
+	theConfig.MaxFileBytes = 0;
+
+	long theOps = (long)inIterations * 100;
+	long theDone = 0;
+	OpMeter theFiltered;
+	OpMeter theWritten;
+	bool outOk = Log::start(theConfig) && Log::attachThread();
+
+	theFiltered.start();
+	for (long i = 0; i < theOps; i++) {
+		Log::debug("Point (%g,%g,%g)", (float)i, 2.0f, 3.0f);
+	}
+	theFiltered.stop();
+	theFiltered.print("Log::debug descartado por nivel", theOps);
+
+	// Por tandas que caben en el anillo, dejando que el hilo del registro las escriba
+
+	while (outOk && (theDone < theOps)) {
+
+		long theBatch = (theOps - theDone < LOG_RING_SLOTS / 2) ? theOps - theDone : LOG_RING_SLOTS / 2;
+
+		theWritten.start();
+		for (long i = 0; i < theBatch; i++) {
+			Log::info("Point (%g,%g,%g) cuadro %lu", 1.5f, -2.25f, 3.0f, (unsigned long)(theDone + i));
+		}
+		theWritten.stop();
+
+		theDone += theBatch;
+		usleep(2 * LOG_FLUSH_MS * 1000);
+	}
+	theWritten.print("Log::info registrado", theOps);
+
+	// El doble de hilos que anillos, uno tras otro: cada uno debe encontrar un anillo libre
+
+	const int theNumThreads = 2 * LOG_MAX_THREADS;
+
+	for (int t = 0; outOk && (t < theNumThreads); t++) {
+		pthread_t theThread;
+		outOk = (pthread_create(&theThread, NULL, logThreadMain, (void*)(long)t) == 0);
+		if (outOk) {
+			pthread_join(theThread, NULL);
+			usleep(2 * LOG_FLUSH_MS * 1000);
+		}
+	}
+
+	Log::warn("%s: pan %d, tilt %.2f, %lu bytes, %x%%", "PTU-46", -300, 12.5f, 4096UL, 255);
+
+	unsigned long theDropped = Log::getDropped();
+	Log::stop();
+
+	// Una línea por mensaje y el último con el formato de printf
+
+	FILE* theFile = fopen(thePath, "r");
+	char theLine[256] = "";
+	char theLast[256] = "";
+	long theLines = 0;
+
+	while ((theFile != NULL) && (fgets(theLine, sizeof(theLine), theFile) != NULL)) {
+		theLines++;
+		strcpy(theLast, theLine);
+	}
+
+	if (theFile != NULL) {
+		fclose(theFile);
+	}
+	unlink(thePath);
+
+	const char* theExpected = "W PTU-46: pan -300, tilt 12.50, 4096 bytes, ff%\n";
+	int theLastLength = (int)strlen(theLast);
+	int theExpectedLength = (int)strlen(theExpected);
+
+	outOk = outOk && (theDropped == 0) && (theLines == theOps + theNumThreads + 1) && (theLastLength >= theExpectedLength) &&
+			(strcmp(theLast + theLastLength - theExpectedLength, theExpected) == 0);
+
+	if (!outOk) {
+		printf("El registro no ha escrito los mensajes esperados (%ld líneas, %lu descartados) DISTINTO!\n", theLines, theDropped);
+	}
+
+	return outOk;
+}
+
+// PtuParser con respuestas juntas, sin fin de línea entre ellas y en modo normal: se comprueban
+// los eventos y se mide el coste por byte
+
+static bool benchPtuParser(int inIterations) {
+
+	const char* theStream = "*\r\n* -300\r\n! Illegal command argument\r\n**\r\nPP * Current Pan position is 1234\r\n!  Maximum allowable pan\r\n";
+	const PtuEventType theTypes[] = { PTU_EVENT_ACK, PTU_EVENT_POSITION, PTU_EVENT_ERROR, PTU_EVENT_ACK, PTU_EVENT_ACK, PTU_EVENT_POSITION, PTU_EVENT_ERROR };
+	const int theValues[] = { 0, -300, 0, 0, 0, 1234, 0 };
+	const char* theTexts[] = { "", "", "Illegal command argument", "", "", "", "Maximum allowable pan" };
+	const int theNumEvents = (int)(sizeof(theTypes) / sizeof(theTypes[0]));
+
+	int theLength = (int)strlen(theStream);
+	long theOps = (long)inIterations * 100;
+	volatile int theSink = 0;
+	PtuParser theParser;
+	PtuEvent theEvent;
+	OpMeter theMeter;
+	bool outOk = true;
+	int theNumFound = 0;
+
+	for (int i = 0; i < theLength; i++) {
+		if (theParser.feed(theStream[i], &theEvent)) {
+			outOk = outOk && (theNumFound < theNumEvents) && (theEvent.Type == theTypes[theNumFound]) &&
+					(theEvent.Value == theValues[theNumFound]) && (strcmp(theEvent.Text, theTexts[theNumFound]) == 0);
+			theNumFound++;
+		}
+	}
+
+	outOk = outOk && (theNumFound == theNumEvents) && !theParser.flush(&theEvent);
+
+	if (!outOk) {
+		printf("PtuParser no ha interpretado las respuestas DISTINTO!\n");
+	}
+
+	theMeter.start();
+	for (long i = 0; i < theOps; i++) {
+		for (int j = 0; j < theLength; j++) {
+			if (theParser.feed(theStream[j], &theEvent)) {
+				theSink += theEvent.Value;
+			}
+		}
+	}
+	theMeter.stop();
+	theMeter.print("PtuParser::feed (por byte)", theOps * theLength);
+
+	return outOk;
+}
+
+// processPtuComm con respuestas típicas de la PTU-46 (modo escueto) recibidas por un pseudoterminal.
+// Solo se mide la llamada: la escritura en el pseudoterminal y la espera a que los datos
+// lleguen al otro extremo quedan fuera.
+
+static bool benchPtuComm(int inIterations) {
+
+	struct Response {
+		estado myStatus;
+		const char* myText;
+		const char* myName;
+	};
+
+	const Response theResponses[] = {
+		{ WAIT_COMMAND_CONF, "*\r\n", "processPtuComm confirmacion" },
+		{ WAIT_COMMAND_CONF, "! Illegal command argument\r\n", "processPtuComm error" },
+		{ WAIT_POS_TILT, "* -300\r\n", "processPtuComm posicion" }
+	};
+
+	int theMaster = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if ((theMaster < 0) || (grantpt(theMaster) != 0) || (unlockpt(theMaster) != 0)) {
+		printf("No se ha podido crear el pseudoterminal\n");
+		return false;
+	}
+
+	PtuLink theLink;
+	theLink.Port = new Serial::Serial_Q(ptsname(theMaster), B9600);
+
+	int thePollFd = open(ptsname(theMaster), O_RDONLY | O_NOCTTY | O_NONBLOCK);
+	struct pollfd thePoll = { thePollFd, POLLIN, 0 };
+	bool outOk = (theLink.Port->LastError == NULL) && (thePollFd >= 0);
+
+	for (int r = 0; outOk && (r < 3); r++) {
+
+		long theOps = (long)inIterations * 10;
+		int theLength = (int)strlen(theResponses[r].myText);
+		OpMeter theMeter;
+
+		for (long i = 0; outOk && (i < theOps); i++) {
+
+			outOk = (write(theMaster, theResponses[r].myText, theLength) == theLength) && (poll(&thePoll, 1, 1000) == 1);
+
+			theLink.Status = theResponses[r].myStatus;
+			theMeter.start();
+			processPtuComm(&theLink);
+			theMeter.stop();
+
+			outOk = outOk && (theLink.Status == IDLE) && (theLink.Port->getNumBytesInQ() == 0);
+		}
+
+		theMeter.print(theResponses[r].myName, theOps);
+	}
+
+	if (!outOk) {
+		printf("processPtuComm no ha procesado las respuestas DISTINTO!\n");
+	}
+
+	closePtu(&theLink);
+	close(thePollFd);
+	close(theMaster);
+
+	return outOk;
+}
+
+// Abre la PTU en el extremo cliente de un simulador ya iniciado
+
+static bool openSimulatedPtu(PtuLink* ioLink, Sim::PtuSimulator* inSimulator) {
+
+	ioLink->Port = new Serial::Serial_Q(inSimulator->getDeviceName(), Serial::Serial::getBaudConstant(PTU_DEFAULT_BPS));
+
+	if (ioLink->Port->LastError != NULL) {
+		printf("No se puede abrir la PTU simulada: %s\n", ioLink->Port->LastError);
+		closePtu(ioLink);
+		return false;
+	}
+
+	return true;
+}
+
+// Protocolo de la PTU contra el simulador: sin límite de velocidad (coste del envío, del
+// despertar del bucle de eventos y del procesado), con el enlace y el movimiento simulados
+// (latencias esperables con la PTU real) y con errores inyectados
+
+static bool benchPtuSim(int inIterations) {
+
+	long theOps = (long)inIterations * 10;
+	bool outOk = true;
+
+	// Sin límite de velocidad: ida y vuelta, negociación y enlace
+
+	{
+		Sim::PtuSimConfig theConfig;
+		theConfig.Bps = 0;
+		theConfig.PanSpeed = 0;
+		theConfig.TiltSpeed = 0;
+
+		Sim::PtuSimulator theSimulator(theConfig);
+		PtuLink theLink;
+		OpMeter theMeter;
+
+		outOk = theSimulator.start() && openSimulatedPtu(&theLink, &theSimulator);
+
+		theMeter.start();
+		for (long i = 0; outOk && (i < theOps); i++) {
+			outOk = sendPtuCommand(&theLink, "PO100 ", PTU_COMMAND_TIMEOUT_MS) && sendPtuCommand(&theLink, "PO-100 ", PTU_COMMAND_TIMEOUT_MS);
+		}
+		theMeter.stop();
+		theMeter.print("sendPtuCommand ida y vuelta", theOps * 2);
+
+		if (!outOk) {
+			printf("sendPtuCommand no ha recibido la confirmación (%lu sin respuesta)\n", theLink.Timeouts);
+		}
+
+		// Recorre el cambio de velocidad del puerto y las consultas
+
+		outOk = outOk && (negotiatePtuBaud(&theLink, 38400) == 38400);
+		if (outOk) {
+			benchPtuLink(&theLink, (int)theOps, theConfig.Bps != 0);
+		} else {
+			printf("negotiatePtuBaud no ha llegado a 38400 bps\n");
+		}
+
+		closePtu(&theLink);
+	}
+
+	// Enlace a 9600 bps, negociado hasta 38400, y secuencia inicial con movimiento
+
+	if (outOk) {
+
+		Sim::PtuSimConfig theConfig;
+		theConfig.PanSpeed = 10 * PTU_SIM_DEFAULT_SPEED;
+		theConfig.TiltSpeed = 10 * PTU_SIM_DEFAULT_SPEED;
+
+		Sim::PtuSimulator theSimulator(theConfig);
+		PtuLink theLink;
+		int theRounds = (inIterations < 100) ? inIterations : 100;
+
+		outOk = theSimulator.start() && openSimulatedPtu(&theLink, &theSimulator);
+
+		if (outOk) {
+			benchPtuLink(&theLink, theRounds);
+			outOk = (negotiatePtuBaud(&theLink, 38400) == 38400);
+		}
+
+		if (outOk) {
+
+			benchPtuLink(&theLink, theRounds);
+
+			// Pan no se mueve; tilt va a -300 y vuelve a 600 (1200 pasos)
+
+			int64_t theStart = Timing::nowNs();
+			ceroPtu(&theLink);
+			double theMs = (Timing::nowNs() - theStart) * 1e-6;
+
+			printf("ceroPtu simulado: %.1f ms (%.1f ms de movimiento)\n", theMs, 1200 * 1e3 / theConfig.TiltSpeed);
+			outOk = (theSimulator.getPosition(TILT) == PTU_HOME_TILT_POS);
+		}
+
+		if (!outOk) {
+			printf("PTU simulada a 9600 bps: la negociación o la secuencia inicial ha fallado DISTINTO!\n");
+		}
+
+		closePtu(&theLink);
+	}
+
+	// Errores inyectados: cada uno debe contar como una orden fallida
+
+	if (outOk) {
+
+		Sim::PtuSimConfig theConfig;
+		theConfig.Bps = 0;
+		theConfig.ErrorRate = 0.1f;
+
+		Sim::PtuSimulator theSimulator(theConfig);
+		PtuLink theLink;
+		int theFailed = 0;
+
+		outOk = theSimulator.start() && openSimulatedPtu(&theLink, &theSimulator);
+
+		for (long i = 0; outOk && (i < theOps); i++) {
+			outOk = queuePtuQuery(&theLink, (i & 1) ? TILT : PAN);
+			theFailed += waitPtuCommands(&theLink, PTU_MAX_IN_FLIGHT / 2);
+		}
+		theFailed += waitPtuCommands(&theLink, 0);
+
+		Sim::PtuSimStats theStats = theSimulator.getStats();
+
+		printf("PTU simulada con errores: %d órdenes fallidas, %lu errores inyectados\n", theFailed, theStats.InjectedErrors);
+		outOk = outOk && (theFailed == (int)theStats.InjectedErrors) && (theStats.Commands == (unsigned long)theOps);
+
+		if (!outOk) {
+			printf("Las órdenes fallidas no coinciden con los errores inyectados DISTINTO!\n");
+		}
+
+		closePtu(&theLink);
+	}
+
+	return outOk;
+}
+
+// Varias PTU a la vez, cada una con su hilo y su PtuLink (como las unidades de ptu_xtion):
+// cada hilo coloca su PTU en una posición distinta y la consulta encadenando órdenes a
+// 38400 bps. Las posiciones leídas deben ser las de su PTU y, como cada enlace está limitado
+// por su velocidad, el ritmo por PTU debe ser el de una sola.
+
+#define BENCH_MAX_UNITS 4
+
+struct UnitRun {
+	Sim::PtuSimulator* mySimulator;
+	int myPanSteps;
+	int myRounds;
+	bool myOk;
+	double myQueriesPerS;
+};
+
+static void* runPtuUnit(void* inRun) {
+
+	UnitRun* theRun = (UnitRun*)inRun;
+	PtuLink theLink;
+	char theCommand[16];
+
+
+	theRun->myOk = openSimulatedPtu(&theLink, theRun->mySimulator);
+
+	snprintf(theCommand, sizeof(theCommand), "PP%d ", theRun->myPanSteps);
+	theRun->myOk = theRun->myOk && sendPtuCommand(&theLink, theCommand, PTU_COMMAND_TIMEOUT_MS);
+
+	int64_t theStart = Timing::nowNs();
+	int theFailed = 0;
+
+	for (int i = 0; theRun->myOk && (i < theRun->myRounds); i++) {
+		queuePtuQuery(&theLink, PAN);
+		theFailed += waitPtuCommands(&theLink, PTU_MAX_IN_FLIGHT / 2);
+	}
+	theFailed += waitPtuCommands(&theLink, 0);
+
+	theRun->myQueriesPerS = theRun->myRounds / ((Timing::nowNs() - theStart) * 1e-9);
+
+	float theExpected = theRun->myPanSteps * PAN_RESOLUTION / 3600;
+
+	theRun->myOk = theRun->myOk && (theFailed == 0) && (theLink.JointState.NumUpdates[PAN] == (unsigned long)theRun->myRounds) &&
+			(fabs(theLink.JointState.Position[PAN] - theExpected) < 0.01f);
+
+	closePtu(&theLink);
+
+	return NULL;
+}
+
+static bool benchPtuUnits(int inIterations) {
+
+	int theRounds = inIterations * 2;
+	bool outOk = true;
+
+	for (int theNumUnits = 1; outOk && (theNumUnits <= BENCH_MAX_UNITS); theNumUnits *= 2) {
+
+		Sim::PtuSimConfig theConfig;
+		theConfig.Bps = 38400;
+		theConfig.PanSpeed = 0;
+		theConfig.TiltSpeed = 0;
+
+		Sim::PtuSimulator* theSimulators[BENCH_MAX_UNITS];
+		UnitRun theRuns[BENCH_MAX_UNITS];
+		pthread_t theThreads[BENCH_MAX_UNITS];
+
+		for (int u = 0; u < theNumUnits; u++) {
+			theSimulators[u] = new Sim::PtuSimulator(theConfig);
+			theRuns[u].mySimulator = theSimulators[u];
+			theRuns[u].myPanSteps = 100 * (u + 1);
+			theRuns[u].myRounds = theRounds;
+			theRuns[u].myOk = false;
+			theRuns[u].myQueriesPerS = 0;
+			outOk = outOk && theSimulators[u]->start();
+		}
+
+		for (int u = 0; outOk && (u < theNumUnits); u++) {
+			pthread_create(&theThreads[u], NULL, runPtuUnit, &theRuns[u]);
+		}
+
+		double theTotal = 0;
+
+		for (int u = 0; outOk && (u < theNumUnits); u++) {
+			pthread_join(theThreads[u], NULL);
+			theTotal += theRuns[u].myQueriesPerS;
+		}
+
+		for (int u = 0; u < theNumUnits; u++) {
+			outOk = outOk && theRuns[u].myOk;
+			delete theSimulators[u];
+		}
+
+		printf("%d PTU simuladas a la vez a 38400 bps: %.0f consultas/s por PTU, %.0f en total\n", theNumUnits, theTotal / theNumUnits, theTotal);
+
+		if (!outOk) {
+			printf("Las posiciones leídas no son las de cada PTU DISTINTO!\n");
+		}
+	}
+
+	return outOk;
+}
+
+// Grabación: cuadros desde un hilo a 4 veces la velocidad del sensor mientras otro graba las
+// órdenes, respuestas y posiciones de una PTU simulada por su enlace. Se comprueba todo al
+// leerlo, la búsqueda por instante y que una grabación sin cerrar se recupera.
+
+#define BENCH_RECORD_FRAMES			150
+#define BENCH_RECORD_SEGMENT_BYTES	(16ULL * 1024 * 1024)
+#define BENCH_RECORD_PERIOD_US		8000
+
+struct RecordRun {
+	Record::Recorder* myRecorder;
+	volatile bool myStop;
+	bool myOk;
+	unsigned long myQueries;
+};
+
+static void* runRecordedPtu(void* inRun) {
+
+	RecordRun* theRun = (RecordRun*)inRun;
+	PtuLink theLink;
+
+	Sim::PtuSimConfig theConfig;
+	theConfig.Bps = 0;
+	theConfig.PanSpeed = 0;
+	theConfig.TiltSpeed = 0;
+
+	Sim::PtuSimulator theSimulator(theConfig);
+
+
+	theRun->myOk = theSimulator.start() && openSimulatedPtu(&theLink, &theSimulator);
+	theLink.Recorder = theRun->myRecorder;
+
+	// Se va y se vuelve para no llegar al límite del pan
+
+	while (theRun->myOk && !theRun->myStop) {
+		theRun->myOk = sendPtuCommand(&theLink, (theRun->myQueries % 2 == 0) ? "PO10 " : "PO-10 ", PTU_COMMAND_TIMEOUT_MS) && queuePtuQuery(&theLink, PAN) && (waitPtuCommands(&theLink, 0) == 0);
+		theRun->myQueries++;
+		usleep(1000);
+	}
+
+	theLink.Recorder = NULL;
+	closePtu(&theLink);
+
+	return NULL;
+}
+
+static void removeRecording(const char* inPrefix) {
+
+	char thePath[300];
+
+	for (int s = 0; ; s++) {
+		snprintf(thePath, sizeof(thePath), "%s.%04d.rec", inPrefix, s);
+		if (unlink(thePath) != 0) {
+			break;
+		}
+	}
+
+}
+
+static bool benchRecorder(int inIterations) {
+
+	char theDir[] = "/tmp/ptu_xtion_bench_rec_XXXXXX";
+
+	if (mkdtemp(theDir) == NULL) {
+		printf("No se ha podido crear el directorio de la grabación\n");
+		return false;
+	}
+
+	char thePrefix[64];
+	snprintf(thePrefix, sizeof(thePrefix), "%s/unidad", theDir);
+
+	vector< vector<uint16_t> > theFrames(8, vector<uint16_t>(FRAME_WIDTH * FRAME_HEIGHT));
+	for (size_t f = 0; f < theFrames.size(); f++) {
+		fillMovingTarget(theFrames[f], (int)f * 10);
+	}
+
+	// Escritura
+
+	Record::Recorder theRecorder;
+	RecordRun theRun;
+	pthread_t thePtuThread;
+	Timing::LatencyHistogram theLatency;
+	OpMeter theMeter;
+	int64_t theStamps[BENCH_RECORD_FRAMES];
+
+	theRun.myRecorder = &theRecorder;
+	theRun.myStop = false;
+	theRun.myOk = false;
+	theRun.myQueries = 0;
+
+	// Aquí se mide la copia en bruto; la compresión, en benchCodec
+
+	theRecorder.setCompression(false);
+
+	bool outOk = theRecorder.open(thePrefix, BENCH_RECORD_SEGMENT_BYTES) && (pthread_create(&thePtuThread, NULL, runRecordedPtu, &theRun) == 0);
+
+	for (int f = 0; outOk && (f < BENCH_RECORD_FRAMES); f++) {
+
+		usleep(BENCH_RECORD_PERIOD_US);
+
+		theStamps[f] = Timing::nowNs();
+
+		theMeter.start();
+		outOk = theRecorder.recordDepth(&theFrames[f % theFrames.size()][0], FRAME_WIDTH, FRAME_HEIGHT, (uint64_t)f * 33333, theStamps[f]);
+		theMeter.stop();
+
+		theLatency.record(Timing::nowNs() - theStamps[f]);
+	}
+
+	theRun.myStop = true;
+	pthread_join(thePtuThread, NULL);
+
+	unsigned long theNumRecords = theRecorder.getNumRecords();
+	unsigned long theDropped = theRecorder.getDropped();
+	uint32_t theNumSegments = theRecorder.getNumSegments();
+
+	theRecorder.close();
+
+	theMeter.print("Recorder::recordDepth 640x480", BENCH_RECORD_FRAMES);
+	Timing::LatencyHistogram::printHeader();
+	theLatency.print("recordDepth");
+	printf("Grabación: %lu registros en %u segmentos de %llu MB, %lu descartados, %.0f MB/s al copiar\n", theNumRecords, theNumSegments,
+			BENCH_RECORD_SEGMENT_BYTES >> 20, theDropped, FRAME_WIDTH * FRAME_HEIGHT * 2.0 * BENCH_RECORD_FRAMES / theLatency.getMean() / theLatency.getCount() * 1e3);
+
+	outOk = outOk && theRun.myOk && (theDropped == 0) && (theNumSegments > 1);
+
+	// Lectura: cuadros (sin copiarlos), búsqueda por instante y recorrido de todos los registros
+
+	Record::RecordingReader theReader;
+	OpMeter theFindMeter;
+	unsigned long theCounts[5] = { 0, 0, 0, 0, 0 };
+	unsigned long theFailedReplies = 0;
+	long theLookups = (long)inIterations * 100;
+	long theFound = 0;
+
+	outOk = outOk && theReader.open(thePrefix) && (theReader.getNumFrames() == BENCH_RECORD_FRAMES) &&
+			(theReader.getNumSegments() == (int)theNumSegments) && (theReader.getNumRecovered() == 0);
+
+	for (unsigned long f = 0; outOk && (f < theReader.getNumFrames()); f++) {
+		const Record::DepthRecord* theFrame = theReader.getFrame(f);
+		outOk = (theFrame->Frame == f) && (theFrame->Header.StampNs == theStamps[f]) && (theFrame->SensorTimestampUs == f * 33333) &&
+				(theFrame->Width == FRAME_WIDTH) && (theFrame->Height == FRAME_HEIGHT) &&
+				(memcmp(Record::getPixels(theFrame), &theFrames[f % theFrames.size()][0], FRAME_WIDTH * FRAME_HEIGHT * 2) == 0);
+	}
+
+	theFindMeter.start();
+	for (long i = 0; outOk && (i < theLookups); i++) {
+		int f = (int)(i % BENCH_RECORD_FRAMES);
+		theFound += (theReader.findFrame(theStamps[f]) == f) && (theReader.findFrame(theStamps[f] - 1) == f);
+	}
+	theFindMeter.stop();
+	theFindMeter.print("RecordingReader::findFrame", theLookups * 2);
+
+	outOk = outOk && (theFound == theLookups) && (theReader.findFrame(theStamps[BENCH_RECORD_FRAMES - 1] + 1) == -1);
+
+	Record::RecordCursor theCursor;
+	const Record::RecordHeader* theRecord;
+	int64_t theLastFrameNs = 0;
+
+	while (outOk && ((theRecord = theReader.next(&theCursor)) != NULL)) {
+		theCounts[(theRecord->Type < 5) ? theRecord->Type : 0]++;
+		if (theRecord->Type == Record::RECORD_DEPTH) {
+			outOk = (theRecord->StampNs > theLastFrameNs);
+			theLastFrameNs = theRecord->StampNs;
+		} else if ((theRecord->Type == Record::RECORD_REPLY) && !((const Record::ReplyRecord*)theRecord)->Ok) {
+			theFailedReplies++;
+		}
+	}
+
+	// Desde el cuadro que sigue a un instante: el cuadro y lo grabado después
+
+	unsigned long theAfter = 0;
+
+	if (outOk && theReader.seekFrame(theReader.findFrame(theStamps[BENCH_RECORD_FRAMES / 2]), &theCursor)) {
+		const Record::DepthRecord* theFrame = (const Record::DepthRecord*)theReader.next(&theCursor);
+		outOk = (theFrame != NULL) && (theFrame->Frame == BENCH_RECORD_FRAMES / 2);
+		while (theReader.next(&theCursor) != NULL) {
+			theAfter++;
+		}
+	}
+
+	theReader.close();
+
+	// Cada consulta es una orden y una consulta, con sus respuestas y una posición
+
+	outOk = outOk && (theCounts[0] == 0) && (theCounts[Record::RECORD_DEPTH] == BENCH_RECORD_FRAMES) &&
+			(theCounts[Record::RECORD_COMMAND] == 2 * theRun.myQueries) && (theCounts[Record::RECORD_REPLY] == 2 * theRun.myQueries) &&
+			(theCounts[Record::RECORD_JOINT] == theRun.myQueries) && (theFailedReplies == 0) &&
+			(theAfter > 0) && (theAfter < theNumRecords - BENCH_RECORD_FRAMES / 2);
+
+	printf("Lectura: %lu cuadros, %lu órdenes, %lu respuestas, %lu posiciones\n", theCounts[Record::RECORD_DEPTH],
+			theCounts[Record::RECORD_COMMAND], theCounts[Record::RECORD_REPLY], theCounts[Record::RECORD_JOINT]);
+
+	if (!outOk) {
+		printf("La grabación leída no coincide con la escrita DISTINTO!\n");
+	}
+
+	removeRecording(thePrefix);
+
+	// Un proceso que termina sin cerrar la grabación
+
+	pid_t theChild = outOk ? fork() : -1;
+
+	if (theChild == 0) {
+		Record::Recorder theCrashing;
+		if (theCrashing.open(thePrefix, BENCH_RECORD_SEGMENT_BYTES)) {
+			for (int f = 0; f < 20; f++) {
+				theCrashing.recordDepth(&theFrames[f % theFrames.size()][0], FRAME_WIDTH, FRAME_HEIGHT, f, Timing::nowNs());
+				theCrashing.recordJoint(PAN, (float)f, Timing::nowNs());
+			}
+		}
+		_exit(0);
+	}
+
+	if (theChild > 0) {
+
+		int theStatus;
+		unsigned long theJoints = 0;
+		vector<uint16_t> theDepth(FRAME_WIDTH * FRAME_HEIGHT);
+
+		waitpid(theChild, &theStatus, 0);
+
+		// También queda sin cerrar el segmento siguiente, ya preparado y vacío
+
+		outOk = theReader.open(thePrefix) && (theReader.getNumRecovered() >= 1) && (theReader.getNumFrames() == 20);
+
+		Record::RecordCursor theCrashCursor;
+		while (outOk && ((theRecord = theReader.next(&theCrashCursor)) != NULL)) {
+			theJoints += (theRecord->Type == Record::RECORD_JOINT);
+		}
+
+		outOk = outOk && (theJoints == 20) && Record::getDepth(theReader.getFrame(19), &theDepth[0]) && (theDepth == theFrames[19 % theFrames.size()]);
+
+		theReader.close();
+
+		printf("Grabación sin cerrar: %s\n", outOk ? "recuperados los 20 cuadros y las 20 posiciones" : "no se ha recuperado DISTINTO!");
+
+		removeRecording(thePrefix);
+	}
+
+	rmdir(theDir);
+
+	return outOk;
+}
+
+// Habitación sintética más parecida a un cuadro real: suelo y pared con la cuantización
+// del sensor (el paso crece con la distancia), una caja cercana con su sombra sin medida a
+// la izquierda, una ventana fuera de rango y un ruido de ±1 en algunos pixeles
+
+static void fillRoom(vector<uint16_t>& outFrame, int inFrameIndex) {
+
+	int theBoxX = 200 + (inFrameIndex * 7) % 200;
+
+	srand(inFrameIndex);
+	outFrame.resize(FRAME_WIDTH * FRAME_HEIGHT);
+
+	for (int y = 0; y < FRAME_HEIGHT; y++) {
+		for (int x = 0; x < FRAME_WIDTH; x++) {
+
+			int theZ = (y > 300) ? 1500 + (FRAME_HEIGHT - y) * 20 : 3500 + x;
+
+			if ((x >= theBoxX) && (x < theBoxX + 120) && (y >= 150) && (y < 350)) {
+				theZ = 1200 + (y - 150) / 2;
+			} else if ((x >= theBoxX - 15) && (x < theBoxX) && (y >= 150) && (y < 350)) {
+				theZ = 0;
+			} else if ((x > 480) && (x < 600) && (y > 40) && (y < 160)) {
+				theZ = 0;
+			}
+
+			if (theZ > 0) {
+				theZ -= theZ % (1 + theZ / 1000);
+				theZ += (rand() % 8 == 0) ? rand() % 3 - 1 : 0;
+			}
+
+			outFrame[y * FRAME_WIDTH + x] = (uint16_t)theZ;
+		}
+	}
+}
+
+// Depth::encodeFrame / decodeFrame por implementación sobre una secuencia de cuadros
+
+static bool benchCodecFrames(const char* inName, const vector< vector<uint16_t> >& inFrames, int inWidth, int inHeight, int inRounds) {
+
+	bool outOk = true;
+	const Depth::Kernel theKernels[] = { Depth::KERNEL_SCALAR, Depth::KERNEL_SSE41 };
+	double theRawBytes = (double)inWidth * inHeight * 2 * inFrames.size();
+	vector< vector<uint8_t> > theScalarBytes(inFrames.size());
+	vector<uint8_t> theBytes(Depth::getEncodedBound(inWidth, inHeight));
+	vector<uint16_t> theDepth(inWidth * inHeight);
+	double theScalarEncodeNs = 0;
+
+	for (int k = 0; k < 2; k++) {
+
+		if (!Depth::isKernelSupported(theKernels[k])) {
+			continue;
+		}
+
+		Depth::setKernel(theKernels[k]);
+
+		double theEncodedBytes = 0;
+		bool theSame = true;
+
+		// Ida y vuelta de cada cuadro, y los mismos bytes con cada implementación
+
+		for (size_t f = 0; f < inFrames.size(); f++) {
+			size_t theNumBytes = Depth::encodeFrame(&inFrames[f][0], inWidth, inHeight, &theBytes[0]);
+			theEncodedBytes += theNumBytes;
+			theSame = theSame && Depth::decodeFrame(&theBytes[0], theNumBytes, inWidth, inHeight, &theDepth[0]) && (theDepth == inFrames[f]);
+			if (k == 0) {
+				theScalarBytes[f].assign(theBytes.begin(), theBytes.begin() + theNumBytes);
+			} else {
+				theSame = theSame && (theScalarBytes[f].size() == theNumBytes) && (memcmp(&theScalarBytes[f][0], &theBytes[0], theNumBytes) == 0);
+			}
+		}
+
+		long theOps = (long)inRounds * inFrames.size();
+
+		double theStart = nowNs();
+		for (long i = 0; i < theOps; i++) {
+			Depth::encodeFrame(&inFrames[i % inFrames.size()][0], inWidth, inHeight, &theBytes[0]);
+		}
+		double theEncodeNs = (nowNs() - theStart) / theOps;
+
+		size_t theLastBytes = Depth::encodeFrame(&inFrames[0][0], inWidth, inHeight, &theBytes[0]);
+
+		theStart = nowNs();
+		for (long i = 0; i < theOps; i++) {
+			Depth::decodeFrame(&theBytes[0], theLastBytes, inWidth, inHeight, &theDepth[0]);
+		}
+		double theDecodeNs = (nowNs() - theStart) / theOps;
+
+		if (k == 0) {
+			theScalarEncodeNs = theEncodeNs;
+		}
+
+		outOk = outOk && theSame;
+
+		printf("%-10s %-8s %8.2f %10.0f %10.0f %10.0f %10.0f x%.2f%s\n", inName, Depth::getKernelName(theKernels[k]), theRawBytes / theEncodedBytes,
+				theRawBytes / inFrames.size() / theEncodeNs * 1e3, theRawBytes / inFrames.size() / theDecodeNs * 1e3,
+				1e9 / theEncodeNs, 1e9 / theDecodeNs, theScalarEncodeNs / theEncodeNs, theSame ? "" : " DISTINTO!");
+	}
+
+	Depth::setKernel(Depth::KERNEL_AUTO);
+
+	return outOk;
+}
+
+static bool benchCodec(int inIterations, const char* inRecording) {
+
+	const int theNumFrames = 8;
+	int theRounds = (inIterations + 9) / 10;
+	bool outOk = true;
+
+	vector< vector<uint16_t> > theScene(1);
+	vector< vector<uint16_t> > theTarget(theNumFrames, vector<uint16_t>(FRAME_WIDTH * FRAME_HEIGHT));
+	vector< vector<uint16_t> > theRoom(theNumFrames);
+
+	fillScene(theScene[0], FRAME_WIDTH, FRAME_HEIGHT);
+
+	for (int f = 0; f < theNumFrames; f++) {
+		fillMovingTarget(theTarget[f], f);
+		fillRoom(theRoom[f], f);
+	}
+
+	printf("\nDepth::encodeFrame / decodeFrame (MB/s del cuadro sin comprimir; el sensor da 30 cuadros/s)\n");
+	printf("%-10s %-8s %8s %10s %10s %10s %10s\n", "cuadros", "kernel", "razón", "MB/s comp", "MB/s desc", "cuadros/s", "desc/s");
+
+	outOk = benchCodecFrames("pared", theScene, FRAME_WIDTH, FRAME_HEIGHT, theRounds * theNumFrames) && outOk;
+	outOk = benchCodecFrames("objetivo", theTarget, FRAME_WIDTH, FRAME_HEIGHT, theRounds) && outOk;
+	outOk = benchCodecFrames("habitación", theRoom, FRAME_WIDTH, FRAME_HEIGHT, theRounds) && outOk;
+
+	if (inRecording != NULL) {
+
+		vector< vector<uint16_t> > theFrames;
+		int theWidth = 0, theHeight = 0;
+
+		if (loadRecording(inRecording, 300, theFrames, &theWidth, &theHeight) > 0) {
+			outOk = benchCodecFrames("oni", theFrames, theWidth, theHeight, (theRounds + 9) / 10) && outOk;
+		} else {
+			printf("No se ha podido leer %s\n", inRecording);
+		}
+	}
+
+	// Casos límite: cuadros sin ninguna medida, constantes, de ancho no múltiplo del bloque
+	// y con saltos de todo el rango; y un cuadro comprimido truncado
+
+	const int theEdgeSizes[][2] = { { 640, 480 }, { 1, 1 }, { 17, 3 }, { 333, 7 } };
+	bool theEdgeOk = true;
+
+	for (int s = 0; s < 4; s++) {
+
+		int theWidth = theEdgeSizes[s][0], theHeight = theEdgeSizes[s][1];
+		vector<uint16_t> theFrame(theWidth * theHeight), theDepth(theWidth * theHeight);
+		vector<uint8_t> theBytes(Depth::getEncodedBound(theWidth, theHeight));
+
+		for (int c = 0; c < 3; c++) {
+
+			srand(s * 3 + c);
+			for (int p = 0; p < theWidth * theHeight; p++) {
+				theFrame[p] = (c == 0) ? 0 : (c == 1) ? 2500 : (uint16_t)((rand() % 3 == 0) ? 0 : (rand() % 2) ? 0xffff : 1);
+			}
+
+			size_t theNumBytes = Depth::encodeFrame(&theFrame[0], theWidth, theHeight, &theBytes[0]);
+			theEdgeOk = theEdgeOk && (theNumBytes <= theBytes.size()) &&
+					Depth::decodeFrame(&theBytes[0], theNumBytes, theWidth, theHeight, &theDepth[0]) && (theDepth == theFrame) &&
+					!Depth::decodeFrame(&theBytes[0], theNumBytes - 1, theWidth, theHeight, &theDepth[0]);
+		}
+	}
+
+	printf("Casos límite (vacío, constante, saltos de 16 bits, anchos de 1, 17 y 333): %s\n", theEdgeOk ? "ok" : "DISTINTO!");
+	outOk = outOk && theEdgeOk;
+
+	// Grabación comprimida: lo que cuesta recordDepth y lo que se lee con getDepth
+
+	char theDir[] = "/tmp/ptu_xtion_bench_codec_XXXXXX";
+
+	if (mkdtemp(theDir) == NULL) {
+		printf("No se ha podido crear el directorio de la grabación\n");
+		return false;
+	}
+
+	char thePrefix[64];
+	snprintf(thePrefix, sizeof(thePrefix), "%s/unidad", theDir);
+
+	Record::Recorder theRecorder;
+	Record::RecordingReader theReader;
+	Timing::LatencyHistogram theLatency;
+	OpMeter theMeter;
+	vector<uint16_t> theDepth(FRAME_WIDTH * FRAME_HEIGHT);
+	int theRecorded = 0;
+	bool theRecordOk = theRecorder.open(thePrefix, BENCH_RECORD_SEGMENT_BYTES);
+
+	theRecorder.reserveFrames(FRAME_WIDTH, FRAME_HEIGHT);
+
+	for (int f = 0; theRecordOk && (f < BENCH_RECORD_FRAMES); f++) {
+		usleep(BENCH_RECORD_PERIOD_US);
+		int64_t theStart = Timing::nowNs();
+		theMeter.start();
+		theRecordOk = theRecorder.recordDepth(&theRoom[f % theNumFrames][0], FRAME_WIDTH, FRAME_HEIGHT, f, theStart);
+		theMeter.stop();
+		theLatency.record(Timing::nowNs() - theStart);
+		theRecorded++;
+	}
+
+	uint64_t theBytesWritten = theRecorder.getBytesWritten();
+	theRecorder.close();
+
+	theRecordOk = theRecordOk && theReader.open(thePrefix) && (theReader.getNumFrames() == BENCH_RECORD_FRAMES);
+
+	for (unsigned long f = 0; theRecordOk && (f < theReader.getNumFrames()); f++) {
+		const Record::DepthRecord* theFrame = theReader.getFrame(f);
+		theRecordOk = (theFrame->Encoding == Record::DEPTH_CODEC) && Record::getDepth(theFrame, &theDepth[0]) && (theDepth == theRoom[f % theNumFrames]);
+	}
+
+	theReader.close();
+	removeRecording(thePrefix);
+	rmdir(theDir);
+
+	theMeter.print("Recorder::recordDepth comprimido", theRecorded);
+	Timing::LatencyHistogram::printHeader();
+	theLatency.print("recordDepth");
+	printf("Grabación comprimida: %d cuadros en %.1f MB (%.1f MB sin comprimir)%s\n", theRecorded, theBytesWritten / 1048576.0,
+			FRAME_WIDTH * FRAME_HEIGHT * 2.0 * theRecorded / 1048576.0, theRecordOk ? "" : " DISTINTO!");
+
+	return outOk && theRecordOk;
+}
+
+int main(int argc, char ** argv) {
+
+	int theIterations = (argc > 1) ? atoi(argv[1]) : 200;
+	const char* theRecording = (argc > 2) ? argv[2] : NULL;
+	bool theOk = true;
+
+	if (theIterations <= 0) {
+		printf("Uso: %s [iteraciones] [grabacion.oni]\n", argv[0]);
+		return 1;
+	}
+
+	theOk = benchFindMin(theIterations) && theOk;
+	theOk = benchClosestPoint(theIterations) && theOk;
+	theOk = benchTracker(theIterations) && theOk;
+	theOk = benchBlob(theIterations) && theOk;
+	theOk = benchStats(theIterations) && theOk;
+	theOk = benchWorld(theIterations) && theOk;
+	theOk = benchModeSwitch(theIterations) && theOk;
+
+	benchClosestPointOps(theIterations, theRecording);
+	benchQueue(theIterations);
+	benchPosCommand(theIterations);
+	benchLatency(theIterations);
+	theOk = benchLog(theIterations) && theOk;
+	theOk = benchPtuParser(theIterations) && theOk;
+	theOk = benchPtuComm(theIterations) && theOk;
+	theOk = benchPtuSim(theIterations) && theOk;
+	theOk = benchPtuUnits(theIterations) && theOk;
+	theOk = benchRecorder(theIterations) && theOk;
+	theOk = benchCodec(theIterations, theRecording) && theOk;
+
+	return theOk ? 0 : 1;
+}